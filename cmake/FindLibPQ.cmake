@@ -0,0 +1,72 @@
+#.rst:
+# FindLibPQ
+# ---------
+#
+# Try to find libpq, the PostgreSQL client library.
+#
+# This will define the following variables:
+#
+# ``LibPQ_FOUND``
+#     True if libpq is available.
+#
+# ``LibPQ_VERSION``
+#     The version of libpq
+#
+# ``LibPQ_INCLUDE_DIRS``
+#     This should be passed to target_include_directories() if
+#     the target is not used for linking
+#
+# ``LibPQ_LIBRARIES``
+#     This can be passed to target_link_libraries() instead of
+#     the ``LibPQ::LibPQ`` target
+#
+# If ``LibPQ_FOUND`` is TRUE, the following imported target
+# will be available:
+#
+# ``LibPQ::LibPQ``
+#     The PostgreSQL client library
+#
+# Unlike CMake's own FindPostgreSQL module, this does not require the
+# PostgreSQL server headers to be installed.
+#
+#=============================================================================
+# Copyright (C) 2005-2022 by the Quassel Project - devel@quassel-irc.org
+#
+# Redistribution and use is allowed according to the terms of the BSD license.
+#=============================================================================
+
+find_path(LibPQ_INCLUDE_DIRS NAMES libpq-fe.h PATH_SUFFIXES postgresql pgsql)
+find_library(LibPQ_LIBRARIES NAMES pq libpq)
+
+if (LibPQ_INCLUDE_DIRS AND EXISTS ${LibPQ_INCLUDE_DIRS}/pg_config.h)
+    file(STRINGS ${LibPQ_INCLUDE_DIRS}/pg_config.h _PG_VERSION_LINE REGEX "#define PG_VERSION_NUM[ ]+[0-9]+")
+    string(REGEX REPLACE ".*PG_VERSION_NUM[ ]+([0-9]+).*" "\\1" _PG_VERSION_NUM "${_PG_VERSION_LINE}")
+    if (_PG_VERSION_NUM)
+        math(EXPR _PG_VERSION_MAJOR "${_PG_VERSION_NUM} / 10000")
+        math(EXPR _PG_VERSION_MINOR "${_PG_VERSION_NUM} % 10000")
+        set(LibPQ_VERSION "${_PG_VERSION_MAJOR}.${_PG_VERSION_MINOR}")
+    endif()
+endif()
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LibPQ
+    FOUND_VAR LibPQ_FOUND
+    REQUIRED_VARS LibPQ_LIBRARIES LibPQ_INCLUDE_DIRS
+    VERSION_VAR LibPQ_VERSION
+)
+
+if (LibPQ_FOUND AND NOT TARGET LibPQ::LibPQ)
+    add_library(LibPQ::LibPQ UNKNOWN IMPORTED)
+    set_target_properties(LibPQ::LibPQ PROPERTIES
+        IMPORTED_LOCATION "${LibPQ_LIBRARIES}"
+        INTERFACE_INCLUDE_DIRECTORIES "${LibPQ_INCLUDE_DIRS}"
+    )
+endif()
+
+mark_as_advanced(LibPQ_INCLUDE_DIRS LibPQ_LIBRARIES)
+
+include(FeatureSummary)
+set_package_properties(LibPQ PROPERTIES
+    URL "https://www.postgresql.org/docs/current/libpq.html"
+    DESCRIPTION "the PostgreSQL client library"
+)
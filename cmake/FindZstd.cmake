@@ -0,0 +1,67 @@
+#.rst:
+# FindZstd
+# --------
+#
+# Try to find the Zstandard compression library.
+#
+# This will define the following variables:
+#
+# ``Zstd_FOUND``
+#     True if libzstd is available.
+#
+# ``Zstd_VERSION``
+#     The version of libzstd
+#
+# ``Zstd_INCLUDE_DIRS``
+#     This should be passed to target_include_directories() if
+#     the target is not used for linking
+#
+# ``Zstd_LIBRARIES``
+#     This can be passed to target_link_libraries() instead of
+#     the ``Zstd::Zstd`` target
+#
+# If ``Zstd_FOUND`` is TRUE, the following imported target
+# will be available:
+#
+# ``Zstd::Zstd``
+#     The Zstandard library
+#
+#=============================================================================
+# Copyright (C) 2005-2022 by the Quassel Project - devel@quassel-irc.org
+#
+# Redistribution and use is allowed according to the terms of the BSD license.
+#=============================================================================
+
+find_path(Zstd_INCLUDE_DIRS NAMES zstd.h)
+find_library(Zstd_LIBRARIES NAMES zstd zstd_static)
+
+if (Zstd_INCLUDE_DIRS AND EXISTS ${Zstd_INCLUDE_DIRS}/zstd.h)
+    file(STRINGS ${Zstd_INCLUDE_DIRS}/zstd.h _ZSTD_VERSION_LINES REGEX "#define ZSTD_VERSION_(MAJOR|MINOR|RELEASE)[ ]+[0-9]+")
+    string(REGEX REPLACE ".*ZSTD_VERSION_MAJOR[ ]+([0-9]+).*" "\\1" _ZSTD_VERSION_MAJOR "${_ZSTD_VERSION_LINES}")
+    string(REGEX REPLACE ".*ZSTD_VERSION_MINOR[ ]+([0-9]+).*" "\\1" _ZSTD_VERSION_MINOR "${_ZSTD_VERSION_LINES}")
+    string(REGEX REPLACE ".*ZSTD_VERSION_RELEASE[ ]+([0-9]+).*" "\\1" _ZSTD_VERSION_RELEASE "${_ZSTD_VERSION_LINES}")
+    set(Zstd_VERSION "${_ZSTD_VERSION_MAJOR}.${_ZSTD_VERSION_MINOR}.${_ZSTD_VERSION_RELEASE}")
+endif()
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(Zstd
+    FOUND_VAR Zstd_FOUND
+    REQUIRED_VARS Zstd_LIBRARIES Zstd_INCLUDE_DIRS
+    VERSION_VAR Zstd_VERSION
+)
+
+if (Zstd_FOUND AND NOT TARGET Zstd::Zstd)
+    add_library(Zstd::Zstd UNKNOWN IMPORTED)
+    set_target_properties(Zstd::Zstd PROPERTIES
+        IMPORTED_LOCATION "${Zstd_LIBRARIES}"
+        INTERFACE_INCLUDE_DIRECTORIES "${Zstd_INCLUDE_DIRS}"
+    )
+endif()
+
+mark_as_advanced(Zstd_INCLUDE_DIRS Zstd_LIBRARIES)
+
+include(FeatureSummary)
+set_package_properties(Zstd PROPERTIES
+    URL "https://facebook.github.io/zstd/"
+    DESCRIPTION "a fast lossless compression algorithm"
+)
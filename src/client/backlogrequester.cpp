@@ -41,13 +41,21 @@ void BacklogRequester::setWaitingBuffers(const BufferIdList& buffers)
     _totalBuffers = int(_buffersWaiting.size());
 }
 
-bool BacklogRequester::buffer(BufferId bufferId, const MessageList& messages)
+bool BacklogRequester::buffer(BufferId bufferId, const MessageList& messages, bool complete)
 {
     _bufferedMessages << messages;
-    _buffersWaiting.erase(bufferId);
+    if (complete)
+        _buffersWaiting.erase(bufferId);
     return !_buffersWaiting.empty();
 }
 
+MessageList BacklogRequester::takeBufferedMessages()
+{
+    MessageList messages;
+    messages.swap(_bufferedMessages);
+    return messages;
+}
+
 BufferIdList BacklogRequester::allBufferIds() const
 {
     QSet<BufferId> bufferIds = Client::bufferViewOverlay()->bufferIds();
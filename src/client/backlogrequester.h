@@ -53,7 +53,10 @@ public:
     inline int buffersWaiting() const { return int(_buffersWaiting.size()); }
     inline int totalBuffers() const { return _totalBuffers; }
 
-    bool buffer(BufferId bufferId, const MessageList& messages);  //! returns false if it was the last missing backlogpart
+    //! returns false if it was the last missing backlogpart, incomplete parts keep the buffer waiting
+    bool buffer(BufferId bufferId, const MessageList& messages, bool complete = true);
+    //! hands over the messages buffered so far, leaving the buffers waiting
+    MessageList takeBufferedMessages();
 
     virtual void requestBacklog(const BufferIdList& bufferIds) = 0;
     virtual inline void requestInitialBacklog() { requestBacklog(allBufferIds()); }
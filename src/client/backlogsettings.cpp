@@ -61,6 +61,17 @@ void BacklogSettings::setEnsureBacklogOnBufferShow(bool enabled)
     return setLocalValue("EnsureBacklogOnBufferShow", enabled);
 }
 
+int BacklogSettings::memoryBudget() const
+{
+    // This settings key is also used within MessageModel::MessageModel()
+    return localValue("MemoryBudget", 0).toInt();
+}
+
+void BacklogSettings::setMemoryBudget(int budget)
+{
+    return setLocalValue("MemoryBudget", budget);
+}
+
 int BacklogSettings::fixedBacklogAmount() const
 {
     return localValue("FixedBacklogAmount", 500).toInt();
@@ -50,6 +50,19 @@ public:
      */
     void setEnsureBacklogOnBufferShow(bool enabled);
 
+    /**
+     * Gets the memory the client may use for messages before evicting old lines of hidden chats
+     *
+     * @return Memory budget in MiB, or 0 if unlimited
+     */
+    int memoryBudget() const;
+    /**
+     * Sets the memory the client may use for messages before evicting old lines of hidden chats
+     *
+     * @param budget Memory budget in MiB, or 0 if unlimited
+     */
+    void setMemoryBudget(int budget);
+
     int fixedBacklogAmount() const;
     void setFixedBacklogAmount(int amount);
 
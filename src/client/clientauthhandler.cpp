@@ -161,6 +161,8 @@ void ClientAuthHandler::onSocketConnected()
         quint32 magic = Protocol::magic;
         magic |= Protocol::Encryption;
         magic |= Protocol::Compression;
+        if (Compressor::isAvailable(Compressor::Zstd))
+            magic |= Protocol::ZstdCompression | Protocol::ZstdDictionary;
 
         stream << magic;
 
@@ -186,6 +188,7 @@ void ClientAuthHandler::onSocketConnected()
                                          this,
                                          socket(),
                                          Compressor::NoCompression,
+                                         Compressor::Deflate,
                                          this);
     // Only needed for the legacy peer, as all others check the protocol version before instantiation
     connect(peer, &RemotePeer::protocolVersionMismatch, this, &ClientAuthHandler::onProtocolVersionMismatch);
@@ -218,7 +221,13 @@ void ClientAuthHandler::onReadyRead()
     else
         level = Compressor::NoCompression;
 
-    RemotePeer* peer = PeerFactory::createPeer(PeerFactory::ProtoDescriptor(type, protoFeatures), this, socket(), level, this);
+    Compressor::Algorithm algorithm = Compressor::Deflate;
+    if (_connectionFeatures & Protocol::ZstdDictionary)
+        algorithm = Compressor::ZstdWithDictionary;
+    else if (_connectionFeatures & Protocol::ZstdCompression)
+        algorithm = Compressor::Zstd;
+
+    RemotePeer* peer = PeerFactory::createPeer(PeerFactory::ProtoDescriptor(type, protoFeatures), this, socket(), level, algorithm, this);
     if (!peer) {
         qWarning() << "No valid protocol supported for this core!";
         emit errorPopup(tr("<b>Incompatible Quassel Core!</b><br>"
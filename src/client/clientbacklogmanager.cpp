@@ -31,6 +31,21 @@
 #include "client.h"
 #include "util.h"
 
+namespace {
+
+MessageList backlogMessages(const QVariantList& msgs)
+{
+    MessageList msglist;
+    foreach (QVariant v, msgs) {
+        Message msg = v.value<Message>();
+        msg.setFlags(msg.flags() | Message::Backlog);
+        msglist << msg;
+    }
+    return msglist;
+}
+
+}  // namespace
+
 ClientBacklogManager::ClientBacklogManager(QObject* parent)
     : BacklogManager(parent)
 {}
@@ -38,9 +53,22 @@ ClientBacklogManager::ClientBacklogManager(QObject* parent)
 QVariantList ClientBacklogManager::requestBacklog(BufferId bufferId, MsgId first, MsgId last, int limit, int additional)
 {
     _buffersRequested << bufferId;
+    if (Client::isCoreFeatureEnabled(Quassel::Feature::StreamedBacklog)) {
+        requestBacklogStreamed(bufferId, first, last, limit, additional);
+        return {};
+    }
     return BacklogManager::requestBacklog(bufferId, first, last, limit, additional);
 }
 
+QVariantList ClientBacklogManager::requestBacklogAll(MsgId first, MsgId last, int limit, int additional)
+{
+    if (Client::isCoreFeatureEnabled(Quassel::Feature::StreamedBacklog)) {
+        requestBacklogStreamed(BufferId(), first, last, limit, additional);
+        return {};
+    }
+    return BacklogManager::requestBacklogAll(first, last, limit, additional);
+}
+
 void ClientBacklogManager::receiveBacklog(BufferId bufferId, MsgId first, MsgId last, int limit, int additional, QVariantList msgs)
 {
     Q_UNUSED(first)
@@ -50,12 +78,7 @@ void ClientBacklogManager::receiveBacklog(BufferId bufferId, MsgId first, MsgId
 
     emit messagesReceived(bufferId, msgs.count());
 
-    MessageList msglist;
-    foreach (QVariant v, msgs) {
-        Message msg = v.value<Message>();
-        msg.setFlags(msg.flags() | Message::Backlog);
-        msglist << msg;
-    }
+    MessageList msglist = backlogMessages(msgs);
 
     if (isBuffering()) {
         bool lastPart = !_requester->buffer(bufferId, msglist);
@@ -77,16 +100,35 @@ void ClientBacklogManager::receiveBacklogAll(MsgId first, MsgId last, int limit,
     Q_UNUSED(limit)
     Q_UNUSED(additional)
 
-    MessageList msglist;
-    foreach (QVariant v, msgs) {
-        Message msg = v.value<Message>();
-        msg.setFlags(msg.flags() | Message::Backlog);
-        msglist << msg;
-    }
+    MessageList msglist = backlogMessages(msgs);
 
     dispatchMessages(msglist);
 }
 
+void ClientBacklogManager::receiveBacklogChunk(BufferId bufferId, QVariantList messages, bool complete)
+{
+    if (!bufferId.isValid()) {
+        receiveBacklogAll(-1, -1, -1, 0, messages);
+        return;
+    }
+
+    if (!isBuffering()) {
+        receiveBacklog(bufferId, -1, -1, -1, 0, messages);
+        return;
+    }
+
+    emit messagesReceived(bufferId, messages.count());
+
+    MessageList msglist = backlogMessages(messages);
+
+    // Hand each chunk on right away instead of holding back the whole backlog until every buffer is complete
+    bool lastPart = !_requester->buffer(bufferId, msglist, complete);
+    updateProgress(_requester->totalBuffers() - _requester->buffersWaiting(), _requester->totalBuffers());
+    dispatchMessages(_requester->takeBufferedMessages(), true);
+    if (lastPart)
+        _requester->flushBuffer();
+}
+
 void ClientBacklogManager::requestInitialBacklog()
 {
     if (_initBacklogRequested) {
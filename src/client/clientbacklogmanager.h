@@ -41,8 +41,10 @@ public:
 
 public slots:
     QVariantList requestBacklog(BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0) override;
+    QVariantList requestBacklogAll(MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0) override;
     void receiveBacklog(BufferId bufferId, MsgId first, MsgId last, int limit, int additional, QVariantList msgs) override;
     void receiveBacklogAll(MsgId first, MsgId last, int limit, int additional, QVariantList msgs) override;
+    void receiveBacklogChunk(BufferId bufferId, QVariantList messages, bool complete) override;
 
     void requestInitialBacklog();
 
@@ -56,13 +58,15 @@ signals:
 
     void updateProgress(int, int);
 
+protected:
+    BacklogRequester* _requester{nullptr};
+
 private:
     bool isBuffering();
     BufferIdList filterNewBufferIds(const BufferIdList& bufferIds);
 
     void dispatchMessages(const MessageList& messages, bool sort = false);
 
-    BacklogRequester* _requester{nullptr};
     bool _initBacklogRequested{false};
     QSet<BufferId> _buffersRequested;
 };
@@ -21,6 +21,7 @@
 #include "messagefilter.h"
 
 #include <algorithm>
+#include <iterator>
 
 #include "buffermodel.h"
 #include "buffersettings.h"
@@ -30,26 +31,34 @@
 #include "networkmodel.h"
 #include "util.h"
 
-MessageFilter::MessageFilter(QAbstractItemModel* source, QObject* parent)
-    : QSortFilterProxyModel(parent)
+MessageFilter::MessageFilter(MessageModel* source, QObject* parent)
+    : QAbstractProxyModel(parent)
+    , _messageModel(source)
     , _messageTypeFilter(0)
 {
     init();
-    setSourceModel(source);
 }
 
 MessageFilter::MessageFilter(MessageModel* source, const QList<BufferId>& buffers, QObject* parent)
-    : QSortFilterProxyModel(parent)
+    : QAbstractProxyModel(parent)
+    , _messageModel(source)
     , _validBuffers(toQSet(buffers))
     , _messageTypeFilter(0)
 {
     init();
-    setSourceModel(source);
 }
 
 void MessageFilter::init()
 {
-    setDynamicSortFilter(true);
+    setSourceModel(_messageModel);
+    _messageModel->addFilter(this);
+    connect(_messageModel, &QAbstractItemModel::rowsAboutToBeInserted, this, &MessageFilter::sourceRowsAboutToBeInserted);
+    connect(_messageModel, &QAbstractItemModel::rowsInserted, this, &MessageFilter::sourceRowsInserted);
+    connect(_messageModel, &QAbstractItemModel::rowsAboutToBeRemoved, this, &MessageFilter::sourceRowsAboutToBeRemoved);
+    connect(_messageModel, &QAbstractItemModel::rowsRemoved, this, &MessageFilter::sourceRowsRemoved);
+    connect(_messageModel, &QAbstractItemModel::dataChanged, this, &MessageFilter::sourceDataChanged);
+    connect(_messageModel, &QAbstractItemModel::modelAboutToBeReset, this, &MessageFilter::sourceModelAboutToBeReset);
+    connect(_messageModel, &QAbstractItemModel::modelReset, this, &MessageFilter::sourceModelReset);
 
     _userNoticesTarget = _serverNoticesTarget = _errorMsgsTarget = -1;
 
@@ -125,11 +134,230 @@ QString MessageFilter::idString() const
     return bufferIdStrings.join("|");
 }
 
+QModelIndex MessageFilter::index(int row, int column, const QModelIndex& parent) const
+{
+    if (parent.isValid() || row < 0 || row >= rowCount() || column < 0 || column >= columnCount())
+        return {};
+
+    return createIndex(row, column);
+}
+
+int MessageFilter::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    ensureMapped();
+    return static_cast<int>(_sourceRows.size());
+}
+
+int MessageFilter::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : _messageModel->columnCount();
+}
+
+QModelIndex MessageFilter::mapToSource(const QModelIndex& proxyIndex) const
+{
+    if (!proxyIndex.isValid() || proxyIndex.model() != this)
+        return {};
+
+    ensureMapped();
+    return _messageModel->index(_sourceRows[proxyIndex.row()], proxyIndex.column());
+}
+
+QModelIndex MessageFilter::mapFromSource(const QModelIndex& sourceIndex) const
+{
+    if (!sourceIndex.isValid() || sourceIndex.model() != _messageModel)
+        return {};
+
+    ensureMapped();
+    auto iter = std::lower_bound(_sourceRows.begin(), _sourceRows.end(), sourceIndex.row());
+    if (iter == _sourceRows.end() || *iter != sourceIndex.row())
+        return {};
+
+    return createIndex(static_cast<int>(iter - _sourceRows.begin()), sourceIndex.column());
+}
+
+void MessageFilter::ensureMapped() const
+{
+    if (_mapped)
+        return;
+
+    auto* that = const_cast<MessageFilter*>(this);
+    that->_sourceRows = candidateRows(0, _messageModel->rowCount() - 1);
+    that->filterRows(that->_sourceRows);
+    that->_mapped = true;
+}
+
+std::vector<int> MessageFilter::candidateRows(int first, int last) const
+{
+    std::vector<int> rows;
+    if (last < first)
+        return rows;
+
+    if (_validBuffers.isEmpty()) {
+        rows.reserve(last - first + 1);
+        for (int row = first; row <= last; row++)
+            rows.push_back(row);
+        return rows;
+    }
+
+    // Besides our own buffers' messages, only those without a buffer and the few that can be forwarded may show up
+    auto addRows = [&rows, first, last](const std::vector<int>& partition) {
+        auto begin = std::lower_bound(partition.begin(), partition.end(), first);
+        auto end = std::upper_bound(begin, partition.end(), last);
+        rows.insert(rows.end(), begin, end);
+    };
+    for (BufferId bufferId : _validBuffers)
+        addRows(_messageModel->bufferRows(bufferId));
+    addRows(_messageModel->bufferRows(BufferId()));
+    addRows(_messageModel->crossBufferRows());
+
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    return rows;
+}
+
+void MessageFilter::filterRows(std::vector<int>& rows)
+{
+    // filterAcceptsRow() may store a redirection target in the source model; that's not a change we need to act on
+    _filtering = true;
+    rows.erase(std::remove_if(rows.begin(), rows.end(), [this](int row) { return !filterAcceptsRow(row, QModelIndex()); }), rows.end());
+    _filtering = false;
+}
+
+void MessageFilter::insertSourceRows(const std::vector<int>& rows)
+{
+    auto next = rows.begin();
+    while (next != rows.end()) {
+        int pos = static_cast<int>(std::lower_bound(_sourceRows.begin(), _sourceRows.end(), *next) - _sourceRows.begin());
+        // Everything up to the next row we already show goes in as one block
+        auto blockEnd = pos < static_cast<int>(_sourceRows.size()) ? std::lower_bound(next, rows.end(), _sourceRows[pos]) : rows.end();
+        beginInsertRows(QModelIndex(), pos, pos + static_cast<int>(blockEnd - next) - 1);
+        _sourceRows.insert(_sourceRows.begin() + pos, next, blockEnd);
+        endInsertRows();
+        next = blockEnd;
+    }
+}
+
+void MessageFilter::invalidateFilter()
+{
+    if (!_mapped)
+        return;
+
+    std::vector<int> accepted = candidateRows(0, _messageModel->rowCount() - 1);
+    filterRows(accepted);
+
+    // Remove what's no longer accepted, back to front and in blocks
+    int last = static_cast<int>(_sourceRows.size()) - 1;
+    while (last >= 0) {
+        if (std::binary_search(accepted.begin(), accepted.end(), _sourceRows[last])) {
+            last--;
+            continue;
+        }
+        int first = last;
+        while (first > 0 && !std::binary_search(accepted.begin(), accepted.end(), _sourceRows[first - 1]))
+            first--;
+        beginRemoveRows(QModelIndex(), first, last);
+        _sourceRows.erase(_sourceRows.begin() + first, _sourceRows.begin() + last + 1);
+        endRemoveRows();
+        last = first - 1;
+    }
+
+    std::vector<int> added;
+    std::set_difference(accepted.begin(), accepted.end(), _sourceRows.begin(), _sourceRows.end(), std::back_inserter(added));
+    insertSourceRows(added);
+}
+
+void MessageFilter::sourceRowsAboutToBeInserted()
+{
+    _insertPending = true;
+}
+
+void MessageFilter::sourceRowsInserted(const QModelIndex& parent, int start, int end)
+{
+    Q_UNUSED(parent);
+    _insertPending = false;
+    if (!_mapped)
+        return;
+
+    const int count = end - start + 1;
+    for (auto iter = std::lower_bound(_sourceRows.begin(), _sourceRows.end(), start); iter != _sourceRows.end(); ++iter)
+        *iter += count;
+
+    std::vector<int> rows = candidateRows(start, end);
+    filterRows(rows);
+    insertSourceRows(rows);
+}
+
+void MessageFilter::sourceRowsAboutToBeRemoved(const QModelIndex& parent, int start, int end)
+{
+    Q_UNUSED(parent);
+    if (!_mapped)
+        return;
+
+    auto first = std::lower_bound(_sourceRows.begin(), _sourceRows.end(), start);
+    auto last = std::upper_bound(first, _sourceRows.end(), end);
+    if (first == last)
+        return;
+
+    beginRemoveRows(QModelIndex(), static_cast<int>(first - _sourceRows.begin()), static_cast<int>(last - _sourceRows.begin()) - 1);
+    _sourceRows.erase(first, last);
+    endRemoveRows();
+}
+
+void MessageFilter::sourceRowsRemoved(const QModelIndex& parent, int start, int end)
+{
+    Q_UNUSED(parent);
+    if (!_mapped)
+        return;
+
+    const int count = end - start + 1;
+    for (auto iter = std::lower_bound(_sourceRows.begin(), _sourceRows.end(), start); iter != _sourceRows.end(); ++iter)
+        *iter -= count;
+}
+
+void MessageFilter::sourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight)
+{
+    // Filters notified of new rows before us store redirection targets for them, which changes their data. Our row
+    // numbers are outdated until we get to see the insertion ourselves, which then evaluates the new rows anyway.
+    if (!_mapped || _filtering || _insertPending)
+        return;
+
+    auto first = std::lower_bound(_sourceRows.begin(), _sourceRows.end(), topLeft.row());
+    auto last = std::upper_bound(first, _sourceRows.end(), bottomRight.row());
+    if (first != last) {
+        emit dataChanged(index(static_cast<int>(first - _sourceRows.begin()), topLeft.column()),
+                         index(static_cast<int>(last - _sourceRows.begin()) - 1, bottomRight.column()));
+    }
+
+    // A change can make messages show up (e.g. when buffers get merged), but messages already shown stay
+    std::vector<int> rows = candidateRows(topLeft.row(), bottomRight.row());
+    rows.erase(std::remove_if(rows.begin(),
+                              rows.end(),
+                              [this](int row) { return std::binary_search(_sourceRows.begin(), _sourceRows.end(), row); }),
+               rows.end());
+    filterRows(rows);
+    insertSourceRows(rows);
+}
+
+void MessageFilter::sourceModelAboutToBeReset()
+{
+    beginResetModel();
+}
+
+void MessageFilter::sourceModelReset()
+{
+    _sourceRows.clear();
+    _mapped = false;
+    endResetModel();
+}
+
 bool MessageFilter::filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const
 {
     Q_UNUSED(sourceParent);
-    QModelIndex sourceIdx = sourceModel()->index(sourceRow, 2);
-    Message::Type messageType = (Message::Type)sourceIdx.data(MessageModel::TypeRole).toInt();
+    const MessageModelItem* item = sourceItem(sourceRow);
+    Message::Type messageType = item->msgType();
 
     // apply message type filter
     if (_messageTypeFilter & messageType)
@@ -138,13 +366,16 @@ bool MessageFilter::filterAcceptsRow(int sourceRow, const QModelIndex& sourcePar
     if (_validBuffers.isEmpty())
         return true;
 
-    BufferId bufferId = sourceIdx.data(MessageModel::BufferIdRole).value<BufferId>();
+    BufferId bufferId = item->bufferId();
     if (!bufferId.isValid()) {
         return true;
     }
 
-    // MsgId msgId = sourceIdx.data(MessageModel::MsgIdRole).value<MsgId>();
-    Message::Flags flags = (Message::Flags)sourceIdx.data(MessageModel::FlagsRole).toInt();
+    Message::Flags flags = item->msgFlags();
+
+    // Only redirected messages and quits are ever shown outside of their own buffer
+    if (!(flags & Message::Redirected) && !(messageType & Message::Quit) && !_validBuffers.contains(bufferId))
+        return false;
 
     NetworkId myNetworkId = networkId();
     NetworkId msgNetworkId = Client::networkModel()->networkId(bufferId);
@@ -154,8 +385,7 @@ bool MessageFilter::filterAcceptsRow(int sourceRow, const QModelIndex& sourcePar
     // ignorelist handling
     // only match if message is not flagged as server msg
     if (!(flags & Message::ServerMsg) && Client::ignoreListManager()
-        && Client::ignoreListManager()->match(sourceIdx.data(MessageModel::MessageRole).value<Message>(),
-                                              Client::networkModel()->networkName(bufferId)))
+        && Client::ignoreListManager()->match(item->message(), Client::networkModel()->networkName(bufferId)))
         return false;
 
     if (flags & Message::Redirected) {
@@ -183,6 +413,7 @@ bool MessageFilter::filterAcceptsRow(int sourceRow, const QModelIndex& sourcePar
             return true;
 
         if (redirectionTarget & BufferSettings::CurrentBuffer && !(flags & Message::Backlog)) {
+            QModelIndex sourceIdx = sourceModel()->index(sourceRow, 2);
             BufferId redirectedTo = sourceModel()->data(sourceIdx, MessageModel::RedirectedToRole).value<BufferId>();
             if (!redirectedTo.isValid()) {
                 redirectedTo = Client::bufferModel()->currentIndex().data(NetworkModel::BufferIdRole).value<BufferId>();
@@ -220,8 +451,8 @@ bool MessageFilter::filterAcceptsRow(int sourceRow, const QModelIndex& sourcePar
             return false;
 
         // Extract timestamp and nickname from the new quit message
-        qint64 messageTimestamp = sourceModel()->data(sourceIdx, MessageModel::TimestampRole).value<QDateTime>().toMSecsSinceEpoch();
-        QString quiter = nickFromMask(sourceModel()->data(sourceIdx, MessageModel::MessageRole).value<Message>().sender()).toLower();
+        qint64 messageTimestamp = item->timestamp().toMSecsSinceEpoch();
+        QString quiter = nickFromMask(item->message().sender()).toLower();
 
         // Check that nickname matches query name
         if (quiter != bufferName().toLower())
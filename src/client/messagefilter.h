@@ -23,8 +23,9 @@
 #include "client-export.h"
 
 #include <set>
+#include <vector>
 
-#include <QSortFilterProxyModel>
+#include <QAbstractProxyModel>
 
 #include "bufferinfo.h"
 #include "client.h"
@@ -32,12 +33,17 @@
 #include "networkmodel.h"
 #include "types.h"
 
-class CLIENT_EXPORT MessageFilter : public QSortFilterProxyModel
+//! Shows the messages of a set of buffers, or of all buffers if none are given
+/** Filters for particular buffers only look at the rows MessageModel indexes for them, plus the few messages that can be
+ *  forwarded from other buffers, rather than at the whole model. This keeps switching buffers and adding messages cheap
+ *  no matter how many messages the client holds overall.
+ */
+class CLIENT_EXPORT MessageFilter : public QAbstractProxyModel
 {
     Q_OBJECT
 
 protected:
-    MessageFilter(QAbstractItemModel* source, QObject* parent = nullptr);
+    MessageFilter(MessageModel* source, QObject* parent);
 
 public:
     MessageFilter(MessageModel*, const QList<BufferId>& buffers = QList<BufferId>(), QObject* parent = nullptr);
@@ -48,24 +54,59 @@ public:
     BufferId singleBufferId() const { return *(_validBuffers.constBegin()); }
     bool containsBuffer(const BufferId& id) const { return _validBuffers.contains(id); }
     QSet<BufferId> containedBuffers() const { return _validBuffers; }
+    //! Returns the source rows of the messages shown, in ascending order; empty until the filter is first used
+    const std::vector<int>& sourceRows() const { return _sourceRows; }
 
-    bool filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const override;
+    QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex&) const override { return {}; }
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex mapToSource(const QModelIndex& proxyIndex) const override;
+    QModelIndex mapFromSource(const QModelIndex& sourceIndex) const override;
+
+    virtual bool filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const;
 
 public slots:
     void messageTypeFilterChanged();
     void messageRedirectionChanged();
     void requestBacklog();
-    // redefined as public slot
-    void invalidateFilter() { QSortFilterProxyModel::invalidateFilter(); }
+    //! Re-evaluates the filter for all messages
+    void invalidateFilter();
 
 protected:
+    const MessageModelItem* sourceItem(int sourceRow) const { return _messageModel->messageItemAt(sourceRow); }
+
     QString bufferName() const { return Client::networkModel()->bufferName(singleBufferId()); }
     BufferInfo::Type bufferType() const { return Client::networkModel()->bufferType(singleBufferId()); }
     NetworkId networkId() const { return Client::networkModel()->networkId(singleBufferId()); }
 
+private slots:
+    void sourceRowsAboutToBeInserted();
+    void sourceRowsInserted(const QModelIndex& parent, int start, int end);
+    void sourceRowsAboutToBeRemoved(const QModelIndex& parent, int start, int end);
+    void sourceRowsRemoved(const QModelIndex& parent, int start, int end);
+    void sourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+    void sourceModelAboutToBeReset();
+    void sourceModelReset();
+
 private:
     void init();
 
+    //! Maps the source rows on first use, so subclasses get to filter them
+    void ensureMapped() const;
+    //! Returns the source rows between first and last that could pass the filter, in ascending order
+    std::vector<int> candidateRows(int first, int last) const;
+    //! Removes the rows that don't pass the filter
+    void filterRows(std::vector<int>& rows);
+    //! Adds the given source rows, which must be sorted and not be shown yet
+    void insertSourceRows(const std::vector<int>& rows);
+
+    MessageModel* _messageModel;
+    std::vector<int> _sourceRows;  ///< Source rows of the messages shown, in ascending order
+    bool _mapped{false};
+    bool _filtering{false};
+    bool _insertPending{false};  ///< The source model inserted rows we haven't been told about yet
+
     QSet<BufferId> _validBuffers;
     std::set<qint64> _filteredQuitMsgTime;  ///< Timestamps (ms) of already forwarded quit messages
     int _messageTypeFilter;
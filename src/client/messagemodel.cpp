@@ -21,6 +21,7 @@
 #include "messagemodel.h"
 
 #include <algorithm>
+#include <iterator>
 
 #include <QEvent>
 
@@ -28,6 +29,7 @@
 #include "client.h"
 #include "clientbacklogmanager.h"
 #include "message.h"
+#include "messagefilter.h"
 #include "networkmodel.h"
 
 class ProcessBufferEvent : public QEvent
@@ -49,6 +51,12 @@ MessageModel::MessageModel(QObject* parent)
     _dayChangeTimer.setInterval(QDateTime::currentDateTime().secsTo(_nextDayChange) * 1000);
     _dayChangeTimer.start();
     connect(&_dayChangeTimer, &QTimer::timeout, this, &MessageModel::changeOfDay);
+
+    // Cached data grows as lines are shown, so check the budget regularly rather than only when adding messages
+    _memoryBudgetTimer.setInterval(60 * 1000);
+    connect(&_memoryBudgetTimer, &QTimer::timeout, this, &MessageModel::enforceMemoryBudget);
+    BacklogSettings backlogSettings;
+    backlogSettings.initAndNotify("MemoryBudget", this, &MessageModel::memoryBudgetChanged, 0);
 }
 
 QVariant MessageModel::data(const QModelIndex& index, int role) const
@@ -132,6 +140,7 @@ void MessageModel::insertMessageGroup(const QList<Message>& msglist)
         int prevIdx = start - 1;
         if (messageItemAt(prevIdx)->msgType() == Message::DayChange && messageItemAt(prevIdx)->timestamp() > msglist.at(0).timestamp()) {
             beginRemoveRows(QModelIndex(), prevIdx, prevIdx);
+            unindexRows(prevIdx, prevIdx);
             Message oldDayChangeMsg = takeMessageAt(prevIdx);
             if (msglist.last().timestamp() < oldDayChangeMsg.timestamp()) {
                 // we have to reinsert it with a changed msgId
@@ -175,6 +184,7 @@ void MessageModel::insertMessageGroup(const QList<Message>& msglist)
     insertMessages__(start, msglist);
     if (dayChangeMsg.isValid())
         insertMessage__(start + msglist.count(), dayChangeMsg);
+    indexRows(start, end);
     endInsertRows();
 
     Q_ASSERT(start == end || messageItemAt(start)->msgId() != messageItemAt(end)->msgId()
@@ -328,6 +338,8 @@ void MessageModel::clear()
     if (rowCount() > 0) {
         beginRemoveRows(QModelIndex(), 0, rowCount() - 1);
         removeAllMessages();
+        _bufferRows.clear();
+        _crossBufferRows.clear();
         endRemoveRows();
     }
 }
@@ -367,6 +379,7 @@ void MessageModel::changeOfDay()
         Message dayChangeMsg = Message::ChangeOfDay(_nextDayChange);
         dayChangeMsg.setMsgId(messageItemAt(idx - 1)->msgId());
         insertMessage__(idx, dayChangeMsg);
+        indexRows(idx, idx);
         endInsertRows();
     }
     _nextDayChange = _nextDayChange.addMSecs(DAY_IN_MSECS);
@@ -382,6 +395,7 @@ void MessageModel::insertErrorMessage(BufferInfo bufferInfo, const QString& erro
     else
         msg.setMsgId(0);
     insertMessage__(idx, msg);
+    indexRows(idx, idx);
     endInsertRows();
 }
 
@@ -397,12 +411,10 @@ void MessageModel::requestBacklog(BufferId bufferId)
     MsgId oldestAvailableMsgId{-1};
 
     // Try to find the oldest (lowest ID) message belonging to this buffer
-    for (int i = 0; i < messageCount(); i++) {
-        if (messageItemAt(i)->bufferId() == bufferId) {
-            // Match found, use this message ID for requesting more backlog
-            oldestAvailableMsgId = messageItemAt(i)->msgId();
-            break;
-        }
+    const std::vector<int>& rows = bufferRows(bufferId);
+    if (!rows.empty()) {
+        // Match found, use this message ID for requesting more backlog
+        oldestAvailableMsgId = messageItemAt(rows.front())->msgId();
     }
 
     // Prepare to fetch messages
@@ -438,13 +450,232 @@ void MessageModel::messagesReceived(BufferId bufferId, int count)
 
 void MessageModel::buffersPermanentlyMerged(BufferId bufferId1, BufferId bufferId2)
 {
-    for (int i = 0; i < messageCount(); i++) {
-        if (messageItemAt(i)->bufferId() == bufferId2) {
-            messageItemAt(i)->setBufferId(bufferId1);
-            QModelIndex idx = index(i, 0);
-            emit dataChanged(idx, idx);
+    auto iter = _bufferRows.find(bufferId2);
+    if (bufferId1 == bufferId2 || iter == _bufferRows.end())
+        return;
+
+    std::vector<int> movedRows = std::move(*iter);
+    _bufferRows.erase(iter);
+
+    // Update the index first, so filters can pick up the moved messages when they see the change
+    std::vector<int>& targetRows = _bufferRows[bufferId1];
+    std::vector<int> mergedRows;
+    mergedRows.reserve(targetRows.size() + movedRows.size());
+    std::merge(targetRows.begin(), targetRows.end(), movedRows.begin(), movedRows.end(), std::back_inserter(mergedRows));
+    targetRows.swap(mergedRows);
+
+    for (int row : movedRows) {
+        messageItemAt(row)->setBufferId(bufferId1);
+        QModelIndex idx = index(row, 0);
+        emit dataChanged(idx, idx);
+    }
+}
+
+void MessageModel::removeMessagesAt(int start, int count)
+{
+    for (int i = start + count - 1; i >= start; i--)
+        removeMessageAt(i);
+}
+
+void MessageModel::memoryBudgetChanged(const QVariant& budget)
+{
+    // Configured in MiB
+    _memoryBudget = budget.toLongLong() * 1024 * 1024;
+    if (_memoryBudget > 0)
+        _memoryBudgetTimer.start();
+    else
+        _memoryBudgetTimer.stop();
+}
+
+void MessageModel::enforceMemoryBudget()
+{
+    if (_memoryBudget <= 0)
+        return;
+
+    QHash<BufferId, MsgId> markerLines;
+    for (auto iter = _bufferRows.constBegin(); iter != _bufferRows.constEnd(); ++iter) {
+        if (iter.key().isValid())
+            markerLines[iter.key()] = Client::networkModel()->markerLineMsgId(iter.key());
+    }
+
+    shrinkTo(_memoryBudget, markerLines);
+}
+
+void MessageModel::addFilter(MessageFilter* filter)
+{
+    removeDeletedFilters();
+    _filters.emplace_back(filter);
+}
+
+void MessageModel::removeDeletedFilters()
+{
+    _filters.erase(std::remove_if(_filters.begin(), _filters.end(), [](auto&& filter) { return filter.isNull(); }), _filters.end());
+}
+
+qint64 MessageModel::memoryUsage() const
+{
+    qint64 usage = 0;
+    for (int row = 0; row < messageCount(); row++)
+        usage += messageItemAt(row)->memoryUsage();
+    return usage;
+}
+
+qint64 MessageModel::shrinkTo(qint64 budget, const QHash<BufferId, MsgId>& markerLines)
+{
+    qint64 usage = memoryUsage();
+    if (usage <= budget)
+        return usage;
+
+    // Buffers waiting for backlog or shown by a filter keep all of their lines
+    QSet<BufferId> visible;
+    for (auto iter = _messagesWaiting.constBegin(); iter != _messagesWaiting.constEnd(); ++iter)
+        visible.insert(iter.key());
+    removeDeletedFilters();
+    for (auto&& filter : _filters)
+        visible += filter->containedBuffers();
+
+    // Other buffers may still have lines shown, e.g. in the chat monitor or forwarded to a visible buffer; as lines are
+    // only evicted from the start of a buffer, everything from the first of them on stays
+    QHash<BufferId, int> firstShownRow;
+    for (auto&& filter : _filters) {
+        for (int row : filter->sourceRows()) {
+            BufferId bufferId = messageItemAt(row)->bufferId();
+            if (visible.contains(bufferId))
+                continue;
+            auto iter = firstShownRow.find(bufferId);
+            if (iter == firstShownRow.end())
+                firstShownRow.insert(bufferId, row);
+            else if (row < *iter)
+                *iter = row;
+        }
+    }
+
+    // Cached data is cheap to get back, so drop that first, starting with the oldest lines
+    for (int row = 0; row < messageCount() && usage > budget; row++) {
+        MessageModelItem* item = messageItemAt(row);
+        if (visible.contains(item->bufferId()) || row >= firstShownRow.value(item->bufferId(), messageCount()))
+            continue;
+        qint64 before = item->memoryUsage();
+        item->dropCaches();
+        usage -= before - item->memoryUsage();
+    }
+    if (usage <= budget)
+        return usage;
+
+    // Determine how many of its oldest lines each hidden buffer can spare
+    QHash<BufferId, int> evictable;
+    for (auto iter = _bufferRows.constBegin(); iter != _bufferRows.constEnd(); ++iter) {
+        if (!iter.key().isValid() || visible.contains(iter.key()))
+            continue;
+        const std::vector<int>& rows = iter.value();
+        int count = static_cast<int>(rows.size()) - _keepLines;
+        MsgId markerLine = markerLines.value(iter.key());
+        if (markerLine.isValid()) {
+            auto marker = std::lower_bound(rows.begin(), rows.end(), markerLine, [this](int row, MsgId msgId) {
+                return messageItemAt(row)->msgId() < msgId;
+            });
+            count = std::min(count, static_cast<int>(marker - rows.begin()) - _markerLineMargin);
         }
+        auto shown = firstShownRow.constFind(iter.key());
+        if (shown != firstShownRow.constEnd())
+            count = std::min(count, static_cast<int>(std::lower_bound(rows.begin(), rows.end(), *shown) - rows.begin()));
+        if (count > 0)
+            evictable[iter.key()] = count;
+    }
+
+    // Leave some headroom, so we don't have to evict again right away
+    const qint64 target = budget / 10 * 9;
+    std::vector<int> evicted;
+    for (int row = 0; row < messageCount() && usage > target; row++) {
+        const MessageModelItem* item = messageItemAt(row);
+        auto iter = evictable.find(item->bufferId());
+        if (iter == evictable.end() || *iter == 0)
+            continue;
+        --(*iter);
+        usage -= item->memoryUsage();
+        evicted.push_back(row);
+    }
+    removeRowsAt(evicted);
+
+    return usage;
+}
+
+void MessageModel::removeRowsAt(const std::vector<int>& rows)
+{
+    // Back to front and in blocks, so the remaining row numbers stay valid
+    int last = static_cast<int>(rows.size()) - 1;
+    while (last >= 0) {
+        int first = last;
+        while (first > 0 && rows[first - 1] == rows[first] - 1)
+            first--;
+        beginRemoveRows(QModelIndex(), rows[first], rows[last]);
+        unindexRows(rows[first], rows[last]);
+        removeMessagesAt(rows[first], rows[last] - rows[first] + 1);
+        endRemoveRows();
+        last = first - 1;
+    }
+}
+
+const std::vector<int>& MessageModel::bufferRows(BufferId bufferId) const
+{
+    static const std::vector<int> noRows;
+    auto iter = _bufferRows.constFind(bufferId);
+    return iter != _bufferRows.constEnd() ? *iter : noRows;
+}
+
+void MessageModel::indexRows(int start, int end)
+{
+    const int count = end - start + 1;
+    auto shift = [start, count](std::vector<int>& rows) {
+        for (auto iter = std::lower_bound(rows.begin(), rows.end(), start); iter != rows.end(); ++iter)
+            *iter += count;
+    };
+
+    // Appending new messages is the common case; anything else (e.g. backlog) moves the rows behind the new ones
+    if (end + 1 < messageCount()) {
+        for (auto&& rows : _bufferRows)
+            shift(rows);
+        shift(_crossBufferRows);
+    }
+
+    // The new rows form a contiguous block in each partition, so collect and insert them in one go
+    QHash<BufferId, std::vector<int>> newRows;
+    std::vector<int> newCrossBufferRows;
+    for (int row = start; row <= end; row++) {
+        const MessageModelItem* item = messageItemAt(row);
+        newRows[item->bufferId()].push_back(row);
+        if (item->msgFlags() & Message::Redirected || item->msgType() == Message::Quit)
+            newCrossBufferRows.push_back(row);
+    }
+
+    auto insert = [start](std::vector<int>& rows, const std::vector<int>& added) {
+        rows.insert(std::lower_bound(rows.begin(), rows.end(), start), added.begin(), added.end());
+    };
+    for (auto iter = newRows.constBegin(); iter != newRows.constEnd(); ++iter)
+        insert(_bufferRows[iter.key()], iter.value());
+    if (!newCrossBufferRows.empty())
+        insert(_crossBufferRows, newCrossBufferRows);
+}
+
+void MessageModel::unindexRows(int start, int end)
+{
+    const int count = end - start + 1;
+    auto unindex = [start, end, count](std::vector<int>& rows) {
+        auto first = std::lower_bound(rows.begin(), rows.end(), start);
+        auto last = std::upper_bound(first, rows.end(), end);
+        for (auto iter = last; iter != rows.end(); ++iter)
+            *iter -= count;
+        rows.erase(first, last);
+    };
+
+    for (auto iter = _bufferRows.begin(); iter != _bufferRows.end();) {
+        unindex(*iter);
+        if (iter->empty())
+            iter = _bufferRows.erase(iter);
+        else
+            ++iter;
     }
+    unindex(_crossBufferRows);
 }
 
 // ========================================
@@ -475,6 +706,14 @@ QVariant MessageModelItem::data(int column, int role) const
     }
 }
 
+qint64 MessageModelItem::memoryUsage() const
+{
+    const Message& msg = message();
+    int characters = msg.contents().size() + msg.sender().size() + msg.senderPrefixes().size() + msg.realName().size()
+                     + msg.avatarUrl().size();
+    return sizeof(Message) + characters * static_cast<qint64>(sizeof(QChar));
+}
+
 bool MessageModelItem::setData(int column, const QVariant& value, int role)
 {
     Q_UNUSED(column);
@@ -22,13 +22,19 @@
 
 #include "client-export.h"
 
+#include <vector>
+
 #include <QAbstractItemModel>
 #include <QDateTime>
+#include <QHash>
+#include <QPointer>
+#include <QSet>
 #include <QTimer>
 
 #include "message.h"
 #include "types.h"
 
+class MessageFilter;
 class MessageModelItem;
 struct MsgId;
 
@@ -79,6 +85,33 @@ public:
 
     void clear();
 
+    virtual const MessageModelItem* messageItemAt(int i) const = 0;
+
+    //! Returns the rows holding messages of the given buffer, in ascending order
+    const std::vector<int>& bufferRows(BufferId bufferId) const;
+
+    //! Returns the rows holding messages that may be shown outside of their own buffer, in ascending order
+    /** These are redirected messages and quits, which MessageFilter forwards to other buffers of the same network. */
+    const std::vector<int>& crossBufferRows() const { return _crossBufferRows; }
+
+    //! Registers a filter showing our messages, so they aren't evicted while it's around
+    void addFilter(MessageFilter* filter);
+
+    //! Returns an estimate of the memory taken up by all messages, in bytes
+    qint64 memoryUsage() const;
+
+    //! Frees memory until the messages take up no more than the given number of bytes, as far as possible
+    /** Cached data of hidden buffers is dropped first, then the oldest lines of hidden buffers are evicted. Lines are only
+     *  ever evicted from the start of a buffer, so scrolling back re-requests exactly what is missing. The newest lines
+     *  and those around the marker line stay, as do all lines of buffers that are waiting for backlog or shown by a
+     *  filter. Filters for all buffers, like the chat monitor, keep each buffer from its first line they show on.
+     *
+     *  \param budget       The number of bytes to shrink to
+     *  \param markerLines  The marker line of each buffer
+     *  \return The estimated memory usage afterwards
+     */
+    qint64 shrinkTo(qint64 budget, const QHash<BufferId, MsgId>& markerLines);
+
 signals:
     void finishedBacklogFetch(BufferId bufferId);
 
@@ -93,7 +126,6 @@ protected:
 
     virtual int messageCount() const = 0;
     virtual bool messagesIsEmpty() const = 0;
-    virtual const MessageModelItem* messageItemAt(int i) const = 0;
     virtual MessageModelItem* messageItemAt(int i) = 0;
     virtual const MessageModelItem* firstMessageItem() const = 0;
     virtual MessageModelItem* firstMessageItem() = 0;
@@ -102,6 +134,7 @@ protected:
     virtual void insertMessage__(int pos, const Message&) = 0;
     virtual void insertMessages__(int pos, const QList<Message>&) = 0;
     virtual void removeMessageAt(int i) = 0;
+    virtual void removeMessagesAt(int start, int count);
     virtual void removeAllMessages() = 0;
     virtual Message takeMessageAt(int i) = 0;
 
@@ -109,18 +142,41 @@ protected:
 
 private slots:
     void changeOfDay();
+    void memoryBudgetChanged(const QVariant& budget);
+    void enforceMemoryBudget();
 
 private:
     void insertMessageGroup(const QList<Message>&);
     int insertMessagesGracefully(const QList<Message>&);  // inserts as many contiguous msgs as possible. returns number of inserted msgs.
     int indexForId(MsgId);
 
+    // Keep the per-buffer row index in sync; call after inserting and before removing rows, respectively
+    void indexRows(int start, int end);
+    void unindexRows(int start, int end);
+
+    //! Removes the given rows, which must be sorted
+    void removeRowsAt(const std::vector<int>& rows);
+
+    void removeDeletedFilters();
+
     //  QList<MessageModelItem *> _messageList;
     QList<Message> _messageBuffer;
     QTimer _dayChangeTimer;
     QDateTime _nextDayChange;
     QHash<BufferId, int> _messagesWaiting;
 
+    QHash<BufferId, std::vector<int>> _bufferRows;  ///< Rows of each buffer's messages
+    std::vector<int> _crossBufferRows;
+
+    std::vector<QPointer<MessageFilter>> _filters;  ///< Filters showing our messages, null once deleted
+
+    QTimer _memoryBudgetTimer;
+    qint64 _memoryBudget{0};  ///< In bytes, 0 if unlimited
+
+    /// Lines kept in every buffer, and before its marker line, when evicting messages
+    static const int _keepLines = 100;
+    static const int _markerLineMargin = 50;
+
     /// Period of time for one day in milliseconds
     /// 24 hours * 60 minutes * 60 seconds * 1000 milliseconds
     const qint64 DAY_IN_MSECS = 24 * 60 * 60 * 1000;
@@ -159,6 +215,11 @@ public:
     virtual Message::Type msgType() const = 0;
     virtual Message::Flags msgFlags() const = 0;
 
+    //! Returns an estimate of the memory taken up by this item, in bytes
+    virtual qint64 memoryUsage() const;
+    //! Drops cached data that can be computed again when needed
+    virtual void dropCaches() {}
+
     // For sorting
     bool operator<(const MessageModelItem&) const;
     bool operator==(const MessageModelItem&) const;
@@ -49,3 +49,20 @@ QVariantList BacklogManager::requestBacklogAllFiltered(MsgId first, MsgId last,
     REQUEST(ARG(first), ARG(last), ARG(limit), ARG(additional), ARG(type), ARG(flags))
     return QVariantList();
 }
+
+void BacklogManager::requestBacklogStreamed(BufferId bufferId, MsgId first, MsgId last, int limit, int additional)
+{
+    REQUEST(ARG(bufferId), ARG(first), ARG(last), ARG(limit), ARG(additional))
+}
+
+void BacklogManager::receiveBacklogChunk(BufferId bufferId, QVariantList messages, bool complete)
+{
+    SYNC(ARG(bufferId), ARG(messages), ARG(complete))
+}
+
+QVariantList BacklogManager::requestBacklogSearch(
+    QString query, NetworkId networkId, BufferId bufferId, QString sender, int type, QDateTime start, QDateTime end, MsgId last, int limit)
+{
+    REQUEST(ARG(query), ARG(networkId), ARG(bufferId), ARG(sender), ARG(type), ARG(start), ARG(end), ARG(last), ARG(limit))
+    return QVariantList();
+}
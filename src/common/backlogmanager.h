@@ -22,6 +22,8 @@
 
 #include "common-export.h"
 
+#include <QDateTime>
+
 #include "syncableobject.h"
 #include "types.h"
 
@@ -51,6 +53,56 @@ public slots:
     inline virtual void receiveBacklogAll(MsgId, MsgId, int, int, QVariantList){};
     inline virtual void receiveBacklogAllFiltered(MsgId, MsgId, int, int, int, int, QVariantList){};
 
+    /**
+     * Requests backlog to be sent in chunks, as receiveBacklogChunk() calls
+     *
+     * Behaves like requestBacklog(), or requestBacklogAll() for an invalid buffer, but doesn't
+     * hold the whole backlog in memory at once.  Requires the StreamedBacklog feature.
+     *
+     * @param bufferId    Buffer to fetch backlog for, or an invalid BufferId for all buffers
+     * @param first       Oldest message to fetch, or -1
+     * @param last        Message to fetch backlog before, or -1 for the newest messages
+     * @param limit       Maximum number of messages to fetch, or -1 for no limit
+     * @param additional  Number of older messages to fetch in addition
+     */
+    virtual void requestBacklogStreamed(BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0);
+
+    /**
+     * Receives a chunk of backlog requested with requestBacklogStreamed()
+     *
+     * @param bufferId  The buffer given in the request
+     * @param messages  The messages, newest first
+     * @param complete  True for the final chunk of the request
+     */
+    virtual void receiveBacklogChunk(BufferId bufferId, QVariantList messages, bool complete);
+
+    /**
+     * Searches the backlog for messages containing the given words
+     *
+     * Results are sorted newest first.  To fetch the next page, repeat the request with last set to
+     * the oldest message received.  Requires the BacklogSearch feature.
+     *
+     * @param query      Words that have to appear in the message text
+     * @param networkId  Network to search, or an invalid NetworkId for all networks
+     * @param bufferId   Buffer to search, or an invalid BufferId for all buffers
+     * @param sender     Words that have to appear in the sender, e.g. a nick
+     * @param type       Message types to search, or -1 for all types
+     * @param start      If valid, only find messages sent at or after this time
+     * @param end        If valid, only find messages sent before this time
+     * @param last       Only find messages older than this one, or -1
+     * @param limit      Maximum number of messages to return, or -1 for as many as the core allows
+     */
+    virtual QVariantList requestBacklogSearch(QString query,
+                                              NetworkId networkId = {},
+                                              BufferId bufferId = {},
+                                              QString sender = {},
+                                              int type = -1,
+                                              QDateTime start = {},
+                                              QDateTime end = {},
+                                              MsgId last = -1,
+                                              int limit = -1);
+    inline virtual void receiveBacklogSearch(QString, NetworkId, BufferId, QString, int, QDateTime, QDateTime, MsgId, int, QVariantList){};
+
 signals:
     void backlogRequested(BufferId, MsgId, MsgId, int, int);
     void backlogAllRequested(MsgId, MsgId, int, int);
@@ -20,16 +20,27 @@
 
 #include "compressor.h"
 
+#include <QDataStream>
 #include <QTcpSocket>
 #include <QTimer>
 
+#ifdef HAVE_ZSTD
+#    include <zstd.h>
+#endif
+
 const int maxBufferSize = 64 * 1024 * 1024;  // protect us from zip bombs
 const int ioBufferSize = 64 * 1024;          // chunk size for inflate/deflate; should not be too large as we preallocate that space!
 
-Compressor::Compressor(QTcpSocket* socket, Compressor::CompressionLevel level, QObject* parent)
+#ifdef HAVE_ZSTD
+const int zstdWindowLog = 19;     // 512 KiB per direction and connection; plenty for the repetitive sync traffic
+const int zstdMaxWindowLog = 23;  // refuse streams that would make us allocate more than 8 MiB
+#endif
+
+Compressor::Compressor(QTcpSocket* socket, Compressor::CompressionLevel level, Compressor::Algorithm algorithm, QObject* parent)
     : QObject(parent)
     , _socket(socket)
     , _level(level)
+    , _algorithm(algorithm)
     , _inflater(nullptr)
     , _deflater(nullptr)
 {
@@ -62,10 +73,79 @@ Compressor::~Compressor()
         deflateEnd(_deflater);
         delete _deflater;
     }
+#ifdef HAVE_ZSTD
+    ZSTD_freeCCtx(_zstdCompressor);
+    ZSTD_freeDCtx(_zstdDecompressor);
+#endif
+}
+
+bool Compressor::isAvailable(Algorithm algorithm)
+{
+#ifdef HAVE_ZSTD
+    Q_UNUSED(algorithm)
+    return true;
+#else
+    return algorithm == Deflate;
+#endif
+}
+
+QByteArray Compressor::dictionary()
+{
+    // Sorted roughly by increasing frequency, as zstd can reference the end of the dictionary most cheaply
+    static const char* const keys[] = {"codecForServer", "codecForEncoding", "codecForDecoding", "skipCaps", "autoIdentifyService",
+                                       "autoIdentifyPassword", "saslAccount", "saslPassword", "useAutoReconnect", "autoReconnectInterval",
+                                       "autoReconnectRetries", "unlimitedReconnectRetries", "rejoinChannels", "useCustomMessageRate",
+                                       "msgRateBurstSize", "msgRateMessageDelay", "unlimitedMessageRate", "useRandomServer", "perform",
+                                       "ServerList", "identityId", "networkName", "currentServer", "myNick", "latency", "isConnected",
+                                       "connectionState", "Supports", "Caps", "CapsEnabled", "IrcUsersAndChannels", "ChanModes",
+                                       "UserModes", "topic", "password", "encrypted", "name", "whoisServiceReply", "suserHost",
+                                       "lastAwayMessageTime", "ircOperator", "server", "loginTime", "idleTime", "awayMessage", "away",
+                                       "account", "realName", "host", "user", "nick", "channels", "userModes"};
+    static const char* const types[] = {"IdentityId", "Identity", "NetworkInfo", "NetworkId", "BufferInfo", "MsgId", "BufferId", "Message"};
+    static const char* const classes[] = {"TransferManager", "CoreInfo", "NetworkConfig", "AliasManager", "IgnoreListManager",
+                                          "HighlightRuleManager", "BufferViewManager", "BufferViewConfig", "BacklogManager", "Network",
+                                          "BufferSyncer", "IrcChannel", "IrcUser"};
+    static const char* const slotNames[] = {"requestBacklog", "receiveBacklog", "receiveBacklogChunk", "setLatency", "setTopic",
+                                            "addChannelMode", "removeChannelMode", "setUserModes", "addUserModes", "removeUserModes",
+                                            "setServer", "setLoginTime", "setIdleTime", "setRealName", "setAccount", "setAwayMessage",
+                                            "setAway", "setHost", "setUser", "setNick", "quit", "partChannel", "joinChannel", "part",
+                                            "addUserMode", "removeUserMode", "joinIrcUsers", "addIrcUser", "setMarkerLine",
+                                            "setBufferActivity", "setHighlightCount", "setLastSeenMsg", "markBufferAsRead"};
+    static const char* const signalNames[] = {"2displayStatusMsg(QString,QString)",
+                                              "2bufferInfoUpdated(BufferInfo)",
+                                              "2displayMsg(Message)"};
+
+    static const QByteArray dict = []() {
+        QByteArray result;
+        QDataStream stream(&result, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_4_2);
+
+        // Strings and byte arrays wrapped in QVariants, the way DataStreamPeer sends them
+        for (const char* key : keys) {
+            stream << quint32(QMetaType::QString) << qint8(0) << QString::fromLatin1(key);
+        }
+        for (const char* type : types) {
+            stream << quint32(127) << qint8(0) << type;  // QVariant::UserType, as seen by Qt 4 streams
+        }
+        for (const char* slot : slotNames) {
+            stream << quint32(QMetaType::QByteArray) << qint8(0) << QByteArray(slot);
+        }
+        for (const char* signal : signalNames) {
+            stream << quint32(QMetaType::Int) << qint8(0) << qint32(2) << quint32(QMetaType::QByteArray) << qint8(0) << QByteArray(signal);
+        }
+        for (const char* cls : classes) {
+            stream << quint32(QMetaType::Int) << qint8(0) << qint32(1) << quint32(QMetaType::QByteArray) << qint8(0) << QByteArray(cls);
+        }
+        return result;
+    }();
+    return dict;
 }
 
 bool Compressor::initStreams()
 {
+    if (algorithm() != Deflate)
+        return initZstdStreams();
+
     int zlevel;
     switch (compressionLevel()) {
     case BestCompression:
@@ -100,6 +180,56 @@ bool Compressor::initStreams()
     return true;
 }
 
+bool Compressor::initZstdStreams()
+{
+#ifdef HAVE_ZSTD
+    int zlevel;
+    switch (compressionLevel()) {
+    case BestCompression:
+        // Higher levels cost a lot more CPU for little gain on this kind of traffic
+        zlevel = 6;
+        break;
+    case BestSpeed:
+        zlevel = 1;
+        break;
+    default:
+        zlevel = ZSTD_CLEVEL_DEFAULT;
+    }
+
+    _zstdCompressor = ZSTD_createCCtx();
+    _zstdDecompressor = ZSTD_createDCtx();
+    if (!_zstdCompressor || !_zstdDecompressor) {
+        qWarning() << "Could not initialize the zstd streams!";
+        return false;
+    }
+
+    if (ZSTD_isError(ZSTD_CCtx_setParameter(_zstdCompressor, ZSTD_c_compressionLevel, zlevel))
+        || ZSTD_isError(ZSTD_CCtx_setParameter(_zstdCompressor, ZSTD_c_windowLog, zstdWindowLog))
+        || ZSTD_isError(ZSTD_DCtx_setParameter(_zstdDecompressor, ZSTD_d_windowLogMax, zstdMaxWindowLog))) {
+        qWarning() << "Could not configure the zstd streams!";
+        return false;
+    }
+
+    if (algorithm() == ZstdWithDictionary) {
+        const QByteArray dict = dictionary();
+        if (ZSTD_isError(ZSTD_CCtx_loadDictionary(_zstdCompressor, dict.constData(), dict.size()))
+            || ZSTD_isError(ZSTD_DCtx_loadDictionary(_zstdDecompressor, dict.constData(), dict.size()))) {
+            qWarning() << "Could not load the zstd dictionary!";
+            return false;
+        }
+    }
+
+    _outputBuffer.resize(ioBufferSize);
+
+    qDebug() << "Enabling zstd compression...";
+
+    return true;
+#else
+    qWarning() << "Zstd compression requested, but not supported by this build!";
+    return false;
+#endif
+}
+
 qint64 Compressor::bytesAvailable() const
 {
     return _readBuffer.size();
@@ -156,6 +286,11 @@ void Compressor::readData()
         return;
     }
 
+    if (algorithm() != Deflate) {
+        readZstdData();
+        return;
+    }
+
     // We let zlib directly append to the readBuffer, which means we pre-allocate extra space for ioBufferSize.
     // Afterwards, we'll shrink the buffer appropriately. Since shrinking should not reallocate, the readBuffer's
     // capacity should over time adapt to the largest message sizes we encounter. However, this is not a bad thing
@@ -206,6 +341,45 @@ void Compressor::readData()
     // qDebug() << "inflate in:" << _inflater->total_in << "out:" << _inflater->total_out << "ratio:" << (double)_inflater->total_in/_inflater->total_out;
 }
 
+void Compressor::readZstdData()
+{
+#ifdef HAVE_ZSTD
+    // Unlike with zlib, we drain the decompressor completely for every chunk read from the socket. RemotePeer
+    // consumes complete messages as soon as we emit readyRead(), so the read buffer only grows beyond a single
+    // message if the peer sends garbage.
+    while (_socket->bytesAvailable()) {
+        _inputBuffer = _socket->read(ioBufferSize);
+        ZSTD_inBuffer input{_inputBuffer.constData(), static_cast<size_t>(_inputBuffer.size()), 0};
+
+        bool outputFull;
+        do {
+            if (_readBuffer.size() + ioBufferSize > maxBufferSize) {
+                qWarning() << "Decompressed data exceeds the maximum buffer size!";
+                emit error(StreamError);
+                return;
+            }
+
+            int pos = _readBuffer.size();
+            _readBuffer.resize(pos + ioBufferSize);
+            ZSTD_outBuffer output{_readBuffer.data() + pos, static_cast<size_t>(ioBufferSize), 0};
+            size_t status = ZSTD_decompressStream(_zstdDecompressor, &output, &input);
+            _readBuffer.resize(pos + static_cast<int>(output.pos));
+
+            if (ZSTD_isError(status)) {
+                qWarning() << "Error while decompressing stream:" << ZSTD_getErrorName(status);
+                emit error(StreamError);
+                return;
+            }
+
+            outputFull = output.pos == output.size;
+            if (output.pos > 0)
+                emit readyRead();
+        } while (input.pos < input.size || outputFull);
+    }
+    _inputBuffer.clear();
+#endif
+}
+
 void Compressor::writeData()
 {
     if (compressionLevel() == NoCompression) {
@@ -214,6 +388,11 @@ void Compressor::writeData()
         return;
     }
 
+    if (algorithm() != Deflate) {
+        writeZstdData();
+        return;
+    }
+
     _deflater->next_in = reinterpret_cast<unsigned char*>(_writeBuffer.data());
     _deflater->avail_in = _writeBuffer.size();
 
@@ -248,6 +427,32 @@ void Compressor::writeData()
     // qDebug() << "deflate in:" << _deflater->total_in << "out:" << _deflater->total_out << "ratio:" << (double)_deflater->total_out/_deflater->total_in;
 }
 
+void Compressor::writeZstdData()
+{
+#ifdef HAVE_ZSTD
+    ZSTD_inBuffer input{_writeBuffer.constData(), static_cast<size_t>(_writeBuffer.size()), 0};
+
+    size_t remaining;
+    do {
+        ZSTD_outBuffer output{_outputBuffer.data(), static_cast<size_t>(ioBufferSize), 0};
+        remaining = ZSTD_compressStream2(_zstdCompressor, &output, &input, ZSTD_e_flush);
+        if (ZSTD_isError(remaining)) {
+            qWarning() << "Error while compressing stream:" << ZSTD_getErrorName(remaining);
+            emit error(StreamError);
+            return;
+        }
+
+        if (output.pos > 0 && !_socket->write(_outputBuffer.constData(), static_cast<qint64>(output.pos))) {
+            qWarning() << "Error while writing to socket:" << _socket->errorString();
+            emit error(DeviceError);
+            return;
+        }
+    } while (remaining > 0);  // with ZSTD_e_flush, all input has been consumed once nothing remains to be flushed
+
+    _writeBuffer.resize(0);
+#endif
+}
+
 void Compressor::flush()
 {
     if (compressionLevel() == NoCompression && _socket->state() == QAbstractSocket::ConnectedState)
@@ -25,6 +25,8 @@
 #include <zlib.h>
 
 class QTcpSocket;
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
 
 class Compressor : public QObject
 {
@@ -39,6 +41,13 @@ public:
         BestSpeed
     };
 
+    enum Algorithm
+    {
+        Deflate,
+        Zstd,                ///< Requires Protocol::ZstdCompression
+        ZstdWithDictionary,  ///< Zstd, primed with dictionary(); requires Protocol::ZstdDictionary as well
+    };
+
     enum Error
     {
         NoError,
@@ -52,10 +61,23 @@ public:
         Flush
     };
 
-    Compressor(QTcpSocket* socket, CompressionLevel level, QObject* parent = nullptr);
+    Compressor(QTcpSocket* socket, CompressionLevel level, Algorithm algorithm, QObject* parent = nullptr);
     ~Compressor() override;
 
     CompressionLevel compressionLevel() const { return _level; }
+    Algorithm algorithm() const { return _algorithm; }
+
+    /// Whether this build supports the given algorithm
+    static bool isAvailable(Algorithm algorithm);
+
+    /**
+     * Returns the dictionary used for ZstdWithDictionary
+     *
+     * It is made up of the identifiers that dominate SignalProxy traffic, as serialized by the
+     * DataStream protocol, so even the first messages on a connection compress well. Client and
+     * core must use the exact same dictionary; any change to it requires a new protocol feature.
+     */
+    static QByteArray dictionary();
 
     qint64 bytesAvailable() const;
 
@@ -73,11 +95,15 @@ private slots:
 
 private:
     bool initStreams();
+    bool initZstdStreams();
+    void readZstdData();
     void writeData();
+    void writeZstdData();
 
 private:
     QTcpSocket* _socket;
     CompressionLevel _level;
+    Algorithm _algorithm;
 
     QByteArray _readBuffer;
     QByteArray _writeBuffer;
@@ -87,4 +113,7 @@ private:
 
     z_streamp _inflater;
     z_streamp _deflater;
+
+    ZSTD_CCtx_s* _zstdCompressor{nullptr};
+    ZSTD_DCtx_s* _zstdDecompressor{nullptr};
 };
@@ -20,6 +20,8 @@
 
 #include "eventmanager.h"
 
+#include <algorithm>
+
 #include <QCoreApplication>
 #include <QDebug>
 #include <QEvent>
@@ -154,6 +156,7 @@ void EventManager::registerObject(QObject* object, Priority priority, const QStr
             // qDebug() << "Registered event filterer for" << methodSignature << "in" << object;
         }
     }
+    _dispatchTables.clear();
 }
 
 void EventManager::registerEventFilter(EventType event, QObject* object, const char* slot)
@@ -189,6 +192,7 @@ void EventManager::registerEventHandler(QList<EventType> events, QObject* object
             qDebug() << "Registered event handler for" << event << "in" << object;
         }
     }
+    _dispatchTables.clear();
 }
 
 void EventManager::postEvent(Event* event)
@@ -230,70 +234,99 @@ void EventManager::dispatchEvent(Event* event)
 {
     // qDebug() << "Dispatching" << event;
 
-    // we try handlers from specialized to generic by masking the enum
-
-    // build a list sorted by priorities that contains all eligible handlers
-    QList<Handler> handlers;
-    QHash<QObject*, Handler> filters;
-    QSet<QObject*> ignored;
     uint type = event->type();
-
-    bool checkDupes = false;
+    int num = 0;
 
     // special handling for numeric IrcEvents
     if ((type & ~IrcEventNumericMask) == IrcEventNumeric) {
         auto* numEvent = static_cast<::IrcEventNumeric*>(event);
         if (!numEvent)
             qWarning() << "Invalid event type for IrcEventNumeric!";
-        else {
-            int num = numEvent->number();
-            if (num > 0) {
-                insertHandlers(registeredHandlers().value(type + num), handlers, false);
-                insertFilters(registeredFilters().value(type + num), filters);
-                checkDupes = true;
-            }
-        }
+        else
+            num = numEvent->number();
     }
 
-    // exact type
-    insertHandlers(registeredHandlers().value(type), handlers, checkDupes);
-    insertFilters(registeredFilters().value(type), filters);
+    // Keep our own reference, the cache might be cleared by one of the handlers
+    std::shared_ptr<const DispatchTable> table = dispatchTable(type, num);
 
-    // check if we have a generic handler for the event group
-    if ((type & EventGroupMask) != type) {
-        insertHandlers(registeredHandlers().value(type & EventGroupMask), handlers, true);
-        insertFilters(registeredFilters().value(type & EventGroupMask), filters);
-    }
+    // objects that have filtered the event
+    std::vector<QObject*> ignored;
 
     // now dispatch the event
-    QList<Handler>::const_iterator it;
-    for (it = handlers.begin(); it != handlers.end() && !event->isStopped(); ++it) {
-        QObject* obj = it->object;
+    for (auto it = table->begin(); it != table->end() && !event->isStopped(); ++it) {
+        QObject* obj = it->handler.object;
 
-        if (ignored.contains(obj))  // object has filtered the event
+        if (!ignored.empty() && std::find(ignored.begin(), ignored.end(), obj) != ignored.end())
             continue;
 
-        if (filters.contains(obj)) {  // we have a filter, so let's check if we want to deliver the event
-            Handler filter = filters.value(obj);
+        if (it->filterMethodIndex >= 0) {  // we have a filter, so let's check if we want to deliver the event
             bool result = false;
             void* param[] = {Q_RETURN_ARG(bool, result).data(), Q_ARG(Event*, event).data()};
-            obj->qt_metacall(QMetaObject::InvokeMetaMethod, filter.methodIndex, param);
+            obj->qt_metacall(QMetaObject::InvokeMetaMethod, it->filterMethodIndex, param);
             if (!result) {
-                ignored.insert(obj);
+                ignored.push_back(obj);
                 continue;  // mmmh, event filter told us to not accept
             }
         }
 
         // finally, deliverance!
         void* param[] = {nullptr, Q_ARG(Event*, event).data()};
-        obj->qt_metacall(QMetaObject::InvokeMetaMethod, it->methodIndex, param);
+        obj->qt_metacall(QMetaObject::InvokeMetaMethod, it->handler.methodIndex, param);
     }
 
     // that's it
     delete event;
 }
 
-void EventManager::insertHandlers(const QList<Handler>& newHandlers, QList<Handler>& existing, bool checkDupes)
+std::shared_ptr<const EventManager::DispatchTable> EventManager::dispatchTable(uint type, int num)
+{
+    // Numeric handlers are registered as IrcEventNumeric + number, so that's a unique key as well
+    uint key = num > 0 ? type + num : type;
+    auto it = _dispatchTables.constFind(key);
+    if (it != _dispatchTables.constEnd())
+        return *it;
+
+    auto table = buildDispatchTable(type, num);
+    _dispatchTables.insert(key, table);
+    return table;
+}
+
+std::shared_ptr<const EventManager::DispatchTable> EventManager::buildDispatchTable(uint type, int num) const
+{
+    // we try handlers from specialized to generic by masking the enum
+
+    // build a list sorted by priorities that contains all eligible handlers
+    QList<Handler> handlers;
+    QHash<QObject*, Handler> filters;
+
+    bool checkDupes = false;
+
+    if (num > 0) {
+        insertHandlers(registeredHandlers().value(type + num), handlers, false);
+        insertFilters(registeredFilters().value(type + num), filters);
+        checkDupes = true;
+    }
+
+    // exact type
+    insertHandlers(registeredHandlers().value(type), handlers, checkDupes);
+    insertFilters(registeredFilters().value(type), filters);
+
+    // check if we have a generic handler for the event group
+    if ((type & EventGroupMask) != type) {
+        insertHandlers(registeredHandlers().value(type & EventGroupMask), handlers, true);
+        insertFilters(registeredFilters().value(type & EventGroupMask), filters);
+    }
+
+    auto table = std::make_shared<DispatchTable>();
+    table->reserve(handlers.count());
+    for (const Handler& handler : handlers) {
+        auto filter = filters.constFind(handler.object);
+        table->push_back({handler, filter != filters.constEnd() ? filter->methodIndex : -1});
+    }
+    return table;
+}
+
+void EventManager::insertHandlers(const QList<Handler>& newHandlers, QList<Handler>& existing, bool checkDupes) const
 {
     foreach (const Handler& handler, newHandlers) {
         if (existing.isEmpty())
@@ -321,7 +354,7 @@ void EventManager::insertHandlers(const QList<Handler>& newHandlers, QList<Handl
 
 // priority is ignored, and only the first (should be most specialized) filter is being used
 // fun things could happen if you used the registerEventFilter() methods in the wrong order though
-void EventManager::insertFilters(const QList<Handler>& newFilters, QHash<QObject*, Handler>& existing)
+void EventManager::insertFilters(const QList<Handler>& newFilters, QHash<QObject*, Handler>& existing) const
 {
     foreach (const Handler& filter, newFilters) {
         if (!existing.contains(filter.object))
@@ -22,6 +22,9 @@
 
 #include "common-export.h"
 
+#include <memory>
+#include <vector>
+
 #include <QMetaEnum>
 
 #include "types.h"
@@ -176,6 +179,16 @@ private:
 
     using HandlerHash = QHash<uint, QList<Handler>>;
 
+    //! A handler, along with the filter its object registered for the same event (-1 if none)
+    struct DispatchEntry
+    {
+        Handler handler;
+        int filterMethodIndex;
+    };
+
+    //! Resolved handler chain for one event type, in dispatch order
+    using DispatchTable = std::vector<DispatchEntry>;
+
     inline const HandlerHash& registeredHandlers() const { return _registeredHandlers; }
     inline HandlerHash& registeredHandlers() { return _registeredHandlers; }
 
@@ -183,20 +196,30 @@ private:
     inline HandlerHash& registeredFilters() { return _registeredFilters; }
 
     //! Add handlers to an existing sorted (by priority) handler list
-    void insertHandlers(const QList<Handler>& newHandlers, QList<Handler>& existing, bool checkDupes = false);
+    void insertHandlers(const QList<Handler>& newHandlers, QList<Handler>& existing, bool checkDupes = false) const;
     //! Add filters to an existing filter hash
-    void insertFilters(const QList<Handler>& newFilters, QHash<QObject*, Handler>& existing);
+    void insertFilters(const QList<Handler>& newFilters, QHash<QObject*, Handler>& existing) const;
 
     int findEventType(const QString& methodSignature, const QString& methodPrefix) const;
 
     void processEvent(Event* event);
     void dispatchEvent(Event* event);
 
+    //! Get the handler chain for an event type, building and caching it on first use
+    /**
+      @param type   The event's type
+      @param num    The number of a numeric IrcEvent, 0 otherwise
+     */
+    std::shared_ptr<const DispatchTable> dispatchTable(uint type, int num);
+    std::shared_ptr<const DispatchTable> buildDispatchTable(uint type, int num) const;
+
     //! @return the EventType enum
     static QMetaEnum eventEnum();
 
     HandlerHash _registeredHandlers;
     HandlerHash _registeredFilters;
+    // Tables are shared, as handlers may register new ones (clearing the cache) while being dispatched to
+    QHash<uint, std::shared_ptr<const DispatchTable>> _dispatchTables;  ///< Cleared whenever a handler is registered
     QList<Event*> _eventQueue;
     static QMetaEnum _enum;
 };
@@ -74,6 +74,22 @@ bool ExpressionMatch::match(const QString& string, bool matchEmpty) const
     }
 }
 
+QString ExpressionMatch::combinablePattern() const
+{
+    if (_sourceExpressionEmpty || _matchInvertRegExActive || !_matchRegExActive || !_matchRegEx.isValid()) {
+        return {};
+    }
+
+    // Backreferences (\1, \g{1}, \k<name>, (?P=name)), subroutine calls and recursion ((?1), (?R),
+    // (?&name)) and branch resets ((?|...)) would all change meaning inside a larger expression
+    static const QRegularExpression selfReference(R"(\\(?:[1-9]|g|k)|\(\?(?:P[=>]|[0-9R&|+-]))");
+    QString pattern = _matchRegEx.pattern();
+    if (pattern.contains(selfReference)) {
+        return {};
+    }
+    return pattern;
+}
+
 QString ExpressionMatch::trimMultiWildcardWhitespace(const QString& originalRule)
 {
     // This gets handled in two steps:
@@ -171,6 +171,17 @@ public:
      */
     static QString trimMultiWildcardWhitespace(const QString& originalRule);
 
+    /**
+     * Gets the regular expression pattern of this expression, if it can be combined with others
+     *
+     * Only valid, non-empty expressions without inverted rules can be combined, as these match
+     * whenever their pattern matches.  Patterns referring to their own capture groups by number or
+     * name are excluded as well, since those references break when the pattern gets embedded.
+     *
+     * @return Regular expression pattern for combining, or an empty string if not combinable
+     */
+    QString combinablePattern() const;
+
 private:
     /**
      * Calculates internal regular expressions
@@ -99,6 +99,7 @@ void HighlightRuleManager::initSetHighlightRuleList(const QVariantMap& highlight
     }
 
     _highlightRuleList.clear();
+    _compiledRulesValid = false;
     for (int i = 0; i < name.count(); i++) {
         _highlightRuleList << HighlightRule(id[i].toInt(),
                                             name[i],
@@ -120,6 +121,7 @@ void HighlightRuleManager::addHighlightRule(
 
     HighlightRule newItem = HighlightRule(id, name, isRegEx, isCaseSensitive, isActive, isInverse, sender, channel);
     _highlightRuleList << newItem;
+    _compiledRulesValid = false;
 
     SYNC(ARG(id), ARG(name), ARG(isRegEx), ARG(isCaseSensitive), ARG(isActive), ARG(isInverse), ARG(sender), ARG(channel))
 }
@@ -137,11 +139,36 @@ bool HighlightRuleManager::match(const NetworkId& netId,
         return false;
     }
 
+    compileRules();
+
+    // Only strip formatting once for all rules
+    const QString contents = stripFormatCodes(msgContents);
+
+    // Check all combinable rules at once.  Rules whose combined expression doesn't match can be
+    // skipped right away; for the ones that do, we already know at least one rule matches.
+    std::vector<bool> combinedMatches(_combinedContents.size(), false);
+    std::vector<bool> knownContentsMatches(_compiledRules.size(), false);
+    for (size_t i = 0; i < _combinedContents.size(); i++) {
+        const CombinedExpression& combined = _combinedContents[i];
+        QRegularExpressionMatch match = combined.regEx.match(contents);
+        if (!match.hasMatch())
+            continue;
+        combinedMatches[i] = true;
+        for (const auto& ruleGroup : combined.ruleGroups) {
+            if (match.capturedStart(ruleGroup.first) != -1) {
+                knownContentsMatches[ruleGroup.second] = true;
+                break;
+            }
+        }
+    }
+
     bool matches = false;
 
-    for (int i = 0; i < _highlightRuleList.count(); i++) {
-        auto& rule = _highlightRuleList.at(i);
-        if (!rule.isEnabled())
+    for (size_t i = 0; i < _compiledRules.size(); i++) {
+        const CompiledRule& rule = _compiledRules[i];
+
+        // The contents of this rule can't match if the combined expression didn't
+        if (rule.combinedIndex >= 0 && !combinedMatches[rule.combinedIndex])
             continue;
 
         // Skip if channel name doesn't match and channel rule is not empty
@@ -150,21 +177,21 @@ bool HighlightRuleManager::match(const NetworkId& netId,
         //   Channel name matches a defined rule
         //   Defined rule is empty
         // And take the inverse of the above
-        if (!rule.chanNameMatcher().match(bufferName, true)) {
+        if (!rule.chanNameMatch.match(bufferName, true)) {
             // A channel name rule is specified and does NOT match the current buffer name, skip
             // this rule
             continue;
         }
 
         // Check message according to specified rule, allowing empty rules to match
-        bool contentsMatch = rule.contentsMatcher().match(stripFormatCodes(msgContents), true);
+        bool contentsMatch = knownContentsMatches[i] || rule.contentsMatch.match(contents, true);
 
         // Check sender according to specified rule, allowing empty rules to match
-        bool senderMatch = rule.senderMatcher().match(msgSender, true);
+        bool senderMatch = rule.senderMatch.match(msgSender, true);
 
         if (contentsMatch && senderMatch) {
             // If an inverse rule matches, then we know that we never want to return a highlight.
-            if (rule.isInverse()) {
+            if (rule.isInverse) {
                 return false;
             }
             else {
@@ -180,7 +207,7 @@ bool HighlightRuleManager::match(const NetworkId& netId,
     if (_highlightNick != HighlightNickType::NoNick && !currentNick.isEmpty()) {
         // Nickname matching allowed and current nickname is known
         // Run the nickname matcher on the unformatted string
-        if (_nickMatcher.match(stripFormatCodes(msgContents), netId, currentNick, identityNicks)) {
+        if (_nickMatcher.match(contents, netId, currentNick, identityNicks)) {
             return true;
         }
     }
@@ -200,6 +227,7 @@ void HighlightRuleManager::toggleHighlightRule(int highlightRule)
     if (idx == -1)
         return;
     _highlightRuleList[idx].setIsEnabled(!_highlightRuleList[idx].isEnabled());
+    _compiledRulesValid = false;
     SYNC(ARG(highlightRule))
 }
 
@@ -215,6 +243,73 @@ bool HighlightRuleManager::match(const Message& msg, const QString& currentNick,
                  identityNicks);
 }
 
+void HighlightRuleManager::compileRules()
+{
+    if (_compiledRulesValid)
+        return;
+
+    _compiledRules.clear();
+    _combinedContents.clear();
+
+    // Name prefix of the capture group wrapping each rule, unlikely to clash with the rule itself
+    static const QString ruleGroupPrefix = QStringLiteral("quasselrule");
+
+    // Combinable patterns of each case sensitivity, along with the index of their rule
+    QList<QPair<QString, int>> combinable[2];
+
+    for (const HighlightRule& rule : _highlightRuleList) {
+        if (!rule.isEnabled())
+            continue;
+
+        int index = static_cast<int>(_compiledRules.size());
+        _compiledRules.push_back({rule.isInverse(), -1, rule.contentsMatcher(), rule.senderMatcher(), rule.chanNameMatcher()});
+
+        QString pattern = rule.contentsMatcher().combinablePattern();
+        if (!pattern.isEmpty())
+            combinable[rule.isCaseSensitive() ? 1 : 0] << qMakePair(pattern, index);
+    }
+
+    for (int caseSensitive = 0; caseSensitive < 2; caseSensitive++) {
+        // Not worth it for a single rule
+        if (combinable[caseSensitive].count() < 2)
+            continue;
+
+        QStringList alternatives;
+        for (const auto& entry : combinable[caseSensitive]) {
+            alternatives << "(?<" + ruleGroupPrefix + QString::number(entry.second) + ">" + entry.first + ")";
+        }
+
+        // Keep the options in sync with ExpressionMatch
+        QRegularExpression::PatternOptions options = QRegularExpression::UseUnicodePropertiesOption;
+        if (!caseSensitive)
+            options |= QRegularExpression::CaseInsensitiveOption;
+
+        CombinedExpression combined;
+        combined.regEx = QRegularExpression(alternatives.join("|"), options);
+        if (!combined.regEx.isValid()) {
+            qDebug() << "Could not combine highlight rules, matching them one by one:" << combined.regEx.errorString();
+            continue;
+        }
+        // All of these get used for every message
+        combined.regEx.optimize();
+
+        // Map capture groups back to rules, as rules may contain unnamed groups of their own
+        QStringList groupNames = combined.regEx.namedCaptureGroups();
+        for (int group = 1; group < groupNames.count(); group++) {
+            if (groupNames[group].startsWith(ruleGroupPrefix))
+                combined.ruleGroups << qMakePair(group, groupNames[group].mid(ruleGroupPrefix.size()).toInt());
+        }
+
+        int combinedIndex = static_cast<int>(_combinedContents.size());
+        for (const auto& entry : combinable[caseSensitive]) {
+            _compiledRules[entry.second].combinedIndex = combinedIndex;
+        }
+        _combinedContents.push_back(std::move(combined));
+    }
+
+    _compiledRulesValid = true;
+}
+
 /**************************************************************************
  * HighlightRule
  *************************************************************************/
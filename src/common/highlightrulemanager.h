@@ -23,11 +23,15 @@
 #include "common-export.h"
 
 #include <utility>
+#include <vector>
 
+#include <QPair>
+#include <QRegularExpression>
 #include <QString>
 #include <QStringList>
 #include <QVariantList>
 #include <QVariantMap>
+#include <QVector>
 
 #include "expressionmatch.h"
 #include "message.h"
@@ -304,9 +308,22 @@ public:
     inline bool contains(int rule) const { return indexOf(rule) != -1; }
     inline bool isEmpty() const { return _highlightRuleList.isEmpty(); }
     inline int count() const { return _highlightRuleList.count(); }
-    inline void removeAt(int index) { _highlightRuleList.removeAt(index); }
-    inline void clear() { _highlightRuleList.clear(); }
-    inline HighlightRule& operator[](int i) { return _highlightRuleList[i]; }
+    inline void removeAt(int index)
+    {
+        _highlightRuleList.removeAt(index);
+        _compiledRulesValid = false;
+    }
+    inline void clear()
+    {
+        _highlightRuleList.clear();
+        _compiledRulesValid = false;
+    }
+    inline HighlightRule& operator[](int i)
+    {
+        // The rule might get modified
+        _compiledRulesValid = false;
+        return _highlightRuleList[i];
+    }
     inline const HighlightRule& operator[](int i) const { return _highlightRuleList.at(i); }
     inline const HighlightRuleList& highlightRuleList() const { return _highlightRuleList; }
 
@@ -403,7 +420,11 @@ public slots:
     }
 
 protected:
-    void setHighlightRuleList(const QList<HighlightRule>& HighlightRuleList) { _highlightRuleList = HighlightRuleList; }
+    void setHighlightRuleList(const QList<HighlightRule>& HighlightRuleList)
+    {
+        _highlightRuleList = HighlightRuleList;
+        _compiledRulesValid = false;
+    }
 
     bool match(const NetworkId& netId,
                const QString& msgContents,
@@ -418,7 +439,40 @@ signals:
     void ruleAdded(QString name, bool isRegEx, bool isCaseSensitive, bool isEnabled, bool isInverse, QString sender, QString chanName);
 
 private:
+    /**
+     * Enabled highlight rule, with its expression matchers resolved
+     */
+    struct CompiledRule
+    {
+        bool isInverse;
+        int combinedIndex;  ///< Index into _combinedContents if the contents are matched there, else -1
+        ExpressionMatch contentsMatch;
+        ExpressionMatch senderMatch;
+        ExpressionMatch chanNameMatch;
+    };
+
+    /**
+     * Contents expressions of many rules, merged into a single regular expression
+     *
+     * Each rule is wrapped in a capture group of its own.  If the expression doesn't match, none
+     * of the rules can match; if it does, at least the rule owning the matched group matches.
+     */
+    struct CombinedExpression
+    {
+        QRegularExpression regEx;
+        QVector<QPair<int, int>> ruleGroups;  ///< Pairs of capture group number and index into _compiledRules
+    };
+
+    /**
+     * Rebuild the compiled rules and combined expressions if the rule list changed
+     */
+    void compileRules();
+
     HighlightRuleList _highlightRuleList = {};  ///< Custom highlight rule list
+
+    bool _compiledRulesValid = false;                        ///< If false, the compiled rules need to be rebuilt
+    std::vector<CompiledRule> _compiledRules = {};           ///< Enabled rules, in list order
+    std::vector<CombinedExpression> _combinedContents = {};  ///< Combined contents, by case sensitivity
     NickHighlightMatcher _nickMatcher = {};     ///< Nickname highlight matcher
 
     /// Nickname highlighting mode
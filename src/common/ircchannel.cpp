@@ -42,6 +42,11 @@ IrcChannel::IrcChannel(const QString& channelname, Network* network)
     setObjectName(QString::number(network->networkId().toInt()) + "/" + channelname);
 }
 
+void IrcChannel::aboutToSync() const
+{
+    _network->invalidateEncodedIrcUsersAndChannels();
+}
+
 // ====================
 //  PUBLIC:
 // ====================
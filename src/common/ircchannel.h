@@ -132,6 +132,8 @@ private slots:
     void ircUserNickSet(QString nick);
 
 private:
+    void aboutToSync() const override;
+
     bool _initialized;
     QString _name;
     QString _topic;
@@ -100,10 +100,13 @@ void IrcDecoder::skipEmptyParts(const QByteArray& raw, int& start)
     }
 }
 
-QHash<IrcTagKey, QString> IrcDecoder::parseTags(const std::function<QString(const QByteArray&)>& decode, const QByteArray& raw, int& start)
+QHash<IrcTagKey, QString> IrcDecoder::parseTags(const std::function<QString(const QByteArray&)>& decode, const QByteArray& encodedTags)
 {
     QHash<IrcTagKey, QString> tags = {};
-    QString rawTagStr = decode(extractFragment(raw, start, -1, '@'));
+    if (encodedTags.isEmpty()) {
+        return tags;
+    }
+    QString rawTagStr = decode(encodedTags);
     // Tags are delimited with ; according to spec
     QList<QString> rawTags = rawTagStr.split(';');
     for (const QString& rawTag : rawTags) {
@@ -141,25 +144,51 @@ QHash<IrcTagKey, QString> IrcDecoder::parseTags(const std::function<QString(cons
     return tags;
 }
 
-QString IrcDecoder::parsePrefix(const std::function<QString(const QByteArray&)>& decode, const QByteArray& raw, int& start)
+void IrcDecoder::parseSlices(const QByteArray& raw, MessageSlices& slices)
 {
-    return decode(extractFragment(raw, start, -1, ':'));
-}
+    const int length = raw.length();
+    const char* data = raw.constData();
+    // End of the space-delimited fragment starting at the given index
+    auto fragmentEnd = [&raw, length](int from) {
+        int end = raw.indexOf(' ', from);
+        return end == -1 ? length : end;
+    };
 
-QString IrcDecoder::parseCommand(const std::function<QString(const QByteArray&)>& decode, const QByteArray& raw, int& start)
-{
-    return decode(extractFragment(raw, start, -1));
-}
+    slices.tags = {};
+    slices.prefix = {};
+    slices.command = {};
+    slices.parameters.clear();
 
-QByteArray IrcDecoder::parseParameter(const QByteArray& raw, int& start)
-{
-    if (start < raw.length() && raw[start] == ':') {
-        // Skip the prefix
-        start++;
-        return extractFragment(raw, start, raw.size());
+    int start = 0;
+    skipEmptyParts(raw, start);
+    if (start < length && data[start] == '@') {
+        int end = fragmentEnd(start);
+        slices.tags = {start + 1, end - start - 1};
+        start = end;
     }
-    else {
-        return extractFragment(raw, start);
+    skipEmptyParts(raw, start);
+    if (start < length && data[start] == ':') {
+        int end = fragmentEnd(start);
+        slices.prefix = {start + 1, end - start - 1};
+        start = end;
+    }
+    skipEmptyParts(raw, start);
+    int end = fragmentEnd(start);
+    slices.command = {start, end - start};
+    start = end;
+    skipEmptyParts(raw, start);
+    while (start != length) {
+        if (data[start] == ':') {
+            // Trailing parameter, takes up the rest of the message
+            slices.parameters.append({start + 1, length - start - 1});
+            start = length;
+        }
+        else {
+            end = fragmentEnd(start);
+            slices.parameters.append({start, end - start});
+            start = end;
+        }
+        skipEmptyParts(raw, start);
     }
 }
 
@@ -170,19 +199,15 @@ void IrcDecoder::parseMessage(const std::function<QString(const QByteArray&)>& d
                               QString& command,
                               QList<QByteArray>& parameters)
 {
-    int start = 0;
-    skipEmptyParts(rawMsg, start);
-    tags = parseTags(decode, rawMsg, start);
-    skipEmptyParts(rawMsg, start);
-    prefix = parsePrefix(decode, rawMsg, start);
-    skipEmptyParts(rawMsg, start);
-    command = parseCommand(decode, rawMsg, start);
-    skipEmptyParts(rawMsg, start);
+    MessageSlices slices;
+    parseSlices(rawMsg, slices);
+    tags = parseTags(decode, slice(rawMsg, slices.tags));
+    prefix = decode(slice(rawMsg, slices.prefix));
+    command = decode(slice(rawMsg, slices.command));
     QList<QByteArray> params;
-    while (start != rawMsg.length()) {
-        QByteArray param = parseParameter(rawMsg, start);
-        skipEmptyParts(rawMsg, start);
-        params.append(param);
+    params.reserve(slices.parameters.size());
+    for (const Slice& param : slices.parameters) {
+        params.append(rawMsg.mid(param.offset, param.length));
     }
     parameters = params;
 }
@@ -24,11 +24,33 @@
 
 #include <functional>
 
+#include <QVarLengthArray>
+
 #include "irctag.h"
 
 class COMMON_EXPORT IrcDecoder
 {
 public:
+    /**
+     * Position of a part of a raw message
+     */
+    struct Slice
+    {
+        int offset{0};
+        int length{0};
+    };
+
+    /**
+     * Positions of the parts of a raw message, as determined by parseSlices()
+     */
+    struct MessageSlices
+    {
+        Slice tags;     ///< Without the leading '@', empty if there are no tags
+        Slice prefix;   ///< Without the leading ':', empty if there is no prefix
+        Slice command;
+        QVarLengthArray<Slice, 16> parameters;  ///< Trailing parameter without its ':'; IRC allows for at most 15 parameters
+    };
+
     /**
      * Parses an IRC message
      * @param decode Decoder to be used for decoding the message
@@ -40,6 +62,24 @@ public:
      */
     static void parseMessage(const std::function<QString(const QByteArray&)>& decode, const QByteArray& raw, QHash<IrcTagKey, QString>& tags, QString& prefix, QString& command, QList<QByteArray>& parameters);
 
+    /**
+     * Splits an IRC message into its parts, without copying or decoding anything
+     * @param raw Raw Message
+     * @param slices[out] Positions of the parts within the raw message
+     */
+    static void parseSlices(const QByteArray& raw, MessageSlices& slices);
+
+    /**
+     * Returns a part of a raw message without copying it
+     * @param raw Raw Message
+     * @param part Position of the part, as determined by parseSlices()
+     * @return View of the part, only valid as long as the raw message is; null if the part is empty
+     */
+    static QByteArray slice(const QByteArray& raw, const Slice& part)
+    {
+        return part.length ? QByteArray::fromRawData(raw.constData() + part.offset, part.length) : QByteArray();
+    }
+
     /**
      * Extracts a space-delimited fragment from an IRC message
      * @param raw Raw Message
@@ -65,35 +105,10 @@ private:
      */
     static QString parseTagValue(const QString& value);
     /**
-     * Parses IRCv3 message tags given a message
+     * Parses IRCv3 message tags
      * @param net Decoder to be used for decoding the message
-     * @param raw Raw Message
-     * @param start Current index into the message, will be advanced automatically
+     * @param encodedTags Raw message tags, without the leading '@'
      * @return Parsed message tags
      */
-    static QHash<IrcTagKey, QString> parseTags(const std::function<QString(const QByteArray&)>& decode, const QByteArray& raw, int& start);
-    /**
-     * Parses an IRC prefix, if available
-     * @param net Decoder to be used for decoding the message
-     * @param raw Raw Message
-     * @param start Current index into the message, will be advanced automatically
-     * @return Parsed prefix or empty string
-     */
-    static QString parsePrefix(const std::function<QString(const QByteArray&)>& decode, const QByteArray& raw, int& start);
-    /**
-     * Parses an IRC named command or numeric RPL
-     * @param net Decoder to be used for decoding the message
-     * @param raw Raw Message
-     * @param start Current index into the message, will be advanced automatically
-     * @return Parsed command
-     */
-    static QString parseCommand(const std::function<QString(const QByteArray&)>& decode, const QByteArray& raw, int& start);
-    /**
-     * Parses an IRC parameter
-     * @param net Decoder to be used for decoding the message
-     * @param raw Raw Message
-     * @param start Current index into the message, will be advanced automatically
-     * @return Parsed parameter
-     */
-    static QByteArray parseParameter(const QByteArray& raw, int& start);
+    static QHash<IrcTagKey, QString> parseTags(const std::function<QString(const QByteArray&)>& decode, const QByteArray& encodedTags);
 };
@@ -0,0 +1,65 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "irclinereader.h"
+
+#include <QIODevice>
+
+qint64 IrcLineReader::readFrom(QIODevice* device)
+{
+    if (_begin > 0) {
+        // Keep the incomplete line, if any; this doesn't free the buffer's memory
+        _buffer.remove(0, _begin);
+        _begin = 0;
+    }
+
+    qint64 available = device->bytesAvailable();
+    if (available <= 0)
+        return 0;
+
+    int size = _buffer.size();
+    // Reserving also keeps QByteArray from releasing the memory once everything has been consumed
+    if (_buffer.capacity() < size + available)
+        _buffer.reserve(size + static_cast<int>(available));
+    _buffer.resize(size + static_cast<int>(available));
+    qint64 bytesRead = device->read(_buffer.data() + size, available);
+    _buffer.resize(size + static_cast<int>(qMax<qint64>(bytesRead, 0)));
+    return bytesRead;
+}
+
+bool IrcLineReader::readLine(QByteArray& line)
+{
+    int end = _buffer.indexOf('\n', _begin);
+    if (end == -1)
+        return false;
+
+    int next = end + 1;
+    if (end > _begin && _buffer.at(end - 1) == '\r')
+        end--;
+    line = QByteArray::fromRawData(_buffer.constData() + _begin, end - _begin);
+    _begin = next;
+    return true;
+}
+
+void IrcLineReader::clear()
+{
+    _buffer.clear();
+    _begin = 0;
+}
@@ -0,0 +1,69 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include "common-export.h"
+
+#include <QByteArray>
+
+class QIODevice;
+
+/**
+ * Splits the data received from an IRC server into lines
+ *
+ * Everything available on the device is read at once into a buffer that is reused for the lifetime
+ * of the reader; only an incomplete line at the end is moved to the front before reading more.
+ * Lines are handed out as views into that buffer, so there's no allocation per line.
+ */
+class COMMON_EXPORT IrcLineReader
+{
+public:
+    /**
+     * Appends all data available from the device to the buffer
+     *
+     * Invalidates all lines returned by readLine() so far.
+     *
+     * @param device Device to read from
+     * @return Number of bytes read, or -1 on error
+     */
+    qint64 readFrom(QIODevice* device);
+
+    /**
+     * Extracts the next complete line, without its line ending
+     *
+     * The line doesn't own its data, it stays valid only until the next call to readFrom() or clear().
+     * Note that copies of it don't own the data either; use QByteArray(line.constData(), line.size())
+     * to keep the line around.
+     *
+     * @param line[out] The line, if any
+     * @return Whether a complete line was available
+     */
+    bool readLine(QByteArray& line);
+
+    /**
+     * Discards all buffered data
+     */
+    void clear();
+
+private:
+    QByteArray _buffer;
+    int _begin{0};  ///< Start of the data not handed out yet
+};
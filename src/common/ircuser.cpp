@@ -32,22 +32,18 @@ IrcUser::IrcUser(const QString& hostmask, Network* network)
     : SyncableObject(network)
     , _initialized(false)
     , _nick(nickFromMask(hostmask))
-    , _user(userFromMask(hostmask))
-    , _host(hostFromMask(hostmask))
     , _realName()
     , _awayMessage()
     , _away(false)
     , _server()
-    ,
-    // _idleTime(QDateTime::currentDateTime()),
-    _ircOperator()
     , _lastAwayMessageTime()
-    , _whoisServiceReply()
     , _encrypted(false)
     , _network(network)
     , _codecForEncoding(nullptr)
     , _codecForDecoding(nullptr)
 {
+    _user = intern(userFromMask(hostmask));
+    _host = intern(hostFromMask(hostmask));
     updateObjectName();
     _lastAwayMessageTime.setTimeSpec(Qt::UTC);
     _lastAwayMessageTime.setMSecsSinceEpoch(0);
@@ -62,21 +58,39 @@ QString IrcUser::hostmask() const
     return QString("%1!%2@%3").arg(nick()).arg(user()).arg(host());
 }
 
+IrcUser::Details& IrcUser::details()
+{
+    if (!_details)
+        _details.reset(new Details);
+    return *_details;
+}
+
+QString IrcUser::intern(const QString& string) const
+{
+    return _network->_stringPool.intern(string);
+}
+
+void IrcUser::aboutToSync() const
+{
+    _network->invalidateEncodedIrcUsersAndChannels();
+}
+
 QDateTime IrcUser::idleTime()
 {
-    if ((QDateTime::currentDateTime().toMSecsSinceEpoch() - _idleTimeSet.toMSecsSinceEpoch()) > 1200000) {
+    if (!_details)
+        return {};
+    if ((QDateTime::currentDateTime().toMSecsSinceEpoch() - _details->idleTimeSet.toMSecsSinceEpoch()) > 1200000) {
         // 20 * 60 * 1000 = 1200000
         // 20 minutes have elapsed, clear the known idle time as it's likely inaccurate by now
-        _idleTime = QDateTime();
+        _details->idleTime = QDateTime();
     }
-    return _idleTime;
+    return _details->idleTime;
 }
 
 QStringList IrcUser::channels() const
 {
     QStringList chanList;
-    IrcChannel* channel;
-    foreach (channel, _channels) {
+    for (IrcChannel* channel : _channels) {
         chanList << channel->name();
     }
     return chanList;
@@ -123,7 +137,7 @@ QByteArray IrcUser::encodeString(const QString& string) const
 void IrcUser::setUser(const QString& user)
 {
     if (!user.isEmpty() && _user != user) {
-        _user = user;
+        _user = intern(user);
         SYNC(ARG(user));
     }
 }
@@ -131,7 +145,7 @@ void IrcUser::setUser(const QString& user)
 void IrcUser::setRealName(const QString& realName)
 {
     if (!realName.isEmpty() && _realName != realName) {
-        _realName = realName;
+        _realName = intern(realName);
         SYNC(ARG(realName))
     }
 }
@@ -139,7 +153,7 @@ void IrcUser::setRealName(const QString& realName)
 void IrcUser::setAccount(const QString& account)
 {
     if (_account != account) {
-        _account = account;
+        _account = intern(account);
         SYNC(ARG(account))
     }
 }
@@ -157,7 +171,7 @@ void IrcUser::setAway(bool away)
 void IrcUser::setAwayMessage(const QString& awayMessage)
 {
     if (!awayMessage.isEmpty() && _awayMessage != awayMessage) {
-        _awayMessage = awayMessage;
+        _awayMessage = intern(awayMessage);
         markAwayChanged();
         SYNC(ARG(awayMessage))
     }
@@ -165,17 +179,17 @@ void IrcUser::setAwayMessage(const QString& awayMessage)
 
 void IrcUser::setIdleTime(const QDateTime& idleTime)
 {
-    if (idleTime.isValid() && _idleTime != idleTime) {
-        _idleTime = idleTime;
-        _idleTimeSet = QDateTime::currentDateTime();
+    if (idleTime.isValid() && (!_details || _details->idleTime != idleTime)) {
+        details().idleTime = idleTime;
+        details().idleTimeSet = QDateTime::currentDateTime();
         SYNC(ARG(idleTime))
     }
 }
 
 void IrcUser::setLoginTime(const QDateTime& loginTime)
 {
-    if (loginTime.isValid() && _loginTime != loginTime) {
-        _loginTime = loginTime;
+    if (loginTime.isValid() && (!_details || _details->loginTime != loginTime)) {
+        details().loginTime = loginTime;
         SYNC(ARG(loginTime))
     }
 }
@@ -183,15 +197,15 @@ void IrcUser::setLoginTime(const QDateTime& loginTime)
 void IrcUser::setServer(const QString& server)
 {
     if (!server.isEmpty() && _server != server) {
-        _server = server;
+        _server = intern(server);
         SYNC(ARG(server))
     }
 }
 
 void IrcUser::setIrcOperator(const QString& ircOperator)
 {
-    if (!ircOperator.isEmpty() && _ircOperator != ircOperator) {
-        _ircOperator = ircOperator;
+    if (!ircOperator.isEmpty() && ircOperator != this->ircOperator()) {
+        details().ircOperator = intern(ircOperator);
         SYNC(ARG(ircOperator))
     }
 }
@@ -222,7 +236,7 @@ void IrcUser::setLastAwayMessageTime(const QDateTime& lastAwayMessageTime)
 void IrcUser::setHost(const QString& host)
 {
     if (!host.isEmpty() && _host != host) {
-        _host = host;
+        _host = intern(host);
         SYNC(ARG(host))
     }
 }
@@ -239,16 +253,16 @@ void IrcUser::setNick(const QString& nick)
 
 void IrcUser::setWhoisServiceReply(const QString& whoisServiceReply)
 {
-    if (!whoisServiceReply.isEmpty() && whoisServiceReply != _whoisServiceReply) {
-        _whoisServiceReply = whoisServiceReply;
+    if (!whoisServiceReply.isEmpty() && whoisServiceReply != this->whoisServiceReply()) {
+        details().whoisServiceReply = whoisServiceReply;
         SYNC(ARG(whoisServiceReply))
     }
 }
 
 void IrcUser::setSuserHost(const QString& suserHost)
 {
-    if (!suserHost.isEmpty() && suserHost != _suserHost) {
-        _suserHost = suserHost;
+    if (!suserHost.isEmpty() && suserHost != this->suserHost()) {
+        details().suserHost = suserHost;
         SYNC(ARG(suserHost))
     }
 }
@@ -280,7 +294,7 @@ void IrcUser::joinChannel(IrcChannel* channel, bool skip_channel_join)
 {
     Q_ASSERT(channel);
     if (!_channels.contains(channel)) {
-        _channels.insert(channel);
+        _channels.append(channel);
         if (!skip_channel_join)
             channel->joinIrcUser(this);
     }
@@ -309,8 +323,9 @@ void IrcUser::partChannel(const QString& channelname)
 
 void IrcUser::partChannelInternal(IrcChannel* channel, bool skip_sync)
 {
-    if (_channels.contains(channel)) {
-        _channels.remove(channel);
+    int index = _channels.indexOf(channel);
+    if (index >= 0) {
+        _channels.remove(index);
         disconnect(channel, nullptr, this, nullptr);
         channel->part(this);
         QString channelName = channel->name();
@@ -327,9 +342,9 @@ void IrcUser::quit()
 
 void IrcUser::quitInternal(bool skip_sync)
 {
-    QList<IrcChannel*> channels = _channels.values();
+    QVarLengthArray<IrcChannel*, 2> channels = _channels;
     _channels.clear();
-    foreach (IrcChannel* channel, channels) {
+    for (IrcChannel* channel : channels) {
         disconnect(channel, nullptr, this, nullptr);
         channel->part(this);
     }
@@ -342,8 +357,9 @@ void IrcUser::channelDestroyed()
 {
     // private slot!
     auto* channel = static_cast<IrcChannel*>(sender());
-    if (_channels.contains(channel)) {
-        _channels.remove(channel);
+    int index = _channels.indexOf(channel);
+    if (index >= 0) {
+        _channels.remove(index);
         if (_channels.isEmpty() && !network()->isMe(this))
             quit();
     }
@@ -392,12 +408,12 @@ void IrcUser::removeUserModes(const QString& modes)
 
 void IrcUser::setLastChannelActivity(BufferId buffer, const QDateTime& time)
 {
-    _lastActivity[buffer] = time;
+    details().lastActivity[buffer] = time;
     emit lastChannelActivityUpdated(buffer, time);
 }
 
 void IrcUser::setLastSpokenTo(BufferId buffer, const QDateTime& time)
 {
-    _lastSpokenTo[buffer] = time;
+    details().lastSpokenTo[buffer] = time;
     emit lastSpokenToUpdated(buffer, time);
 }
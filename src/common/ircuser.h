@@ -22,10 +22,13 @@
 
 #include "common-export.h"
 
+#include <memory>
+
 #include <QDateTime>
-#include <QSet>
+#include <QHash>
 #include <QString>
 #include <QStringList>
+#include <QVarLengthArray>
 #include <QVariantMap>
 
 #include "syncableobject.h"
@@ -76,12 +79,12 @@ public:
     inline bool isAway() const { return _away; }
     inline QString awayMessage() const { return _awayMessage; }
     QDateTime idleTime();
-    inline QDateTime loginTime() const { return _loginTime; }
+    inline QDateTime loginTime() const { return _details ? _details->loginTime : QDateTime(); }
     inline QString server() const { return _server; }
-    inline QString ircOperator() const { return _ircOperator; }
+    inline QString ircOperator() const { return _details ? _details->ircOperator : QString(); }
     inline QDateTime lastAwayMessageTime() const { return _lastAwayMessageTime; }
-    inline QString whoisServiceReply() const { return _whoisServiceReply; }
-    inline QString suserHost() const { return _suserHost; }
+    inline QString whoisServiceReply() const { return _details ? _details->whoisServiceReply : QString(); }
+    inline QString suserHost() const { return _details ? _details->suserHost : QString(); }
     inline bool encrypted() const { return _encrypted; }
     inline Network* network() const { return _network; }
 
@@ -101,9 +104,9 @@ public:
     QByteArray encodeString(const QString& string) const;
 
     // only valid on client side, these are not synced!
-    inline QDateTime lastChannelActivity(BufferId id) const { return _lastActivity.value(id); }
+    inline QDateTime lastChannelActivity(BufferId id) const { return _details ? _details->lastActivity.value(id) : QDateTime(); }
     void setLastChannelActivity(BufferId id, const QDateTime& time);
-    inline QDateTime lastSpokenTo(BufferId id) const { return _lastSpokenTo.value(id); }
+    inline QDateTime lastSpokenTo(BufferId id) const { return _details ? _details->lastSpokenTo.value(id) : QDateTime(); }
     void setLastSpokenTo(BufferId id, const QDateTime& time);
 
     /**
@@ -219,6 +222,27 @@ private:
      */
     inline void markAwayChanged() { _awayChanged = true; }
 
+    /// State only known for a few users, mostly from WHOIS replies
+    struct Details
+    {
+        QDateTime idleTime;
+        QDateTime idleTimeSet;
+        QDateTime loginTime;
+        QString ircOperator;
+        QString whoisServiceReply;
+        QString suserHost;
+        QHash<BufferId, QDateTime> lastActivity;
+        QHash<BufferId, QDateTime> lastSpokenTo;
+    };
+
+    /// Returns the details, allocating them on first use
+    Details& details();
+
+    void aboutToSync() const override;
+
+    /// Returns a copy of the string sharing its data with equal strings of other users of the network
+    QString intern(const QString& string) const;
+
     bool _initialized;
 
     QString _nick;
@@ -229,17 +253,11 @@ private:
     QString _awayMessage;
     bool _away;
     QString _server;
-    QDateTime _idleTime;
-    QDateTime _idleTimeSet;
-    QDateTime _loginTime;
-    QString _ircOperator;
     QDateTime _lastAwayMessageTime;
-    QString _whoisServiceReply;
-    QString _suserHost;
     bool _encrypted;
 
-    // QSet<QString> _channels;
-    QSet<IrcChannel*> _channels;
+    // Most users are in one or two channels, which a set would need several allocations for
+    QVarLengthArray<IrcChannel*, 2> _channels;
     QString _userModes;
 
     Network* _network;
@@ -247,8 +265,7 @@ private:
     QTextCodec* _codecForEncoding;
     QTextCodec* _codecForDecoding;
 
-    QHash<BufferId, QDateTime> _lastActivity;
-    QHash<BufferId, QDateTime> _lastSpokenTo;
+    std::unique_ptr<Details> _details;
 
     // Given it's never been acknowledged, assume changes exist on IrcUser creation
     /// Tracks if changes in away state (away/here, message) have yet to be acknowledged
@@ -21,6 +21,8 @@
 #include "network.h"
 
 #include <algorithm>
+#include <utility>
+#include <vector>
 
 #include <QTextCodec>
 
@@ -30,6 +32,173 @@ QTextCodec* Network::_defaultCodecForServer = nullptr;
 QTextCodec* Network::_defaultCodecForEncoding = nullptr;
 QTextCodec* Network::_defaultCodecForDecoding = nullptr;
 
+namespace {
+
+const quint8 compactFormatVersion = 1;
+
+// Builds data in the format of Network::encodeIrcUsersAndChannels(): a version byte, the string
+// dictionary, then the columns; numbers are written as LEB128 varints
+class CompactWriter
+{
+public:
+    CompactWriter() { _strings << QString(); }
+
+    void writeNumber(quint64 value)
+    {
+        while (value >= 0x80) {
+            _body.append(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        _body.append(static_cast<char>(value));
+    }
+
+    void writeDelta(qint64 value, qint64& previous)
+    {
+        qint64 delta = value - previous;
+        previous = value;
+        writeNumber((static_cast<quint64>(delta) << 1) ^ static_cast<quint64>(delta >> 63));
+    }
+
+    void writeString(const QString& string)
+    {
+        if (string.isEmpty()) {
+            writeNumber(0);
+            return;
+        }
+        auto it = _index.constFind(string);
+        if (it == _index.constEnd()) {
+            it = _index.insert(string, _strings.count());
+            _strings << string;
+        }
+        writeNumber(*it);
+    }
+
+    void writeFlags(const std::vector<bool>& flags)
+    {
+        for (size_t i = 0; i < flags.size(); i += 8) {
+            quint8 byte = 0;
+            for (size_t bit = 0; bit < 8 && i + bit < flags.size(); bit++) {
+                byte |= flags[i + bit] << bit;
+            }
+            _body.append(static_cast<char>(byte));
+        }
+    }
+
+    QByteArray finish()
+    {
+        QByteArray columns;
+        std::swap(columns, _body);
+        _body.append(static_cast<char>(compactFormatVersion));
+        writeNumber(_strings.count() - 1);
+        for (int i = 1; i < _strings.count(); i++) {
+            QByteArray utf8 = _strings[i].toUtf8();
+            writeNumber(utf8.size());
+            _body.append(utf8);
+        }
+        return _body + columns;
+    }
+
+private:
+    QByteArray _body;
+    QHash<QString, quint32> _index;
+    QStringList _strings;
+};
+
+class CompactReader
+{
+public:
+    explicit CompactReader(const QByteArray& data)
+        : _data(data)
+    {
+        _strings << QString();
+        if (_data.isEmpty() || static_cast<quint8>(_data[_pos++]) != compactFormatVersion) {
+            _ok = false;
+            return;
+        }
+        quint64 count = readNumber();
+        for (quint64 i = 0; i < count && _ok; i++) {
+            quint64 size = readNumber();
+            if (size > static_cast<quint64>(_data.size() - _pos)) {
+                _ok = false;
+                break;
+            }
+            _strings << QString::fromUtf8(_data.constData() + _pos, static_cast<int>(size));
+            _pos += static_cast<int>(size);
+        }
+    }
+
+    bool ok() const { return _ok; }
+
+    quint64 readNumber()
+    {
+        quint64 value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (_pos >= _data.size()) {
+                _ok = false;
+                return 0;
+            }
+            quint8 byte = static_cast<quint8>(_data[_pos++]);
+            value |= static_cast<quint64>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        _ok = false;
+        return 0;
+    }
+
+    /// Reads a count of items that need at least one byte each, so bogus counts don't make us allocate memory
+    int readCount()
+    {
+        quint64 count = readNumber();
+        if (count > static_cast<quint64>(_data.size() - _pos) * 8) {
+            _ok = false;
+            return 0;
+        }
+        return static_cast<int>(count);
+    }
+
+    qint64 readDelta(qint64& previous)
+    {
+        quint64 zigzag = readNumber();
+        previous += static_cast<qint64>(zigzag >> 1) ^ -static_cast<qint64>(zigzag & 1);
+        return previous;
+    }
+
+    QString readString()
+    {
+        quint64 index = readNumber();
+        if (index >= static_cast<quint64>(_strings.count())) {
+            _ok = false;
+            return {};
+        }
+        return _strings[static_cast<int>(index)];
+    }
+
+    std::vector<bool> readFlags(int count)
+    {
+        std::vector<bool> flags(count);
+        for (int i = 0; i < count; i += 8) {
+            if (_pos >= _data.size()) {
+                _ok = false;
+                break;
+            }
+            quint8 byte = static_cast<quint8>(_data[_pos++]);
+            for (int bit = 0; bit < 8 && i + bit < count; bit++) {
+                flags[i + bit] = byte & (1 << bit);
+            }
+        }
+        return flags;
+    }
+
+private:
+    const QByteArray _data;
+    int _pos{0};
+    QStringList _strings;
+    bool _ok{true};
+};
+
+}  // namespace
+
 // ====================
 //  Public:
 // ====================
@@ -329,6 +498,7 @@ IrcUser* Network::newIrcUser(const QString& hostmask, const QVariantMap& initDat
         connect(ircuser, &IrcUser::nickSet, this, &Network::ircUserNickChanged);
 
         _ircUsers[nick] = ircuser;
+        invalidateEncodedIrcUsersAndChannels();
 
         // This method will be called with a nick instead of hostmask by setInitIrcUsersAndChannels().
         // Not a problem because initData contains all we need; however, making sure here to get the real
@@ -358,6 +528,7 @@ void Network::removeIrcUser(IrcUser* ircuser)
         return;
 
     _ircUsers.remove(nick);
+    invalidateEncodedIrcUsersAndChannels();
     disconnect(ircuser, nullptr, this, nullptr);
     ircuser->deleteLater();
 }
@@ -369,6 +540,7 @@ void Network::removeIrcChannel(IrcChannel* channel)
         return;
 
     _ircChannels.remove(chanName);
+    invalidateEncodedIrcUsersAndChannels();
     disconnect(channel, nullptr, this, nullptr);
     channel->deleteLater();
 }
@@ -382,6 +554,8 @@ void Network::removeChansAndUsers()
 
     qDeleteAll(users);
     qDeleteAll(channels);
+    invalidateEncodedIrcUsersAndChannels();
+    _stringPool.squeeze();
 }
 
 IrcChannel* Network::newIrcChannel(const QString& channelname, const QVariantMap& initData)
@@ -399,6 +573,7 @@ IrcChannel* Network::newIrcChannel(const QString& channelname, const QVariantMap
             qWarning() << "unable to synchronize new IrcChannel" << channelname << "forgot to call Network::setProxy(SignalProxy *)?";
 
         _ircChannels[channelname.toLower()] = channel;
+        invalidateEncodedIrcUsersAndChannels();
 
         SYNC_OTHER(addIrcChannel, ARG(channelname))
         // emit ircChannelAdded(channelname);
@@ -894,6 +1069,10 @@ QVariantMap Network::initIrcUsersAndChannels() const
 {
     Q_ASSERT(proxy());
     Q_ASSERT(proxy()->targetPeer());
+    if (proxy()->targetPeer()->hasFeature(Quassel::Feature::CompactUsersAndChannels)) {
+        return {{"Compact", encodeIrcUsersAndChannels()}};
+    }
+
     QVariantMap usersAndChannels;
 
     if (_ircUsers.count()) {
@@ -963,6 +1142,12 @@ void Network::initSetIrcUsersAndChannels(const QVariantMap& usersAndChannels)
         return;
     }
 
+    if (usersAndChannels.contains("Compact")) {
+        if (!decodeIrcUsersAndChannels(usersAndChannels["Compact"].toByteArray()))
+            qWarning() << "Received invalid compact usersAndChannels init data!";
+        return;
+    }
+
     // toMap() and toList() are cheap, so we can avoid copying to lists...
     // However, we really have to make sure to never accidentally detach from the shared data!
 
@@ -1021,6 +1206,219 @@ void Network::initSetIrcUsersAndChannels(const QVariantMap& usersAndChannels)
     }
 }
 
+QByteArray Network::encodeIrcUsersAndChannels() const
+{
+    if (!_encodedIrcUsersAndChannels.isEmpty())
+        return _encodedIrcUsersAndChannels;
+
+    CompactWriter writer;
+
+    const QList<IrcUser*> users = _ircUsers.values();
+    QHash<IrcUser*, int> userIndex;
+    userIndex.reserve(users.count());
+    for (int i = 0; i < users.count(); i++) {
+        userIndex[users[i]] = i;
+    }
+    writer.writeNumber(users.count());
+
+    using StringGetter = QString (IrcUser::*)() const;
+    for (StringGetter getter : {&IrcUser::nick,
+                                &IrcUser::user,
+                                &IrcUser::host,
+                                &IrcUser::realName,
+                                &IrcUser::account,
+                                &IrcUser::awayMessage,
+                                &IrcUser::server,
+                                &IrcUser::ircOperator,
+                                &IrcUser::whoisServiceReply,
+                                &IrcUser::suserHost,
+                                &IrcUser::userModes}) {
+        for (IrcUser* ircUser : users) {
+            writer.writeString((ircUser->*getter)());
+        }
+    }
+
+    std::vector<bool> away, encrypted;
+    std::vector<QDateTime> times[3];
+    for (IrcUser* ircUser : users) {
+        away.push_back(ircUser->isAway());
+        encrypted.push_back(ircUser->encrypted());
+        times[0].push_back(ircUser->idleTime());
+        times[1].push_back(ircUser->loginTime());
+        times[2].push_back(ircUser->lastAwayMessageTime());
+    }
+    writer.writeFlags(away);
+    writer.writeFlags(encrypted);
+    for (auto&& column : times) {
+        std::vector<bool> valid;
+        for (auto&& time : column) {
+            valid.push_back(time.isValid());
+        }
+        writer.writeFlags(valid);
+        qint64 previous = 0;
+        for (auto&& time : column) {
+            if (time.isValid())
+                writer.writeDelta(time.toMSecsSinceEpoch(), previous);
+        }
+    }
+
+    const QList<IrcChannel*> channels = _ircChannels.values();
+    writer.writeNumber(channels.count());
+    for (IrcChannel* channel : channels) {
+        writer.writeString(channel->name());
+    }
+    for (IrcChannel* channel : channels) {
+        writer.writeString(channel->topic());
+    }
+    for (IrcChannel* channel : channels) {
+        writer.writeString(channel->password());
+    }
+    std::vector<bool> channelEncrypted;
+    for (IrcChannel* channel : channels) {
+        channelEncrypted.push_back(channel->encrypted());
+    }
+    writer.writeFlags(channelEncrypted);
+
+    for (IrcChannel* channel : channels) {
+        const QVariantMap chanModes = channel->initChanModes();
+        const QVariantMap listModes = chanModes["A"].toMap();
+        writer.writeNumber(listModes.count());
+        for (auto it = listModes.cbegin(); it != listModes.cend(); ++it) {
+            writer.writeString(it.key());
+            const QStringList values = it.value().toStringList();
+            writer.writeNumber(values.count());
+            for (auto&& value : values) {
+                writer.writeString(value);
+            }
+        }
+        for (auto&& type : {"B", "C"}) {
+            const QVariantMap modes = chanModes[type].toMap();
+            writer.writeNumber(modes.count());
+            for (auto it = modes.cbegin(); it != modes.cend(); ++it) {
+                writer.writeString(it.key());
+                writer.writeString(it.value().toString());
+            }
+        }
+        writer.writeString(chanModes["D"].toString());
+    }
+
+    // Members are referred to by their index in the user columns, sorted and delta-encoded
+    for (IrcChannel* channel : channels) {
+        std::vector<std::pair<int, IrcUser*>> members;
+        for (IrcUser* ircUser : channel->ircUsers()) {
+            members.emplace_back(userIndex.value(ircUser), ircUser);
+        }
+        std::sort(members.begin(), members.end());
+        writer.writeNumber(members.size());
+        int previous = 0;
+        for (auto&& member : members) {
+            writer.writeNumber(member.first - previous);
+            previous = member.first;
+            writer.writeString(channel->userModes(member.second));
+        }
+    }
+
+    _encodedIrcUsersAndChannels = writer.finish();
+    return _encodedIrcUsersAndChannels;
+}
+
+bool Network::decodeIrcUsersAndChannels(const QByteArray& data)
+{
+    CompactReader reader(data);
+
+    // Decode everything first, so invalid data doesn't leave us with half of the users
+    const int userCount = reader.readCount();
+    std::vector<QVariantMap> users(userCount);
+    for (auto&& column : {"nick",
+                          "user",
+                          "host",
+                          "realName",
+                          "account",
+                          "awayMessage",
+                          "server",
+                          "ircOperator",
+                          "whoisServiceReply",
+                          "suserHost",
+                          "userModes"}) {
+        for (auto&& user : users) {
+            user[column] = reader.readString();
+        }
+    }
+    for (auto&& column : {"away", "encrypted"}) {
+        std::vector<bool> flags = reader.readFlags(userCount);
+        for (int i = 0; i < userCount; i++) {
+            users[i][column] = static_cast<bool>(flags[i]);
+        }
+    }
+    for (auto&& column : {"idleTime", "loginTime", "lastAwayMessageTime"}) {
+        std::vector<bool> valid = reader.readFlags(userCount);
+        qint64 previous = 0;
+        for (int i = 0; i < userCount; i++) {
+            users[i][column] = valid[i] ? QDateTime::fromMSecsSinceEpoch(reader.readDelta(previous), Qt::UTC) : QDateTime();
+        }
+    }
+
+    const int channelCount = reader.readCount();
+    std::vector<QVariantMap> channels(channelCount);
+    for (auto&& column : {"name", "topic", "password"}) {
+        for (auto&& channel : channels) {
+            channel[column] = reader.readString();
+        }
+    }
+    std::vector<bool> channelEncrypted = reader.readFlags(channelCount);
+    for (int i = 0; i < channelCount; i++) {
+        channels[i]["encrypted"] = static_cast<bool>(channelEncrypted[i]);
+    }
+
+    for (auto&& channel : channels) {
+        QVariantMap chanModes;
+        QVariantMap listModes;
+        for (int i = reader.readCount(); i > 0 && reader.ok(); i--) {
+            QString mode = reader.readString();
+            QStringList values;
+            for (int j = reader.readCount(); j > 0 && reader.ok(); j--) {
+                values << reader.readString();
+            }
+            listModes[mode] = values;
+        }
+        chanModes["A"] = listModes;
+        for (auto&& type : {"B", "C"}) {
+            QVariantMap modes;
+            for (int i = reader.readCount(); i > 0 && reader.ok(); i--) {
+                QString mode = reader.readString();
+                modes[mode] = reader.readString();
+            }
+            chanModes[type] = modes;
+        }
+        chanModes["D"] = reader.readString();
+        channel["ChanModes"] = chanModes;
+    }
+
+    for (auto&& channel : channels) {
+        QVariantMap userModes;
+        quint64 index = 0;
+        for (int i = reader.readCount(); i > 0 && reader.ok(); i--) {
+            index += reader.readNumber();
+            QString modes = reader.readString();
+            if (index >= static_cast<quint64>(userCount))
+                return false;
+            userModes[users[index]["nick"].toString()] = modes;
+        }
+        channel["UserModes"] = userModes;
+    }
+
+    if (!reader.ok())
+        return false;
+
+    for (auto&& user : users) {
+        newIrcUser(user["nick"].toString(), user);
+    }
+    for (auto&& channel : channels) {
+        newIrcChannel(channel["name"].toString(), channel);
+    }
+    return true;
+}
+
 void Network::initSetSupports(const QVariantMap& supports)
 {
     QMapIterator<QString, QVariant> iter(supports);
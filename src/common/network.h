@@ -37,6 +37,7 @@
 #include "ircchannel.h"
 #include "ircuser.h"
 #include "signalproxy.h"
+#include "stringpool.h"
 #include "syncableobject.h"
 #include "types.h"
 #include "util.h"
@@ -406,6 +407,25 @@ public:
     inline QList<IrcChannel*> ircChannels() const { return _ircChannels.values(); }
     inline quint32 ircChannelCount() const { return _ircChannels.count(); }
 
+    /**
+     * Encodes all IrcUsers and IrcChannels in the compact format used with the CompactUsersAndChannels feature
+     *
+     * Strings are stored once in a dictionary and referred to by index, attributes are stored
+     * column by column, and times as deltas.  The result is cached and sent to every client
+     * attaching, until a user or channel syncs a change.
+     *
+     * @return The encoded users and channels
+     */
+    QByteArray encodeIrcUsersAndChannels() const;
+
+    /**
+     * Creates IrcUsers and IrcChannels from data made by encodeIrcUsersAndChannels()
+     *
+     * @param data  The encoded users and channels
+     * @return false if the data is invalid
+     */
+    bool decodeIrcUsersAndChannels(const QByteArray& data);
+
     QByteArray codecForServer() const;
     QByteArray codecForEncoding() const;
     QByteArray codecForDecoding() const;
@@ -721,6 +741,9 @@ protected:
     inline virtual IrcUser* ircUserFactory(const QString& hostmask) { return new IrcUser(hostmask, this); }
 
 private:
+    /// Drops the cached result of encodeIrcUsersAndChannels()
+    inline void invalidateEncodedIrcUsersAndChannels() const { _encodedIrcUsersAndChannels.clear(); }
+
     QPointer<SignalProxy> _proxy;
 
     NetworkId _networkId;
@@ -737,6 +760,8 @@ private:
     mutable QString _prefixModes;
 
     QHash<QString, IrcUser*> _ircUsers;        // stores all known nicks for the server
+    StringPool _stringPool;                    // shared by the IrcUsers, which mostly have the same few servers, hosts etc.
+    mutable QByteArray _encodedIrcUsersAndChannels;
     QHash<QString, IrcChannel*> _ircChannels;  // stores all known channels
     QHash<QString, QString> _supports;         // stores results from RPL_ISUPPORT
 
@@ -20,6 +20,30 @@
 
 #include "networkevent.h"
 
+#include <vector>
+
+namespace {
+
+const std::size_t maxPooledEvents = 256;
+
+struct NetworkDataEventPool
+{
+    ~NetworkDataEventPool()
+    {
+        for (void* ptr : freeList) {
+            ::operator delete(ptr);
+        }
+    }
+
+    std::vector<void*> freeList;
+};
+
+// One pool per thread, so no locking is needed. An event destroyed on another thread than it was
+// created on simply ends up in that thread's pool.
+thread_local NetworkDataEventPool networkDataEventPool;
+
+}  // namespace
+
 Event* NetworkEvent::create(EventManager::EventType type, QVariantMap& map, Network* network)
 {
     switch (type) {
@@ -93,3 +117,24 @@ void NetworkSplitEvent::toVariantMap(QVariantMap& map) const
     map["users"] = users();
     map["quitMessage"] = quitMessage();
 }
+
+void* NetworkDataEvent::operator new(std::size_t size)
+{
+    auto& freeList = networkDataEventPool.freeList;
+    if (size == sizeof(NetworkDataEvent) && !freeList.empty()) {
+        void* ptr = freeList.back();
+        freeList.pop_back();
+        return ptr;
+    }
+    return ::operator new(size);
+}
+
+void NetworkDataEvent::operator delete(void* ptr, std::size_t size)
+{
+    auto& freeList = networkDataEventPool.freeList;
+    if (size == sizeof(NetworkDataEvent) && freeList.size() < maxPooledEvents) {
+        freeList.push_back(ptr);
+        return;
+    }
+    ::operator delete(ptr);
+}
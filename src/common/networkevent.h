@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <utility>
 
 #include <QStringList>
@@ -93,6 +94,10 @@ public:
     inline QByteArray data() const { return _data; }
     inline void setData(const QByteArray& data) { _data = data; }
 
+    // There is one of these for every line received from an IRC server, so recycle their memory
+    static void* operator new(std::size_t size);
+    static void operator delete(void* ptr, std::size_t size);
+
 protected:
     explicit NetworkDataEvent(EventManager::EventType type, QVariantMap& map, Network* network);
     void toVariantMap(QVariantMap& map) const override;
@@ -71,6 +71,24 @@ public:
     virtual QString address() const = 0;
     virtual quint16 port() const = 0;
 
+    /**
+     * Serializes a sigproxy message, to be sent with writeSerialized()
+     *
+     * The result only depends on the protocol and the features of the peer, so it can be written to
+     * all peers with the same protocol() and features() without serializing the message again.
+     *
+     * @returns The serialized message, or a null QByteArray if the peer doesn't support this
+     */
+    virtual QByteArray serialize(const Protocol::SyncMessage& msg) const;
+    virtual QByteArray serialize(const Protocol::RpcCall& msg) const;
+
+    /**
+     * Writes a message obtained from serialize()
+     *
+     * @param msg  The serialized message
+     */
+    virtual void writeSerialized(const QByteArray& msg);
+
 public slots:
     /* Handshake messages */
     virtual void dispatch(const Protocol::RegisterClient&) = 0;
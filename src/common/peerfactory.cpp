@@ -31,14 +31,22 @@ PeerFactory::ProtoList PeerFactory::supportedProtocols()
     return result;
 }
 
-RemotePeer* PeerFactory::createPeer(
-    const ProtoDescriptor& protocol, AuthHandler* authHandler, QTcpSocket* socket, Compressor::CompressionLevel level, QObject* parent)
+RemotePeer* PeerFactory::createPeer(const ProtoDescriptor& protocol,
+                                    AuthHandler* authHandler,
+                                    QTcpSocket* socket,
+                                    Compressor::CompressionLevel level,
+                                    Compressor::Algorithm algorithm,
+                                    QObject* parent)
 {
-    return createPeer(ProtoList() << protocol, authHandler, socket, level, parent);
+    return createPeer(ProtoList() << protocol, authHandler, socket, level, algorithm, parent);
 }
 
-RemotePeer* PeerFactory::createPeer(
-    const ProtoList& protocols, AuthHandler* authHandler, QTcpSocket* socket, Compressor::CompressionLevel level, QObject* parent)
+RemotePeer* PeerFactory::createPeer(const ProtoList& protocols,
+                                    AuthHandler* authHandler,
+                                    QTcpSocket* socket,
+                                    Compressor::CompressionLevel level,
+                                    Compressor::Algorithm algorithm,
+                                    QObject* parent)
 {
     foreach (const ProtoDescriptor& protodesc, protocols) {
         Protocol::Type proto = protodesc.first;
@@ -48,7 +56,7 @@ RemotePeer* PeerFactory::createPeer(
             return new LegacyPeer(authHandler, socket, level, parent);
         case Protocol::DataStreamProtocol:
             if (DataStreamPeer::acceptsFeatures(features))
-                return new DataStreamPeer(authHandler, socket, features, level, parent);
+                return new DataStreamPeer(authHandler, socket, features, level, algorithm, parent);
             break;
         default:
             break;
@@ -44,7 +44,9 @@ enum Type
 enum Feature
 {
     Encryption = 0x01,
-    Compression = 0x02
+    Compression = 0x02,
+    ZstdCompression = 0x04,  ///< Use zstd instead of zlib, if Compression is enabled
+    ZstdDictionary = 0x08    ///< Prime zstd with Compressor::dictionary()
 };
 
 enum class Handler
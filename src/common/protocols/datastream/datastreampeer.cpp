@@ -31,9 +31,13 @@
 
 using namespace Protocol;
 
-DataStreamPeer::DataStreamPeer(
-    ::AuthHandler* authHandler, QTcpSocket* socket, quint16 features, Compressor::CompressionLevel level, QObject* parent)
-    : RemotePeer(authHandler, socket, level, parent)
+DataStreamPeer::DataStreamPeer(::AuthHandler* authHandler,
+                               QTcpSocket* socket,
+                               quint16 features,
+                               Compressor::CompressionLevel level,
+                               Compressor::Algorithm algorithm,
+                               QObject* parent)
+    : RemotePeer(authHandler, socket, level, algorithm, parent)
 {
     Q_UNUSED(features);
 }
@@ -86,13 +90,17 @@ void DataStreamPeer::writeMessage(const QVariantMap& handshakeMsg)
 }
 
 void DataStreamPeer::writeMessage(const QVariantList& sigProxyMsg)
+{
+    writeMessage(serializeMessage(sigProxyMsg));
+}
+
+QByteArray DataStreamPeer::serializeMessage(const QVariantList& sigProxyMsg)
 {
     QByteArray data;
     QDataStream msgStream(&data, QIODevice::WriteOnly);
     msgStream.setVersion(QDataStream::Qt_4_2);
     msgStream << sigProxyMsg;
-
-    writeMessage(data);
+    return data;
 }
 
 /*** Handshake messages ***/
@@ -378,12 +386,22 @@ void DataStreamPeer::handlePackedFunc(const QVariantList& packedFunc)
 
 void DataStreamPeer::dispatch(const Protocol::SyncMessage& msg)
 {
-    dispatchPackedFunc(QVariantList() << (qint16)Sync << msg.className << msg.objectName.toUtf8() << msg.slotName << msg.params);
+    writeMessage(serialize(msg));
 }
 
 void DataStreamPeer::dispatch(const Protocol::RpcCall& msg)
 {
-    dispatchPackedFunc(QVariantList() << (qint16)RpcCall << msg.signalName << msg.params);
+    writeMessage(serialize(msg));
+}
+
+QByteArray DataStreamPeer::serialize(const Protocol::SyncMessage& msg) const
+{
+    return serializeMessage(QVariantList() << (qint16)Sync << msg.className << msg.objectName.toUtf8() << msg.slotName << msg.params);
+}
+
+QByteArray DataStreamPeer::serialize(const Protocol::RpcCall& msg) const
+{
+    return serializeMessage(QVariantList() << (qint16)RpcCall << msg.signalName << msg.params);
 }
 
 void DataStreamPeer::dispatch(const Protocol::InitRequest& msg)
@@ -36,7 +36,7 @@ const uint clientNeedsProtocol = protocolVersion;
 using namespace Protocol;
 
 LegacyPeer::LegacyPeer(::AuthHandler* authHandler, QTcpSocket* socket, Compressor::CompressionLevel level, QObject* parent)
-    : RemotePeer(authHandler, socket, level, parent)
+    : RemotePeer(authHandler, socket, level, Compressor::Deflate, parent)
     , _useCompression(false)
 {}
 
@@ -105,25 +105,31 @@ void LegacyPeer::processMessage(const QByteArray& msg)
 
 void LegacyPeer::writeMessage(const QVariant& item)
 {
-    QByteArray block;
-    QDataStream out(&block, QIODevice::WriteOnly);
-    out.setVersion(QDataStream::Qt_4_2);
-
-    if (_useCompression) {
-        QByteArray rawItem;
-        QDataStream itemStream(&rawItem, QIODevice::WriteOnly);
-        itemStream.setVersion(QDataStream::Qt_4_2);
-        itemStream << item;
+    writeSerialized(serializeItem(item));
+}
 
-        rawItem = qCompress(rawItem);
+QByteArray LegacyPeer::serializeItem(const QVariant& item)
+{
+    QByteArray rawItem;
+    QDataStream itemStream(&rawItem, QIODevice::WriteOnly);
+    itemStream.setVersion(QDataStream::Qt_4_2);
+    itemStream << item;
+    return rawItem;
+}
 
-        out << rawItem;
+void LegacyPeer::writeSerialized(const QByteArray& msg)
+{
+    // Compression is per peer, so it can't be part of the serialized message
+    if (_useCompression) {
+        QByteArray block;
+        QDataStream out(&block, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_4_2);
+        out << qCompress(msg);
+        writeMessage(block);
     }
     else {
-        out << item;
+        writeMessage(msg);
     }
-
-    writeMessage(block);
 }
 
 /*** Handshake messages ***/
@@ -452,12 +458,22 @@ void LegacyPeer::handlePackedFunc(const QVariant& packedFunc)
 
 void LegacyPeer::dispatch(const Protocol::SyncMessage& msg)
 {
-    dispatchPackedFunc(QVariantList() << (qint16)Sync << msg.className << msg.objectName << msg.slotName << msg.params);
+    writeSerialized(serialize(msg));
 }
 
 void LegacyPeer::dispatch(const Protocol::RpcCall& msg)
 {
-    dispatchPackedFunc(QVariantList() << (qint16)RpcCall << msg.signalName << msg.params);
+    writeSerialized(serialize(msg));
+}
+
+QByteArray LegacyPeer::serialize(const Protocol::SyncMessage& msg) const
+{
+    return serializeItem(QVariant(QVariantList() << (qint16)Sync << msg.className << msg.objectName << msg.slotName << msg.params));
+}
+
+QByteArray LegacyPeer::serialize(const Protocol::RpcCall& msg) const
+{
+    return serializeItem(QVariant(QVariantList() << (qint16)RpcCall << msg.signalName << msg.params));
 }
 
 void LegacyPeer::dispatch(const Protocol::InitRequest& msg)
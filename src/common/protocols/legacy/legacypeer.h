@@ -64,12 +64,17 @@ public:
     void dispatch(const Protocol::HeartBeat& msg) override;
     void dispatch(const Protocol::HeartBeatReply& msg) override;
 
+    QByteArray serialize(const Protocol::SyncMessage& msg) const override;
+    QByteArray serialize(const Protocol::RpcCall& msg) const override;
+    void writeSerialized(const QByteArray& msg) override;
+
 signals:
     void protocolError(const QString& errorString);
 
 private:
     using RemotePeer::writeMessage;
     void writeMessage(const QVariant& item);
+    static QByteArray serializeItem(const QVariant& item);
     void processMessage(const QByteArray& msg) override;
 
     void handleHandshakeMessage(const QVariant& msg);
@@ -366,6 +366,27 @@ void Quassel::setupCliParser()
             {"require-ssl", tr("Require SSL for remote (non-loopback) client connections.")},
             {"ssl-cert", tr("Specify the path to the SSL certificate."), tr("path"), "configdir/quasselCert.pem"},
             {"ssl-key", tr("Specify the path to the SSL key."), tr("path"), "ssl-cert-path"},
+            {"max-commit-latency",
+             tr("The time in milliseconds messages may be held back to be written to the database along with others. Higher values "
+                "increase throughput, but delay messages and lose more of them if the core crashes."),
+             tr("milliseconds"),
+             "0"},
+            {"backlog-retention",
+             tr("Delete backlog older than the given number of days. Rules are separated by semicolons, and may be limited to a user, "
+                "network or buffer type (status, channel, query or group); the most specific one applies. Add \"archive\" to move "
+                "old backlog into compressed archive files instead, which clients can still scroll back to. Example: "
+                "\"days=365;buffertype=status,days=30;user=alice,days=0\""),
+             tr("[user=<name>,][network=<id>,][buffertype=<type>,]days=<n>[,archive][;...]")},
+            {"backlog-prune-interval", tr("The time in minutes between checks for expired backlog."), tr("minutes"), "60"},
+            {"max-concurrent-connects",
+             tr("The number of IRC connections that may be set up at the same time; others wait for their turn. Users with "
+                "attached clients go first. Use 0 for no limit."),
+             tr("count"),
+             "10"},
+            {"session-threads",
+             tr("Run user sessions on a fixed number of worker threads, instead of giving each session a thread of its own. Sessions "
+                "are moved between workers to even out the load. Use 0 for one thread per CPU core."),
+             tr("count")},
             {"metrics-daemon", tr("Enable metrics API.")},
             {"metrics-port", tr("The port quasselcore will listen at for metrics requests. Only meaningful with --metrics-daemon."), tr("port"), "9558"},
             {"metrics-listen", tr("The address(es) quasselcore will listen on for metrics requests. Same format as --listen."), tr("<address>[,...]"), "::1,127.0.0.1"}
@@ -661,6 +682,11 @@ bool Quassel::Features::isEnabled(Feature feature) const
     return i < _features.size() ? _features[i] : false;
 }
 
+bool Quassel::Features::operator==(const Features& other) const
+{
+    return _features == other._features;
+}
+
 QStringList Quassel::Features::toStringList(bool enabled) const
 {
     // Check if any feature is enabled
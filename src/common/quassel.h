@@ -125,25 +125,28 @@ public:
         SaslAuthentication,
         SaslExternal,
         HideInactiveNetworks,
-        PasswordChange,       ///< Remote password change
-        CapNegotiation,       ///< IRCv3 capability negotiation, account tracking
-        VerifyServerSSL,      ///< IRC server SSL validation
-        CustomRateLimits,     ///< IRC server custom message rate limits
-        AwayFormatTimestamp,  ///< Timestamp formatting in away (e.g. %%hh:mm%%)
-        Authenticators,       ///< Whether or not the core supports auth backends
-        BufferActivitySync,   ///< Sync buffer activity status
-        CoreSideHighlights,   ///< Core-Side highlight configuration and matching
-        SenderPrefixes,       ///< Show prefixes for senders in backlog
-        RemoteDisconnect,     ///< Allow this peer to be remotely disconnected
-        ExtendedFeatures,     ///< Extended features
-        LongTime,             ///< Serialize time as 64-bit values
-        RichMessages,         ///< Real Name and Avatar URL in backlog
-        BacklogFilterType,    ///< BacklogManager supports filtering backlog by MessageType
-        EcdsaCertfpKeys,      ///< ECDSA keys for CertFP in identities
-        LongMessageId,        ///< 64-bit IDs for messages
-        SyncedCoreInfo,       ///< CoreInfo dynamically updated using signals
-        LoadBacklogForwards,  ///< Allow loading backlog in ascending order, old to new
-        SkipIrcCaps,          ///< Control what IRCv3 capabilities are skipped during negotiation
+        PasswordChange,           ///< Remote password change
+        CapNegotiation,           ///< IRCv3 capability negotiation, account tracking
+        VerifyServerSSL,          ///< IRC server SSL validation
+        CustomRateLimits,         ///< IRC server custom message rate limits
+        AwayFormatTimestamp,      ///< Timestamp formatting in away (e.g. %%hh:mm%%)
+        Authenticators,           ///< Whether or not the core supports auth backends
+        BufferActivitySync,       ///< Sync buffer activity status
+        CoreSideHighlights,       ///< Core-Side highlight configuration and matching
+        SenderPrefixes,           ///< Show prefixes for senders in backlog
+        RemoteDisconnect,         ///< Allow this peer to be remotely disconnected
+        ExtendedFeatures,         ///< Extended features
+        LongTime,                 ///< Serialize time as 64-bit values
+        RichMessages,             ///< Real Name and Avatar URL in backlog
+        BacklogFilterType,        ///< BacklogManager supports filtering backlog by MessageType
+        EcdsaCertfpKeys,          ///< ECDSA keys for CertFP in identities
+        LongMessageId,            ///< 64-bit IDs for messages
+        SyncedCoreInfo,           ///< CoreInfo dynamically updated using signals
+        LoadBacklogForwards,      ///< Allow loading backlog in ascending order, old to new
+        SkipIrcCaps,              ///< Control what IRCv3 capabilities are skipped during negotiation
+        StreamedBacklog,          ///< BacklogManager can stream backlog in chunks
+        BacklogSearch,            ///< BacklogManager can search the backlog
+        CompactUsersAndChannels,  ///< Network init data for users and channels in a compact, columnar format
     };
     Q_ENUMS(Feature)
 
@@ -162,6 +165,13 @@ public:
 
     static void setupBuildInfo();
     static const BuildInfo& buildInfo();
+
+    /**
+     * Registers the types exchanged with peers, and their stream operators, with the meta type system.
+     *
+     * This is done by init(), but tools talking to a core or client without a full Quassel instance may call it directly.
+     */
+    static void registerMetaTypes();
     static RunMode runMode();
 
     static QString configDirPath();
@@ -225,7 +235,6 @@ signals:
     void messageLogged(const QDateTime& timeStamp, const QString& msg);
 
 private:
-    void registerMetaTypes();
     void setupSignalHandling();
     void setupEnvironment();
     void setupCliParser();
@@ -329,6 +338,14 @@ public:
      */
     QStringList unknownFeatures() const;
 
+    /**
+     * Compares the known features of two Features instances.
+     *
+     * @returns Whether the same known features are enabled in both instances
+     */
+    bool operator==(const Features& other) const;
+    bool operator!=(const Features& other) const { return !(*this == other); }
+
 private:
     std::vector<bool> _features;
     QStringList _unknownFeatures;
@@ -35,10 +35,11 @@ using namespace Protocol;
 const quint32 maxMessageSize = 64 * 1024
                                * 1024;  // This is uncompressed size. 64 MB should be enough for any sort of initData or backlog chunk
 
-RemotePeer::RemotePeer(::AuthHandler* authHandler, QTcpSocket* socket, Compressor::CompressionLevel level, QObject* parent)
+RemotePeer::RemotePeer(
+    ::AuthHandler* authHandler, QTcpSocket* socket, Compressor::CompressionLevel level, Compressor::Algorithm algorithm, QObject* parent)
     : Peer(authHandler, parent)
     , _socket(socket)
-    , _compressor(new Compressor(socket, level, this))
+    , _compressor(new Compressor(socket, level, algorithm, this))
     , _signalProxy(nullptr)
     , _proxyLine({})
     , _useProxyLine(false)
@@ -259,6 +260,12 @@ void RemotePeer::writeMessage(const QByteArray& msg)
     auto size = qToBigEndian<quint32>(msg.size());
     _compressor->write((const char*)&size, 4, Compressor::NoFlush);
     _compressor->write(msg.constData(), msg.size());
+    emit messageWritten(msg.size());
+}
+
+void RemotePeer::writeSerialized(const QByteArray& msg)
+{
+    writeMessage(msg);
 }
 
 void RemotePeer::handle(const HeartBeat& heartBeat)
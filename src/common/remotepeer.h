@@ -43,7 +43,11 @@ public:
     using Peer::dispatch;
     using Peer::handle;
 
-    RemotePeer(AuthHandler* authHandler, QTcpSocket* socket, Compressor::CompressionLevel level, QObject* parent = nullptr);
+    RemotePeer(AuthHandler* authHandler,
+               QTcpSocket* socket,
+               Compressor::CompressionLevel level,
+               Compressor::Algorithm algorithm,
+               QObject* parent = nullptr);
 
     void setSignalProxy(SignalProxy* proxy) override;
 
@@ -63,6 +67,8 @@ public:
 
     int lag() const override;
 
+    void writeSerialized(const QByteArray& msg) override;
+
     bool compressionEnabled() const;
     void setCompressionEnabled(bool enabled);
 
@@ -75,6 +81,8 @@ signals:
     void transferProgress(int current, int max);
     void socketError(QAbstractSocket::SocketError error, const QString& errorString);
     void statusMessage(const QString& msg);
+    /// Emitted for every message written to the peer, with its size before compression
+    void messageWritten(int size);
 
     // Only used by LegacyPeer
     void protocolVersionMismatch(int actual, int expected);
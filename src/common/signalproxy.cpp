@@ -20,6 +20,7 @@
 
 #include <algorithm>
 #include <utility>
+#include <vector>
 
 #include <QCoreApplication>
 #include <QHostAddress>
@@ -342,12 +343,10 @@ void SignalProxy::dispatchSignal(QByteArray sigName, QVariantList params)
 {
     RpcCall rpcCall{std::move(sigName), std::move(params)};
     if (_restrictMessageTarget) {
-        for (auto&& peer : _restrictedTargets) {
-            dispatch(peer, rpcCall);
-        }
+        broadcast(_restrictedTargets.values(), rpcCall);
     }
     else {
-        dispatch(rpcCall);
+        broadcast(_peerMap.values(), rpcCall);
     }
 }
 
@@ -372,6 +371,43 @@ void SignalProxy::dispatch(Peer* peer, const T& protoMessage)
     _targetPeer = nullptr;
 }
 
+template<class T>
+void SignalProxy::broadcast(const QList<Peer*>& peers, const T& protoMessage)
+{
+    if (peers.count() < 2) {
+        for (auto&& peer : peers) {
+            dispatch(peer, protoMessage);
+        }
+        return;
+    }
+
+    // The first peer of every protocol and feature combination, and the message serialized for it
+    std::vector<std::pair<Peer*, QByteArray>> serialized;
+    for (auto&& peer : peers) {
+        if (!peer || !peer->isOpen()) {
+            dispatch(peer, protoMessage);
+            continue;
+        }
+
+        _targetPeer = peer;
+        auto it = std::find_if(serialized.begin(), serialized.end(), [peer](const std::pair<Peer*, QByteArray>& entry) {
+            return entry.first->protocol() == peer->protocol() && entry.first->features() == peer->features();
+        });
+        if (it == serialized.end()) {
+            QByteArray msg = peer->serialize(protoMessage);
+            if (msg.isNull()) {
+                // Not supported by this peer (e.g. an InternalPeer)
+                peer->dispatch(protoMessage);
+                _targetPeer = nullptr;
+                continue;
+            }
+            it = serialized.emplace(serialized.end(), peer, std::move(msg));
+        }
+        peer->writeSerialized(it->second);
+        _targetPeer = nullptr;
+    }
+}
+
 void SignalProxy::handle(Peer* peer, const SyncMessage& syncMessage)
 {
     if (!_syncSlave.contains(syncMessage.className) || !_syncSlave[syncMessage.className].contains(syncMessage.objectName)) {
@@ -597,14 +633,14 @@ void SignalProxy::sync_call__(const SyncableObject* obj, SignalProxy::ProxyMode
         params << QVariant(argTypes[i], va_arg(ap, void*));
     }
 
+    SyncMessage syncMessage(eMeta->metaObject()->className(), obj->objectName(), QByteArray(funcname), params);
     if (_restrictMessageTarget) {
-        for (auto peer : _restrictedTargets) {
-            if (peer != nullptr)
-                dispatch(peer, SyncMessage(eMeta->metaObject()->className(), obj->objectName(), QByteArray(funcname), params));
-        }
+        QList<Peer*> peers = _restrictedTargets.values();
+        peers.removeAll(nullptr);
+        broadcast(peers, syncMessage);
     }
     else
-        dispatch(SyncMessage(eMeta->metaObject()->className(), obj->objectName(), QByteArray(funcname), params));
+        broadcast(_peerMap.values(), syncMessage);
 }
 
 void SignalProxy::disconnectDevice(QIODevice* dev, const QString& reason)
@@ -260,6 +260,15 @@ private:
     template<class T>
     void dispatch(Peer* peer, const T& protoMessage);
 
+    /**
+     * Dispatches a message to the given peers, serializing it only once for peers that share protocol and features
+     *
+     * @param peers         The target peers
+     * @param protoMessage  The message, must be supported by Peer::serialize()
+     */
+    template<class T>
+    void broadcast(const QList<Peer*>& peers, const T& protoMessage);
+
     void handle(Peer* peer, const Protocol::SyncMessage& syncMessage);
     void handle(Peer* peer, const Protocol::RpcCall& rpcCall);
     void handle(Peer* peer, const Protocol::InitRequest& initRequest);
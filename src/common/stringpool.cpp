@@ -0,0 +1,52 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "stringpool.h"
+
+#include <algorithm>
+
+constexpr int StringPool::minSqueezeThreshold;
+
+QString StringPool::intern(const QString& string)
+{
+    if (string.isEmpty())
+        return string;
+
+    auto it = _strings.constFind(string);
+    if (it != _strings.constEnd())
+        return *it;
+
+    if (_strings.size() >= _squeezeThreshold)
+        squeeze();
+    _strings.insert(string);
+    return string;
+}
+
+void StringPool::squeeze()
+{
+    for (auto it = _strings.begin(); it != _strings.end();) {
+        // Only referenced by the pool itself
+        if (it->isDetached())
+            it = _strings.erase(it);
+        else
+            ++it;
+    }
+    _squeezeThreshold = std::max(minSqueezeThreshold, _strings.size() * 2);
+}
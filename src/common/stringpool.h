@@ -0,0 +1,57 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include "common-export.h"
+
+#include <QSet>
+#include <QString>
+
+/**
+ * Deduplicates strings that many objects hold copies of
+ *
+ * Strings parsed from IRC messages each get their own allocation, even if they are equal to
+ * countless others, like the server or host of users on a big network.  Passing them through
+ * intern() makes equal strings share a single allocation.
+ *
+ * Strings no longer used outside the pool are dropped whenever the pool has doubled in size.
+ */
+class COMMON_EXPORT StringPool
+{
+public:
+    /**
+     * Returns a string equal to the given one, sharing its data with all equal strings interned before
+     */
+    QString intern(const QString& string);
+
+    /**
+     * Drops strings that are no longer used outside the pool
+     */
+    void squeeze();
+
+    int size() const { return _strings.size(); }
+
+private:
+    QSet<QString> _strings;
+    int _squeezeThreshold{minSqueezeThreshold};
+
+    static constexpr int minSqueezeThreshold = 1024;
+};
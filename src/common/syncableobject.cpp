@@ -166,6 +166,8 @@ void SyncableObject::requestUpdate(const QVariantMap& properties)
 void SyncableObject::sync_call__(SignalProxy::ProxyMode modeType, const char* funcname, ...) const
 {
     // qDebug() << Q_FUNC_INFO << modeType << funcname;
+    if (modeType == SignalProxy::Server)
+        aboutToSync();
     foreach (SignalProxy* proxy, _signalProxies) {
         va_list ap;
         va_start(ap, funcname);
@@ -93,6 +93,11 @@ public slots:
 protected:
     void sync_call__(SignalProxy::ProxyMode modeType, const char* funcname, ...) const;
 
+    //! Called before a change of the object's state is synced to the clients
+    /** Reimplement this to drop anything derived from the object's state, e.g. cached init data.
+     */
+    virtual void aboutToSync() const {}
+
 signals:
     void initDone();
     void updatedRemotely();
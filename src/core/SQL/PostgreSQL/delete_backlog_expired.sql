@@ -0,0 +1,10 @@
+DELETE FROM backlog
+WHERE messageid IN (
+    SELECT messageid
+    FROM backlog
+    WHERE bufferid = :bufferid
+        AND time < :before
+        AND messageid <= :lastmsg
+    ORDER BY messageid ASC
+    LIMIT :limit
+)
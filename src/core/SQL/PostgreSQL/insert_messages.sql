@@ -0,0 +1,2 @@
+INSERT INTO backlog (messageid, time, bufferid, type, flags, senderid, senderprefixes, message)
+VALUES
@@ -0,0 +1,2 @@
+SELECT nextval('backlog_messageid_seq')
+FROM generate_series(1, $1)
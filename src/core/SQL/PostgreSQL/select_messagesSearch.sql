@@ -0,0 +1,14 @@
+SELECT messageid, bufferid, time, type, flags, sender, senderprefixes, realname, avatarurl, message
+FROM backlog
+JOIN sender ON backlog.senderid = sender.senderid
+WHERE backlog.bufferid IN (SELECT bufferid FROM buffer WHERE userid = :userid AND (:networkid <= 0 OR networkid = :networkid))
+    AND (:bufferid <= 0 OR backlog.bufferid = :bufferid)
+    -- Must match the expressions of backlog_message_fts_idx and sender_sender_fts_idx
+    AND (:query = '' OR to_tsvector('simple', backlog.message) @@ plainto_tsquery('simple', :query))
+    AND (:sender = '' OR to_tsvector('simple', sender.sender) @@ plainto_tsquery('simple', :sender))
+    AND backlog.messageid < :lastmsg
+    AND backlog.time >= :starttime
+    AND backlog.time < :endtime
+    AND (:type <= 0 OR backlog.type & :type != 0)
+ORDER BY messageid DESC
+LIMIT :limit
@@ -0,0 +1,17 @@
+WITH inserted AS (
+    INSERT INTO sender (sender, realname, avatarurl)
+    SELECT $1, $2, $3
+    WHERE NOT EXISTS (
+        SELECT 1
+        FROM sender
+        WHERE sender = $1 AND coalesce(realname, '') = coalesce($2, '') AND coalesce(avatarurl, '') = coalesce($3, '')
+    )
+    ON CONFLICT DO NOTHING
+    RETURNING senderid
+)
+SELECT senderid FROM inserted
+UNION ALL
+SELECT senderid
+FROM sender
+WHERE sender = $1 AND coalesce(realname, '') = coalesce($2, '') AND coalesce(avatarurl, '') = coalesce($3, '')
+LIMIT 1
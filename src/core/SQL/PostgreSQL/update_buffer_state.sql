@@ -0,0 +1,6 @@
+UPDATE buffer
+SET lastseenmsgid = CASE WHEN CAST(:lastseenmsgid AS bigint) IS NULL THEN lastseenmsgid ELSE least(:lastseenmsgid, buffer.lastmsgid) END,
+    markerlinemsgid = coalesce(:markerlinemsgid, markerlinemsgid),
+    bufferactivity = coalesce(:bufferactivity, bufferactivity),
+    highlightcount = coalesce(:highlightcount, highlightcount)
+WHERE userid = :userid AND bufferid = :bufferid
@@ -0,0 +1 @@
+CREATE INDEX sender_sender_fts_idx ON sender USING gin (to_tsvector('simple', sender))
@@ -0,0 +1,2 @@
+INSERT INTO backlog (time, bufferid, type, flags, senderid, senderprefixes, message)
+VALUES
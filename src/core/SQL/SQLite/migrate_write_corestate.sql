@@ -0,0 +1,2 @@
+INSERT INTO core_state (key, value)
+VALUES (?, ?)
@@ -0,0 +1,2 @@
+INSERT INTO identity_nick (nickid, identityid, nick)
+VALUES (?, ?, ?)
@@ -0,0 +1,2 @@
+INSERT INTO quasseluser (userid, username, password, hashversion, authenticator)
+VALUES (?, ?, ?, ?, ?)
@@ -0,0 +1,2 @@
+INSERT INTO user_setting (userid, settingname, settingvalue)
+VALUES (?, ?, ?)
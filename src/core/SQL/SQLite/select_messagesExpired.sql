@@ -0,0 +1,7 @@
+SELECT messageid, bufferid, time, type, flags, sender, senderprefixes, realname, avatarurl, message
+FROM backlog
+JOIN sender ON backlog.senderid = sender.senderid
+WHERE backlog.bufferid = :bufferid
+    AND backlog.time < :before
+ORDER BY messageid ASC
+LIMIT :limit
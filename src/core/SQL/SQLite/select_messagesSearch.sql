@@ -0,0 +1,14 @@
+SELECT backlog.messageid, backlog.bufferid, backlog.time, backlog.type, backlog.flags, sender.sender, backlog.senderprefixes,
+       sender.realname, sender.avatarurl, backlog.message
+FROM backlog_fts
+JOIN backlog ON backlog.messageid = backlog_fts.rowid
+JOIN sender ON backlog.senderid = sender.senderid
+WHERE backlog_fts MATCH :query
+    AND backlog_fts.rowid < :lastmsg
+    AND backlog.bufferid IN (SELECT bufferid FROM buffer WHERE userid = :userid AND (:networkid <= 0 OR networkid = :networkid))
+    AND (:bufferid <= 0 OR backlog.bufferid = :bufferid)
+    AND backlog.time >= :starttime
+    AND backlog.time < :endtime
+    AND (:type <= 0 OR backlog.type & :type != 0)
+ORDER BY backlog_fts.rowid DESC
+LIMIT :limit
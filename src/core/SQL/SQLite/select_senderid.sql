@@ -0,0 +1,3 @@
+SELECT senderid
+FROM sender
+WHERE sender = :sender AND coalesce(realname, '') = coalesce(:realname, '') AND coalesce(avatarurl, '') = coalesce(:avatarurl, '')
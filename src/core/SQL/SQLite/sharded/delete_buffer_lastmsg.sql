@@ -0,0 +1,2 @@
+DELETE FROM buffer_lastmsg
+WHERE bufferid = :bufferid
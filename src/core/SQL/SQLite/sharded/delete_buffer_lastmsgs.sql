@@ -0,0 +1 @@
+DELETE FROM buffer_lastmsg
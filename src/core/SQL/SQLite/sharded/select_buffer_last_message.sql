@@ -0,0 +1,3 @@
+SELECT lastmsgid
+FROM buffer_lastmsg
+WHERE bufferid = :bufferid
@@ -0,0 +1,2 @@
+SELECT bufferid, lastmsgid
+FROM buffer_lastmsg
@@ -0,0 +1,2 @@
+SELECT coalesce(max(messageid), 0)
+FROM backlog
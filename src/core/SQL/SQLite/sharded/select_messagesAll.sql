@@ -0,0 +1,7 @@
+SELECT messageid, bufferid, time,  type, flags, sender, senderprefixes, realname, avatarurl, message
+FROM backlog
+JOIN sender ON backlog.senderid = sender.senderid
+WHERE backlog.messageid >= :firstmsg
+    AND backlog.messageid < :lastmsg
+ORDER BY messageid DESC
+LIMIT :limit
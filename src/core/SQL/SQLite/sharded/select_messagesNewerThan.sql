@@ -0,0 +1,8 @@
+SELECT messageid, time,  type, flags, sender, senderprefixes, realname, avatarurl, message
+FROM backlog
+JOIN sender ON backlog.senderid = sender.senderid
+WHERE backlog.messageid >= :firstmsg
+    AND backlog.messageid <= (SELECT lastmsgid FROM buffer_lastmsg WHERE buffer_lastmsg.bufferid = :bufferid)
+    AND bufferid = :bufferid
+ORDER BY messageid DESC
+LIMIT :limit
@@ -0,0 +1,7 @@
+SELECT messageid, time,  type, flags, sender, senderprefixes, realname, avatarurl, message
+FROM backlog
+JOIN sender ON backlog.senderid = sender.senderid
+WHERE bufferid = :bufferid
+AND backlog.messageid <= (SELECT lastmsgid FROM buffer_lastmsg WHERE buffer_lastmsg.bufferid = :bufferid)
+ORDER BY messageid DESC
+LIMIT :limit
@@ -0,0 +1,13 @@
+SELECT backlog.messageid, backlog.bufferid, backlog.time, backlog.type, backlog.flags, sender.sender, backlog.senderprefixes,
+       sender.realname, sender.avatarurl, backlog.message
+FROM backlog_fts
+JOIN backlog ON backlog.messageid = backlog_fts.rowid
+JOIN sender ON backlog.senderid = sender.senderid
+WHERE backlog_fts MATCH :query
+    AND backlog_fts.rowid < :lastmsg
+    AND (:bufferids = '' OR instr(:bufferids, ',' || backlog.bufferid || ',') > 0)
+    AND backlog.time >= :starttime
+    AND backlog.time < :endtime
+    AND (:type <= 0 OR backlog.type & :type != 0)
+ORDER BY backlog_fts.rowid DESC
+LIMIT :limit
@@ -0,0 +1,3 @@
+SELECT senderid, sender, realname, avatarurl
+FROM sender
+WHERE senderid = ?
@@ -0,0 +1 @@
+CREATE UNIQUE INDEX sender_index ON sender(sender, realname, avatarurl);
@@ -0,0 +1 @@
+CREATE INDEX backlog_buffer_msg_idx ON backlog (bufferid, messageid)
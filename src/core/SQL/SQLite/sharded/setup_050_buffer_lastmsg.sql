@@ -0,0 +1,4 @@
+CREATE TABLE buffer_lastmsg ( -- LAST MESSAGE PER BUFFER, REPLACES buffer.lastmsgid OF THE MAIN FILE
+	bufferid INTEGER NOT NULL PRIMARY KEY,
+	lastmsgid INTEGER NOT NULL DEFAULT 0
+)
@@ -0,0 +1,12 @@
+CREATE TRIGGER IF NOT EXISTS backlog_lastmsg_update_trigger_update
+AFTER UPDATE
+ON backlog
+FOR EACH ROW
+    BEGIN
+        INSERT OR IGNORE INTO buffer_lastmsg (bufferid, lastmsgid)
+        VALUES (new.bufferid, new.messageid);
+        UPDATE buffer_lastmsg
+        SET lastmsgid = new.messageid
+        WHERE buffer_lastmsg.bufferid = new.bufferid
+            AND buffer_lastmsg.lastmsgid < new.messageid;
+    END
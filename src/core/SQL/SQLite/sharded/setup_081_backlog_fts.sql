@@ -0,0 +1 @@
+CREATE VIRTUAL TABLE backlog_fts USING fts5(message, sender, content = 'backlog_fts_content', content_rowid = 'messageid')
@@ -0,0 +1,10 @@
+CREATE TRIGGER IF NOT EXISTS backlog_fts_update_trigger_insert
+AFTER INSERT
+ON backlog
+FOR EACH ROW
+    BEGIN
+        INSERT INTO backlog_fts (rowid, message, sender)
+        SELECT new.messageid, new.message, sender.sender
+        FROM sender
+        WHERE sender.senderid = new.senderid;
+    END
@@ -0,0 +1,10 @@
+CREATE TRIGGER IF NOT EXISTS backlog_fts_update_trigger_delete
+AFTER DELETE
+ON backlog
+FOR EACH ROW
+    BEGIN
+        INSERT INTO backlog_fts (backlog_fts, rowid, message, sender)
+        SELECT 'delete', old.messageid, old.message, sender.sender
+        FROM sender
+        WHERE sender.senderid = old.senderid;
+    END
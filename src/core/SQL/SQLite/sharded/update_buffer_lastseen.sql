@@ -0,0 +1,4 @@
+UPDATE buffer
+SET lastmsgid = max(buffer.lastmsgid, :lastmsgid),
+    lastseenmsgid = min(:lastseenmsgid, max(buffer.lastmsgid, :lastmsgid))
+WHERE userid = :userid AND bufferid = :bufferid
@@ -0,0 +1,7 @@
+UPDATE buffer
+SET lastmsgid = max(buffer.lastmsgid, coalesce(:lastmsgid, buffer.lastmsgid)),
+    lastseenmsgid = coalesce(min(:lastseenmsgid, max(buffer.lastmsgid, :lastmsgid)), lastseenmsgid),
+    markerlinemsgid = coalesce(:markerlinemsgid, markerlinemsgid),
+    bufferactivity = coalesce(:bufferactivity, bufferactivity),
+    highlightcount = coalesce(:highlightcount, highlightcount)
+WHERE userid = :userid AND bufferid = :bufferid
@@ -0,0 +1,6 @@
+UPDATE buffer
+SET lastseenmsgid = coalesce(min(:lastseenmsgid, buffer.lastmsgid), lastseenmsgid),
+    markerlinemsgid = coalesce(:markerlinemsgid, markerlinemsgid),
+    bufferactivity = coalesce(:bufferactivity, bufferactivity),
+    highlightcount = coalesce(:highlightcount, highlightcount)
+WHERE userid = :userid AND bufferid = :bufferid
@@ -0,0 +1,4 @@
+CREATE VIEW backlog_fts_content AS
+SELECT backlog.messageid, backlog.message, sender.sender
+FROM backlog
+JOIN sender ON backlog.senderid = sender.senderid
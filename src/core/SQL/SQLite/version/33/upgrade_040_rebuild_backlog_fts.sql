@@ -0,0 +1 @@
+INSERT INTO backlog_fts (backlog_fts) VALUES ('rebuild')
@@ -29,6 +29,7 @@
 #include <QSqlQuery>
 #include <QThread>
 
+#include "metricsserver.h"
 #include "quassel.h"
 
 int AbstractSqlStorage::_nextConnectionId = 0;
@@ -39,8 +40,9 @@ AbstractSqlStorage::AbstractSqlStorage(QObject* parent)
 AbstractSqlStorage::~AbstractSqlStorage()
 {
     // disconnect the connections, so their deletion is no longer interesting for us
-    QHash<QThread*, Connection*>::iterator conIter;
+    QHash<ConnectionKey, Connection*>::iterator conIter;
     for (conIter = _connectionPool.begin(); conIter != _connectionPool.end(); ++conIter) {
+        conIter.value()->statements().clear();
         QSqlDatabase::removeDatabase(conIter.value()->name());
         disconnect(conIter.value(), nullptr, this, nullptr);
     }
@@ -48,30 +50,46 @@ AbstractSqlStorage::~AbstractSqlStorage()
 
 QSqlDatabase AbstractSqlStorage::logDb()
 {
-    if (!_connectionPool.contains(QThread::currentThread()))
-        addConnectionToPool();
+    return shardDb(QString());
+}
 
-    QSqlDatabase db = QSqlDatabase::database(_connectionPool[QThread::currentThread()]->name(), false);
+QSqlDatabase AbstractSqlStorage::shardDb(const QString& shard)
+{
+    ConnectionKey key{QThread::currentThread(), shard};
+    Connection* connection = nullptr;
+    {
+        QMutexLocker locker(&_connectionPoolMutex);
+        connection = _connectionPool.value(key);
+    }
+    if (!connection) {
+        addConnectionToPool(shard);
+        QMutexLocker locker(&_connectionPoolMutex);
+        connection = _connectionPool[key];
+    }
+
+    QSqlDatabase db = QSqlDatabase::database(connection->name(), false);
 
     if (!db.isOpen()) {
-        qWarning() << "Database connection" << displayName() << "for thread" << QThread::currentThread()
+        qWarning() << "Database connection" << displayName() << shard << "for thread" << QThread::currentThread()
                    << "was lost, attempting to reconnect...";
+        // Statements prepared on the old connection are gone with it
+        connection->statements().clear();
         dbConnect(db);
     }
 
     return db;
 }
 
-void AbstractSqlStorage::addConnectionToPool()
+void AbstractSqlStorage::addConnectionToPool(const QString& shard)
 {
     QMutexLocker locker(&_connectionPoolMutex);
+    QThread* currentThread = QThread::currentThread();
+
     // we have to recheck if the connection pool already contains a connection for
     // this thread. Since now (after the lock) we can only tell for sure
-    if (_connectionPool.contains(QThread::currentThread()))
+    if (_connectionPool.contains({currentThread, shard}))
         return;
 
-    QThread* currentThread = QThread::currentThread();
-
     int connectionId = _nextConnectionId++;
 
     Connection* connection = new Connection(QLatin1String(QString("quassel_%1_con_%2").arg(driverName()).arg(connectionId).toLatin1()));
@@ -79,10 +97,11 @@ void AbstractSqlStorage::addConnectionToPool()
     connect(this, &QObject::destroyed, connection, &QObject::deleteLater);
     connect(currentThread, &QObject::destroyed, connection, &QObject::deleteLater);
     connect(connection, &QObject::destroyed, this, &AbstractSqlStorage::connectionDestroyed);
-    _connectionPool[currentThread] = connection;
+    _connectionPool[{currentThread, shard}] = connection;
+    _connectionsByName[connection->name()] = connection;
 
     QSqlDatabase db = QSqlDatabase::addDatabase(driverName(), connection->name());
-    db.setDatabaseName(databaseName());
+    db.setDatabaseName(shard.isEmpty() ? databaseName() : shardDatabaseName(shard));
 
     if (!hostName().isEmpty())
         db.setHostName(hostName());
@@ -161,12 +180,20 @@ QString AbstractSqlStorage::queryString(const QString& queryName, int version)
     // 'versions/##' subfolders.
     if (version == 0) {
         // Use the current SQL schema, not a versioned request
-        queryInfo = QFileInfo(QString(":/SQL/%1/%2.sql").arg(displayName()).arg(queryName));
+        queryInfo = QFileInfo(QString(":/SQL/%1/%2.sql").arg(queryFolder()).arg(queryName));
         // If version is needed later, get it via version = schemaVersion();
     }
     else {
         // Use the specified schema version, not the general folder
-        queryInfo = QFileInfo(QString(":/SQL/%1/version/%2/%3.sql").arg(displayName()).arg(version).arg(queryName));
+        queryInfo = QFileInfo(QString(":/SQL/%1/version/%2/%3.sql").arg(queryFolder()).arg(version).arg(queryName));
+    }
+
+    // Queries are compiled into the binary, so they never change while we're running
+    {
+        QMutexLocker locker(&_queryStringsMutex);
+        auto it = _queryStrings.constFind(queryInfo.filePath());
+        if (it != _queryStrings.constEnd())
+            return it.value();
     }
 
     if (!queryInfo.exists() || !queryInfo.isFile() || !queryInfo.isReadable()) {
@@ -177,17 +204,65 @@ QString AbstractSqlStorage::queryString(const QString& queryName, int version)
     QFile queryFile(queryInfo.filePath());
     if (!queryFile.open(QIODevice::ReadOnly | QIODevice::Text))
         return QString();
-    QString query = QTextStream(&queryFile).readAll();
+    QString query = QTextStream(&queryFile).readAll().trimmed();
     queryFile.close();
 
-    return query.trimmed();
+    QMutexLocker locker(&_queryStringsMutex);
+    _queryStrings.insert(queryInfo.filePath(), query);
+    return query;
+}
+
+PreparedQuery AbstractSqlStorage::cachedQuery(const QString& queryName, const QSqlDatabase& db, const QString& suffix)
+{
+    Connection* connection;
+    {
+        QMutexLocker locker(&_connectionPoolMutex);
+        connection = _connectionsByName.value(db.connectionName());
+    }
+    if (!connection) {
+        // Not one of ours, so there's nothing to cache the statement in
+        QSqlQuery query(db);
+        query.prepare(queryString(queryName) + suffix);
+        return PreparedQuery(std::move(query));
+    }
+    Q_ASSERT(connection->thread() == QThread::currentThread());
+
+    QHash<QString, QSqlQuery>& statements = connection->statements();
+    const QString key = suffix.isEmpty() ? queryName : queryName + suffix;
+    auto it = statements.find(key);
+    bool hit = it != statements.end();
+    if (!hit) {
+        QSqlQuery query(db);
+        if (!query.prepare(queryString(queryName) + suffix)) {
+            // Don't cache broken statements, so the error shows up again on the next attempt
+            return PreparedQuery(std::move(query));
+        }
+        it = statements.insert(key, query);
+    }
+    if (_metricsServer)
+        _metricsServer->statementCacheLookup(hit);
+
+    return PreparedQuery(it.value());
+}
+
+void AbstractSqlStorage::bindBufferState(QSqlQuery& query, UserId user, const BufferState& state)
+{
+    auto value = [&state](BufferState::Field field, const QVariant& value) {
+        return (state.fields & field) ? value : QVariant(value.type());
+    };
+    query.bindValue(":userid", user.toInt());
+    query.bindValue(":bufferid", state.bufferId.toInt());
+    query.bindValue(":lastseenmsgid", value(BufferState::LastSeenMsg, state.lastSeenMsg.toQint64()));
+    query.bindValue(":markerlinemsgid", value(BufferState::MarkerLineMsg, state.markerLineMsg.toQint64()));
+    query.bindValue(":bufferactivity", value(BufferState::Activity, static_cast<int>(state.activity)));
+    query.bindValue(":highlightcount", value(BufferState::HighlightCount, state.highlightCount));
 }
 
 std::vector<AbstractSqlStorage::SqlQueryResource> AbstractSqlStorage::setupQueries()
 {
     std::vector<SqlQueryResource> queries;
     // The current schema is stored in the root folder, including setup scripts.
-    QDir dir = QDir(QString(":/SQL/%1/").arg(displayName()));
+    QDir dir = QDir(QString(":/SQL/%1/").arg(queryFolder()));
     foreach (QFileInfo fileInfo, dir.entryInfoList(QStringList() << "setup*", QDir::NoFilter, QDir::Name)) {
         queries.emplace_back(queryString(fileInfo.baseName()), fileInfo.baseName());
     }
@@ -225,7 +300,7 @@ std::vector<AbstractSqlStorage::SqlQueryResource> AbstractSqlStorage::upgradeQue
 {
     std::vector<SqlQueryResource> queries;
     // Upgrade queries are stored in the 'version/##' subfolders.
-    QDir dir = QDir(QString(":/SQL/%1/version/%2/").arg(displayName()).arg(version));
+    QDir dir = QDir(QString(":/SQL/%1/version/%2/").arg(queryFolder()).arg(version));
     foreach (QFileInfo fileInfo, dir.entryInfoList(QStringList() << "upgrade*", QDir::NoFilter, QDir::Name)) {
         queries.emplace_back(queryString(fileInfo.baseName(), version), fileInfo.baseName());
     }
@@ -326,7 +401,7 @@ int AbstractSqlStorage::schemaVersion()
     int version;
     bool ok;
     // Schema versions are stored in the 'version/##' subfolders.
-    QDir dir = QDir(QString(":/SQL/%1/version/").arg(displayName()));
+    QDir dir = QDir(QString(":/SQL/%1/version/").arg(queryFolder()));
     foreach (QFileInfo fileInfo, dir.entryInfoList()) {
         if (!fileInfo.isDir())
             continue;
@@ -400,7 +475,21 @@ bool AbstractSqlStorage::watchQuery(QSqlQuery& query)
 void AbstractSqlStorage::connectionDestroyed()
 {
     QMutexLocker locker(&_connectionPoolMutex);
-    _connectionPool.remove(sender()->thread());
+    // The connection is already half-destroyed at this point, so look it up by identity
+    QHash<ConnectionKey, Connection*>::iterator conIter = _connectionPool.begin();
+    while (conIter != _connectionPool.end()) {
+        if (conIter.value() == sender())
+            conIter = _connectionPool.erase(conIter);
+        else
+            ++conIter;
+    }
+    auto nameIter = _connectionsByName.begin();
+    while (nameIter != _connectionsByName.end()) {
+        if (nameIter.value() == sender())
+            nameIter = _connectionsByName.erase(nameIter);
+        else
+            ++nameIter;
+    }
 }
 
 // ========================================
@@ -413,6 +502,8 @@ AbstractSqlStorage::Connection::Connection(const QString& name, QObject* parent)
 
 AbstractSqlStorage::Connection::~Connection()
 {
+    // Statements must be gone before the database can be removed
+    _statements.clear();
     {
         QSqlDatabase db = QSqlDatabase::database(name(), false);
         if (db.isOpen()) {
@@ -653,3 +744,54 @@ bool operator==(const SenderData& a, const SenderData& b)
 {
     return a.sender == b.sender && a.realname == b.realname && a.avatarurl == b.avatarurl;
 }
+
+// ========================================
+//  SenderIdCache
+// ========================================
+
+SenderIdCache::SenderIdCache(int capacity)
+    : _capacity(capacity)
+{}
+
+qint64 SenderIdCache::find(const SenderData& sender)
+{
+    QMutexLocker locker(&_mutex);
+    auto it = _index.find(sender);
+    if (it == _index.end())
+        return -1;
+    _entries.splice(_entries.begin(), _entries, it.value());
+    return it.value()->second;
+}
+
+void SenderIdCache::insert(const SenderData& sender, qint64 senderId)
+{
+    if (_capacity <= 0)
+        return;
+
+    QMutexLocker locker(&_mutex);
+    auto it = _index.find(sender);
+    if (it != _index.end()) {
+        it.value()->second = senderId;
+        _entries.splice(_entries.begin(), _entries, it.value());
+        return;
+    }
+    if (_index.count() >= _capacity) {
+        _index.remove(_entries.back().first);
+        _entries.pop_back();
+    }
+    _entries.emplace_front(sender, senderId);
+    _index.insert(sender, _entries.begin());
+}
+
+void SenderIdCache::clear()
+{
+    QMutexLocker locker(&_mutex);
+    _index.clear();
+    _entries.clear();
+}
+
+int SenderIdCache::count() const
+{
+    QMutexLocker locker(&_mutex);
+    return _index.count();
+}
@@ -20,11 +20,14 @@
 
 #pragma once
 
+#include <list>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include <QHash>
 #include <QMutex>
+#include <QPair>
 #include <QSqlDatabase>
 #include <QSqlError>
 #include <QSqlQuery>
@@ -36,6 +39,40 @@ class QThread;
 class AbstractSqlMigrationReader;
 class AbstractSqlMigrationWriter;
 
+/**
+ * A statement from the per-connection statement cache, see AbstractSqlStorage::cachedQuery()
+ *
+ * Behaves like a pointer to the QSqlQuery.  The statement is reset when this goes out of scope,
+ * so it doesn't hold on to its result set (and the locks that come with it) until its next use.
+ */
+class PreparedQuery
+{
+public:
+    explicit PreparedQuery(QSqlQuery query)
+        : _query(std::move(query))
+    {}
+    PreparedQuery(PreparedQuery&& other)
+        : _query(other._query)
+        , _active(other._active)
+    {
+        other._active = false;
+    }
+    PreparedQuery(const PreparedQuery&) = delete;
+    PreparedQuery& operator=(const PreparedQuery&) = delete;
+    ~PreparedQuery()
+    {
+        if (_active)
+            _query.finish();
+    }
+
+    QSqlQuery& operator*() { return _query; }
+    QSqlQuery* operator->() { return &_query; }
+
+private:
+    QSqlQuery _query;
+    bool _active{true};
+};
+
 class AbstractSqlStorage : public Storage
 {
     Q_OBJECT
@@ -47,6 +84,8 @@ public:
     virtual std::unique_ptr<AbstractSqlMigrationReader> createMigrationReader() { return {}; }
     virtual std::unique_ptr<AbstractSqlMigrationWriter> createMigrationWriter() { return {}; }
 
+    void setMetricsServer(MetricsServer* metricsServer) override { _metricsServer = metricsServer; }
+
     /**
      * An SQL query with associated resource filename
      */
@@ -72,6 +111,42 @@ protected:
 
     QSqlDatabase logDb();
 
+    /**
+     * Gets the current thread's connection to an additional database file of this storage
+     *
+     * Backends that spread their data over several database files (shards) use this to obtain a
+     * connection to one of them.  Connections are pooled per thread and shard, just like the ones
+     * returned by logDb(), which is equivalent to requesting the unnamed shard.
+     *
+     * @see shardDatabaseName()
+     *
+     * @param shard  Name of the shard; an empty name refers to the main database
+     * @return Open connection to the requested shard for the current thread
+     */
+    QSqlDatabase shardDb(const QString& shard);
+
+    /**
+     * Gets the database name used for connecting to the given shard
+     *
+     * @param shard  Name of the shard, never empty
+     * @return Database name (e.g. file name) for the shard; defaults to the main database
+     */
+    virtual QString shardDatabaseName(const QString& shard)
+    {
+        Q_UNUSED(shard);
+        return databaseName();
+    }
+
+    /**
+     * Name of the folder in the SQL resource collection that provides this backend's queries
+     *
+     * Defaults to the display name.  Backends sharing the schema of another backend can override
+     * this to reuse its queries.
+     *
+     * @return Folder name below :/SQL/
+     */
+    virtual QString queryFolder() const { return displayName(); }
+
     /**
      * Fetch an SQL query string by name and optional schema version
      *
@@ -91,6 +166,35 @@ protected:
      */
     QString queryString(const QString& queryName, int version = 0);
 
+    /**
+     * Gets a prepared statement for an SQL query from the statement cache of the given connection
+     *
+     * Statements are prepared on first use for each connection, i.e. for each thread and shard, so
+     * frequently used queries are only parsed and planned once.  Values bound by a previous user of
+     * the statement are kept, so all parameters need to be bound again.
+     *
+     * As the statement is shared, it must not be used by nested calls while the returned query is
+     * alive, e.g. while iterating over its results.
+     *
+     * @param[in] queryName  File name of the SQL query, minus the .sql extension
+     * @param[in] db         Connection obtained from logDb() or shardDb() in the current thread
+     * @param[in] suffix     Appended to the query, e.g. the VALUES list of a multi-row insert; each
+     *                       distinct suffix gets its own statement
+     * @return The prepared query
+     */
+    PreparedQuery cachedQuery(const QString& queryName, const QSqlDatabase& db, const QString& suffix = QString());
+
+    /**
+     * Binds the parameters of an update_buffer_state query
+     *
+     * Fields that didn't change are bound as NULL, which the query leaves alone.
+     *
+     * @param[in,out] query  The query
+     * @param[in] user       The owner of the buffer
+     * @param[in] state      The changes to the buffer's state
+     */
+    static void bindBufferState(QSqlQuery& query, UserId user, const BufferState& state);
+
     /**
      * Gets the collection of SQL setup queries and filenames to create a new database
      *
@@ -159,11 +263,15 @@ private slots:
     void connectionDestroyed();
 
 private:
-    void addConnectionToPool();
+    void addConnectionToPool(const QString& shard);
     void dbConnect(QSqlDatabase& db);
 
     int _schemaVersion{0};
-    bool _debug;
+    bool _debug{false};
+    MetricsServer* _metricsServer{nullptr};
+
+    QMutex _queryStringsMutex;
+    QHash<QString, QString> _queryStrings;  ///< Query strings by resource path
 
     static int _nextConnectionId;
     QMutex _connectionPoolMutex;
@@ -171,7 +279,9 @@ private:
     // those objects reside in the thread the connection belongs to
     // which allows us thread safe termination of a connection
     class Connection;
-    QHash<QThread*, Connection*> _connectionPool;
+    using ConnectionKey = QPair<QThread*, QString>;  ///< Owning thread and shard name
+    QHash<ConnectionKey, Connection*> _connectionPool;
+    QHash<QString, Connection*> _connectionsByName;
 };
 
 struct SenderData
@@ -184,6 +294,59 @@ struct SenderData
     friend bool operator==(const SenderData& a, const SenderData& b);
 };
 
+/**
+ * Maps senders to their IDs in the sender table, keeping the most recently used ones
+ *
+ * Storage backends use this to avoid looking up (or trying to insert) senders they have seen
+ * before.  Cached IDs only stay valid as long as sender rows aren't removed, so only backends
+ * that never prune senders while the core is running may use this (the sharded SQLite backend
+ * deletes senders and thus doesn't); only mappings that have been committed to the database
+ * must be inserted, though.
+ *
+ * This class is threadsafe.
+ */
+class SenderIdCache
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param capacity  Maximum number of senders to keep
+     */
+    explicit SenderIdCache(int capacity = 10000);
+
+    /**
+     * Looks up the ID of a sender, marking it as recently used
+     *
+     * @param sender  Sender to look up
+     * @return The sender's ID, or -1 if it's not cached
+     */
+    qint64 find(const SenderData& sender);
+
+    /**
+     * Adds or updates a sender, evicting the least recently used one if the cache is full
+     *
+     * @param sender    Sender to add
+     * @param senderId  The sender's ID in the database
+     */
+    void insert(const SenderData& sender, qint64 senderId);
+
+    /**
+     * Removes all senders, e.g. after senders have been deleted from the database
+     */
+    void clear();
+
+    int count() const;
+
+private:
+    using Entry = std::pair<SenderData, qint64>;
+
+    int _capacity;
+    mutable QMutex _mutex;
+    std::list<Entry> _entries;  ///< Most recently used first
+    QHash<SenderData, std::list<Entry>::iterator> _index;
+};
+
 // ========================================
 //  AbstractSqlStorage::Connection
 // ========================================
@@ -197,8 +360,12 @@ public:
 
     inline QLatin1String name() const { return QLatin1String(_name); }
 
+    /// Prepared statements by query name; only to be used from the connection's thread
+    QHash<QString, QSqlQuery>& statements() { return _statements; }
+
 private:
     QByteArray _name;
+    QHash<QString, QSqlQuery> _statements;
 };
 
 // ========================================
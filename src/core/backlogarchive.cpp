@@ -0,0 +1,248 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "backlogarchive.h"
+
+#include <algorithm>
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#ifdef Q_OS_UNIX
+#    include <unistd.h>
+#endif
+
+namespace {
+
+const quint32 segmentMagic = 0x51424131;  // "QBA1"
+const int segmentHeaderSize = 24;
+
+bool syncFile(QFile& file)
+{
+    if (!file.flush())
+        return false;
+#ifdef Q_OS_UNIX
+    return ::fsync(file.handle()) == 0;
+#else
+    return true;
+#endif
+}
+
+}  // namespace
+
+BacklogArchive::BacklogArchive(QString directory)
+    : _directory(std::move(directory))
+{}
+
+QString BacklogArchive::fileName(UserId user, BufferId bufferId) const
+{
+    return QDir(_directory).filePath(QString("%1/%2.archive").arg(user.toInt()).arg(bufferId.toInt()));
+}
+
+bool BacklogArchive::contains(UserId user, BufferId bufferId) const
+{
+    return QFile::exists(fileName(user, bufferId));
+}
+
+BacklogArchive::Index& BacklogArchive::updateIndex(QFile& file)
+{
+    Index& index = _index[file.fileName()];
+    if (file.size() < index.size) {
+        // Replaced behind our back, start over
+        index = {};
+    }
+
+    QDataStream in(&file);
+    while (index.size + segmentHeaderSize <= file.size()) {
+        file.seek(index.size);
+        quint32 magic, size;
+        qint64 first, last;
+        in >> magic >> size >> first >> last;
+        if (in.status() != QDataStream::Ok || magic != segmentMagic || index.size + segmentHeaderSize + size > file.size())
+            break;
+        index.segments.push_back({index.size + segmentHeaderSize, size, first, last});
+        index.size += segmentHeaderSize + size;
+    }
+    return index;
+}
+
+bool BacklogArchive::write(QFile& file, const QByteArray& data)
+{
+    Index& index = updateIndex(file);
+    if (file.size() > index.size) {
+        qWarning() << "Dropping incomplete segment at the end of" << file.fileName();
+        if (!file.resize(index.size))
+            return false;
+    }
+    if (!file.seek(index.size) || file.write(data) != data.size() || !syncFile(file)) {
+        qWarning() << "Could not write to backlog archive" << file.fileName() << file.errorString();
+        return false;
+    }
+    updateIndex(file);
+    return true;
+}
+
+bool BacklogArchive::append(UserId user, BufferId bufferId, const std::vector<Message>& messages)
+{
+    if (messages.empty())
+        return true;
+
+    QByteArray payload;
+    {
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_0);
+        out << static_cast<quint32>(messages.size());
+        for (auto&& msg : messages) {
+            out << msg.msgId().toQint64() << msg.timestamp().toMSecsSinceEpoch() << static_cast<qint32>(msg.type())
+                << static_cast<qint32>(msg.flags()) << msg.sender() << msg.senderPrefixes() << msg.realName() << msg.avatarUrl()
+                << msg.contents();
+        }
+    }
+    payload = qCompress(payload);
+
+    QByteArray segment;
+    {
+        QDataStream out(&segment, QIODevice::WriteOnly);
+        out << segmentMagic << static_cast<quint32>(payload.size()) << messages.front().msgId().toQint64()
+            << messages.back().msgId().toQint64();
+    }
+    segment += payload;
+
+    QMutexLocker locker(&_mutex);
+    QFile file(fileName(user, bufferId));
+    if (!QDir().mkpath(QFileInfo(file).absolutePath()) || !file.open(QIODevice::ReadWrite)) {
+        qWarning() << "Could not open backlog archive" << file.fileName() << file.errorString();
+        return false;
+    }
+    return write(file, segment);
+}
+
+std::vector<Message> BacklogArchive::readSegment(QFile& file, const Segment& segment, const BufferInfo& bufferInfo)
+{
+    std::vector<Message> messages;
+    if (!file.seek(segment.offset))
+        return messages;
+    QByteArray payload = qUncompress(file.read(segment.size));
+
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 count;
+    in >> count;
+    messages.reserve(std::min<quint32>(count, 100000));
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        qint64 msgId, timestamp;
+        qint32 type, flags;
+        QString sender, senderPrefixes, realName, avatarUrl, contents;
+        in >> msgId >> timestamp >> type >> flags >> sender >> senderPrefixes >> realName >> avatarUrl >> contents;
+        Message msg(QDateTime::fromMSecsSinceEpoch(timestamp),
+                    bufferInfo,
+                    static_cast<Message::Type>(type),
+                    contents,
+                    sender,
+                    senderPrefixes,
+                    realName,
+                    avatarUrl,
+                    Message::Flags{flags});
+        msg.setMsgId(msgId);
+        messages.push_back(std::move(msg));
+    }
+    if (in.status() != QDataStream::Ok && !messages.empty()) {
+        qWarning() << "Corrupt segment at offset" << segment.offset << "in backlog archive" << file.fileName();
+        messages.pop_back();
+    }
+    return messages;
+}
+
+std::vector<Message> BacklogArchive::requestMsgs(UserId user, const BufferInfo& bufferInfo, MsgId first, MsgId last, int limit)
+{
+    std::vector<Message> result;
+
+    QMutexLocker locker(&_mutex);
+    QFile file(fileName(user, bufferInfo.bufferId()));
+    if (!file.exists() || !file.open(QIODevice::ReadOnly))
+        return result;
+
+    // Segments are appended in ascending order, but merging buffers mixes them up
+    std::vector<Segment> segments;
+    for (auto&& segment : updateIndex(file).segments) {
+        if ((first == -1 || segment.last >= first) && (last == -1 || segment.first < last))
+            segments.push_back(segment);
+    }
+    std::sort(segments.begin(), segments.end(), [](const Segment& a, const Segment& b) { return a.last > b.last; });
+
+    auto newerFirst = [](const Message& a, const Message& b) { return a.msgId() > b.msgId(); };
+    for (auto&& segment : segments) {
+        if (limit != -1 && static_cast<int>(result.size()) >= limit && segment.last < result[limit - 1].msgId())
+            break;
+        for (auto&& msg : readSegment(file, segment, bufferInfo)) {
+            if ((first == -1 || msg.msgId() >= first) && (last == -1 || msg.msgId() < last))
+                result.push_back(std::move(msg));
+        }
+        std::sort(result.begin(), result.end(), newerFirst);
+        // A batch may have been archived twice if deleting it from the database failed
+        result.erase(std::unique(result.begin(), result.end(), [](const Message& a, const Message& b) { return a.msgId() == b.msgId(); }),
+                     result.end());
+    }
+    if (limit != -1 && static_cast<int>(result.size()) > limit)
+        result.resize(limit);
+    return result;
+}
+
+void BacklogArchive::removeBuffer(UserId user, BufferId bufferId)
+{
+    QMutexLocker locker(&_mutex);
+    QString name = fileName(user, bufferId);
+    _index.remove(name);
+    QFile::remove(name);
+}
+
+bool BacklogArchive::mergeBuffers(UserId user, BufferId bufferId1, BufferId bufferId2)
+{
+    QMutexLocker locker(&_mutex);
+    QFile source(fileName(user, bufferId2));
+    if (!source.exists())
+        return true;
+    if (!source.open(QIODevice::ReadOnly))
+        return false;
+
+    qint64 size = updateIndex(source).size;
+    source.seek(0);
+    QByteArray data = source.read(size);
+    QFile target(fileName(user, bufferId1));
+    if (!target.open(QIODevice::ReadWrite) || !write(target, data))
+        return false;
+
+    _index.remove(source.fileName());
+    source.close();
+    return source.remove();
+}
+
+void BacklogArchive::removeUser(UserId user)
+{
+    QMutexLocker locker(&_mutex);
+    QDir dir(QDir(_directory).filePath(QString::number(user.toInt())));
+    for (const QString& name : dir.entryList(QDir::Files)) {
+        _index.remove(dir.filePath(name));
+    }
+    dir.removeRecursively();
+}
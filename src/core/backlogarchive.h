@@ -0,0 +1,130 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include "core-export.h"
+
+#include <vector>
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+#include "bufferinfo.h"
+#include "message.h"
+#include "types.h"
+
+/**
+ * Cold storage for backlog that has been pruned from the database
+ *
+ * Each buffer has an archive file of its own, which is only ever appended to. A file consists of
+ * segments, each holding a batch of consecutive messages compressed as a whole, and a header with
+ * the range of MsgIds contained, so reading back a few messages only requires decompressing the
+ * segments that cover them.
+ *
+ * Segments are synced to disk before append() returns, so the messages may be removed from the
+ * database afterwards.  A segment that has been cut short by a crash is ignored, and overwritten by
+ * the next append.
+ *
+ * @note All methods are threadsafe.
+ */
+class CORE_EXPORT BacklogArchive
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param directory  The directory holding the archive files
+     */
+    explicit BacklogArchive(QString directory);
+
+    /**
+     * Checks whether a buffer has archived messages
+     */
+    bool contains(UserId user, BufferId bufferId) const;
+
+    /**
+     * Appends messages to the archive of a buffer
+     *
+     * @param user      The owner of the buffer
+     * @param bufferId  The buffer the messages belong to
+     * @param messages  The messages, oldest first; they must be newer than anything archived before
+     * @return true if the messages have been written to disk
+     */
+    bool append(UserId user, BufferId bufferId, const std::vector<Message>& messages);
+
+    /**
+     * Reads archived messages of a buffer
+     *
+     * @param user        The owner of the buffer
+     * @param bufferInfo  The buffer we request messages from
+     * @param first       if != -1 return only messages with a MsgId >= first
+     * @param last        if != -1 return only messages with a MsgId < last
+     * @param limit       if != -1 limit the returned list to a max of \limit entries
+     * @return The newest matching messages, newest first
+     */
+    std::vector<Message> requestMsgs(UserId user, const BufferInfo& bufferInfo, MsgId first = -1, MsgId last = -1, int limit = -1);
+
+    /**
+     * Deletes the archive of a buffer
+     */
+    void removeBuffer(UserId user, BufferId bufferId);
+
+    /**
+     * Moves the archived messages of bufferId2 into the archive of bufferId1
+     */
+    bool mergeBuffers(UserId user, BufferId bufferId1, BufferId bufferId2);
+
+    /**
+     * Deletes the archives of all buffers of a user
+     */
+    void removeUser(UserId user);
+
+private:
+    struct Segment
+    {
+        qint64 offset;  ///< Position of the compressed data in the file
+        quint32 size;   ///< Size of the compressed data
+        MsgId first;
+        MsgId last;
+    };
+
+    struct Index
+    {
+        qint64 size{0};  ///< End of the last complete segment
+        std::vector<Segment> segments;
+    };
+
+    QString fileName(UserId user, BufferId bufferId) const;
+
+    /// Reads the headers of segments added since the file was last indexed
+    Index& updateIndex(QFile& file);
+
+    /// Writes raw segment data to the end of an open archive file, dropping any incomplete segment first
+    bool write(QFile& file, const QByteArray& data);
+
+    std::vector<Message> readSegment(QFile& file, const Segment& segment, const BufferInfo& bufferInfo);
+
+    const QString _directory;
+    mutable QMutex _mutex;
+    QHash<QString, Index> _index;
+};
@@ -0,0 +1,121 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "backlogpruner.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+#include "backlogarchive.h"
+#include "core.h"
+
+const int BacklogPruner::_batchSize = 500;
+const int BacklogPruner::_batchPause = 50;
+
+BacklogPruner::BacklogPruner(RetentionPolicy policy, BacklogArchive* archive, int interval, QObject* parent)
+    : QThread(parent)
+    , _policy(std::move(policy))
+    , _archive(archive)
+    , _interval(interval)
+{
+    setObjectName("BacklogPruner");
+}
+
+BacklogPruner::~BacklogPruner()
+{
+    stop();
+}
+
+void BacklogPruner::stop()
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _stopping = true;
+        _stopRequested.wakeOne();
+    }
+    wait();
+}
+
+bool BacklogPruner::sleep(unsigned long msecs)
+{
+    QMutexLocker locker(&_mutex);
+    if (!_stopping)
+        _stopRequested.wait(&_mutex, msecs);
+    return !_stopping;
+}
+
+void BacklogPruner::run()
+{
+    // Don't add to the load of a core that is just starting up
+    while (sleep(60 * 1000)) {
+        prune();
+        if (!sleep(static_cast<unsigned long>(_interval) * 60 * 1000))
+            break;
+    }
+}
+
+void BacklogPruner::prune()
+{
+    QElapsedTimer timer;
+    timer.start();
+    qint64 deletedTotal = 0;
+    qint64 archivedTotal = 0;
+
+    const QMap<UserId, QString> users = Core::userNames();
+    for (auto user = users.cbegin(); user != users.cend(); ++user) {
+        for (const BufferInfo& bufferInfo : Core::requestBuffers(user.key())) {
+            const RetentionPolicy::Rule* rule = _policy.rule(user.value(), bufferInfo);
+            if (!rule)
+                continue;
+
+            const QDateTime before = QDateTime::currentDateTimeUtc().addDays(-rule->maxAge);
+            forever {
+                int deleted;
+                if (rule->archive && _archive) {
+                    std::vector<Message> messages = Core::requestExpiredMsgs(user.key(), bufferInfo, before, _batchSize);
+                    if (messages.empty())
+                        break;
+                    if (!_archive->append(user.key(), bufferInfo.bufferId(), messages)) {
+                        qWarning() << "Could not archive backlog of buffer" << bufferInfo.bufferId() << ", keeping it in the database";
+                        break;
+                    }
+                    deleted = Core::deleteExpiredMsgs(user.key(), bufferInfo.bufferId(), before, messages.back().msgId(), _batchSize);
+                    if (deleted > 0)
+                        archivedTotal += deleted;
+                }
+                else {
+                    deleted = Core::deleteExpiredMsgs(user.key(), bufferInfo.bufferId(), before, -1, _batchSize);
+                    if (deleted > 0)
+                        deletedTotal += deleted;
+                }
+
+                if (deleted < _batchSize || !sleep(_batchPause))
+                    break;
+            }
+            if (!sleep(0))
+                return;
+        }
+    }
+
+    if (deletedTotal || archivedTotal)
+        qInfo() << "Pruned backlog:" << deletedTotal << "messages deleted," << archivedTotal << "archived in" << timer.elapsed() << "ms";
+}
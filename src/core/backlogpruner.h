@@ -0,0 +1,80 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "retentionpolicy.h"
+
+class BacklogArchive;
+
+/**
+ * Removes expired backlog from the database on a thread of its own
+ *
+ * Every pruning interval, the backlog of all buffers is checked against the retention policy.
+ * Expired messages are deleted, or moved to the backlog archive if the rule says so, in small
+ * batches with a short pause in between, so sessions writing new messages never have to wait for
+ * the pruner for long.
+ */
+class BacklogPruner : public QThread
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor
+     *
+     * @param policy    The retention policy to enforce
+     * @param archive   The archive to move expired messages to, if the policy says so
+     * @param interval  Time in minutes between pruning runs
+     * @param parent    Parent object
+     */
+    BacklogPruner(RetentionPolicy policy, BacklogArchive* archive, int interval, QObject* parent = nullptr);
+    ~BacklogPruner() override;
+
+    /**
+     * Stops the pruner thread, interrupting a running pruning run between batches
+     */
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    /// Prunes the backlog of all users once
+    void prune();
+
+    /// Waits for the given time in milliseconds, returning false if stopping
+    bool sleep(unsigned long msecs);
+
+    const RetentionPolicy _policy;
+    BacklogArchive* _archive;
+    const int _interval;
+
+    static const int _batchSize;
+    static const int _batchPause;
+
+    QMutex _mutex;
+    QWaitCondition _stopRequested;
+    bool _stopping{false};
+};
@@ -0,0 +1,98 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "bufferstatewriter.h"
+
+#include <QMutexLocker>
+
+#include "core.h"
+
+BufferStateWriter::BufferStateWriter(QObject* parent)
+    : QThread(parent)
+{
+    setObjectName("BufferStateWriter");
+}
+
+BufferStateWriter::~BufferStateWriter()
+{
+    stop();
+}
+
+void BufferStateWriter::store(UserId user, const std::vector<Storage::BufferState>& states)
+{
+    if (states.empty())
+        return;
+
+    QMutexLocker locker(&_mutex);
+    QHash<BufferId, Storage::BufferState>& pending = _pending[user];
+    for (auto&& state : states) {
+        auto it = pending.find(state.bufferId);
+        if (it == pending.end())
+            pending.insert(state.bufferId, state);
+        else
+            it->merge(state);
+    }
+    _queueChanged.wakeOne();
+}
+
+void BufferStateWriter::stop()
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _stopping = true;
+        _queueChanged.wakeOne();
+    }
+    wait();
+}
+
+void BufferStateWriter::run()
+{
+    QMutexLocker locker(&_mutex);
+    forever {
+        while (_pending.isEmpty() && !_stopping) {
+            _queueChanged.wait(&_mutex);
+        }
+        if (_pending.isEmpty()) {
+            // Stopping, and everything has been written
+            break;
+        }
+
+        // Changes coming in while we're writing are merged into the next round
+        QHash<UserId, QHash<BufferId, Storage::BufferState>> pending;
+        pending.swap(_pending);
+        locker.unlock();
+
+        for (auto it = pending.cbegin(); it != pending.cend(); ++it) {
+            std::vector<Storage::BufferState> states;
+            states.reserve(it->size());
+            for (auto&& state : *it) {
+                states.push_back(state);
+            }
+            write(it.key(), states);
+        }
+
+        locker.relock();
+    }
+}
+
+void BufferStateWriter::write(UserId user, const std::vector<Storage::BufferState>& states)
+{
+    Core::setBufferStates(user, states);
+}
@@ -0,0 +1,78 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <vector>
+
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "storage.h"
+
+/**
+ * Writes the persistent state of buffers to the storage backend on a thread of its own
+ *
+ * Sessions hand over changes to last seen message, marker line, activity and highlight count of
+ * their buffers with store(), without waiting for the database.  Changes to the same buffer that
+ * haven't been written yet are merged, and all of a user's changes are written in a single
+ * transaction.
+ */
+class BufferStateWriter : public QThread
+{
+    Q_OBJECT
+
+public:
+    BufferStateWriter(QObject* parent = nullptr);
+    ~BufferStateWriter() override;
+
+    /**
+     * Queues changes to the state of a user's buffers for writing
+     *
+     * @param user    The owner of the buffers
+     * @param states  The changes
+     */
+    void store(UserId user, const std::vector<Storage::BufferState>& states);
+
+    /**
+     * Writes all queued changes, then stops the writer thread
+     */
+    void stop();
+
+protected:
+    void run() override;
+
+    /**
+     * Writes the merged changes of a user's buffers, called on the writer thread
+     *
+     * @param user    The owner of the buffers
+     * @param states  The changes, at most one per buffer
+     */
+    virtual void write(UserId user, const std::vector<Storage::BufferState>& states);
+
+private:
+    QMutex _mutex;
+    QWaitCondition _queueChanged;
+    bool _stopping{false};
+
+    QHash<UserId, QHash<BufferId, Storage::BufferState>> _pending;
+};
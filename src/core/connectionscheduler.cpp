@@ -0,0 +1,193 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "connectionscheduler.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <QMutexLocker>
+
+#include "metricsserver.h"
+
+const qint64 ConnectionScheduler::_attemptTimeout = 60 * 1000;
+const qint64 ConnectionScheduler::_baseBackoff = 2 * 1000;
+const qint64 ConnectionScheduler::_maxBackoff = 5 * 60 * 1000;
+
+ConnectionScheduler::ConnectionScheduler(int maxConnecting, MetricsServer* metricsServer, QObject* parent)
+    : QObject(parent)
+    , _maxConnecting(std::max(1, maxConnecting))
+    , _metricsServer(metricsServer)
+{
+    _clock.start();
+    _dispatchTimer.setParent(this);
+    _dispatchTimer.setSingleShot(true);
+    connect(&_dispatchTimer, &QTimer::timeout, this, &ConnectionScheduler::dispatch);
+}
+
+void ConnectionScheduler::requestAdmission(QObject* network, const QString& server, bool priority)
+{
+    QMutexLocker locker(&_mutex);
+    // A network only ever waits for one connection
+    _queue.erase(std::remove_if(_queue.begin(), _queue.end(), [network](const Request& request) { return request.network == network; }),
+                 _queue.end());
+    _connecting.remove(network);
+    _queue.append({network, server, priority, _clock.elapsed()});
+    scheduleDispatch();
+}
+
+void ConnectionScheduler::finished(QObject* network, bool success)
+{
+    QMutexLocker locker(&_mutex);
+    auto it = _connecting.find(network);
+    if (it == _connecting.end())
+        return;
+
+    const QString server = it->server;
+    _connecting.erase(it);
+    if (success) {
+        _servers.remove(server);
+    }
+    else {
+        ServerState& state = _servers[server];
+        state.failures++;
+        state.notBefore = _clock.elapsed() + backoff(state.failures, qrand() / (double(RAND_MAX) + 1));
+        if (_metricsServer)
+            _metricsServer->connectionFailed();
+    }
+    scheduleDispatch();
+}
+
+void ConnectionScheduler::cancel(QObject* network)
+{
+    QMutexLocker locker(&_mutex);
+    _queue.erase(std::remove_if(_queue.begin(), _queue.end(), [network](const Request& request) { return request.network == network; }),
+                 _queue.end());
+    if (_connecting.remove(network))
+        scheduleDispatch();
+}
+
+int ConnectionScheduler::waiting() const
+{
+    QMutexLocker locker(&_mutex);
+    return _queue.size();
+}
+
+int ConnectionScheduler::connecting() const
+{
+    QMutexLocker locker(&_mutex);
+    return _connecting.size();
+}
+
+qint64 ConnectionScheduler::backoff(int failures, double jitter)
+{
+    if (failures <= 0)
+        return 0;
+
+    qint64 delay = std::min(_baseBackoff << std::min(failures - 1, 16), _maxBackoff);
+    return static_cast<qint64>(delay * (0.5 + jitter));
+}
+
+void ConnectionScheduler::scheduleDispatch()
+{
+    if (!_dispatchPending) {
+        _dispatchPending = true;
+        QMetaObject::invokeMethod(this, "dispatch", Qt::QueuedConnection);
+    }
+}
+
+void ConnectionScheduler::dispatch()
+{
+    // Networks remove themselves before they're destroyed, which takes the mutex, so it's safe to
+    // notify them as long as we're holding it
+    QMutexLocker locker(&_mutex);
+    _dispatchPending = false;
+    const qint64 now = _clock.elapsed();
+
+    // Don't let attempts that never report back hold on to their slot forever
+    for (auto it = _connecting.begin(); it != _connecting.end();) {
+        if (now - it->started >= _attemptTimeout)
+            it = _connecting.erase(it);
+        else
+            ++it;
+    }
+
+    auto isBackingOff = [&](const QString& server) {
+        auto state = _servers.constFind(server);
+        return state != _servers.cend() && state->notBefore > now;
+    };
+
+    while (_connecting.size() < _maxConnecting) {
+        // Oldest prioritized request first, then the oldest one overall
+        int next = -1;
+        for (int i = 0; i < _queue.size(); i++) {
+            if (isBackingOff(_queue[i].server))
+                continue;
+            if (next < 0 || _queue[i].priority) {
+                next = i;
+                if (_queue[i].priority)
+                    break;
+            }
+        }
+        if (next < 0)
+            break;
+
+        Request request = _queue.takeAt(next);
+        _connecting.insert(request.network, {request.server, now});
+        if (_metricsServer)
+            _metricsServer->connectionWait().observe(static_cast<uint64_t>(now - request.queued));
+        QMetaObject::invokeMethod(request.network, "startConnection", Qt::QueuedConnection);
+    }
+
+    // Come back when the next backoff or attempt expires
+    qint64 wakeUp = -1;
+    auto wakeUpAt = [&](qint64 time) {
+        if (wakeUp < 0 || time < wakeUp)
+            wakeUp = time;
+    };
+    if (!_queue.isEmpty()) {
+        for (auto&& attempt : _connecting) {
+            wakeUpAt(attempt.started + _attemptTimeout);
+        }
+        for (auto&& request : _queue) {
+            if (isBackingOff(request.server))
+                wakeUpAt(_servers.value(request.server).notBefore);
+        }
+    }
+    if (wakeUp >= 0)
+        _dispatchTimer.start(static_cast<int>(std::max<qint64>(wakeUp - now, 0)));
+    else
+        _dispatchTimer.stop();
+
+    updateMetrics(now);
+}
+
+void ConnectionScheduler::updateMetrics(qint64 now)
+{
+    if (!_metricsServer)
+        return;
+
+    uint64_t backedOff = 0;
+    for (auto&& state : _servers) {
+        if (state.notBefore > now)
+            backedOff++;
+    }
+    _metricsServer->connectionQueue(_queue.size(), _connecting.size(), backedOff);
+}
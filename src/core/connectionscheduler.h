@@ -0,0 +1,142 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include "core-export.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+class MetricsServer;
+
+/**
+ * Admits connections to IRC servers a few at a time
+ *
+ * When the core starts, or when an upstream outage ends, every network wants to (re)connect at
+ * once.  Rather than starting all the TLS handshakes, logins and join bursts at the same time,
+ * networks ask the scheduler for permission first, and only a limited number of connections is set
+ * up concurrently.  Networks of users with attached clients go first.
+ *
+ * After failed attempts, further connections to the same server are held back for a while, with
+ * exponential, randomized backoff so the waiting networks don't all return at the same moment.
+ *
+ * The scheduler lives in the main thread, but may be called from any session thread.  Admitted
+ * networks are notified by invoking their startConnection() method through their event loop.
+ */
+class CORE_EXPORT ConnectionScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor
+     *
+     * @param maxConnecting  Maximum number of connections being set up at the same time
+     * @param metricsServer  Metrics server to report the queue state to, if any
+     * @param parent         Parent object
+     */
+    ConnectionScheduler(int maxConnecting, MetricsServer* metricsServer = nullptr, QObject* parent = nullptr);
+
+    /**
+     * Queues a network for connecting
+     *
+     * @param network   The network; startConnection() is invoked on it once admitted
+     * @param server    The server it is going to connect to, as host:port
+     * @param priority  Whether the network should go first, e.g. because its user is watching
+     */
+    void requestAdmission(QObject* network, const QString& server, bool priority);
+
+    /**
+     * Reports the outcome of an admitted connection attempt, freeing its slot
+     *
+     * @param network  The network
+     * @param success  Whether the network is connected and registered now
+     */
+    void finished(QObject* network, bool success);
+
+    /**
+     * Withdraws a network from the queue, or frees its slot without reporting a result
+     *
+     * @param network  The network
+     */
+    void cancel(QObject* network);
+
+    int waiting() const;
+    int connecting() const;
+
+    /**
+     * Computes the time to wait before connecting to a server again
+     *
+     * @param failures  Number of consecutive failed attempts
+     * @param jitter    Random factor in [0, 1), spreading out the retries of different networks
+     * @return The backoff in milliseconds
+     */
+    static qint64 backoff(int failures, double jitter);
+
+private slots:
+    void dispatch();
+
+private:
+    struct Request
+    {
+        QObject* network;
+        QString server;
+        bool priority;
+        qint64 queued;  ///< Time of the request, see _clock
+    };
+
+    struct Attempt
+    {
+        QString server;
+        qint64 started;
+    };
+
+    struct ServerState
+    {
+        int failures{0};
+        qint64 notBefore{0};
+    };
+
+    /// Makes sure dispatch() runs soon; needs to hold the mutex
+    void scheduleDispatch();
+    void updateMetrics(qint64 now);
+
+    const int _maxConnecting;
+    MetricsServer* _metricsServer;
+
+    mutable QMutex _mutex;
+    QList<Request> _queue;
+    QHash<QObject*, Attempt> _connecting;
+    QHash<QString, ServerState> _servers;
+    QElapsedTimer _clock;
+    bool _dispatchPending{false};
+
+    QTimer _dispatchTimer;  ///< For waiting on backoffs and expiring attempts; only used in the scheduler's thread
+
+    static const qint64 _attemptTimeout;
+    static const qint64 _baseBackoff;
+    static const qint64 _maxBackoff;
+};
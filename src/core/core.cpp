@@ -21,6 +21,7 @@
 #include "core.h"
 
 #include <algorithm>
+#include <iterator>
 
 #include <QCoreApplication>
 
@@ -32,6 +33,7 @@
 #include "postgresqlstorage.h"
 #include "quassel.h"
 #include "sqlauthenticator.h"
+#include "sqliteshardedstorage.h"
 #include "sqlitestorage.h"
 #include "types.h"
 #include "util.h"
@@ -40,6 +42,10 @@
 #    include "ldapauthenticator.h"
 #endif
 
+#ifdef HAVE_LIBPQ
+#    include "postgresqlnativestorage.h"
+#endif
+
 // migration related
 #include <QFile>
 #ifdef Q_OS_WIN
@@ -86,6 +92,12 @@ Core::~Core()
 {
     qDeleteAll(_connectingClients);
     qDeleteAll(_sessions);
+    if (_backlogPruner)
+        _backlogPruner->stop();
+    if (_messageLogger)
+        _messageLogger->stop();
+    if (_bufferStateWriter)
+        _bufferStateWriter->stop();
     syncStorage();
 }
 
@@ -217,6 +229,8 @@ void Core::init()
             _metricsServer = new MetricsServer(this);
             _server.setMetricsServer(_metricsServer);
             _v6server.setMetricsServer(_metricsServer);
+            if (_storage)
+                _storage->setMetricsServer(_metricsServer);
         }
 
         Quassel::registerReloadHandler([]() {
@@ -233,6 +247,27 @@ void Core::init()
         _storageSyncTimer.start(10 * 60 * 1000);  // 10 minutes
     }
 
+    // Messages are written on a thread of their own, so sessions don't have to wait for the database
+    _messageLogger = new MessageLogger(Quassel::optionValue("max-commit-latency").toInt(), _metricsServer, this);
+    _messageLogger->start();
+    _bufferStateWriter = new BufferStateWriter(this);
+    _bufferStateWriter->start();
+
+    // Old backlog may be moved out of the database, but remains available to clients
+    _backlogArchive.reset(new BacklogArchive(Quassel::configDirPath() + "backlog-archive"));
+    initBacklogPruner();
+
+    // Don't let all networks connect at once after a restart
+    int maxConnecting = Quassel::optionValue("max-concurrent-connects").toInt();
+    if (maxConnecting > 0) {
+        _connectionScheduler = new ConnectionScheduler(maxConnecting, _metricsServer, this);
+    }
+
+    // Many mostly idle sessions are better off sharing a few threads than having one each
+    if (Quassel::isOptionSet("session-threads")) {
+        _sessionScheduler = new SessionScheduler(Quassel::optionValue("session-threads").toInt(), this);
+    }
+
     connect(&_server, &QTcpServer::newConnection, this, &Core::incomingConnection);
     connect(&_v6server, &QTcpServer::newConnection, this, &Core::incomingConnection);
 
@@ -421,7 +456,11 @@ void Core::registerStorageBackends()
 {
     if (_registeredStorageBackends.empty()) {
         registerStorageBackend<SqliteStorage>();
+        registerStorageBackend<SqliteShardedStorage>();
         registerStorageBackend<PostgreSqlStorage>();
+#ifdef HAVE_LIBPQ
+        registerStorageBackend<PostgreSqlNativeStorage>();
+#endif
     }
 }
 
@@ -470,9 +509,14 @@ bool Core::initStorage(
         // delete all other backends
         _registeredStorageBackends.clear();
         connect(storage.get(), &Storage::bufferInfoUpdated, this, &Core::bufferInfoUpdated);
+        connect(storage.get(), &Storage::userRemoved, this, [this](UserId user) {
+            if (_backlogArchive)
+                _backlogArchive->removeUser(user);
+        });
         break;
     }
     _storage = std::move(storage);
+    _storage->setMetricsServer(_metricsServer);
     return true;
 }
 
@@ -583,6 +627,41 @@ bool Core::reloadCerts()
     return retv4 && retv6;
 }
 
+void Core::initBacklogPruner()
+{
+    RetentionPolicy policy;
+    QString errorString;
+    if (!policy.addRules(Quassel::optionValue("backlog-retention"), &errorString)) {
+        throw ExitException{EXIT_FAILURE, errorString};
+    }
+    if (policy.isEmpty() || !_configured)
+        return;
+
+    int interval = std::max(1, Quassel::optionValue("backlog-prune-interval").toInt());
+    _backlogPruner = new BacklogPruner(std::move(policy), _backlogArchive.get(), interval, this);
+    _backlogPruner->start();
+}
+
+void Core::addArchivedMsgs(UserId user, BufferId bufferId, MsgId first, MsgId last, int limit, std::vector<Message>& messages)
+{
+    if (!_backlogArchive->contains(user, bufferId))
+        return;
+
+    // Archived messages are older than anything left in the database
+    BufferInfo bufferInfo;
+    if (!messages.empty()) {
+        bufferInfo = messages.front().bufferInfo();
+        last = std::min(messages.front().msgId(), messages.back().msgId());
+    }
+    else {
+        bufferInfo = _storage->getBufferInfo(user, bufferId);
+    }
+
+    int remaining = limit == -1 ? -1 : limit - static_cast<int>(messages.size());
+    std::vector<Message> archived = _backlogArchive->requestMsgs(user, bufferInfo, first, last, remaining);
+    messages.insert(messages.end(), std::make_move_iterator(archived.begin()), std::make_move_iterator(archived.end()));
+}
+
 void Core::cacheSysIdent()
 {
     if (isConfigured()) {
@@ -827,7 +906,7 @@ SessionThread* Core::sessionForUser(UserId uid, bool restore)
     if (_sessions.contains(uid))
         return _sessions[uid];
 
-    return (_sessions[uid] = new SessionThread(uid, restore, strictIdentEnabled(), this));
+    return (_sessions[uid] = new SessionThread(uid, restore, strictIdentEnabled(), _sessionScheduler, this));
 }
 
 void Core::socketError(QAbstractSocket::SocketError err, const QString& errorString)
@@ -963,6 +1042,7 @@ bool Core::selectBackend(const QString& backend)
 
     // so we were unable to merge, but let's create a user \o/
     _storage = std::move(storage);
+    _storage->setMetricsServer(_metricsServer);
     createUser();
     return true;
 }
@@ -33,12 +33,18 @@
 #include <QVariant>
 
 #include "authenticator.h"
+#include "backlogarchive.h"
+#include "backlogpruner.h"
 #include "bufferinfo.h"
+#include "bufferstatewriter.h"
+#include "connectionscheduler.h"
 #include "deferredptr.h"
 #include "identserver.h"
 #include "message.h"
+#include "messagelogger.h"
 #include "metricsserver.h"
 #include "oidentdconfiggenerator.h"
+#include "sessionscheduler.h"
 #include "sessionthread.h"
 #include "singleton.h"
 #include "sslserver.h"
@@ -216,7 +222,13 @@ public:
      */
     static inline bool removeNetwork(UserId user, const NetworkId& networkId)
     {
-        return instance()->_storage->removeNetwork(user, networkId);
+        std::vector<BufferId> bufferIds = instance()->_storage->requestBufferIdsForNetwork(user, networkId);
+        if (!instance()->_storage->removeNetwork(user, networkId))
+            return false;
+        for (auto&& bufferId : bufferIds) {
+            instance()->_backlogArchive->removeBuffer(user, bufferId);
+        }
+        return true;
     }
 
     //! Returns a list of all NetworkInfos for the given UserId user
@@ -377,21 +389,28 @@ public:
         return instance()->_storage->getBufferInfo(user, bufferId);
     }
 
-    //! Store a Message in the storage backend and set it's unique Id.
+    //! Store a list of Messages in the storage backend and set their unique Id.
     /** \note This method is threadsafe.
      *
-     *  \param message The message object to be stored
+     *  \param messages The list message objects to be stored
      *  \return true on success
      */
-    static inline bool storeMessage(Message& message) { return instance()->_storage->logMessage(message); }
+    static inline bool storeMessages(MessageList& messages) { return instance()->_storage->logMessages(messages); }
 
-    //! Store a list of Messages in the storage backend and set their unique Id.
+    //! Queue a list of Messages to be stored by the message logger thread.
     /** \note This method is threadsafe.
      *
+     *  Once stored, the messages are posted back to \p receiver in a MessagesLoggedEvent.
      *  \param messages The list message objects to be stored
-     *  \return true on success
+     *  \param receiver The object to deliver the stored messages to
      */
-    static inline bool storeMessages(MessageList& messages) { return instance()->_storage->logMessages(messages); }
+    static inline void logMessages(MessageList messages, QObject* receiver)
+    {
+        instance()->_messageLogger->logMessages(std::move(messages), receiver);
+    }
+
+    //! Stop delivering stored messages to \p receiver, which is about to be destroyed.
+    static inline void removeMessageReceiver(QObject* receiver) { instance()->_messageLogger->removeReceiver(receiver); }
 
     //! Request a certain number messages stored in a given buffer.
     /** \param buffer   The buffer we request messages from
@@ -402,7 +421,10 @@ public:
      */
     static inline std::vector<Message> requestMsgs(UserId user, BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1)
     {
-        return instance()->_storage->requestMsgs(user, bufferId, first, last, limit);
+        std::vector<Message> messages = instance()->_storage->requestMsgs(user, bufferId, first, last, limit);
+        if (limit == -1 || static_cast<int>(messages.size()) < limit)
+            instance()->addArchivedMsgs(user, bufferId, first, last, limit, messages);
+        return messages;
     }
 
     //! Request a certain number messages stored in a given buffer, matching certain filters
@@ -472,6 +494,68 @@ public:
         return instance()->_storage->requestAllMsgsFiltered(user, first, last, limit, type, flags);
     }
 
+    //! Search the backlog of a user
+    /** \param query     Words that have to appear in the message text, may be empty if sender is given
+     *  \param networkId if valid, only search buffers of this network
+     *  \param bufferId  if valid, only search this buffer
+     *  \param sender    Words that have to appear in the sender, may be empty
+     *  \param type      The Message::Types that should be returned
+     *  \param start     if valid, return only messages sent at or after this time
+     *  \param end       if valid, return only messages sent before this time
+     *  \param last      if != -1 return only messages with a MsgId < last
+     *  \param limit     Max amount of messages
+     *  \return The matching messages, newest first
+     */
+    static inline std::vector<Message> searchMsgs(UserId user,
+                                                  const QString& query,
+                                                  NetworkId networkId,
+                                                  BufferId bufferId,
+                                                  const QString& sender,
+                                                  Message::Types type,
+                                                  const QDateTime& start,
+                                                  const QDateTime& end,
+                                                  MsgId last,
+                                                  int limit)
+    {
+        return instance()->_storage->searchMsgs(user, query, networkId, bufferId, sender, type, start, end, last, limit);
+    }
+
+    //! Request the oldest messages of a buffer that were sent before a given time
+    /** \note This method is threadsafe.
+     *
+     *  \param user       The owner of the buffer
+     *  \param bufferInfo The buffer we request messages from
+     *  \param before     Return only messages with a timestamp < before
+     *  \param limit      Max amount of messages
+     *  \return The expired messages, oldest first
+     */
+    static inline std::vector<Message> requestExpiredMsgs(UserId user, const BufferInfo& bufferInfo, const QDateTime& before, int limit)
+    {
+        return instance()->_storage->requestExpiredMsgs(user, bufferInfo, before, limit);
+    }
+
+    //! Delete a batch of the oldest messages of a buffer that were sent before a given time
+    /** \note This method is threadsafe.
+     *
+     *  \param user       The owner of the buffer
+     *  \param bufferId   The buffer to delete messages from
+     *  \param before     Delete only messages with a timestamp < before
+     *  \param last       if != -1 delete only messages with a MsgId <= last
+     *  \param limit      Max amount of messages to delete
+     *  \return The number of deleted messages, or -1 on error
+     */
+    static inline int deleteExpiredMsgs(UserId user, BufferId bufferId, const QDateTime& before, MsgId last, int limit)
+    {
+        return instance()->_storage->deleteExpiredMsgs(user, bufferId, before, last, limit);
+    }
+
+    //! Fetch the names of all core users
+    /** \note This method is threadsafe.
+     *
+     *  \return Map of all current UserIds to their user names
+     */
+    static inline QMap<UserId, QString> userNames() { return instance()->_storage->getAllAuthUserNames(); }
+
     //! Request a list of all buffers known to a user.
     /** This method is used to get a list of all buffers we have stored a backlog from.
      *  \note This method is threadsafe.
@@ -503,7 +587,10 @@ public:
      */
     static inline bool removeBuffer(const UserId& user, const BufferId& bufferId)
     {
-        return instance()->_storage->removeBuffer(user, bufferId);
+        if (!instance()->_storage->removeBuffer(user, bufferId))
+            return false;
+        instance()->_backlogArchive->removeBuffer(user, bufferId);
+        return true;
     }
 
     //! Rename a Buffer
@@ -527,7 +614,12 @@ public:
      */
     static inline bool mergeBuffersPermanently(const UserId& user, const BufferId& bufferId1, const BufferId& bufferId2)
     {
-        return instance()->_storage->mergeBuffersPermanently(user, bufferId1, bufferId2);
+        if (!instance()->_storage->mergeBuffersPermanently(user, bufferId1, bufferId2))
+            return false;
+        // The buffers are merged in the database already, so the archive must not make the merge look failed
+        if (!instance()->_backlogArchive->mergeBuffers(user, bufferId1, bufferId2))
+            qWarning() << "Could not merge the backlog archive of buffer" << bufferId2 << "into buffer" << bufferId1 << "for user" << user;
+        return true;
     }
 
     //! Update the LastSeenDate for a Buffer
@@ -543,6 +635,28 @@ public:
         return instance()->_storage->setBufferLastSeenMsg(user, bufferId, msgId);
     }
 
+    //! Store changes to the state of several buffers at once
+    /** \note This method is threadsafe.
+     *
+     * \param user    The Owner of the buffers
+     * \param states  The changes, at most one per buffer
+     */
+    static inline void setBufferStates(UserId user, const std::vector<Storage::BufferState>& states)
+    {
+        return instance()->_storage->setBufferStates(user, states);
+    }
+
+    //! Queue changes to the state of several buffers, to be stored in the background
+    /** \note This method is threadsafe.
+     *
+     * \param user    The Owner of the buffers
+     * \param states  The changes
+     */
+    static inline void storeBufferStates(UserId user, const std::vector<Storage::BufferState>& states)
+    {
+        instance()->_bufferStateWriter->store(user, states);
+    }
+
     //! Get a usable sysident for the given user in oidentd-strict mode
     /** \param user    The user to retrieve the sysident for
      *  \return The authusername
@@ -678,6 +792,7 @@ public:
     inline OidentdConfigGenerator* oidentdConfigGenerator() const { return _oidentdConfigGenerator; }
     inline IdentServer* identServer() const { return _identServer; }
     inline MetricsServer* metricsServer() const { return _metricsServer; }
+    inline ConnectionScheduler* connectionScheduler() const { return _connectionScheduler; }
 
     static const int AddClientEventId;
 
@@ -753,6 +868,10 @@ private slots:
 
 private:
     SessionThread* sessionForUser(UserId userId, bool restoreState = false);
+    /// Appends archived messages older than the given ones, if the database didn't have enough
+    void addArchivedMsgs(UserId user, BufferId bufferId, MsgId first, MsgId last, int limit, std::vector<Message>& messages);
+    /// Starts the backlog pruner if a retention policy has been configured
+    void initBacklogPruner();
     void addClientHelper(RemotePeer* peer, UserId uid);
     // void processCoreSetup(QTcpSocket *socket, QVariantMap &msg);
     QString setupCoreForInternalUsage();
@@ -805,6 +924,12 @@ private:
 
     IdentServer* _identServer{nullptr};
     MetricsServer* _metricsServer{nullptr};
+    MessageLogger* _messageLogger{nullptr};
+    BufferStateWriter* _bufferStateWriter{nullptr};
+    std::unique_ptr<BacklogArchive> _backlogArchive;
+    BacklogPruner* _backlogPruner{nullptr};
+    SessionScheduler* _sessionScheduler{nullptr};
+    ConnectionScheduler* _connectionScheduler{nullptr};
 
     bool _initialized{false};
     bool _configured{false};
@@ -90,6 +90,7 @@ void CoreAuthHandler::onReadyRead()
                                                        this,
                                                        socket(),
                                                        Compressor::NoCompression,
+                                                       Compressor::Deflate,
                                                        this);
             connect(peer, &RemotePeer::protocolVersionMismatch, this, &CoreAuthHandler::onProtocolVersionMismatch);
             setPeer(peer);
@@ -101,8 +102,14 @@ void CoreAuthHandler::onReadyRead()
         // figure out which connection features we'll use based on the client's support
         if (Core::sslSupported() && (features & Protocol::Encryption))
             _connectionFeatures |= Protocol::Encryption;
-        if (features & Protocol::Compression)
+        if (features & Protocol::Compression) {
             _connectionFeatures |= Protocol::Compression;
+            if ((features & Protocol::ZstdCompression) && Compressor::isAvailable(Compressor::Zstd)) {
+                _connectionFeatures |= Protocol::ZstdCompression;
+                if (features & Protocol::ZstdDictionary)
+                    _connectionFeatures |= Protocol::ZstdDictionary;
+            }
+        }
 
         socket()->read((char*)&magic, 4);  // read the 4 bytes we've just peeked at
     }
@@ -124,7 +131,13 @@ void CoreAuthHandler::onReadyRead()
             else
                 level = Compressor::NoCompression;
 
-            RemotePeer* peer = PeerFactory::createPeer(_supportedProtos, this, socket(), level, this);
+            Compressor::Algorithm algorithm = Compressor::Deflate;
+            if (_connectionFeatures & Protocol::ZstdDictionary)
+                algorithm = Compressor::ZstdWithDictionary;
+            else if (_connectionFeatures & Protocol::ZstdCompression)
+                algorithm = Compressor::Zstd;
+
+            RemotePeer* peer = PeerFactory::createPeer(_supportedProtos, this, socket(), level, algorithm, this);
             if (!peer) {
                 qWarning() << "Received invalid handshake data from client" << hostAddress().toString();
                 close();
@@ -27,14 +27,29 @@
 
 #include "core.h"
 #include "coresession.h"
+#include "remotepeer.h"
+#include "signalproxy.h"
+
+const int CoreBacklogManager::_streamChunkSize = 500;
+const qint64 CoreBacklogManager::_maxPendingBytes = 1024 * 1024;
+const int CoreBacklogManager::_congestionInterval = 20;
+const int CoreBacklogManager::_maxSearchResults = 1000;
 
 CoreBacklogManager::CoreBacklogManager(CoreSession* coreSession)
     : BacklogManager(coreSession)
     , _coreSession(coreSession)
-{}
+{
+    if (Core::instance()->metricsServer()) {
+        _requestDuration = &Core::instance()->metricsServer()->backlogRequestDuration();
+    }
+
+    _streamTimer.setParent(this);
+    connect(&_streamTimer, &QTimer::timeout, this, &CoreBacklogManager::sendBacklogChunks);
+}
 
 QVariantList CoreBacklogManager::requestBacklog(BufferId bufferId, MsgId first, MsgId last, int limit, int additional)
 {
+    MetricsTimer timer(_requestDuration);
     QVariantList backlog;
     auto msgList = Core::requestMsgs(coreSession()->user(), bufferId, first, last, limit);
 
@@ -73,6 +88,7 @@ QVariantList CoreBacklogManager::requestBacklog(BufferId bufferId, MsgId first,
 
 QVariantList CoreBacklogManager::requestBacklogFiltered(BufferId bufferId, MsgId first, MsgId last, int limit, int additional, int type, int flags)
 {
+    MetricsTimer timer(_requestDuration);
     QVariantList backlog;
     auto msgList = Core::requestMsgsFiltered(coreSession()->user(), bufferId, first, last, limit, Message::Types{type}, Message::Flags{flags});
 
@@ -111,6 +127,7 @@ QVariantList CoreBacklogManager::requestBacklogFiltered(BufferId bufferId, MsgId
 
 QVariantList CoreBacklogManager::requestBacklogForward(BufferId bufferId, MsgId first, MsgId last, int limit, int type, int flags)
 {
+    MetricsTimer timer(_requestDuration);
     QVariantList backlog;
     auto msgList = Core::requestMsgsForward(coreSession()->user(), bufferId, first, last, limit, Message::Types{type}, Message::Flags{flags});
 
@@ -123,6 +140,7 @@ QVariantList CoreBacklogManager::requestBacklogForward(BufferId bufferId, MsgId
 
 QVariantList CoreBacklogManager::requestBacklogAll(MsgId first, MsgId last, int limit, int additional)
 {
+    MetricsTimer timer(_requestDuration);
     QVariantList backlog;
     auto msgList = Core::requestAllMsgs(coreSession()->user(), first, last, limit);
 
@@ -154,6 +172,7 @@ QVariantList CoreBacklogManager::requestBacklogAll(MsgId first, MsgId last, int
 
 QVariantList CoreBacklogManager::requestBacklogAllFiltered(MsgId first, MsgId last, int limit, int additional, int type, int flags)
 {
+    MetricsTimer timer(_requestDuration);
     QVariantList backlog;
     auto msgList = Core::requestAllMsgsFiltered(coreSession()->user(), first, last, limit, Message::Types{type}, Message::Flags{flags});
 
@@ -182,3 +201,145 @@ QVariantList CoreBacklogManager::requestBacklogAllFiltered(MsgId first, MsgId la
 
     return backlog;
 }
+
+QVariantList CoreBacklogManager::requestBacklogSearch(
+    QString query, NetworkId networkId, BufferId bufferId, QString sender, int type, QDateTime start, QDateTime end, MsgId last, int limit)
+{
+    MetricsTimer timer(_requestDuration);
+    QVariantList results;
+    if (query.trimmed().isEmpty() && sender.trimmed().isEmpty())
+        return results;
+
+    limit = searchResultLimit(limit);
+    auto msgList = Core::searchMsgs(coreSession()->user(), query, networkId, bufferId, sender, Message::Types{type}, start, end, last, limit);
+    std::transform(msgList.cbegin(), msgList.cend(), std::back_inserter(results), [](auto&& msg) {
+        return QVariant::fromValue(msg);
+    });
+
+    return results;
+}
+
+int CoreBacklogManager::searchResultLimit(int limit)
+{
+    // Searches may match a large part of the backlog, so results are always paginated
+    if (limit <= 0 || limit > _maxSearchResults)
+        return _maxSearchResults;
+    return limit;
+}
+
+void CoreBacklogManager::requestBacklogStreamed(BufferId bufferId, MsgId first, MsgId last, int limit, int additional)
+{
+    Peer* peer = coreSession()->signalProxy()->sourcePeer();
+    if (!peer) {
+        qWarning() << "CoreBacklogManager::requestBacklogStreamed(): no peer to stream backlog to";
+        return;
+    }
+
+    // Same conditions for fetching additional messages as in requestBacklog() and requestBacklogAll()
+    if (bufferId.isValid() && limit == 0)
+        additional = 0;
+
+    _streams.push_back(BacklogStream{peer, bufferId, first, last, limit, additional, false, first, false});
+    if (!_streamTimer.isActive())
+        _streamTimer.start(0);
+}
+
+void CoreBacklogManager::sendBacklogChunks()
+{
+    bool sent = false;
+    for (auto it = _streams.begin(); it != _streams.end();) {
+        if (!it->peer || !it->peer->isOpen()) {
+            it = _streams.erase(it);
+            continue;
+        }
+        if (isCongested(it->peer)) {
+            ++it;
+            continue;
+        }
+
+        sent = true;
+        if (sendBacklogChunk(*it))
+            ++it;
+        else
+            it = _streams.erase(it);
+    }
+
+    if (_streams.empty())
+        _streamTimer.stop();
+    else
+        // If every client is still busy receiving, check back later instead of spinning
+        _streamTimer.start(sent ? 0 : _congestionInterval);
+}
+
+bool CoreBacklogManager::sendBacklogChunk(BacklogStream& stream)
+{
+    const int chunkSize = stream.nextChunkSize(_streamChunkSize);
+
+    std::vector<Message> msgList;
+    if (chunkSize > 0) {
+        if (stream.bufferId.isValid())
+            msgList = Core::requestMsgs(coreSession()->user(), stream.bufferId, stream.first, stream.last, chunkSize);
+        else
+            msgList = Core::requestAllMsgs(coreSession()->user(), stream.first, stream.last, chunkSize);
+    }
+
+    QVariantList chunk;
+    std::transform(msgList.cbegin(), msgList.cend(), std::back_inserter(chunk), [](auto&& msg) {
+        return QVariant::fromValue(msg);
+    });
+
+    bool complete = stream.advance(msgList, chunkSize);
+    if (!chunk.isEmpty() || complete) {
+        coreSession()->signalProxy()->restrictTargetPeers(stream.peer.data(), [&] {
+            receiveBacklogChunk(stream.bufferId, chunk, complete);
+        });
+    }
+    return !complete;
+}
+
+int CoreBacklogManager::BacklogStream::nextChunkSize(int maxChunkSize) const
+{
+    return remaining == -1 ? maxChunkSize : std::min(remaining, maxChunkSize);
+}
+
+bool CoreBacklogManager::BacklogStream::advance(const std::vector<Message>& messages, int chunkSize)
+{
+    if (!messages.empty()) {
+        // Continue before the oldest message of this chunk
+        MsgId oldestMessage = std::min(messages.front().msgId(), messages.back().msgId());
+        last = oldestMessage;
+        if (!fetchingAdditional) {
+            oldestSent = oldestMessage;
+            sentAny = true;
+        }
+        if (remaining != -1)
+            remaining -= static_cast<int>(messages.size());
+    }
+
+    if (static_cast<int>(messages.size()) < chunkSize || remaining == 0) {
+        if (!fetchingAdditional && additional) {
+            MsgId additionalLast;
+            if (first != -1)
+                additionalLast = first;
+            else
+                additionalLast = sentAny ? oldestSent : MsgId(-1);
+
+            // For a single buffer, only fetch additional messages if they continue seamlessly
+            if (!bufferId.isValid() || additionalLast == oldestSent) {
+                first = -1;
+                last = additionalLast;
+                remaining = additional;
+                fetchingAdditional = true;
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool CoreBacklogManager::isCongested(Peer* peer)
+{
+    auto* remotePeer = qobject_cast<RemotePeer*>(peer);
+    return remotePeer && remotePeer->socket() && remotePeer->socket()->bytesToWrite() > _maxPendingBytes;
+}
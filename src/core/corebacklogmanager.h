@@ -20,9 +20,18 @@
 
 #pragma once
 
+#include <list>
+#include <vector>
+
+#include <QPointer>
+#include <QTimer>
+
 #include "backlogmanager.h"
+#include "message.h"
 
 class CoreSession;
+class MetricsHistogram;
+class Peer;
 
 class CoreBacklogManager : public BacklogManager
 {
@@ -43,6 +52,73 @@ public slots:
     QVariantList requestBacklogAllFiltered(
         MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0, int type = -1, int flags = -1) override;
 
+    void requestBacklogStreamed(BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0) override;
+
+    QVariantList requestBacklogSearch(QString query,
+                                      NetworkId networkId = {},
+                                      BufferId bufferId = {},
+                                      QString sender = {},
+                                      int type = -1,
+                                      QDateTime start = {},
+                                      QDateTime end = {},
+                                      MsgId last = -1,
+                                      int limit = -1) override;
+
+protected:
+    /// @returns the number of results to fetch for a search asking for @p limit, which is capped to keep results paginated
+    static int searchResultLimit(int limit);
+
+    /**
+     * State of a backlog request answered by requestBacklogStreamed()
+     *
+     * Messages are fetched newest first, a chunk at a time, continuing before the oldest message
+     * sent so far.  Once the limit is reached, additional messages are fetched the same way, like
+     * requestBacklog() does.
+     */
+    struct BacklogStream
+    {
+        QPointer<Peer> peer;
+        BufferId bufferId;       ///< Invalid for all buffers
+        MsgId first;
+        MsgId last;
+        int remaining;           ///< Messages left to fetch in the current phase, or -1 for no limit
+        int additional;
+        bool fetchingAdditional;
+        MsgId oldestSent;        ///< Oldest message sent in the first phase
+        bool sentAny;
+
+        /// @returns the number of messages to fetch for the next chunk, at most @p maxChunkSize
+        int nextChunkSize(int maxChunkSize) const;
+
+        /**
+         * Continues the stream after a chunk has been fetched
+         *
+         * @param messages   The messages fetched, newest first
+         * @param chunkSize  The number of messages that were asked for
+         * @return true if this was the final chunk of the stream
+         */
+        bool advance(const std::vector<Message>& messages, int chunkSize);
+    };
+
+private slots:
+    /// Sends the next chunk of every stream whose peer is ready for more data
+    void sendBacklogChunks();
+
 private:
+    /// Fetches and sends the next chunk of the stream, returning false if the stream is done
+    bool sendBacklogChunk(BacklogStream& stream);
+
+    /// @returns whether the peer has too much data waiting to be written to accept another chunk
+    static bool isCongested(Peer* peer);
+
     CoreSession* _coreSession;
+    MetricsHistogram* _requestDuration{nullptr};
+
+    std::list<BacklogStream> _streams;
+    QTimer _streamTimer;
+
+    static const int _streamChunkSize;
+    static const qint64 _maxPendingBytes;
+    static const int _congestionInterval;
+    static const int _maxSearchResults;
 };
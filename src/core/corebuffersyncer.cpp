@@ -30,6 +30,71 @@
 #include "ircchannel.h"
 #include "util.h"
 
+UnreadTracker::UnreadTracker(MsgId since, int maxHighlights)
+    : _since(since)
+    , _newest(since)
+    , _maxHighlights(maxHighlights)
+{}
+
+void UnreadTracker::addActivity(MsgId msgId, Message::Type type)
+{
+    if (msgId <= _since)
+        return;
+
+    _newest = std::max(_newest, msgId);
+    for (size_t bit = 0; bit < _lastMsgOfType.size(); bit++) {
+        if ((type & (1u << bit)) && _lastMsgOfType[bit] < msgId)
+            _lastMsgOfType[bit] = msgId;
+    }
+}
+
+void UnreadTracker::addHighlight(MsgId msgId)
+{
+    if (msgId <= _since)
+        return;
+
+    _newest = std::max(_newest, msgId);
+    if (_highlights.empty() || _highlights.back() < msgId) {
+        _highlights.push_back(msgId);
+    }
+    else {
+        auto it = std::lower_bound(_highlights.begin(), _highlights.end(), msgId);
+        if (*it != msgId)
+            _highlights.insert(it, msgId);
+    }
+
+    while (_highlights.size() > static_cast<size_t>(_maxHighlights)) {
+        // Anything up to the dropped highlight is out of reach now
+        _since = _highlights.front();
+        _highlights.pop_front();
+    }
+}
+
+int UnreadTracker::activity(MsgId lastSeen) const
+{
+    int activity = 0;
+    for (size_t bit = 0; bit < _lastMsgOfType.size(); bit++) {
+        if (lastSeen < _lastMsgOfType[bit])
+            activity |= static_cast<int>(1u << bit);
+    }
+    return activity;
+}
+
+int UnreadTracker::highlightCount(MsgId lastSeen) const
+{
+    return static_cast<int>(std::distance(std::upper_bound(_highlights.begin(), _highlights.end(), lastSeen), _highlights.end()));
+}
+
+void UnreadTracker::setLastSeen(MsgId lastSeen)
+{
+    if (lastSeen <= _since)
+        return;
+
+    _since = lastSeen;
+    _newest = std::max(_newest, lastSeen);
+    _highlights.erase(_highlights.begin(), std::upper_bound(_highlights.begin(), _highlights.end(), lastSeen));
+}
+
 class PurgeEvent : public QEvent
 {
 public:
@@ -55,8 +120,19 @@ CoreBufferSyncer::CoreBufferSyncer(CoreSession* parent)
 void CoreBufferSyncer::requestSetLastSeenMsg(BufferId buffer, const MsgId& msgId)
 {
     if (setLastSeenMsg(buffer, msgId)) {
-        int activity = Core::bufferActivity(buffer, msgId);
-        int highlightCount = Core::highlightCount(buffer, msgId);
+        UnreadTracker& tracker = unreadTracker(buffer);
+        int activity;
+        int highlightCount;
+        if (tracker.covers(msgId)) {
+            activity = tracker.activity(msgId);
+            highlightCount = tracker.highlightCount(msgId);
+            tracker.setLastSeen(msgId);
+        }
+        else {
+            // The new last seen message predates what we've been tracking, so we need to ask the database
+            activity = Core::bufferActivity(buffer, msgId);
+            highlightCount = Core::highlightCount(buffer, msgId);
+        }
 
         setBufferActivity(buffer, activity);
         setHighlightCount(buffer, highlightCount);
@@ -73,32 +149,56 @@ void CoreBufferSyncer::requestSetMarkerLine(BufferId buffer, const MsgId& msgId)
 
 void CoreBufferSyncer::storeDirtyIds()
 {
-    UserId userId = _coreSession->user();
-    MsgId msgId;
-    foreach (BufferId bufferId, dirtyLastSeenBuffers) {
-        msgId = lastSeenMsg(bufferId);
-        if (msgId.isValid())
-            Core::setBufferLastSeenMsg(userId, bufferId, msgId);
+    // Coalesce all changes to a buffer, so it's only updated once
+    QHash<BufferId, Storage::BufferState> states;
+    auto stateOf = [&states](BufferId bufferId) -> Storage::BufferState& {
+        Storage::BufferState& state = states[bufferId];
+        state.bufferId = bufferId;
+        return state;
+    };
+
+    for (BufferId bufferId : dirtyLastSeenBuffers) {
+        MsgId msgId = lastSeenMsg(bufferId);
+        if (msgId.isValid()) {
+            Storage::BufferState& state = stateOf(bufferId);
+            state.lastSeenMsg = msgId;
+            state.fields |= Storage::BufferState::LastSeenMsg;
+        }
     }
 
-    foreach (BufferId bufferId, dirtyMarkerLineBuffers) {
-        msgId = markerLine(bufferId);
-        if (msgId.isValid())
-            Core::setBufferMarkerLineMsg(userId, bufferId, msgId);
+    for (BufferId bufferId : dirtyMarkerLineBuffers) {
+        MsgId msgId = markerLine(bufferId);
+        if (msgId.isValid()) {
+            Storage::BufferState& state = stateOf(bufferId);
+            state.markerLineMsg = msgId;
+            state.fields |= Storage::BufferState::MarkerLineMsg;
+        }
     }
 
-    foreach (BufferId bufferId, dirtyActivities) {
-        Core::setBufferActivity(userId, bufferId, activity(bufferId));
+    for (BufferId bufferId : dirtyActivities) {
+        Storage::BufferState& state = stateOf(bufferId);
+        state.activity = activity(bufferId);
+        state.fields |= Storage::BufferState::Activity;
     }
 
-    foreach (BufferId bufferId, dirtyHighlights) {
-        Core::setHighlightCount(userId, bufferId, highlightCount(bufferId));
+    for (BufferId bufferId : dirtyHighlights) {
+        Storage::BufferState& state = stateOf(bufferId);
+        state.highlightCount = highlightCount(bufferId);
+        state.fields |= Storage::BufferState::HighlightCount;
     }
 
     dirtyLastSeenBuffers.clear();
     dirtyMarkerLineBuffers.clear();
     dirtyActivities.clear();
     dirtyHighlights.clear();
+
+    // Written in the background, in one transaction
+    std::vector<Storage::BufferState> changes;
+    changes.reserve(states.size());
+    for (auto&& change : states) {
+        changes.push_back(change);
+    }
+    Core::storeBufferStates(_coreSession->user(), changes);
 }
 
 void CoreBufferSyncer::removeBuffer(BufferId bufferId)
@@ -126,8 +226,10 @@ void CoreBufferSyncer::removeBuffer(BufferId bufferId)
             return;
         }
     }
-    if (Core::removeBuffer(_coreSession->user(), bufferId))
+    if (Core::removeBuffer(_coreSession->user(), bufferId)) {
+        _unreadTrackers.remove(bufferId);
         BufferSyncer::removeBuffer(bufferId);
+    }
 }
 
 void CoreBufferSyncer::renameBuffer(BufferId bufferId, QString newName)
@@ -165,6 +267,10 @@ void CoreBufferSyncer::mergeBuffersPermanently(BufferId bufferId1, BufferId buff
     }
 
     if (Core::mergeBuffersPermanently(_coreSession->user(), bufferId1, bufferId2)) {
+        // We don't know the details of the messages moved into the first buffer, so start over after them
+        MsgId newest = std::max(unreadTracker(bufferId1).newest(), unreadTracker(bufferId2).newest());
+        _unreadTrackers.remove(bufferId2);
+        _unreadTrackers.insert(bufferId1, UnreadTracker(newest));
         BufferSyncer::mergeBuffersPermanently(bufferId1, bufferId2);
     }
 }
@@ -198,11 +304,22 @@ void CoreBufferSyncer::purgeBufferIds()
     QSet<BufferId> storedIds = toQSet(lastSeenBufferIds()) + toQSet(markerLineBufferIds());
     foreach (BufferId bufferId, storedIds) {
         if (actualBuffers.find(bufferId) == actualBuffers.end()) {
+            _unreadTrackers.remove(bufferId);
             BufferSyncer::removeBuffer(bufferId);
         }
     }
 }
 
+UnreadTracker& CoreBufferSyncer::unreadTracker(BufferId buffer)
+{
+    auto it = _unreadTrackers.find(buffer);
+    if (it == _unreadTrackers.end()) {
+        // Messages stored before the session started are only known to the database
+        it = _unreadTrackers.insert(buffer, UnreadTracker(lastMsg(buffer)));
+    }
+    return it.value();
+}
+
 void CoreBufferSyncer::setBufferActivity(BufferId buffer, int activity)
 {
     BufferSyncer::setBufferActivity(buffer, activity);
@@ -20,10 +20,60 @@
 
 #pragma once
 
+#include "core-export.h"
+
+#include <array>
+#include <deque>
+
 #include "buffersyncer.h"
 
 class CoreSession;
 
+/**
+ * Keeps track of the unread activity and highlights of a single buffer
+ *
+ * Knows about all messages stored after a given message ID, so that activity and highlight count can be
+ * determined for a new last seen message without scanning the backlog, as long as it is not older than that.
+ */
+class CORE_EXPORT UnreadTracker
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param since          Newest message not tracked, i.e. all messages with a greater ID will be added
+     * @param maxHighlights  Maximum number of highlights to keep, older ones are dropped and no longer covered
+     */
+    explicit UnreadTracker(MsgId since = {}, int maxHighlights = 1000);
+
+    /// Newest message not accounted for; results are only available for last seen messages at least this new
+    MsgId since() const { return _since; }
+
+    /// The newest message ID seen so far, or since() if there is none
+    MsgId newest() const { return _newest; }
+
+    bool covers(MsgId lastSeen) const { return lastSeen >= _since; }
+
+    void addActivity(MsgId msgId, Message::Type type);
+    void addHighlight(MsgId msgId);
+
+    /// Activity of messages newer than lastSeen, only valid if covers(lastSeen)
+    int activity(MsgId lastSeen) const;
+
+    /// Number of highlights newer than lastSeen, only valid if covers(lastSeen)
+    int highlightCount(MsgId lastSeen) const;
+
+    /// Forgets about messages up to lastSeen, as they can no longer become unread
+    void setLastSeen(MsgId lastSeen);
+
+private:
+    MsgId _since;
+    MsgId _newest;
+    int _maxHighlights;
+    std::array<MsgId, 32> _lastMsgOfType{};  ///< Newest message for each bit of Message::Type
+    std::deque<MsgId> _highlights;            ///< Ascending
+};
+
 class CoreBufferSyncer : public BufferSyncer
 {
     Q_OBJECT
@@ -44,6 +94,8 @@ public slots:
             // Don't update buffer activity with messages that are ignored
             return;
         }
+        if (!message.flags().testFlag(Message::Flag::Self))
+            unreadTracker(message.bufferId()).addActivity(message.msgId(), message.type());
         auto oldActivity = activity(message.bufferId());
         if (!oldActivity.testFlag(message.type())) {
             setBufferActivity(message.bufferId(), (int)(oldActivity | message.type()));
@@ -58,6 +110,7 @@ public slots:
         }
         auto oldHighlightCount = highlightCount(message.bufferId());
         if (message.flags().testFlag(Message::Flag::Highlight) && !message.flags().testFlag(Message::Flag::Self)) {
+            unreadTracker(message.bufferId()).addHighlight(message.msgId());
             setHighlightCount(message.bufferId(), oldHighlightCount + 1);
         }
     }
@@ -96,5 +149,9 @@ private:
     QSet<BufferId> dirtyActivities;
     QSet<BufferId> dirtyHighlights;
 
+    /// Unread state of buffers, so moving the last seen message doesn't need to scan the backlog
+    QHash<BufferId, UnreadTracker> _unreadTrackers;
+
+    UnreadTracker& unreadTracker(BufferId buffer);
     void purgeBufferIds();
 };
@@ -74,7 +74,7 @@ void CoreIdentity::setSslCert(const QByteArray& encoded)
 // ========================================
 
 CoreCertManager::CoreCertManager(CoreIdentity* identity)
-    : CertManager(identity->id())
+    : CertManager(identity->id(), identity)
     , _identity(identity)
 {
     setAllowClientUpdates(true);
@@ -20,8 +20,14 @@
 
 #include "coreignorelistmanager.h"
 
+#include <algorithm>
+
+#include <QElapsedTimer>
+#include <QRegularExpression>
+
 #include "core.h"
 #include "coresession.h"
+#include "util.h"
 
 CoreIgnoreListManager::CoreIgnoreListManager(CoreSession* parent)
     : IgnoreListManager(parent)
@@ -33,6 +39,10 @@ CoreIgnoreListManager::CoreIgnoreListManager(CoreSession* parent)
         return;
     }
 
+    if (Core::instance()->metricsServer()) {
+        _userMetrics = Core::instance()->metricsServer()->userMetrics(session->user());
+    }
+
     initSetIgnoreList(Core::getUserSetting(session->user(), "IgnoreList").toMap());
 
     // we store our settings whenever they change
@@ -44,8 +54,167 @@ CoreIgnoreListManager::CoreIgnoreListManager(CoreSession* parent)
 
 IgnoreListManager::StrictnessType CoreIgnoreListManager::match(const RawMessage& rawMsg, const QString& networkName)
 {
-    // StrictnessType _match(const QString &msgContents, const QString &msgSender, Message::Type msgType, const QString &network, const QString &bufferName);
-    return _match(rawMsg.text, rawMsg.sender, rawMsg.type, networkName, rawMsg.target);
+    if (!(rawMsg.type & (Message::Plain | Message::Notice | Message::Action)))
+        return UnmatchedStrictness;
+
+    QElapsedTimer timer;
+    if (_userMetrics)
+        timer.start();
+
+    buildIndex();
+
+    // Gather the rules that may apply, and evaluate them in list order so the first matching rule wins
+    QVector<int> candidates = _scanned;
+    candidates += _bySender.value(rawMsg.sender.toCaseFolded());
+    candidates += _byNetwork.value(networkName.toCaseFolded());
+    candidates += _byChannel.value(rawMsg.target.toCaseFolded());
+    std::sort(candidates.begin(), candidates.end());
+
+    StrictnessType result = UnmatchedStrictness;
+    QString strippedContents;
+    bool contentsStripped = false;
+    int evaluated = 0;
+    for (int index : candidates) {
+        const IndexedRule& rule = _rules[index];
+        evaluated++;
+        // Rules found through their literal scope or sender don't need to check it again
+        if (!rule.scopeMatchesAlways) {
+            const QString& scopeName = rule.isChannelScope ? rawMsg.target : networkName;
+            if (!rule.scopeMatch.match(scopeName))
+                continue;
+        }
+        if (!rule.senderIndexed) {
+            if (rule.isSenderRule) {
+                if (!rule.contentsMatch.match(rawMsg.sender))
+                    continue;
+            }
+            else {
+                if (!contentsStripped) {
+                    // TODO: Make this configurable?  Pre-0.14, format codes were not removed
+                    strippedContents = stripFormatCodes(rawMsg.text);
+                    contentsStripped = true;
+                }
+                if (!rule.contentsMatch.match(strippedContents))
+                    continue;
+            }
+        }
+        result = rule.strictness;
+        break;
+    }
+
+    if (_userMetrics) {
+        _userMetrics->ignoreChecks.add(1);
+        _userMetrics->ignoreRuleEvaluations.add(evaluated);
+        _userMetrics->ignoreMatchDuration.add(timer.nsecsElapsed());
+    }
+
+    return result;
+}
+
+void CoreIgnoreListManager::initSetIgnoreList(const QVariantMap& ignoreList)
+{
+    IgnoreListManager::initSetIgnoreList(ignoreList);
+    _indexValid = false;
+}
+
+void CoreIgnoreListManager::removeIgnoreListItem(const QString& ignoreRule)
+{
+    IgnoreListManager::removeIgnoreListItem(ignoreRule);
+    _indexValid = false;
+}
+
+void CoreIgnoreListManager::toggleIgnoreRule(const QString& ignoreRule)
+{
+    IgnoreListManager::toggleIgnoreRule(ignoreRule);
+    _indexValid = false;
+}
+
+void CoreIgnoreListManager::addIgnoreListItem(
+    int type, const QString& ignoreRule, bool isRegEx, int strictness, int scope, const QString& scopeRule, bool isActive)
+{
+    IgnoreListManager::addIgnoreListItem(type, ignoreRule, isRegEx, strictness, scope, scopeRule, isActive);
+    _indexValid = false;
+}
+
+void CoreIgnoreListManager::buildIndex()
+{
+    if (_indexValid)
+        return;
+
+    _rules.clear();
+    _bySender.clear();
+    _byNetwork.clear();
+    _byChannel.clear();
+    _scanned.clear();
+
+    for (const IgnoreListItem& item : ignoreList()) {
+        if (!item.isEnabled() || item.type() == CtcpIgnore)
+            continue;
+
+        IndexedRule rule;
+        rule.strictness = item.strictness();
+        rule.isSenderRule = item.type() == SenderIgnore;
+        rule.isChannelScope = item.scope() == ChannelScope;
+        rule.scopeMatchesAlways = item.scope() == GlobalScope;
+        rule.senderIndexed = false;
+        rule.contentsMatch = item.contentsMatcher();
+        rule.scopeMatch = item.scopeRuleMatcher();
+
+        const int index = static_cast<int>(_rules.size());
+        const QStringList senderKeys = (rule.isSenderRule && !item.isRegEx()) ? literalKeys(item.contents(), false) : QStringList{};
+        const QStringList scopeKeys = rule.scopeMatchesAlways ? QStringList{} : literalKeys(item.scopeRule(), true);
+        if (!senderKeys.isEmpty()) {
+            rule.senderIndexed = true;
+            _bySender[senderKeys.first()] << index;
+        }
+        else if (!scopeKeys.isEmpty()) {
+            rule.scopeMatchesAlways = true;
+            auto& scopeIndex = rule.isChannelScope ? _byChannel : _byNetwork;
+            for (const QString& key : scopeKeys) {
+                scopeIndex[key] << index;
+            }
+        }
+        else {
+            _scanned << index;
+        }
+        _rules.push_back(std::move(rule));
+    }
+
+    _indexValid = true;
+}
+
+QStringList CoreIgnoreListManager::literalKeys(const QString& expression, bool isList)
+{
+    static const QString wildcardChars{"*?\\"};
+
+    QStringList entries = isList ? expression.split(QRegularExpression("[;\n]")) : QStringList{expression};
+    QStringList keys;
+    for (QString entry : entries) {
+        if (isList)
+            entry = entry.trimmed();
+        if (entry.isEmpty() || entry.startsWith('!'))
+            return {};
+        for (const QChar& c : entry) {
+            if (wildcardChars.contains(c))
+                return {};
+        }
+        QString key = entry.toCaseFolded();
+        if (!keys.contains(key))
+            keys << key;
+    }
+    return keys;
+}
+
+bool CoreIgnoreListManager::isSenderIndexed(const QString& sender)
+{
+    buildIndex();
+    return _bySender.contains(sender.toCaseFolded());
+}
+
+int CoreIgnoreListManager::scannedRuleCount()
+{
+    buildIndex();
+    return _scanned.count();
 }
 
 void CoreIgnoreListManager::save() const
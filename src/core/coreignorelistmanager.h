@@ -20,7 +20,16 @@
 
 #pragma once
 
+#include <memory>
+#include <vector>
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
 #include "ignorelistmanager.h"
+#include "metricsserver.h"
 
 class CoreSession;
 struct RawMessage;
@@ -32,6 +41,16 @@ class CoreIgnoreListManager : public IgnoreListManager
 public:
     explicit CoreIgnoreListManager(CoreSession* parent);
 
+    /**
+     * Checks if a message matches the ignore list
+     *
+     * Gives the same result as IgnoreListManager::match(), but looks up rules through an index
+     * instead of evaluating all of them.
+     *
+     * @param rawMsg       The message to check
+     * @param networkName  Name of the network the message belongs to
+     * @return UnmatchedStrictness, HardStrictness or SoftStrictness representing the match type
+     */
     StrictnessType match(const RawMessage& rawMsg, const QString& networkName);
 
 public slots:
@@ -43,9 +62,73 @@ public slots:
         addIgnoreListItem(type, ignoreRule, isRegEx, strictness, scope, scopeRule, isActive);
     }
 
+    void initSetIgnoreList(const QVariantMap& ignoreList) override;
+    void removeIgnoreListItem(const QString& ignoreRule) override;
+    void toggleIgnoreRule(const QString& ignoreRule) override;
+    void addIgnoreListItem(
+        int type, const QString& ignoreRule, bool isRegEx, int strictness, int scope, const QString& scopeRule, bool isActive) override;
+
+protected:
+    /**
+     * Checks whether rules for a sender mask are looked up through the sender index
+     *
+     * @param sender  Sender mask, as in the rule
+     * @return True if there are rules indexed by this sender mask
+     */
+    bool isSenderIndexed(const QString& sender);
+
+    /**
+     * Gets the number of rules that could not be indexed and are checked for every message
+     */
+    int scannedRuleCount();
+
 private slots:
     void save() const;
 
+private:
+    /**
+     * Enabled message or sender ignore rule, with its expression matchers resolved
+     */
+    struct IndexedRule
+    {
+        StrictnessType strictness;
+        bool isSenderRule;        ///< If true, match the sender, otherwise the message contents
+        bool isChannelScope;      ///< If true, match the scope against the buffer, otherwise the network
+        bool scopeMatchesAlways;  ///< Global scope, or found through its literal scope
+        bool senderIndexed;       ///< Found through its literal sender mask
+        ExpressionMatch contentsMatch;
+        ExpressionMatch scopeMatch;
+    };
+
+    /**
+     * Rebuilds the rule index if the ignore list changed
+     *
+     * Rules ignoring a literal sender mask are bucketed by that mask.  Other rules with a literal
+     * scope are bucketed by the network or channel names in their scope.  Only the remaining
+     * rules with wildcard scopes, and global rules, need to be scanned for every message.
+     */
+    void buildIndex();
+
+    /**
+     * Gets the key of a literal expression, as used for the index
+     *
+     * Besides "*", "?" and "\", a leading "!" is special as it inverts the expression or list entry.
+     *
+     * @param expression  Wildcard expression or list of wildcard expressions
+     * @param isList      True if the expression is a ";"-separated list
+     * @return Case-folded entries of the expression, or an empty list if it contains wildcards
+     */
+    static QStringList literalKeys(const QString& expression, bool isList);
+
+    bool _indexValid{false};
+    std::vector<IndexedRule> _rules;          ///< Indexed rules, in ignore list order
+    QHash<QString, QVector<int>> _bySender;   ///< Rules with literal sender masks
+    QHash<QString, QVector<int>> _byNetwork;  ///< Network scoped rules with literal scope
+    QHash<QString, QVector<int>> _byChannel;  ///< Channel scoped rules with literal scope
+    QVector<int> _scanned;                    ///< Rules to check for every message
+
+    std::shared_ptr<MetricsServer::UserMetrics> _userMetrics;
+
     // private:
     //  void loadDefaults();
 };
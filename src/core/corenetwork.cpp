@@ -35,6 +35,7 @@
 #include "irccap.h"
 #include "irctag.h"
 #include "networkevent.h"
+#include "signalproxy.h"
 
 CoreNetwork::CoreNetwork(const NetworkId& networkid, CoreSession* session)
     : Network(networkid, session)
@@ -48,10 +49,20 @@ CoreNetwork::CoreNetwork(const NetworkId& networkid, CoreSession* session)
     , _lastUsedServerIndex(0)
     , _requestedUserModes('-')
 {
+    // Own the member objects as well, so they follow along if the session is moved to another thread
+    socket.setParent(this);
+    for (QTimer* timer : {&_autoReconnectTimer, &_socketCloseTimer, &_pingTimer, &_autoWhoTimer, &_autoWhoCycleTimer, &_tokenBucketTimer}) {
+        timer->setParent(this);
+    }
+
     // Check if raw IRC logging is enabled
     _debugLogRawIrc = (Quassel::isOptionSet("debug-irc") || Quassel::isOptionSet("debug-irc-id"));
     _debugLogRawNetId = Quassel::optionValue("debug-irc-id").toInt();
 
+    if (_metricsServer) {
+        _userMetrics = _metricsServer->userMetrics(userId());
+    }
+
     _autoReconnectTimer.setSingleShot(true);
     connect(&_socketCloseTimer, &QTimer::timeout, this, &CoreNetwork::onSocketCloseTimeout);
 
@@ -116,6 +127,10 @@ CoreNetwork::CoreNetwork(const NetworkId& networkid, CoreSession* session)
 
 CoreNetwork::~CoreNetwork()
 {
+    if (Core::instance()->connectionScheduler()) {
+        Core::instance()->connectionScheduler()->cancel(this);
+    }
+
     // Ensure we don't get any more signals from the socket while shutting down
     disconnect(&socket, nullptr, this, nullptr);
     if (!forceDisconnect()) {
@@ -182,14 +197,6 @@ void CoreNetwork::connectToIrc(bool reconnecting)
         return;
     }
 
-    if (Core::instance()->identServer()) {
-        _socketId = Core::instance()->identServer()->addWaitingSocket();
-    }
-
-    if (_metricsServer) {
-        _metricsServer->addNetwork(userId());
-    }
-
     if (!reconnecting && useAutoReconnect() && _autoReconnectCount == 0) {
         _autoReconnectTimer.setInterval(autoReconnectInterval() * 1000);
         if (unlimitedReconnectRetries())
@@ -239,6 +246,45 @@ void CoreNetwork::connectToIrc(bool reconnecting)
         _lastUsedServerIndex = 0;
     }
 
+    // Wait for our turn, so a core restart or an outage doesn't make all networks connect at the same time
+    ConnectionScheduler* scheduler = Core::instance()->connectionScheduler();
+    if (scheduler) {
+        Server server = usedServer();
+        bool hasClients = coreSession()->signalProxy()->peerCount() > 0;
+        _waitingForAdmission = true;
+        // Show the network as connecting while it is queued, so clients can still cancel the attempt
+        setConnectionState(Network::Connecting);
+        displayStatusMsg(tr("Waiting to connect to %1:%2...").arg(server.host).arg(server.port));
+        scheduler->requestAdmission(this, QString("%1:%2").arg(server.host).arg(server.port), hasClients);
+        return;
+    }
+    startConnection();
+}
+
+void CoreNetwork::startConnection()
+{
+    ConnectionScheduler* scheduler = Core::instance()->connectionScheduler();
+    if (scheduler) {
+        if (!_waitingForAdmission || _shuttingDown) {
+            // Withdrawn while the admission was on its way
+            scheduler->cancel(this);
+            return;
+        }
+        _waitingForAdmission = false;
+    }
+    _connectionStarted = true;
+
+    if (Core::instance()->identServer()) {
+        _socketId = Core::instance()->identServer()->addWaitingSocket();
+    }
+
+    if (_metricsServer) {
+        _metricsServer->addNetwork(userId());
+    }
+
+    // Don't mix leftovers of the previous connection into the new one
+    _lineReader.clear();
+
     Server server = usedServer();
     displayStatusMsg(tr("Connecting to %1:%2...").arg(server.host).arg(server.port));
     showMessage(NetworkInternalMessage(
@@ -286,6 +332,12 @@ void CoreNetwork::disconnectFromIrc(bool requested, const QString& reason, bool
     // Disconnecting from the network, should expect a socket close or error
     _disconnectExpected = true;
     _quitRequested = requested;  // see socketDisconnected();
+    if (_waitingForAdmission) {
+        _waitingForAdmission = false;
+        Core::instance()->connectionScheduler()->cancel(this);
+        // We never got to connect, so the socket won't report the state change
+        setConnectionState(Network::Disconnected);
+    }
     if (!withReconnect) {
         _autoReconnectTimer.stop();
         _autoReconnectCount = 0;  // prohibiting auto reconnect
@@ -293,7 +345,7 @@ void CoreNetwork::disconnectFromIrc(bool requested, const QString& reason, bool
     disablePingTimeout();
     _msgQueue.clear();
     if (_metricsServer) {
-        _metricsServer->messageQueue(userId(), 0);
+        _userMetrics->messageQueue = 0;
     }
 
     IrcUser* me_ = me();
@@ -372,7 +424,7 @@ void CoreNetwork::putRawLine(const QByteArray& s, bool prepend)
             _msgQueue.append(s);
         }
         if (_metricsServer) {
-            _metricsServer->messageQueue(userId(), _msgQueue.size());
+            _userMetrics->messageQueue = _msgQueue.size();
         }
     }
 }
@@ -511,17 +563,21 @@ void CoreNetwork::setMyNick(const QString& mynick)
 
 void CoreNetwork::onSocketHasData()
 {
-    while (socket.canReadLine()) {
-        QByteArray s = socket.readLine();
-        if (_metricsServer) {
-            _metricsServer->receiveDataNetwork(userId(), s.size());
-        }
-        if (s.endsWith("\r\n"))
-            s.chop(2);
-        else if (s.endsWith("\n"))
-            s.chop(1);
-        NetworkDataEvent* event = new NetworkDataEvent(EventManager::NetworkIncoming, this, s);
-        event->setTimestamp(QDateTime::currentDateTimeUtc());
+    qint64 bytesRead = _lineReader.readFrom(&socket);
+    if (bytesRead <= 0)
+        return;
+    if (_metricsServer) {
+        _userMetrics->networkDataReceive.add(bytesRead);
+    }
+
+    // Everything read at once has arrived at the same time
+    const QDateTime timestamp = QDateTime::currentDateTimeUtc();
+    QByteArray line;
+    while (_lineReader.readLine(line)) {
+        MetricsTimer timer(_metricsServer ? &_metricsServer->ircLineDuration() : nullptr);
+        // The line is a view into the reader's buffer, the event needs a copy of its own
+        auto* event = new NetworkDataEvent(EventManager::NetworkIncoming, this, QByteArray(line.constData(), line.size()));
+        event->setTimestamp(timestamp);
         emit newEvent(event);
     }
 }
@@ -613,7 +669,7 @@ void CoreNetwork::onSocketDisconnected()
     disablePingTimeout();
     _msgQueue.clear();
     if (_metricsServer) {
-        _metricsServer->messageQueue(userId(), 0);
+        _userMetrics->messageQueue = 0;
     }
 
     _autoWhoCycleTimer.stop();
@@ -637,9 +693,22 @@ void CoreNetwork::onSocketDisconnected()
         }
     }
 
+    // Free our connection slot; unless we wanted to disconnect, this was a failed attempt
+    if (Core::instance()->connectionScheduler()) {
+        if (_quitRequested)
+            Core::instance()->connectionScheduler()->cancel(this);
+        else
+            Core::instance()->connectionScheduler()->finished(this, false);
+    }
+
+    // A network withdrawn while waiting for admission has no socket or metrics to clean up
+    bool connectionStarted = _connectionStarted;
+    _connectionStarted = false;
+
     setConnected(false);
     emit disconnected(networkId());
-    emit socketDisconnected(identityPtr(), localAddress(), localPort(), peerAddress(), peerPort(), _socketId);
+    if (connectionStarted)
+        emit socketDisconnected(identityPtr(), localAddress(), localPort(), peerAddress(), peerPort(), _socketId);
     // Reset disconnect expectations
     _disconnectExpected = false;
     if (_quitRequested) {
@@ -655,7 +724,7 @@ void CoreNetwork::onSocketDisconnected()
             _autoReconnectTimer.start();
     }
 
-    if (_metricsServer) {
+    if (_metricsServer && connectionStarted) {
         _metricsServer->removeNetwork(userId());
     }
 }
@@ -686,6 +755,10 @@ void CoreNetwork::onSocketStateChanged(QAbstractSocket::SocketState socketState)
 
 void CoreNetwork::networkInitialized()
 {
+    if (Core::instance()->connectionScheduler()) {
+        Core::instance()->connectionScheduler()->finished(this, true);
+    }
+
     setConnectionState(Network::Initialized);
     setConnected(true);
     _disconnectExpected = false;
@@ -1578,7 +1651,7 @@ void CoreNetwork::fillBucketAndProcessQueue()
     while (!_msgQueue.empty() && _tokenBucket > 0) {
         writeToSocket(_msgQueue.takeFirst());
         if (_metricsServer) {
-            _metricsServer->messageQueue(userId(), _msgQueue.size());
+            _userMetrics->messageQueue = _msgQueue.size();
         }
     }
 }
@@ -1593,7 +1666,7 @@ void CoreNetwork::writeToSocket(const QByteArray& data)
     socket.write(data);
     socket.write("\r\n");
     if (_metricsServer) {
-        _metricsServer->transmitDataNetwork(userId(), data.size() + 2);
+        _userMetrics->networkDataTransmit.add(data.size() + 2);
     }
     if (!_skipMessageRates) {
         // Only subtract from the token bucket if message rate limiting is enabled
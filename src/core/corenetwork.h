@@ -21,6 +21,7 @@
 #pragma once
 
 #include <functional>
+#include <memory>
 
 #include <QSslError>
 #include <QSslSocket>
@@ -34,7 +35,9 @@
 #include "coreircuser.h"
 #include "coresession.h"
 #include "irccap.h"
+#include "irclinereader.h"
 #include "irctag.h"
+#include "metricsserver.h"
 #include "network.h"
 
 class CoreIdentity;
@@ -223,6 +226,12 @@ public slots:
     void shutdown();
 
     void connectToIrc(bool reconnecting = false);
+    /**
+     * Opens the connection to the IRC server chosen by connectToIrc()
+     *
+     * If connections are admitted by the ConnectionScheduler, this is called once it's our turn.
+     */
+    void startConnection();
     /**
      * Disconnect from the IRC server.
      *
@@ -507,10 +516,12 @@ private:
     qint32 _debugLogRawNetId;  ///< Network ID for logging raw IRC socket messages, or -1 for all
 
     QSslSocket socket;
+    IrcLineReader _lineReader;
     qint64 _socketId{0};
 
     CoreUserInputHandler* _userInputHandler;
     MetricsServer* _metricsServer;
+    std::shared_ptr<MetricsServer::UserMetrics> _userMetrics;  ///< Metrics of our user, set if _metricsServer is
 
     QHash<QString, QString> _channelKeys;  // stores persistent channels and their passwords, if any
 
@@ -530,6 +541,8 @@ private:
     // specifying a permanent (saved to core session) disconnect.
 
     bool _shuttingDown{false};  ///< If true, we're shutting down and ignore requests to (dis)connect networks
+    bool _waitingForAdmission{false};  ///< If true, we're queued in the ConnectionScheduler
+    bool _connectionStarted{false};    ///< If true, startConnection() set up an attempt that has to be torn down
 
     bool _previousConnectionAttemptFailed;
     int _lastUsedServerIndex;
@@ -154,6 +154,12 @@ CoreSession::CoreSession(UserId uid, bool restoreState, bool strictIdentEnabled,
     }
 }
 
+CoreSession::~CoreSession()
+{
+    // Messages still being written must not be delivered to us anymore
+    Core::removeMessageReceiver(this);
+}
+
 void CoreSession::shutdown()
 {
     saveSessionState();
@@ -263,6 +269,7 @@ void CoreSession::addClient(RemotePeer* peer)
 
     if (_metricsServer) {
         _metricsServer->addClient(user());
+        connect(peer, &RemotePeer::messageWritten, this, &CoreSession::onClientMessageWritten);
     }
 }
 
@@ -284,6 +291,11 @@ void CoreSession::removeClient(Peer* peer)
     }
 }
 
+void CoreSession::onClientMessageWritten(int size)
+{
+    _metricsServer->clientMessageSize().observe(size);
+}
+
 QHash<QString, QString> CoreSession::persistentChannels(NetworkId id) const
 {
     return Core::persistentChannels(user(), id);
@@ -374,6 +386,19 @@ std::vector<BufferInfo> CoreSession::buffers() const
 
 void CoreSession::customEvent(QEvent* event)
 {
+    if (event->type() == MessagesLoggedEvent::EventType) {
+        // Messages can only be displayed once they've been stored and have a MsgId
+        auto* loggedEvent = static_cast<MessagesLoggedEvent*>(event);
+        if (loggedEvent->success) {
+            // FIXME: extend protocol to a displayMessages(MessageList)
+            for (const Message& msg : loggedEvent->messages) {
+                emit displayMsg(msg);
+            }
+        }
+        event->accept();
+        return;
+    }
+
     if (event->type() != QEvent::User)
         return;
 
@@ -400,8 +425,7 @@ void CoreSession::processMessages()
                     realName(rawMsg.sender, rawMsg.networkId),
                     avatarUrl(rawMsg.sender, rawMsg.networkId),
                     rawMsg.flags);
-        if (Core::storeMessage(msg))
-            emit displayMsg(msg);
+        Core::logMessages(MessageList{msg}, this);
     }
     else {
         QHash<NetworkId, QHash<QString, BufferInfo>> bufferInfoCache;
@@ -459,12 +483,7 @@ void CoreSession::processMessages()
             messages << msg;
         }
 
-        if (Core::storeMessages(messages)) {
-            // FIXME: extend protocol to a displayMessages(MessageList)
-            for (int i = 0; i < messages.count(); i++) {
-                emit displayMsg(messages[i]);
-            }
-        }
+        Core::logMessages(std::move(messages), this);
     }
     _processMessages = false;
     _messageQueue.clear();
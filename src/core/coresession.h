@@ -65,6 +65,7 @@ class CoreSession : public QObject
 
 public:
     CoreSession(UserId, bool restoreState, bool strictIdentEnabled, QObject* parent = nullptr);
+    ~CoreSession() override;
 
     std::vector<BufferInfo> buffers() const;
     inline UserId user() const { return _user; }
@@ -197,6 +198,7 @@ protected:
 
 private slots:
     void removeClient(Peer* peer);
+    void onClientMessageWritten(int size);
 
     void recvStatusMsgFromServer(QString msg);
     void recvMessageFromServer(RawMessage msg);
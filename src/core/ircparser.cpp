@@ -109,6 +109,8 @@ void IrcParser::processNetworkIncoming(NetworkDataEvent* e)
     QString prefix;
     QString cmd;
     QList<QByteArray> params;
+    // The parameters end up in events that outlive rawMsg, so they need to be copied anyway; parseMessage() does
+    // this on top of the zero-copy parseSlices()
     IrcDecoder::parseMessage([&net](const QByteArray& data) {
         return net->serverDecode(data);
     }, rawMsg, tags, prefix, cmd, params);
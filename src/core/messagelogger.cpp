@@ -0,0 +1,173 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "messagelogger.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QMutexLocker>
+
+#include "core.h"
+#include "metricsserver.h"
+
+const QEvent::Type MessagesLoggedEvent::EventType = static_cast<QEvent::Type>(QEvent::registerEventType());
+
+const int MessageLogger::_maxCommitSize = 1000;
+
+MessageLogger::MessageLogger(int maxCommitLatency, MetricsServer* metricsServer, QObject* parent)
+    : QThread(parent)
+    , _maxCommitLatency(maxCommitLatency)
+    , _metricsServer(metricsServer)
+{
+    setObjectName("MessageLogger");
+}
+
+MessageLogger::~MessageLogger()
+{
+    stop();
+}
+
+void MessageLogger::logMessages(MessageList messages, QObject* receiver)
+{
+    if (messages.isEmpty())
+        return;
+
+    QMutexLocker locker(&_mutex);
+    _queuedMessages += messages.count();
+    _queue.append(Batch{std::move(messages), receiver, {}});
+    _queue.last().queued.start();
+    if (_metricsServer)
+        _metricsServer->storageQueue(_queuedMessages);
+    _queueChanged.wakeOne();
+}
+
+void MessageLogger::removeReceiver(QObject* receiver)
+{
+    // Results are only ever posted while holding the mutex, so once we're done here, no more
+    // events will reach the receiver
+    QMutexLocker locker(&_mutex);
+    for (auto&& batch : _queue) {
+        if (batch.receiver == receiver)
+            batch.receiver = nullptr;
+    }
+    for (auto&& batch : _inFlight) {
+        if (batch.receiver == receiver)
+            batch.receiver = nullptr;
+    }
+}
+
+void MessageLogger::stop()
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _stopping = true;
+        _queueChanged.wakeOne();
+    }
+    wait();
+}
+
+void MessageLogger::run()
+{
+    QMutexLocker locker(&_mutex);
+    forever {
+        while (_queue.isEmpty() && !_stopping) {
+            _queueChanged.wait(&_mutex);
+        }
+        if (_queue.isEmpty()) {
+            // Stopping, and everything has been written
+            break;
+        }
+
+        // Give other sessions the chance to join this commit, unless it's full already
+        while (!_stopping && _queuedMessages < _maxCommitSize) {
+            qint64 remaining = _maxCommitLatency - _queue.first().queued.elapsed();
+            if (remaining <= 0)
+                break;
+            _queueChanged.wait(&_mutex, static_cast<unsigned long>(remaining));
+        }
+
+        // Always take at least one batch, even if it exceeds the commit size on its own
+        int count = 0;
+        do {
+            count += _queue.first().messages.count();
+            _inFlight.append(_queue.takeFirst());
+        } while (!_queue.isEmpty() && count + _queue.first().messages.count() <= _maxCommitSize);
+        _queuedMessages -= count;
+
+        locker.unlock();
+        commit(_inFlight);
+        locker.relock();
+
+        for (auto&& batch : _inFlight) {
+            if (batch.receiver)
+                QCoreApplication::postEvent(batch.receiver, new MessagesLoggedEvent(std::move(batch.messages), batch.success));
+        }
+        _inFlight.clear();
+
+        if (_metricsServer)
+            _metricsServer->storageQueue(_queuedMessages);
+    }
+}
+
+void MessageLogger::commit(QList<Batch>& batches)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    int count = 0;
+    if (batches.count() == 1) {
+        Batch& batch = batches.first();
+        batch.success = store(batch.messages);
+        count = batch.messages.count();
+    }
+    else {
+        MessageList messages;
+        for (auto&& batch : batches) {
+            messages += batch.messages;
+        }
+        count = messages.count();
+
+        if (store(messages)) {
+            int offset = 0;
+            for (auto&& batch : batches) {
+                for (int i = 0; i < batch.messages.count(); i++) {
+                    batch.messages[i].setMsgId(messages.at(offset + i).msgId());
+                }
+                offset += batch.messages.count();
+                batch.success = true;
+            }
+        }
+        else {
+            // Don't let a single bad batch take everyone else's messages down with it
+            qWarning() << "Could not store" << count << "messages at once, retrying separately";
+            for (auto&& batch : batches) {
+                batch.success = store(batch.messages);
+            }
+        }
+    }
+
+    if (_metricsServer)
+        _metricsServer->storageCommit(count, timer.nsecsElapsed());
+}
+
+bool MessageLogger::store(MessageList& messages)
+{
+    return Core::storeMessages(messages);
+}
@@ -0,0 +1,138 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "message.h"
+
+class MetricsServer;
+
+/**
+ * Event carrying messages stored by the MessageLogger back to the object that queued them
+ */
+class MessagesLoggedEvent : public QEvent
+{
+public:
+    static const QEvent::Type EventType;
+
+    MessagesLoggedEvent(MessageList messages, bool success)
+        : QEvent(EventType)
+        , messages(std::move(messages))
+        , success(success)
+    {}
+
+    MessageList messages;  ///< The stored messages, with their MsgId set if successful
+    bool success;          ///< Whether the messages have been stored
+};
+
+/**
+ * Writes messages to the storage backend on a thread of its own
+ *
+ * Sessions queue their messages with logMessages() and carry on with processing IRC traffic while
+ * the storage backend is busy. Messages queued by all sessions are coalesced into group commits,
+ * i.e. written in a single transaction, which are bounded in size and by the maximum commit
+ * latency.  Once stored, the messages are posted back to their receiver in a MessagesLoggedEvent.
+ *
+ * A higher commit latency results in fewer, larger transactions, at the cost of delaying messages
+ * on their way to the clients and losing more of them if the core goes down unexpectedly.
+ */
+class MessageLogger : public QThread
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor
+     *
+     * @param maxCommitLatency  Time in milliseconds messages may be held back to be committed together with others
+     * @param metricsServer     Metrics server to report the queue to, may be nullptr
+     * @param parent            Parent object
+     */
+    MessageLogger(int maxCommitLatency, MetricsServer* metricsServer, QObject* parent = nullptr);
+    ~MessageLogger() override;
+
+    /**
+     * Queues messages for storage
+     *
+     * @note This method is threadsafe.
+     *
+     * @param messages  The messages to store
+     * @param receiver  Object to post the stored messages to
+     */
+    void logMessages(MessageList messages, QObject* receiver);
+
+    /**
+     * Stops delivering stored messages to the given receiver
+     *
+     * Must be called before the receiver is destroyed; messages it has queued are stored anyway.
+     *
+     * @note This method is threadsafe.
+     *
+     * @param receiver  The receiver going away
+     */
+    void removeReceiver(QObject* receiver);
+
+    /**
+     * Writes any queued messages and stops the logger thread
+     */
+    void stop();
+
+protected:
+    void run() override;
+
+    /**
+     * Stores messages in the storage backend, called on the logger thread
+     *
+     * @param messages  The messages to store; their MsgId is set if successful
+     * @return true on success
+     */
+    virtual bool store(MessageList& messages);
+
+private:
+    struct Batch
+    {
+        MessageList messages;
+        QObject* receiver;
+        QElapsedTimer queued;
+        bool success{false};
+    };
+
+    /// Stores the given batches in a single transaction, falling back to one transaction per batch on failure
+    void commit(QList<Batch>& batches);
+
+    const int _maxCommitLatency;
+    static const int _maxCommitSize;
+
+    MetricsServer* _metricsServer;
+
+    QMutex _mutex;
+    QWaitCondition _queueChanged;
+    QList<Batch> _queue;
+    int _queuedMessages{0};
+    QList<Batch> _inFlight;
+    bool _stopping{false};
+};
@@ -0,0 +1,103 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "metrics.h"
+
+#include <algorithm>
+
+namespace {
+
+std::atomic<unsigned int> nextShard{0};
+
+}  // namespace
+
+constexpr int MetricsSharded::ShardCount;
+constexpr int MetricsSharded::CacheLineSize;
+
+int MetricsSharded::shardIndex()
+{
+    // Threads are assigned shards round-robin, the first time they touch any metric
+    thread_local const int index = nextShard.fetch_add(1, std::memory_order_relaxed) % ShardCount;
+    return index;
+}
+
+qint64 MetricsCounter::value() const
+{
+    qint64 sum = 0;
+    for (const auto& shard : _shards) {
+        sum += shard.value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+MetricsHistogram::MetricsHistogram(std::vector<uint64_t> bounds, double scale)
+    : _bounds(std::move(bounds))
+    , _scale(scale)
+    , _stride(paddedSize(_bounds.size() + 2))
+    , _values(_stride * ShardCount)
+{}
+
+size_t MetricsHistogram::paddedSize(size_t count)
+{
+    const size_t valuesPerLine = CacheLineSize / sizeof(uint64_t);
+    return (count + valuesPerLine - 1) / valuesPerLine * valuesPerLine;
+}
+
+void MetricsHistogram::observe(uint64_t value)
+{
+    const size_t bucket = std::lower_bound(_bounds.cbegin(), _bounds.cend(), value) - _bounds.cbegin();
+    const size_t offset = shardIndex() * _stride;
+    _values[offset + bucket].fetch_add(1, std::memory_order_relaxed);
+    _values[offset + _bounds.size() + 1].fetch_add(value, std::memory_order_relaxed);
+}
+
+void MetricsHistogram::render(QByteArray& out, const char* name, const QByteArray& timestamp) const
+{
+    const QByteArray suffix = ' ' + timestamp + '\n';
+
+    uint64_t count = 0;
+    for (size_t bucket = 0; bucket <= _bounds.size(); bucket++) {
+        for (int shard = 0; shard < ShardCount; shard++) {
+            count += _values[shard * _stride + bucket].load(std::memory_order_relaxed);
+        }
+        out += name;
+        out += "_bucket{le=\"";
+        if (bucket < _bounds.size())
+            out += QByteArray::number(_bounds[bucket] * _scale);
+        else
+            out += "+Inf";
+        out += "\"} ";
+        out += QByteArray::number(static_cast<qulonglong>(count));
+        out += suffix;
+    }
+
+    uint64_t sum = 0;
+    for (int shard = 0; shard < ShardCount; shard++) {
+        sum += _values[shard * _stride + _bounds.size() + 1].load(std::memory_order_relaxed);
+    }
+    out += name;
+    out += "_sum ";
+    out += QByteArray::number(sum * _scale);
+    out += suffix;
+    out += name;
+    out += "_count ";
+    out += QByteArray::number(static_cast<qulonglong>(count));
+    out += suffix;
+}
@@ -0,0 +1,128 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QtGlobal>
+
+/**
+ * Base for metrics that are sharded by thread
+ *
+ * Every thread updates its own shard, so concurrent updates neither need locking nor fight over
+ * the same cache line.  Shards are only summed up when the metrics are scraped.
+ */
+class MetricsSharded
+{
+protected:
+    static constexpr int ShardCount = 16;
+    static constexpr int CacheLineSize = 64;
+
+    /// @returns the shard used by the calling thread
+    static int shardIndex();
+};
+
+/**
+ * Counter or gauge that may be updated concurrently from any thread
+ */
+class MetricsCounter : private MetricsSharded
+{
+public:
+    inline void add(qint64 value) { _shards[shardIndex()].value.fetch_add(value, std::memory_order_relaxed); }
+
+    /// @returns the sum of all shards
+    qint64 value() const;
+
+private:
+    struct Shard
+    {
+        std::atomic<qint64> value{0};
+        char padding[CacheLineSize - sizeof(std::atomic<qint64>)];
+    };
+
+    Shard _shards[ShardCount];
+};
+
+/**
+ * Prometheus histogram that may be updated concurrently from any thread
+ *
+ * Values are recorded as integers (e.g. nanoseconds or bytes), and multiplied by the scale when
+ * rendered (e.g. to report seconds).
+ */
+class MetricsHistogram : private MetricsSharded
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param bounds  Inclusive upper bounds of the buckets, in ascending order
+     * @param scale   Factor converting recorded values into the reported unit
+     */
+    MetricsHistogram(std::vector<uint64_t> bounds, double scale = 1.0);
+
+    void observe(uint64_t value);
+
+    /**
+     * Appends the histogram in the Prometheus text format
+     *
+     * @param out        Buffer to append to
+     * @param name       Name of the metric
+     * @param timestamp  Timestamp of the samples, in milliseconds since epoch
+     */
+    void render(QByteArray& out, const char* name, const QByteArray& timestamp) const;
+
+private:
+    /// @returns the given number of values, rounded up to fill whole cache lines
+    static size_t paddedSize(size_t count);
+
+    const std::vector<uint64_t> _bounds;
+    const double _scale;
+    const size_t _stride;  ///< Values per shard: one per bucket, the +Inf bucket and the sum, padded to a cache line
+    std::vector<std::atomic<uint64_t>> _values;
+};
+
+/**
+ * Records the time spent in a scope in a histogram, in nanoseconds
+ */
+class MetricsTimer
+{
+public:
+    explicit MetricsTimer(MetricsHistogram* histogram)
+        : _histogram(histogram)
+    {
+        if (_histogram)
+            _timer.start();
+    }
+
+    ~MetricsTimer()
+    {
+        if (_histogram)
+            _histogram->observe(_timer.nsecsElapsed());
+    }
+
+private:
+    MetricsHistogram* _histogram;
+    QElapsedTimer _timer;
+};
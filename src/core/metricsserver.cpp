@@ -25,14 +25,72 @@
 #include <QByteArray>
 #include <QDebug>
 #include <QHostAddress>
+#include <QReadLocker>
 #include <QStringList>
 #include <QTcpSocket>
+#include <QWriteLocker>
 
 #include "core.h"
 #include "corenetwork.h"
 
+namespace {
+
+// Bucket bounds in nanoseconds
+const std::vector<uint64_t> lineDurationBounds{10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000,
+                                               5000000, 10000000, 25000000, 50000000, 100000000, 250000000, 1000000000};
+const std::vector<uint64_t> requestDurationBounds{1000000, 2500000, 5000000, 10000000, 25000000, 50000000, 100000000,
+                                                  250000000, 500000000, 1000000000, 2500000000, 5000000000, 10000000000};
+// Bucket bounds in bytes
+const std::vector<uint64_t> messageSizeBounds{64, 256, 1024, 4096, 16384, 65536, 262144, 1048576, 4194304, 16777216, 67108864};
+
+// Bucket bounds in milliseconds
+const std::vector<uint64_t> waitDurationBounds{100, 500, 1000, 2500, 5000, 10000, 30000, 60000, 300000, 900000};
+
+const double nsecsToSeconds = 1e-9;
+const double msecsToSeconds = 1e-3;
+
+void appendHeader(QByteArray& out, const char* name, const char* type, const char* help)
+{
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void appendSample(QByteArray& out, const char* name, const QByteArray& labels, const QByteArray& value, const QByteArray& timestamp)
+{
+    out += name;
+    if (!labels.isEmpty()) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    out += ' ';
+    out += value;
+    out += ' ';
+    out += timestamp;
+    out += '\n';
+}
+
+QByteArray userLabel(const QString& name)
+{
+    return "user=\"" + name.toUtf8() + '"';
+}
+
+}  // namespace
+
 MetricsServer::MetricsServer(QObject* parent)
     : QObject(parent)
+    , _storageCommitDuration(requestDurationBounds, nsecsToSeconds)
+    , _ircLineDuration(lineDurationBounds, nsecsToSeconds)
+    , _backlogRequestDuration(requestDurationBounds, nsecsToSeconds)
+    , _clientMessageSize(messageSizeBounds)
+    , _connectionWait(waitDurationBounds, msecsToSeconds)
 {
     connect(&_server, &QTcpServer::newConnection, this, &MetricsServer::incomingConnection);
     connect(&_v6server, &QTcpServer::newConnection, this, &MetricsServer::incomingConnection);
@@ -195,81 +253,7 @@ void MetricsServer::respond()
                 "\r\n"
             );
         }
-        int64_t timestamp = QDateTime::currentMSecsSinceEpoch();
-        for (const auto& key : _sessions.keys()) {
-            const QString& name = _sessions[key];
-            socket->write("# HELP quassel_network_bytes_received Number of currently open connections from quassel clients\n");
-            socket->write("# TYPE quassel_client_sessions gauge\n");
-            socket->write(
-                QString("quassel_client_sessions{user=\"%1\"} %2 %3\n")
-                    .arg(name)
-                    .arg(_clientSessions.value(key, 0))
-                    .arg(timestamp)
-                    .toUtf8()
-            );
-            socket->write("# HELP quassel_network_bytes_received Number of currently open connections to IRC networks\n");
-            socket->write("# TYPE quassel_network_sessions gauge\n");
-            socket->write(
-                QString("quassel_network_sessions{user=\"%1\"} %2 %3\n")
-                    .arg(name)
-                    .arg(_networkSessions.value(key, 0))
-                    .arg(timestamp)
-                    .toUtf8()
-            );
-            socket->write("# HELP quassel_network_bytes_received Amount of bytes sent to IRC\n");
-            socket->write("# TYPE quassel_network_bytes_sent counter\n");
-            socket->write(
-                QString("quassel_network_bytes_sent{user=\"%1\"} %2 %3\n")
-                    .arg(name)
-                    .arg(_networkDataTransmit.value(key, 0))
-                    .arg(timestamp)
-                    .toUtf8()
-            );
-            socket->write("# HELP quassel_network_bytes_received Amount of bytes received from IRC\n");
-            socket->write("# TYPE quassel_network_bytes_received counter\n");
-            socket->write(
-                QString("quassel_network_bytes_received{user=\"%1\"} %2 %3\n")
-                    .arg(name)
-                    .arg(_networkDataReceive.value(key, 0))
-                    .arg(timestamp)
-                    .toUtf8()
-            );
-            socket->write("# HELP quassel_message_queue The number of messages currently queued for that user\n");
-            socket->write("# TYPE quassel_message_queue gauge\n");
-            socket->write(
-                QString("quassel_message_queue{user=\"%1\"} %2 %3\n")
-                    .arg(name)
-                    .arg(_messageQueue.value(key, 0))
-                    .arg(timestamp)
-                    .toUtf8()
-            );
-            socket->write("# HELP quassel_login_attempts The number of times the user has attempted to log in\n");
-            socket->write("# TYPE quassel_login_attempts counter\n");
-            socket->write(
-                QString("quassel_login_attempts{user=\"%1\",successful=\"false\"} %2 %3\n")
-                    .arg(name)
-                    .arg(_loginAttempts.value(key, 0) - _successfulLogins.value(key, 0))
-                    .arg(timestamp)
-                    .toUtf8()
-            );
-            socket->write(
-                QString("quassel_login_attempts{user=\"%1\",successful=\"true\"} %2 %3\n")
-                    .arg(name)
-                    .arg(_successfulLogins.value(key, 0))
-                    .arg(timestamp)
-                    .toUtf8()
-            );
-        }
-        if (!_certificateExpires.isNull()) {
-            socket->write("# HELP quassel_ssl_expire_time_seconds Expiration of the current TLS certificate in unixtime\n");
-            socket->write("# TYPE quassel_ssl_expire_time_seconds gauge\n");
-            socket->write(
-                QString("quassel_ssl_expire_time_seconds %1 %2\n")
-                    .arg(_certificateExpires.toMSecsSinceEpoch() / 1000)
-                    .arg(timestamp)
-                    .toUtf8()
-            );
-        }
+        socket->write(render());
         socket->close();
     }
     else if (requestPath == "/healthz") {
@@ -311,15 +295,151 @@ void MetricsServer::respond()
     }
 }
 
-void MetricsServer::addLoginAttempt(UserId user, bool successful) {
-    _loginAttempts.insert(user, _loginAttempts.value(user, 0) + 1);
+QByteArray MetricsServer::render() const
+{
+    const QByteArray timestamp = QByteArray::number(QDateTime::currentMSecsSinceEpoch());
+
+    QList<QPair<QByteArray, std::shared_ptr<UserMetrics>>> users;
+    {
+        QReadLocker locker(&_usersLock);
+        for (auto it = _sessions.cbegin(); it != _sessions.cend(); ++it) {
+            users.append(qMakePair(userLabel(it.value()), _users.value(it.key())));
+        }
+    }
+
+    QByteArray out;
+    auto appendUserMetric = [&](const char* name, const char* type, const char* help, auto&& value) {
+        appendHeader(out, name, type, help);
+        for (const auto& user : users) {
+            appendSample(out, name, user.first, value(*user.second), timestamp);
+        }
+    };
+
+    appendUserMetric("quassel_client_sessions", "gauge", "Number of currently open connections from quassel clients", [](const UserMetrics& metrics) {
+        return QByteArray::number(metrics.clientSessions.value());
+    });
+    appendUserMetric("quassel_network_sessions", "gauge", "Number of currently open connections to IRC networks", [](const UserMetrics& metrics) {
+        return QByteArray::number(metrics.networkSessions.value());
+    });
+    appendUserMetric("quassel_network_bytes_sent", "counter", "Amount of bytes sent to IRC", [](const UserMetrics& metrics) {
+        return QByteArray::number(metrics.networkDataTransmit.value());
+    });
+    appendUserMetric("quassel_network_bytes_received", "counter", "Amount of bytes received from IRC", [](const UserMetrics& metrics) {
+        return QByteArray::number(metrics.networkDataReceive.value());
+    });
+    appendUserMetric("quassel_message_queue", "gauge", "The number of messages currently queued for that user", [](const UserMetrics& metrics) {
+        return QByteArray::number(static_cast<qulonglong>(metrics.messageQueue.load()));
+    });
+    appendUserMetric("quassel_ignore_checks", "counter", "The number of messages checked against the ignore list", [](const UserMetrics& metrics) {
+        return QByteArray::number(metrics.ignoreChecks.value());
+    });
+    appendUserMetric("quassel_ignore_rule_evaluations",
+                     "counter",
+                     "The number of ignore rules evaluated against messages",
+                     [](const UserMetrics& metrics) { return QByteArray::number(metrics.ignoreRuleEvaluations.value()); });
+    appendUserMetric("quassel_ignore_match_seconds", "counter", "Time spent matching messages against the ignore list", [](const UserMetrics& metrics) {
+        return QByteArray::number(metrics.ignoreMatchDuration.value() * nsecsToSeconds);
+    });
+
+    appendHeader(out, "quassel_login_attempts", "counter", "The number of times the user has attempted to log in");
+    for (const auto& user : users) {
+        const qint64 successful = user.second->successfulLogins.value();
+        appendSample(out,
+                     "quassel_login_attempts",
+                     user.first + ",successful=\"false\"",
+                     QByteArray::number(user.second->loginAttempts.value() - successful),
+                     timestamp);
+        appendSample(out, "quassel_login_attempts", user.first + ",successful=\"true\"", QByteArray::number(successful), timestamp);
+    }
+
+    appendHeader(out, "quassel_irc_line_seconds", "histogram", "Time taken to process a line received from IRC");
+    _ircLineDuration.render(out, "quassel_irc_line_seconds", timestamp);
+    appendHeader(out, "quassel_backlog_request_seconds", "histogram", "Time taken to answer a backlog request");
+    _backlogRequestDuration.render(out, "quassel_backlog_request_seconds", timestamp);
+    appendHeader(out, "quassel_client_message_bytes", "histogram", "Size of the messages sent to clients");
+    _clientMessageSize.render(out, "quassel_client_message_bytes", timestamp);
+
+    appendHeader(out, "quassel_storage_queue", "gauge", "The number of messages currently waiting to be written to the database");
+    appendSample(out, "quassel_storage_queue", {}, QByteArray::number(static_cast<qulonglong>(_storageQueue.load())), timestamp);
+    appendHeader(out, "quassel_storage_committed_messages", "counter", "The number of messages written to the database");
+    appendSample(out, "quassel_storage_committed_messages", {}, QByteArray::number(_storageCommittedMessages.value()), timestamp);
+    appendHeader(out, "quassel_storage_commit_seconds", "histogram", "Time taken by the transactions writing messages to the database");
+    _storageCommitDuration.render(out, "quassel_storage_commit_seconds", timestamp);
+    appendHeader(out, "quassel_storage_statement_cache_lookups", "counter", "The number of lookups in the prepared statement cache");
+    appendSample(out,
+                 "quassel_storage_statement_cache_lookups",
+                 "result=\"hit\"",
+                 QByteArray::number(_statementCacheHits.value()),
+                 timestamp);
+    appendSample(out,
+                 "quassel_storage_statement_cache_lookups",
+                 "result=\"miss\"",
+                 QByteArray::number(_statementCacheMisses.value()),
+                 timestamp);
+
+    appendHeader(out, "quassel_irc_connections_waiting", "gauge", "The number of IRC connections waiting to be admitted");
+    appendSample(out,
+                 "quassel_irc_connections_waiting",
+                 {},
+                 QByteArray::number(static_cast<qulonglong>(_connectionsWaiting.load())),
+                 timestamp);
+    appendHeader(out, "quassel_irc_connections_connecting", "gauge", "The number of admitted IRC connections still being set up");
+    appendSample(out,
+                 "quassel_irc_connections_connecting",
+                 {},
+                 QByteArray::number(static_cast<qulonglong>(_connectionsConnecting.load())),
+                 timestamp);
+    appendHeader(out, "quassel_irc_servers_backed_off", "gauge", "The number of IRC servers not connected to for a while after failures");
+    appendSample(out,
+                 "quassel_irc_servers_backed_off",
+                 {},
+                 QByteArray::number(static_cast<qulonglong>(_serversBackedOff.load())),
+                 timestamp);
+    appendHeader(out, "quassel_irc_connection_failures", "counter", "The number of failed attempts to connect to IRC servers");
+    appendSample(out, "quassel_irc_connection_failures", {}, QByteArray::number(_connectionFailures.value()), timestamp);
+    appendHeader(out, "quassel_irc_connection_wait_seconds", "histogram", "Time IRC connections waited to be admitted");
+    _connectionWait.render(out, "quassel_irc_connection_wait_seconds", timestamp);
+
+    if (!_certificateExpires.isNull()) {
+        appendHeader(out, "quassel_ssl_expire_time_seconds", "gauge", "Expiration of the current TLS certificate in unixtime");
+        appendSample(out, "quassel_ssl_expire_time_seconds", {}, QByteArray::number(_certificateExpires.toMSecsSinceEpoch() / 1000), timestamp);
+    }
+
+    return out;
+}
+
+std::shared_ptr<MetricsServer::UserMetrics> MetricsServer::userMetrics(UserId user)
+{
+    {
+        QReadLocker locker(&_usersLock);
+        auto it = _users.constFind(user);
+        if (it != _users.cend())
+            return *it;
+    }
+
+    QWriteLocker locker(&_usersLock);
+    auto& metrics = _users[user];
+    if (!metrics)
+        metrics = std::make_shared<UserMetrics>();
+    return metrics;
+}
+
+void MetricsServer::addLoginAttempt(UserId user, bool successful)
+{
+    auto metrics = userMetrics(user);
+    metrics->loginAttempts.add(1);
     if (successful) {
-        _successfulLogins.insert(user, _successfulLogins.value(user, 0) + 1);
+        metrics->successfulLogins.add(1);
     }
 }
 
-void MetricsServer::addLoginAttempt(const QString& user, bool successful) {
-    UserId userId = _sessions.key(user);
+void MetricsServer::addLoginAttempt(const QString& user, bool successful)
+{
+    UserId userId;
+    {
+        QReadLocker locker(&_usersLock);
+        userId = _sessions.key(user);
+    }
     if (userId.isValid()) {
         addLoginAttempt(userId, successful);
     }
@@ -327,59 +447,61 @@ void MetricsServer::addLoginAttempt(const QString& user, bool successful) {
 
 void MetricsServer::addSession(UserId user, const QString& name)
 {
+    userMetrics(user);
+    QWriteLocker locker(&_usersLock);
     _sessions.insert(user, name);
 }
 
 void MetricsServer::removeSession(UserId user)
 {
+    QWriteLocker locker(&_usersLock);
     _sessions.remove(user);
 }
 
 void MetricsServer::addClient(UserId user)
 {
-    _clientSessions.insert(user, _clientSessions.value(user, 0) + 1);
+    userMetrics(user)->clientSessions.add(1);
 }
 
 void MetricsServer::removeClient(UserId user)
 {
-    int32_t count = _clientSessions.value(user, 0) - 1;
-    if (count <= 0) {
-        _clientSessions.remove(user);
-    }
-    else {
-        _clientSessions.insert(user, count);
-    }
+    userMetrics(user)->clientSessions.add(-1);
 }
 
 void MetricsServer::addNetwork(UserId user)
 {
-    _networkSessions.insert(user, _networkSessions.value(user, 0) + 1);
+    userMetrics(user)->networkSessions.add(1);
 }
 
 void MetricsServer::removeNetwork(UserId user)
 {
-    int32_t count = _networkSessions.value(user, 0) - 1;
-    if (count <= 0) {
-        _networkSessions.remove(user);
-    }
-    else {
-        _networkSessions.insert(user, count);
-    }
+    userMetrics(user)->networkSessions.add(-1);
+}
+
+void MetricsServer::storageQueue(uint64_t size)
+{
+    _storageQueue = size;
 }
 
-void MetricsServer::transmitDataNetwork(UserId user, uint64_t size)
+void MetricsServer::storageCommit(uint64_t size, uint64_t duration)
 {
-    _networkDataTransmit.insert(user, _networkDataTransmit.value(user, 0) + size);
+    _storageCommittedMessages.add(size);
+    _storageCommitDuration.observe(duration);
 }
 
-void MetricsServer::receiveDataNetwork(UserId user, uint64_t size)
+void MetricsServer::statementCacheLookup(bool hit)
 {
-    _networkDataReceive.insert(user, _networkDataReceive.value(user, 0) + size);
+    if (hit)
+        _statementCacheHits.add(1);
+    else
+        _statementCacheMisses.add(1);
 }
 
-void MetricsServer::messageQueue(UserId user, uint64_t size)
+void MetricsServer::connectionQueue(uint64_t waiting, uint64_t connecting, uint64_t backedOffServers)
 {
-    _messageQueue.insert(user, size);
+    _connectionsWaiting = waiting;
+    _connectionsConnecting = connecting;
+    _serversBackedOff = backedOffServers;
 }
 
 void MetricsServer::setCertificateExpires(QDateTime expires)
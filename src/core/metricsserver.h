@@ -20,23 +20,63 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+
+#include <QDateTime>
 #include <QHash>
 #include <QObject>
+#include <QReadWriteLock>
 #include <QString>
 #include <QTcpServer>
 
 #include "coreidentity.h"
-
+#include "metrics.h"
+
+/**
+ * Exposes the core's metrics in the Prometheus text format
+ *
+ * Metrics are updated from the session threads and the message logger, and read on the main
+ * thread when scraped.  Counters are sharded by thread (see MetricsSharded), so updating them
+ * never takes a lock.
+ */
 class MetricsServer : public QObject
 {
     Q_OBJECT
 
 public:
+    /**
+     * Metrics tracked for every user
+     *
+     * Obtain once with MetricsServer::userMetrics() and keep the pointer around to update them from
+     * hot paths without looking the user up again.
+     */
+    struct UserMetrics
+    {
+        MetricsCounter loginAttempts;
+        MetricsCounter successfulLogins;
+        MetricsCounter clientSessions;
+        MetricsCounter networkSessions;
+        MetricsCounter networkDataTransmit;
+        MetricsCounter networkDataReceive;
+        MetricsCounter ignoreChecks;
+        MetricsCounter ignoreRuleEvaluations;
+        MetricsCounter ignoreMatchDuration;  ///< In nanoseconds
+        std::atomic<uint64_t> messageQueue{0};
+    };
+
     explicit MetricsServer(QObject* parent = nullptr);
 
     bool startListening();
     void stopListening(const QString& msg);
 
+    /**
+     * Gets the metrics of a user, creating them if needed
+     *
+     * @note This method is threadsafe.
+     */
+    std::shared_ptr<UserMetrics> userMetrics(UserId user);
+
     void addLoginAttempt(UserId user, bool successful);
     void addLoginAttempt(const QString& user, bool successful);
 
@@ -49,10 +89,24 @@ public:
     void addNetwork(UserId user);
     void removeNetwork(UserId user);
 
-    void transmitDataNetwork(UserId user, uint64_t size);
-    void receiveDataNetwork(UserId user, uint64_t size);
-
-    void messageQueue(UserId user, uint64_t size);
+    void storageQueue(uint64_t size);
+    /// Records a transaction writing size messages, which took duration nanoseconds
+    void storageCommit(uint64_t size, uint64_t duration);
+    /// Records a lookup in the prepared statement cache of a database connection
+    void statementCacheLookup(bool hit);
+    /// Records the state of the IRC connection admission queue
+    void connectionQueue(uint64_t waiting, uint64_t connecting, uint64_t backedOffServers);
+    /// Records a failed attempt to connect to an IRC server
+    void connectionFailed() { _connectionFailures.add(1); }
+
+    /// Time taken to process a line received from IRC, in nanoseconds
+    MetricsHistogram& ircLineDuration() { return _ircLineDuration; }
+    /// Time taken to answer a backlog request, in nanoseconds
+    MetricsHistogram& backlogRequestDuration() { return _backlogRequestDuration; }
+    /// Size of the messages sent to clients, in bytes
+    MetricsHistogram& clientMessageSize() { return _clientMessageSize; }
+    /// Time IRC connections waited to be admitted, in milliseconds
+    MetricsHistogram& connectionWait() { return _connectionWait; }
 
     void setCertificateExpires(QDateTime expires);
 
@@ -61,20 +115,32 @@ private slots:
     void respond();
 
 private:
-    QTcpServer _server, _v6server;
+    /// Renders all metrics in the Prometheus text format
+    QByteArray render() const;
 
-    QHash<UserId, uint64_t> _loginAttempts{};
-    QHash<UserId, uint64_t> _successfulLogins{};
+    QTcpServer _server, _v6server;
 
+    mutable QReadWriteLock _usersLock;
+    QHash<UserId, std::shared_ptr<UserMetrics>> _users{};
     QHash<UserId, QString> _sessions{};
 
-    QHash<UserId, int32_t> _clientSessions{};
-    QHash<UserId, int32_t> _networkSessions{};
-
-    QHash<UserId, uint64_t> _networkDataTransmit{};
-    QHash<UserId, uint64_t> _networkDataReceive{};
-
-    QHash<UserId, uint64_t> _messageQueue{};
+    // Updated from the message logger thread
+    std::atomic<uint64_t> _storageQueue{0};
+    MetricsCounter _storageCommittedMessages;
+    MetricsHistogram _storageCommitDuration;
+    MetricsCounter _statementCacheHits;
+    MetricsCounter _statementCacheMisses;
+
+    // Updated from the connection scheduler
+    std::atomic<uint64_t> _connectionsWaiting{0};
+    std::atomic<uint64_t> _connectionsConnecting{0};
+    std::atomic<uint64_t> _serversBackedOff{0};
+    MetricsCounter _connectionFailures;
+    MetricsHistogram _connectionWait;
+
+    MetricsHistogram _ircLineDuration;
+    MetricsHistogram _backlogRequestDuration;
+    MetricsHistogram _clientMessageSize;
 
     QDateTime _certificateExpires{};
 };
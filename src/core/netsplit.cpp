@@ -33,6 +33,10 @@ Netsplit::Netsplit(Network* network, QObject* parent)
     , _joinCounter(0)
     , _quitCounter(0)
 {
+    _discardTimer.setParent(this);
+    _joinTimer.setParent(this);
+    _quitTimer.setParent(this);
+
     _discardTimer.setSingleShot(true);
     _joinTimer.setSingleShot(true);
     _quitTimer.setSingleShot(true);
@@ -0,0 +1,514 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "postgresqlnativestorage.h"
+
+#include <algorithm>
+
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QSqlDriver>
+#include <QtEndian>
+
+#include <libpq-fe.h>
+
+namespace {
+
+// Type OIDs from PostgreSQL's pg_type.h, which is not part of the client headers
+const Oid int4Oid = 23;
+const Oid int8Oid = 20;
+const Oid textOid = 25;
+const Oid timestampOid = 1114;
+
+// Binary timestamps count microseconds since the PostgreSQL epoch
+const qint64 postgresEpochMSecs = 946684800000;
+
+template<typename T>
+QByteArray bigEndian(T value)
+{
+    QByteArray bytes(sizeof(T), Qt::Uninitialized);
+    qToBigEndian<T>(value, reinterpret_cast<uchar*>(bytes.data()));
+    return bytes;
+}
+
+QByteArray timestampBytes(const QDateTime& time)
+{
+    // The session runs in UTC, see PostgreSqlStorage::initDbSession()
+    return bigEndian<qint64>((time.toMSecsSinceEpoch() - postgresEpochMSecs) * 1000);
+}
+
+/**
+ * Gets the libpq connection behind a QtSql database connection
+ *
+ * @return The connection, or nullptr if it is unusable for binary parameters
+ */
+PGconn* nativeConnection(const QSqlDatabase& db)
+{
+    QVariant handle = db.driver()->handle();
+    if (!handle.isValid() || qstrcmp(handle.typeName(), "PGconn*") != 0)
+        return nullptr;
+    PGconn* conn = *static_cast<PGconn* const*>(handle.constData());
+    if (!conn || PQstatus(conn) != CONNECTION_OK)
+        return nullptr;
+    // Servers built with floating point timestamps have been gone since PostgreSQL 10, but let's be sure
+    if (qstrcmp(PQparameterStatus(conn, "integer_datetimes"), "on") != 0)
+        return nullptr;
+    return conn;
+}
+
+QString errorMessage(const PGconn* conn, const PGresult* result = nullptr)
+{
+    return QString::fromUtf8(result ? PQresultErrorMessage(result) : PQerrorMessage(conn)).trimmed();
+}
+
+}  // namespace
+
+// ========================================
+//  PostgreSqlNativeStorage::Params
+// ========================================
+class PostgreSqlNativeStorage::Params
+{
+public:
+    void addInt(qint32 value) { add(int4Oid, bigEndian(value)); }
+    void addBigInt(qint64 value) { add(int8Oid, bigEndian(value)); }
+    void addTimestamp(const QDateTime& value) { add(timestampOid, timestampBytes(value)); }
+    // The binary format of text is just the string, in the client encoding
+    void addText(const QString& value) { add(textOid, value.isNull() ? QByteArray() : value.toUtf8(), value.isNull()); }
+
+    int count() const { return static_cast<int>(_types.size()); }
+    const Oid* types() const { return _types.data(); }
+    const char* const* values() const { return _values.data(); }
+    const int* lengths() const { return _lengths.data(); }
+    const int* formats() const { return _formats.data(); }
+
+private:
+    void add(Oid type, QByteArray value, bool isNull = false)
+    {
+        // The QByteArray's data stays put when the vector or the Params are copied or moved
+        _data.push_back(std::move(value));
+        _types.push_back(type);
+        _values.push_back(isNull ? nullptr : _data.back().constData());
+        _lengths.push_back(_data.back().size());
+        _formats.push_back(1);
+    }
+
+    std::vector<QByteArray> _data;
+    std::vector<Oid> _types;
+    std::vector<const char*> _values;
+    std::vector<int> _lengths;
+    std::vector<int> _formats;
+};
+
+// ========================================
+//  PostgreSqlNativeStorage
+// ========================================
+
+// Keeps the results of a pipeline well below the socket buffer sizes, as we only start reading
+// them once everything has been sent
+const int PostgreSqlNativeStorage::_maxPipelineLength = 256;
+
+PostgreSqlNativeStorage::PostgreSqlNativeStorage(QObject* parent)
+    : PostgreSqlStorage(parent)
+{}
+
+std::unique_ptr<AbstractSqlMigrationWriter> PostgreSqlNativeStorage::createMigrationWriter()
+{
+    auto writer = new PostgreSqlNativeMigrationWriter();
+    QVariantMap properties;
+    properties["Username"] = userName();
+    properties["Password"] = password();
+    properties["Hostname"] = hostName();
+    properties["Port"] = port();
+    properties["Database"] = databaseName();
+    writer->setConnectionProperties(properties, {}, false);
+    return std::unique_ptr<AbstractSqlMigrationWriter>{writer};
+}
+
+QString PostgreSqlNativeStorage::backendId() const
+{
+    return QString("PostgreSQLNative");
+}
+
+QString PostgreSqlNativeStorage::description() const
+{
+    return tr("PostgreSQL storage that writes chat history directly through the PostgreSQL client library, using binary parameters "
+              "and pipelined statements. It uses the same database layout as the PostgreSQL backend, so you can switch between "
+              "the two at any time.");
+}
+
+bool PostgreSqlNativeStorage::logMessage(Message& msg)
+{
+    MessageList msgs{msg};
+    if (!logMessages(msgs))
+        return false;
+    msg.setMsgId(msgs.first().msgId());
+    return true;
+}
+
+bool PostgreSqlNativeStorage::logMessages(MessageList& msgs)
+{
+    QSqlDatabase db = logDb();
+    PGconn* conn = nativeConnection(db);
+    if (!conn) {
+        // Let the QtSql path deal with reconnecting and reporting errors
+        return PostgreSqlStorage::logMessages(msgs);
+    }
+
+    if (!beginTransaction(db)) {
+        qWarning() << "PostgreSqlNativeStorage::logMessages(): cannot start transaction!";
+        qWarning() << " -" << qPrintable(db.lastError().text());
+        return false;
+    }
+
+    // Look up or add all senders we don't know yet in one go
+    QHash<SenderData, qint64> newSenderIds;
+    std::vector<SenderData> missingSenders;
+    for (auto&& msg : msgs) {
+        SenderData sender = {msg.sender(), msg.realName(), msg.avatarUrl()};
+        if (_senderIds.find(sender) < 0 && !newSenderIds.contains(sender)) {
+            newSenderIds.insert(sender, -1);
+            missingSenders.push_back(std::move(sender));
+        }
+    }
+
+    bool error = false;
+    if (!missingSenders.empty()) {
+        std::vector<Params> senderParams(missingSenders.size());
+        for (size_t i = 0; i < missingSenders.size(); i++) {
+            senderParams[i].addText(missingSenders[i].sender);
+            senderParams[i].addText(missingSenders[i].realname);
+            senderParams[i].addText(missingSenders[i].avatarurl);
+        }
+        std::vector<qint64> senderIds;
+        error = !execPrepared(conn, "select_or_insert_senderid", senderParams, senderIds);
+
+        for (size_t i = 0; !error && i < missingSenders.size(); i++) {
+            if (senderIds[i] < 0) {
+                // Another session added the same sender concurrently, and it wasn't visible yet when
+                // the statement started; now that its insert went through, it is.
+                std::vector<qint64> retryIds;
+                error = !execPrepared(conn, "select_senderid", {senderParams[i]}, retryIds) || retryIds.front() < 0;
+                senderIds[i] = error ? -1 : retryIds.front();
+            }
+            newSenderIds[missingSenders[i]] = senderIds[i];
+        }
+    }
+
+    std::vector<qint64> msgIds;
+    if (!error) {
+        std::vector<Params> msgParams(msgs.count());
+        for (int i = 0; i < msgs.count(); i++) {
+            const Message& msg = msgs.at(i);
+            SenderData sender = {msg.sender(), msg.realName(), msg.avatarUrl()};
+            qint64 senderId = newSenderIds.value(sender, -1);
+            if (senderId < 0)
+                senderId = _senderIds.find(sender);
+
+            Params& params = msgParams[i];
+            params.addTimestamp(msg.timestamp());
+            params.addInt(msg.bufferInfo().bufferId().toInt());
+            params.addInt(msg.type());
+            params.addInt(static_cast<int>(msg.flags()));
+            params.addBigInt(senderId);
+            params.addText(msg.senderPrefixes());
+            params.addText(msg.contents());
+        }
+        error = !execPrepared(conn, "insert_message", msgParams, msgIds)
+                || std::any_of(msgIds.cbegin(), msgIds.cend(), [](qint64 id) { return id < 0; });
+    }
+
+    if (error || !db.commit()) {
+        db.rollback();
+        // we had a rollback in the db so we need to reset all msgIds
+        for (int i = 0; i < msgs.count(); i++) {
+            msgs[i].setMsgId(MsgId());
+        }
+        return false;
+    }
+
+    for (int i = 0; i < msgs.count(); i++) {
+        msgs[i].setMsgId(msgIds[i]);
+    }
+    for (auto it = newSenderIds.cbegin(); it != newSenderIds.cend(); ++it) {
+        _senderIds.insert(it.key(), it.value());
+    }
+    return true;
+}
+
+bool PostgreSqlNativeStorage::prepare(PGconn* conn, const QString& queryName, const Params& params)
+{
+    {
+        QMutexLocker locker(&_preparedMutex);
+        if (_prepared.value(conn).contains(queryName))
+            return true;
+    }
+
+    // Don't clash with the statements PostgreSqlStorage prepares through SQL
+    QByteArray statementName = "quassel_native_" + queryName.toUtf8();
+    QByteArray query = queryString(queryName).toUtf8();
+    PGresult* result = PQprepare(conn, statementName.constData(), query.constData(), params.count(), params.types());
+    bool success = PQresultStatus(result) == PGRES_COMMAND_OK;
+    if (!success)
+        qWarning() << "PostgreSqlNativeStorage::prepare(): unable to prepare query" << queryName << ":" << errorMessage(conn, result);
+    PQclear(result);
+
+    if (success) {
+        QMutexLocker locker(&_preparedMutex);
+        _prepared[conn].insert(queryName);
+    }
+    return success;
+}
+
+bool PostgreSqlNativeStorage::execPrepared(PGconn* conn,
+                                           const QString& queryName,
+                                           const std::vector<Params>& params,
+                                           std::vector<qint64>& results)
+{
+    results.assign(params.size(), -1);
+    if (params.empty())
+        return true;
+    if (!prepare(conn, queryName, params.front()))
+        return false;
+
+    QByteArray statementName = "quassel_native_" + queryName.toUtf8();
+    bool success = true;
+
+    // Returns false if the result is an error, storing the value of the first row otherwise
+    auto handleResult = [&](PGresult* result, size_t index) {
+        ExecStatusType status = PQresultStatus(result);
+        if (status == PGRES_TUPLES_OK) {
+            if (PQntuples(result) > 0 && PQgetlength(result, 0, 0) == 8)
+                results[index] = qFromBigEndian<qint64>(reinterpret_cast<const uchar*>(PQgetvalue(result, 0, 0)));
+            return true;
+        }
+        if (status == PGRES_COMMAND_OK)
+            return true;
+        if (status != PGRES_PIPELINE_ABORTED) {
+            qWarning() << "PostgreSqlNativeStorage::execPrepared(): query" << queryName << "failed:" << errorMessage(conn, result);
+            // Statements are gone if the server got restarted behind the connection's back
+            if (qstrcmp(PQresultErrorField(result, PG_DIAG_SQLSTATE), "26000") == 0) {
+                QMutexLocker locker(&_preparedMutex);
+                _prepared.remove(conn);
+            }
+        }
+        return false;
+    };
+
+#ifdef LIBPQ_HAS_PIPELINING
+    if (params.size() > 1) {
+        if (!PQenterPipelineMode(conn)) {
+            qWarning() << "PostgreSqlNativeStorage::execPrepared(): unable to enter pipeline mode:" << errorMessage(conn);
+            return false;
+        }
+        for (size_t offset = 0; offset < params.size(); offset += _maxPipelineLength) {
+            size_t count = std::min(params.size() - offset, static_cast<size_t>(_maxPipelineLength));
+            bool sent = true;
+            for (size_t i = offset; sent && i < offset + count; i++) {
+                const Params& p = params[i];
+                sent = PQsendQueryPrepared(conn, statementName.constData(), p.count(), p.values(), p.lengths(), p.formats(), 1);
+            }
+            if (!sent || !PQpipelineSync(conn)) {
+                // The connection is broken; QtSql will notice and reconnect next time
+                qWarning() << "PostgreSqlNativeStorage::execPrepared(): unable to send query" << queryName << ":" << errorMessage(conn);
+                PQexitPipelineMode(conn);
+                return false;
+            }
+
+            // Each query's results are followed by a nullptr, the whole batch by the sync point
+            for (size_t i = offset; i < offset + count; i++) {
+                while (PGresult* result = PQgetResult(conn)) {
+                    success = handleResult(result, i) && success;
+                    PQclear(result);
+                }
+            }
+            PGresult* sync = PQgetResult(conn);
+            if (PQresultStatus(sync) != PGRES_PIPELINE_SYNC)
+                success = false;
+            PQclear(sync);
+            if (!success)
+                break;
+        }
+        if (!PQexitPipelineMode(conn)) {
+            qWarning() << "PostgreSqlNativeStorage::execPrepared(): unable to leave pipeline mode:" << errorMessage(conn);
+            success = false;
+        }
+        return success;
+    }
+#endif
+
+    // One round trip each, but still without any formatting and parsing of parameters
+    for (size_t i = 0; success && i < params.size(); i++) {
+        const Params& p = params[i];
+        PGresult* result = PQexecPrepared(conn, statementName.constData(), p.count(), p.values(), p.lengths(), p.formats(), 1);
+        success = handleResult(result, i);
+        PQclear(result);
+    }
+    return success;
+}
+
+// ========================================
+//  PostgreSqlNativeMigrationWriter
+// ========================================
+
+namespace {
+
+// Signature, flags and header extension length of the binary COPY format
+const char copyHeader[] = "PGCOPY\n\377\r\n\0\0\0\0\0\0\0\0\0";
+const int copyHeaderSize = 19;
+// Amount of data to collect before handing it to libpq
+const int copyChunkSize = 1024 * 1024;
+
+void appendCopyField(QByteArray& buffer, const QByteArray& value)
+{
+    buffer += bigEndian<qint32>(value.size());
+    buffer += value;
+}
+
+void appendCopyField(QByteArray& buffer, const QString& value)
+{
+    if (value.isNull())
+        buffer += bigEndian<qint32>(-1);
+    else
+        appendCopyField(buffer, value.toUtf8());
+}
+
+}  // namespace
+
+bool PostgreSqlNativeMigrationWriter::prepareQuery(MigrationObject mo)
+{
+    if (_copyConnection && !endCopy())
+        return false;
+
+    switch (mo) {
+    case Sender:
+        return beginCopy("COPY sender (senderid, sender, realname, avatarurl) FROM STDIN (FORMAT binary)");
+    case Backlog:
+        return beginCopy("COPY backlog (messageid, time, bufferid, type, flags, senderid, senderprefixes, message) "
+                         "FROM STDIN (FORMAT binary)");
+    default:
+        return PostgreSqlMigrationWriter::prepareQuery(mo);
+    }
+}
+
+bool PostgreSqlNativeMigrationWriter::writeMo(const SenderMO& sender)
+{
+    if (!_copyConnection)
+        return PostgreSqlMigrationWriter::writeMo(sender);
+
+    _copyBuffer += bigEndian<qint16>(4);
+    appendCopyField(_copyBuffer, bigEndian<qint64>(sender.senderId));
+    appendCopyField(_copyBuffer, sender.sender);
+    appendCopyField(_copyBuffer, sender.realname);
+    appendCopyField(_copyBuffer, sender.avatarurl);
+    return flushCopy();
+}
+
+bool PostgreSqlNativeMigrationWriter::writeMo(const BacklogMO& backlog)
+{
+    if (!_copyConnection)
+        return PostgreSqlMigrationWriter::writeMo(backlog);
+
+    _copyBuffer += bigEndian<qint16>(8);
+    appendCopyField(_copyBuffer, bigEndian<qint64>(backlog.messageid.toQint64()));
+    appendCopyField(_copyBuffer, timestampBytes(backlog.time));
+    appendCopyField(_copyBuffer, bigEndian<qint32>(backlog.bufferid.toInt()));
+    appendCopyField(_copyBuffer, bigEndian<qint32>(backlog.type));
+    appendCopyField(_copyBuffer, bigEndian<qint32>(backlog.flags));
+    appendCopyField(_copyBuffer, bigEndian<qint64>(backlog.senderid));
+    appendCopyField(_copyBuffer, backlog.senderprefixes);
+    appendCopyField(_copyBuffer, backlog.message);
+    return flushCopy();
+}
+
+bool PostgreSqlNativeMigrationWriter::postProcess()
+{
+    if (_copyConnection && !endCopy())
+        return false;
+    return PostgreSqlMigrationWriter::postProcess();
+}
+
+void PostgreSqlNativeMigrationWriter::rollback()
+{
+    // The connection won't take any other commands until the COPY is over
+    if (_copyConnection) {
+        _copyBuffer.clear();
+        endCopy("migration aborted");
+    }
+    PostgreSqlMigrationWriter::rollback();
+}
+
+bool PostgreSqlNativeMigrationWriter::beginCopy(const char* statement)
+{
+    PGconn* conn = nativeConnection(logDb());
+    if (!conn) {
+        qWarning() << "PostgreSqlNativeMigrationWriter::beginCopy(): no usable connection";
+        return false;
+    }
+
+    PGresult* result = PQexec(conn, statement);
+    bool success = PQresultStatus(result) == PGRES_COPY_IN;
+    if (!success)
+        qWarning() << "PostgreSqlNativeMigrationWriter::beginCopy(): unable to start COPY:" << errorMessage(conn, result);
+    PQclear(result);
+    if (!success)
+        return false;
+
+    _copyConnection = conn;
+    _copyBuffer = QByteArray(copyHeader, copyHeaderSize);
+    return true;
+}
+
+bool PostgreSqlNativeMigrationWriter::flushCopy(bool force)
+{
+    if (_copyBuffer.isEmpty() || (!force && _copyBuffer.size() < copyChunkSize))
+        return true;
+
+    bool success = PQputCopyData(_copyConnection, _copyBuffer.constData(), _copyBuffer.size()) == 1;
+    if (!success)
+        qWarning() << "PostgreSqlNativeMigrationWriter::flushCopy(): unable to send data:" << errorMessage(_copyConnection);
+    _copyBuffer.clear();
+    return success;
+}
+
+bool PostgreSqlNativeMigrationWriter::endCopy(const char* abortReason)
+{
+    bool success = true;
+    if (!abortReason) {
+        _copyBuffer += bigEndian<qint16>(-1);
+        success = flushCopy(true);
+        if (!success)
+            abortReason = "unable to send data";
+    }
+    _copyBuffer.clear();
+
+    PGconn* conn = _copyConnection;
+    _copyConnection = nullptr;
+    if (PQputCopyEnd(conn, abortReason) != 1)
+        success = false;
+    while (PGresult* result = PQgetResult(conn)) {
+        if (PQresultStatus(result) != PGRES_COMMAND_OK) {
+            if (success)
+                qWarning() << "PostgreSqlNativeMigrationWriter::endCopy(): COPY failed:" << errorMessage(conn, result);
+            success = false;
+        }
+        PQclear(result);
+    }
+    return success;
+}
@@ -0,0 +1,130 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+
+#include "postgresqlstorage.h"
+
+struct pg_conn;
+
+/**
+ * PostgreSQL storage backend writing the backlog through libpq directly
+ *
+ * This uses the same database, schema and queries as PostgreSqlStorage, and only replaces the hot
+ * write paths.  Instead of formatting every parameter into an EXECUTE statement, messages and
+ * senders are sent as binary parameters of statements prepared through the protocol, and a batch
+ * of messages is sent as a pipeline, so it only takes a few round trips regardless of its size.
+ * Migrations into this backend use COPY for the sender and backlog tables.
+ *
+ * libpq is used on the connections opened by the QtSql driver, so both share the same sessions
+ * and transactions.  Everything else goes through PostgreSqlStorage unchanged, which makes both
+ * backends interchangeable on an existing database.
+ */
+class PostgreSqlNativeStorage : public PostgreSqlStorage
+{
+    Q_OBJECT
+
+public:
+    PostgreSqlNativeStorage(QObject* parent = nullptr);
+
+    std::unique_ptr<AbstractSqlMigrationWriter> createMigrationWriter() override;
+
+    /* General */
+    QString backendId() const override;
+    QString description() const override;
+
+    /* Message handling */
+    bool logMessage(Message& msg) override;
+    bool logMessages(MessageList& msgs) override;
+
+protected:
+    // Share the schema and queries of the QtSql based backend
+    QString queryFolder() const override { return PostgreSqlStorage::backendId(); }
+
+private:
+    /// Binary parameters for a prepared statement
+    class Params;
+
+    /**
+     * Executes a prepared statement once for every parameter set
+     *
+     * The statement is prepared on the connection first if needed.  If libpq supports it, all
+     * executions are pipelined.  Every execution must return at most one row, whose first column
+     * is a bigint.
+     *
+     * @param[in]  conn       The connection to use, in a transaction
+     * @param[in]  queryName  File name of the SQL query, minus the .sql extension
+     * @param[in]  params     Parameters for each execution
+     * @param[out] results    First column of each result row, or -1 for executions without result
+     * @return True on success, false if any execution failed
+     */
+    bool execPrepared(pg_conn* conn, const QString& queryName, const std::vector<Params>& params, std::vector<qint64>& results);
+
+    /// Prepares the given query on the connection, unless that happened already
+    bool prepare(pg_conn* conn, const QString& queryName, const Params& params);
+
+    QMutex _preparedMutex;
+    QHash<pg_conn*, QSet<QString>> _prepared;  ///< Statements prepared on each connection
+
+    static const int _maxPipelineLength;
+};
+
+// ========================================
+//  PostgreSqlNativeMigrationWriter
+// ========================================
+/**
+ * Migration writer using COPY for the bulk of the data
+ *
+ * Senders and backlog are streamed into the database in the binary COPY format, all other tables
+ * are written by PostgreSqlMigrationWriter.
+ */
+class PostgreSqlNativeMigrationWriter : public PostgreSqlMigrationWriter
+{
+    Q_OBJECT
+
+public:
+    using PostgreSqlMigrationWriter::writeMo;
+
+    bool writeMo(const SenderMO& sender) override;
+    bool writeMo(const BacklogMO& backlog) override;
+
+    bool prepareQuery(MigrationObject mo) override;
+
+    bool postProcess() override;
+
+protected:
+    void rollback() override;
+
+private:
+    bool beginCopy(const char* statement);
+    bool flushCopy(bool force = false);
+    bool endCopy(const char* abortReason = nullptr);
+
+    pg_conn* _copyConnection{nullptr};
+    QByteArray _copyBuffer;
+};
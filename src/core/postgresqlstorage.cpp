@@ -20,6 +20,9 @@
 
 #include "postgresqlstorage.h"
 
+#include <algorithm>
+#include <limits>
+
 #include <QByteArray>
 #include <QDataStream>
 #include <QSqlDriver>
@@ -28,6 +31,8 @@
 #include "network.h"
 #include "quassel.h"
 
+int PostgreSqlStorage::_maxInsertRows = 100;
+
 PostgreSqlStorage::PostgreSqlStorage(QObject* parent)
     : AbstractSqlStorage(parent)
 {}
@@ -1589,6 +1594,31 @@ void PostgreSqlStorage::setHighlightCount(UserId user, BufferId bufferId, int hi
     watchQuery(query);
 }
 
+void PostgreSqlStorage::setBufferStates(UserId user, const std::vector<BufferState>& states)
+{
+    if (states.empty())
+        return;
+
+    QSqlDatabase db = logDb();
+    if (!db.transaction()) {
+        qWarning() << "PostgreSqlStorage::setBufferStates(): cannot start transaction!";
+        qWarning() << " -" << qPrintable(db.lastError().text());
+        return;
+    }
+
+    QSqlQuery query(db);
+    query.prepare(queryString("update_buffer_state"));
+    for (auto&& state : states) {
+        bindBufferState(query, user, state);
+        safeExec(query);
+        if (!watchQuery(query)) {
+            db.rollback();
+            return;
+        }
+    }
+    db.commit();
+}
+
 QHash<BufferId, int> PostgreSqlStorage::highlightCounts(UserId user)
 {
     QHash<BufferId, int> highlightCountHash;
@@ -1700,16 +1730,19 @@ bool PostgreSqlStorage::logMessages(MessageList& msgs)
         return false;
     }
 
-    QList<int> senderIdList;
-    QHash<SenderData, qint64> senderIds;
+    QList<qint64> senderIdList;
+    // Senders added in this transaction; they must only be cached once it has been committed
+    QHash<SenderData, qint64> newSenderIds;
     QSqlQuery addSenderQuery;
     QSqlQuery selectSenderQuery;
-    ;
     for (int i = 0; i < msgs.count(); i++) {
         auto& msg = msgs.at(i);
         SenderData sender = {msg.sender(), msg.realName(), msg.avatarUrl()};
-        if (senderIds.contains(sender)) {
-            senderIdList << senderIds[sender];
+        qint64 senderId = _senderIds.find(sender);
+        if (senderId < 0)
+            senderId = newSenderIds.value(sender, -1);
+        if (senderId >= 0) {
+            senderIdList << senderId;
             continue;
         }
 
@@ -1718,8 +1751,7 @@ bool PostgreSqlStorage::logMessages(MessageList& msgs)
 
         selectSenderQuery = executePreparedQuery("select_senderid", senderParams, db);
         if (selectSenderQuery.first()) {
-            senderIdList << selectSenderQuery.value(0).toLongLong();
-            senderIds[sender] = selectSenderQuery.value(0).toLongLong();
+            senderId = selectSenderQuery.value(0).toLongLong();
         }
         else {
             savePoint("sender_sp", db);
@@ -1730,40 +1762,68 @@ bool PostgreSqlStorage::logMessages(MessageList& msgs)
                 selectSenderQuery = executePreparedQuery("select_senderid", senderParams, db);
                 watchQuery(selectSenderQuery);
                 selectSenderQuery.first();
-                senderIdList << selectSenderQuery.value(0).toLongLong();
-                senderIds[sender] = selectSenderQuery.value(0).toLongLong();
+                senderId = selectSenderQuery.value(0).toLongLong();
             }
             else {
                 releaseSavePoint("sender_sp", db);
                 addSenderQuery.first();
-                senderIdList << addSenderQuery.value(0).toLongLong();
-                senderIds[sender] = addSenderQuery.value(0).toLongLong();
+                senderId = addSenderQuery.value(0).toLongLong();
             }
         }
+        senderIdList << senderId;
+        newSenderIds[sender] = senderId;
     }
 
-    // yes we loop twice over the same list. This avoids alternating queries.
+    // Reserve the message IDs up front, so we don't depend on the order of the rows RETURNING gives us
     bool error = false;
-    for (int i = 0; i < msgs.count(); i++) {
-        Message& msg = msgs[i];
-        QVariantList params;
-        // PostgreSQL handles QDateTime()'s serialized format by default, and QDateTime() serializes
-        // to a 64-bit time compatible format by default.
-        params << msg.timestamp() << msg.bufferInfo().bufferId().toInt() << msg.type() << (int)msg.flags() << senderIdList.at(i)
-               << msg.senderPrefixes() << msg.contents();
-        QSqlQuery logMessageQuery = executePreparedQuery("insert_message", params, db);
-        if (!watchQuery(logMessageQuery)) {
-            db.rollback();
-            error = true;
-            break;
+    QList<qint64> msgIdList;
+    QSqlQuery selectMsgIdsQuery = executePreparedQuery("select_messageids", msgs.count(), db);
+    if (!watchQuery(selectMsgIdsQuery)) {
+        error = true;
+    }
+    else {
+        while (selectMsgIdsQuery.next()) {
+            msgIdList << selectMsgIdsQuery.value(0).toLongLong();
         }
-        else {
-            logMessageQuery.first();
-            msg.setMsgId(logMessageQuery.value(0).toLongLong());
+        std::sort(msgIdList.begin(), msgIdList.end());
+        error = msgIdList.count() != msgs.count();
+    }
+
+    // Insert in chunks of multi-row statements; the statement only needs preparing again when the chunk size changes
+    QSqlQuery logMessagesQuery(db);
+    int preparedRows = 0;
+    for (int offset = 0; !error && offset < msgs.count(); offset += _maxInsertRows) {
+        int rows = std::min(_maxInsertRows, msgs.count() - offset);
+        if (rows != preparedRows) {
+            QString values = QString("(?, ?, ?, ?, ?, ?, ?, ?), ").repeated(rows);
+            values.chop(2);
+            logMessagesQuery.prepare(queryString("insert_messages") + values);
+            preparedRows = rows;
+        }
+
+        int pos = 0;
+        for (int i = offset; i < offset + rows; i++) {
+            Message& msg = msgs[i];
+            // PostgreSQL handles QDateTime()'s serialized format by default, and QDateTime() serializes
+            // to a 64-bit time compatible format by default.
+            logMessagesQuery.bindValue(pos++, msgIdList.at(i));
+            logMessagesQuery.bindValue(pos++, msg.timestamp());
+            logMessagesQuery.bindValue(pos++, msg.bufferInfo().bufferId().toInt());
+            logMessagesQuery.bindValue(pos++, msg.type());
+            logMessagesQuery.bindValue(pos++, (int)msg.flags());
+            logMessagesQuery.bindValue(pos++, senderIdList.at(i));
+            logMessagesQuery.bindValue(pos++, msg.senderPrefixes());
+            logMessagesQuery.bindValue(pos++, msg.contents());
+        }
+
+        safeExec(logMessagesQuery);
+        if (!watchQuery(logMessagesQuery)) {
+            error = true;
         }
     }
 
     if (error) {
+        db.rollback();
         // we had a rollback in the db so we need to reset all msgIds
         for (int i = 0; i < msgs.count(); i++) {
             msgs[i].setMsgId(MsgId());
@@ -1772,6 +1832,12 @@ bool PostgreSqlStorage::logMessages(MessageList& msgs)
     }
 
     db.commit();
+    for (int i = 0; i < msgs.count(); i++) {
+        msgs[i].setMsgId(msgIdList.at(i));
+    }
+    for (auto it = newSenderIds.cbegin(); it != newSenderIds.cend(); ++it) {
+        _senderIds.insert(it.key(), it.value());
+    }
     return true;
 }
 
@@ -2107,6 +2173,137 @@ std::vector<Message> PostgreSqlStorage::requestAllMsgsFiltered(
     return messagelist;
 }
 
+std::vector<Message> PostgreSqlStorage::searchMsgs(UserId user,
+                                                   const QString& query,
+                                                   NetworkId networkId,
+                                                   BufferId bufferId,
+                                                   const QString& sender,
+                                                   Message::Types type,
+                                                   const QDateTime& start,
+                                                   const QDateTime& end,
+                                                   MsgId last,
+                                                   int limit)
+{
+    std::vector<Message> messagelist;
+    if (query.trimmed().isEmpty() && sender.trimmed().isEmpty())
+        return messagelist;
+
+    // requestBuffers uses it's own transaction.
+    QHash<BufferId, BufferInfo> bufferInfoHash;
+    foreach (BufferInfo bufferInfo, requestBuffers(user)) {
+        bufferInfoHash[bufferInfo.bufferId()] = bufferInfo;
+    }
+
+    QSqlDatabase db = logDb();
+    if (!beginReadOnlyTransaction(db)) {
+        qWarning() << "PostgreSqlStorage::searchMsgs(): cannot start read only transaction!";
+        qWarning() << " -" << qPrintable(db.lastError().text());
+        return messagelist;
+    }
+
+    QSqlQuery searchQuery(db);
+    searchQuery.prepare(queryString("select_messagesSearch"));
+    searchQuery.bindValue(":userid", user.toInt());
+    searchQuery.bindValue(":networkid", networkId.toInt());
+    searchQuery.bindValue(":bufferid", bufferId.toInt());
+    searchQuery.bindValue(":query", query.trimmed());
+    searchQuery.bindValue(":sender", sender.trimmed());
+    searchQuery.bindValue(":lastmsg", last == -1 ? std::numeric_limits<qint64>::max() : last.toQint64());
+    // PostgreSQL knows infinite timestamps, which saves us from having separate queries for open ranges
+    searchQuery.bindValue(":starttime", start.isValid() ? QVariant(start.toUTC()) : QVariant(QString("-infinity")));
+    searchQuery.bindValue(":endtime", end.isValid() ? QVariant(end.toUTC()) : QVariant(QString("infinity")));
+    int typeRaw = type;
+    searchQuery.bindValue(":type", typeRaw);
+    // LIMIT NULL means no limit
+    searchQuery.bindValue(":limit", limit > 0 ? QVariant(limit) : QVariant(QVariant::Int));
+
+    safeExec(searchQuery);
+    if (!watchQuery(searchQuery)) {
+        db.rollback();
+        return messagelist;
+    }
+
+    QDateTime timestamp;
+    while (searchQuery.next()) {
+        timestamp = searchQuery.value(2).toDateTime();
+        timestamp.setTimeSpec(Qt::UTC);
+        Message msg(timestamp,
+                    bufferInfoHash[searchQuery.value(1).toInt()],
+                    (Message::Type)searchQuery.value(3).toInt(),
+                    searchQuery.value(9).toString(),
+                    searchQuery.value(5).toString(),
+                    searchQuery.value(6).toString(),
+                    searchQuery.value(7).toString(),
+                    searchQuery.value(8).toString(),
+                    Message::Flags{searchQuery.value(4).toInt()});
+        msg.setMsgId(searchQuery.value(0).toLongLong());
+        messagelist.push_back(std::move(msg));
+    }
+
+    db.commit();
+    return messagelist;
+}
+
+std::vector<Message> PostgreSqlStorage::requestExpiredMsgs(UserId user, const BufferInfo& bufferInfo, const QDateTime& before, int limit)
+{
+    Q_UNUSED(user)
+    std::vector<Message> messagelist;
+
+    QSqlDatabase db = logDb();
+    if (!beginReadOnlyTransaction(db)) {
+        qWarning() << "PostgreSqlStorage::requestExpiredMsgs(): cannot start read only transaction!";
+        qWarning() << " -" << qPrintable(db.lastError().text());
+        return messagelist;
+    }
+
+    QSqlQuery query(db);
+    query.prepare(queryString("select_messagesExpired"));
+    query.bindValue(":bufferid", bufferInfo.bufferId().toInt());
+    query.bindValue(":before", before.toUTC());
+    query.bindValue(":limit", limit);
+
+    safeExec(query);
+    if (!watchQuery(query)) {
+        db.rollback();
+        return messagelist;
+    }
+
+    QDateTime timestamp;
+    while (query.next()) {
+        timestamp = query.value(2).toDateTime();
+        timestamp.setTimeSpec(Qt::UTC);
+        Message msg(timestamp,
+                    bufferInfo,
+                    (Message::Type)query.value(3).toInt(),
+                    query.value(9).toString(),
+                    query.value(5).toString(),
+                    query.value(6).toString(),
+                    query.value(7).toString(),
+                    query.value(8).toString(),
+                    Message::Flags{query.value(4).toInt()});
+        msg.setMsgId(query.value(0).toLongLong());
+        messagelist.push_back(std::move(msg));
+    }
+
+    db.commit();
+    return messagelist;
+}
+
+int PostgreSqlStorage::deleteExpiredMsgs(UserId user, BufferId bufferId, const QDateTime& before, MsgId last, int limit)
+{
+    Q_UNUSED(user)
+    QSqlQuery query(logDb());
+    query.prepare(queryString("delete_backlog_expired"));
+    query.bindValue(":bufferid", bufferId.toInt());
+    query.bindValue(":before", before.toUTC());
+    query.bindValue(":lastmsg", last == -1 ? std::numeric_limits<qint64>::max() : last.toQint64());
+    query.bindValue(":limit", limit);
+    safeExec(query);
+    if (!watchQuery(query))
+        return -1;
+    return query.numRowsAffected();
+}
+
 QMap<UserId, QString> PostgreSqlStorage::getAllAuthUserNames()
 {
     QMap<UserId, QString> authusernames;
@@ -100,6 +100,7 @@ public:
     QHash<BufferId, Message::Types> bufferActivities(UserId id) override;
     Message::Types bufferActivity(BufferId bufferId, MsgId lastSeenMsgId) override;
     void setHighlightCount(UserId id, BufferId bufferId, int count) override;
+    void setBufferStates(UserId user, const std::vector<BufferState>& states) override;
     QHash<BufferId, int> highlightCounts(UserId id) override;
     int highlightCount(BufferId bufferId, MsgId lastSeenMsgId) override;
     QHash<QString, QByteArray> bufferCiphers(UserId user, const NetworkId& networkId) override;
@@ -130,6 +131,18 @@ public:
                                                 int limit = -1,
                                                 Message::Types type = Message::Types{-1},
                                                 Message::Flags flags = Message::Flags{-1}) override;
+    std::vector<Message> searchMsgs(UserId user,
+                                    const QString& query,
+                                    NetworkId networkId,
+                                    BufferId bufferId,
+                                    const QString& sender,
+                                    Message::Types type,
+                                    const QDateTime& start,
+                                    const QDateTime& end,
+                                    MsgId last,
+                                    int limit) override;
+    std::vector<Message> requestExpiredMsgs(UserId user, const BufferInfo& bufferInfo, const QDateTime& before, int limit) override;
+    int deleteExpiredMsgs(UserId user, BufferId bufferId, const QDateTime& before, MsgId last, int limit) override;
 
     /* Sysident handling */
     QMap<UserId, QString> getAllAuthUserNames() override;
@@ -189,6 +202,8 @@ private:
     QString _databaseName;
     QString _userName;
     QString _password;
+    SenderIdCache _senderIds;
+    static int _maxInsertRows;
 };
 
 // ========================================
@@ -0,0 +1,113 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "retentionpolicy.h"
+
+#include <QCoreApplication>
+#include <QPair>
+#include <QStringList>
+
+int RetentionPolicy::Rule::specificity() const
+{
+    return (userName.isEmpty() ? 0 : 4) + (networkId.isValid() ? 2 : 0) + (bufferType == BufferInfo::InvalidBuffer ? 0 : 1);
+}
+
+bool RetentionPolicy::addRule(const QString& rule, QString* errorString)
+{
+    auto fail = [&](const QString& error) {
+        if (errorString)
+            *errorString = QCoreApplication::translate("RetentionPolicy", "Invalid retention rule \"%1\": %2").arg(rule, error);
+        return false;
+    };
+
+    Rule result;
+    bool hasAge = false;
+    for (const QString& part : rule.split(',', QString::SkipEmptyParts)) {
+        QString key = part.section('=', 0, 0).trimmed().toLower();
+        QString value = part.section('=', 1).trimmed();
+        bool ok = true;
+        if (key == "user") {
+            result.userName = value;
+            ok = !value.isEmpty();
+        }
+        else if (key == "network") {
+            result.networkId = value.toInt(&ok);
+            ok = ok && result.networkId.isValid();
+        }
+        else if (key == "buffertype") {
+            static const QList<QPair<QString, BufferInfo::Type>> types{{"status", BufferInfo::StatusBuffer},
+                                                                        {"channel", BufferInfo::ChannelBuffer},
+                                                                        {"query", BufferInfo::QueryBuffer},
+                                                                        {"group", BufferInfo::GroupBuffer}};
+            ok = false;
+            for (auto&& type : types) {
+                if (type.first == value.toLower()) {
+                    result.bufferType = type.second;
+                    ok = true;
+                }
+            }
+        }
+        else if (key == "days") {
+            result.maxAge = value.toInt(&ok);
+            ok = ok && result.maxAge >= 0;
+            hasAge = true;
+        }
+        else if (key == "archive" && !part.contains('=')) {
+            result.archive = true;
+        }
+        else {
+            return fail(QCoreApplication::translate("RetentionPolicy", "unknown setting \"%1\"").arg(part.trimmed()));
+        }
+        if (!ok)
+            return fail(QCoreApplication::translate("RetentionPolicy", "invalid value for \"%1\"").arg(key));
+    }
+    if (!hasAge)
+        return fail(QCoreApplication::translate("RetentionPolicy", "missing \"days\""));
+
+    _rules.push_back(std::move(result));
+    return true;
+}
+
+bool RetentionPolicy::addRules(const QString& rules, QString* errorString)
+{
+    for (const QString& rule : rules.split(';', QString::SkipEmptyParts)) {
+        if (!addRule(rule.trimmed(), errorString))
+            return false;
+    }
+    return true;
+}
+
+const RetentionPolicy::Rule* RetentionPolicy::rule(const QString& userName, const BufferInfo& bufferInfo) const
+{
+    const Rule* result = nullptr;
+    for (auto&& rule : _rules) {
+        if (!rule.userName.isEmpty() && rule.userName != userName)
+            continue;
+        if (rule.networkId.isValid() && rule.networkId != bufferInfo.networkId())
+            continue;
+        if (rule.bufferType != BufferInfo::InvalidBuffer && rule.bufferType != bufferInfo.type())
+            continue;
+        if (!result || rule.specificity() >= result->specificity())
+            result = &rule;
+    }
+    if (result && result->maxAge == 0)
+        return nullptr;
+    return result;
+}
@@ -0,0 +1,89 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include "core-export.h"
+
+#include <vector>
+
+#include <QString>
+
+#include "bufferinfo.h"
+#include "types.h"
+
+/**
+ * Decides how long the backlog of a buffer is kept
+ *
+ * A policy consists of rules, each matching buffers by user name, network and buffer type, any of
+ * which may be left out.  For a given buffer, the most specific matching rule applies; of equally
+ * specific rules, the one added last wins.
+ *
+ * Rules are given as comma-separated key=value pairs:
+ *   [user=<name>,][network=<id>,][buffertype=status|channel|query|group,]days=<n>[,archive]
+ * where days=0 keeps the backlog forever, and archive moves expired messages into the backlog
+ * archive instead of deleting them.
+ */
+class CORE_EXPORT RetentionPolicy
+{
+public:
+    struct Rule
+    {
+        QString userName;                                        ///< Matches all users if empty
+        NetworkId networkId;                                     ///< Matches all networks if invalid
+        BufferInfo::Type bufferType{BufferInfo::InvalidBuffer};  ///< Matches all buffer types if InvalidBuffer
+        int maxAge{0};                                           ///< Maximum age of messages in days, 0 for unlimited
+        bool archive{false};                                     ///< Whether expired messages are archived rather than deleted
+
+        int specificity() const;
+    };
+
+    /**
+     * Parses a rule and adds it to the policy
+     *
+     * @param rule         The rule, as described above
+     * @param errorString  Set to a description of the problem if the rule is invalid
+     * @return true if the rule has been added
+     */
+    bool addRule(const QString& rule, QString* errorString = nullptr);
+
+    /**
+     * Parses a list of rules separated by semicolons
+     *
+     * @param rules        The rules
+     * @param errorString  Set to a description of the problem if a rule is invalid
+     * @return true if all rules have been added
+     */
+    bool addRules(const QString& rules, QString* errorString = nullptr);
+
+    bool isEmpty() const { return _rules.empty(); }
+
+    /**
+     * Looks up the rule for a buffer
+     *
+     * @param userName    The name of the buffer's owner
+     * @param bufferInfo  The buffer
+     * @return The applicable rule, or nullptr if the backlog is to be kept forever
+     */
+    const Rule* rule(const QString& userName, const BufferInfo& bufferInfo) const;
+
+private:
+    std::vector<Rule> _rules;
+};
@@ -0,0 +1,142 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "sessionscheduler.h"
+
+#include <algorithm>
+
+#include <QDebug>
+#include <QThread>
+
+#include "sessionthread.h"
+
+const int SessionScheduler::_rebalanceInterval = 30 * 1000;
+const quint64 SessionScheduler::_minLoad = 100;
+
+SessionScheduler::SessionScheduler(int workerCount, QObject* parent)
+    : QObject(parent)
+{
+    if (workerCount <= 0)
+        workerCount = std::max(1, QThread::idealThreadCount());
+
+    _workers.resize(workerCount);
+    for (int i = 0; i < workerCount; i++) {
+        _workers[i].thread.reset(new QThread);
+        _workers[i].thread->setObjectName(QString("SessionWorker%1").arg(i));
+        _workers[i].thread->start();
+    }
+    qInfo() << "Running sessions on" << workerCount << "worker threads";
+
+    _rebalanceTimer.setParent(this);
+    connect(&_rebalanceTimer, &QTimer::timeout, this, &SessionScheduler::rebalance);
+    _rebalanceTimer.start(_rebalanceInterval);
+}
+
+SessionScheduler::~SessionScheduler()
+{
+    for (auto&& worker : _workers) {
+        worker.thread->quit();
+    }
+    for (auto&& worker : _workers) {
+        worker.thread->wait(30000);
+    }
+}
+
+QThread* SessionScheduler::assign(SessionThread* session)
+{
+    // Nothing is known about the new session's load yet, so just keep the number of sessions even
+    auto worker = std::min_element(_workers.begin(), _workers.end(), [](const Worker& a, const Worker& b) {
+        return a.sessions.size() < b.sessions.size();
+    });
+    worker->sessions.push_back(session);
+    _lastActivity[session] = session->activity();
+    return worker->thread.get();
+}
+
+void SessionScheduler::release(SessionThread* session)
+{
+    for (auto&& worker : _workers) {
+        worker.sessions.erase(std::remove(worker.sessions.begin(), worker.sessions.end(), session), worker.sessions.end());
+    }
+    _lastActivity.remove(session);
+}
+
+void SessionScheduler::rebalance()
+{
+    std::vector<std::vector<quint64>> loads(_workers.size());
+    for (size_t i = 0; i < _workers.size(); i++) {
+        for (auto&& session : _workers[i].sessions) {
+            quint64 activity = session->activity();
+            loads[i].push_back(activity - _lastActivity.value(session));
+            _lastActivity[session] = activity;
+        }
+    }
+
+    Migration migration = planMigration(loads);
+    if (!migration.isValid())
+        return;
+
+    Worker& source = _workers[migration.worker];
+    Worker& target = _workers[migration.target];
+    SessionThread* session = source.sessions[migration.session];
+    if (!session->moveToWorker(target.thread.get()))
+        return;
+
+    source.sessions.erase(source.sessions.begin() + migration.session);
+    target.sessions.push_back(session);
+    qInfo() << "Moving session from" << source.thread->objectName() << "to" << target.thread->objectName();
+}
+
+SessionScheduler::Migration SessionScheduler::planMigration(const std::vector<std::vector<quint64>>& loads)
+{
+    Migration migration;
+    if (loads.size() < 2)
+        return migration;
+
+    std::vector<quint64> totals;
+    for (auto&& sessions : loads) {
+        quint64 total = 0;
+        for (quint64 load : sessions)
+            total += load;
+        totals.push_back(total);
+    }
+    int busiest = static_cast<int>(std::max_element(totals.begin(), totals.end()) - totals.begin());
+    int idlest = static_cast<int>(std::min_element(totals.begin(), totals.end()) - totals.begin());
+    if (totals[busiest] < _minLoad)
+        return migration;
+
+    // Moving a session with load x leaves the busier of the two workers at max(busiest - x, idlest + x);
+    // pick the session that minimizes that, and only bother if it takes off a fifth of the peak load
+    quint64 best = totals[busiest];
+    for (size_t i = 0; i < loads[busiest].size(); i++) {
+        quint64 load = loads[busiest][i];
+        quint64 peak = std::max(totals[busiest] - load, totals[idlest] + load);
+        if (peak < best) {
+            best = peak;
+            migration.session = static_cast<int>(i);
+        }
+    }
+    if (migration.session < 0 || totals[busiest] - best < totals[busiest] / 5)
+        return Migration{};
+
+    migration.worker = busiest;
+    migration.target = idlest;
+    return migration;
+}
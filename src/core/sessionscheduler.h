@@ -0,0 +1,113 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include "core-export.h"
+
+#include <memory>
+#include <vector>
+
+#include <QHash>
+#include <QObject>
+#include <QTimer>
+
+class QThread;
+class SessionThread;
+
+/**
+ * Runs user sessions on a fixed pool of worker threads
+ *
+ * Instead of giving each session a thread (and event loop, and database connection) of its own,
+ * sessions are pinned to one of a few worker threads, starting out on the one with the fewest
+ * sessions.  Since database connections are pooled per thread, each worker also only needs one
+ * connection, no matter how many sessions it hosts.
+ *
+ * The scheduler periodically compares how busy the workers have been, measured by the number of
+ * messages their sessions handled, and moves a session from the busiest to the least busy worker
+ * if that evens out the load noticeably.
+ */
+class CORE_EXPORT SessionScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    /// A planned move of a session from one worker to another
+    struct Migration
+    {
+        int worker{-1};   ///< Index of the worker to move the session away from
+        int session{-1};  ///< Index of the session within its worker
+        int target{-1};   ///< Index of the worker to move the session to
+
+        bool isValid() const { return worker >= 0; }
+    };
+
+    /**
+     * Constructor
+     *
+     * @param workerCount  Number of worker threads; 0 uses one per CPU core
+     * @param parent       Parent object
+     */
+    SessionScheduler(int workerCount, QObject* parent = nullptr);
+    ~SessionScheduler() override;
+
+    int workerCount() const { return static_cast<int>(_workers.size()); }
+
+    /**
+     * Pins a new session to a worker
+     *
+     * @param session  The session
+     * @return The thread the session should run on
+     */
+    QThread* assign(SessionThread* session);
+
+    /**
+     * Forgets about a session that has shut down
+     *
+     * @param session  The session
+     */
+    void release(SessionThread* session);
+
+    /**
+     * Picks a session to move between workers, if any
+     *
+     * @param loads  For each worker, the recent load of each of its sessions
+     * @return The move that evens out the load between the busiest and the least busy worker the most,
+     *         or an invalid Migration if no move helps enough to be worth it
+     */
+    static Migration planMigration(const std::vector<std::vector<quint64>>& loads);
+
+private slots:
+    void rebalance();
+
+private:
+    struct Worker
+    {
+        std::unique_ptr<QThread> thread;
+        std::vector<SessionThread*> sessions;
+    };
+
+    std::vector<Worker> _workers;
+    QHash<SessionThread*, quint64> _lastActivity;  ///< Activity counters as of the last rebalancing
+    QTimer _rebalanceTimer;
+
+    static const int _rebalanceInterval;
+    static const quint64 _minLoad;
+};
@@ -27,6 +27,7 @@
 #include "coresession.h"
 #include "internalpeer.h"
 #include "remotepeer.h"
+#include "sessionscheduler.h"
 #include "signalproxy.h"
 
 namespace {
@@ -36,21 +37,30 @@ class Worker : public QObject
     Q_OBJECT
 
 public:
-    Worker(UserId userId, bool restoreState, bool strictIdentEnabled)
+    Worker(UserId userId, bool restoreState, bool strictIdentEnabled, std::shared_ptr<std::atomic<quint64>> activity)
         : _userId{userId}
         , _restoreState{restoreState}
         , _strictIdentEnabled{strictIdentEnabled}
+        , _activity{std::move(activity)}
     {}
 
 public slots:
     void initialize()
     {
         _session = new CoreSession{_userId, _restoreState, _strictIdentEnabled, this};
-        connect(_session, &QObject::destroyed, QThread::currentThread(), &QThread::quit);
+        connect(_session, &QObject::destroyed, this, &QObject::deleteLater);
         connect(_session, &CoreSession::sessionStateReceived, Core::instance(), &Core::sessionStateReceived);
+        connect(_session, &CoreSession::displayMsg, this, [this]() { _activity->fetch_add(1, std::memory_order_relaxed); });
         emit initialized();
     }
 
+    void moveTo(QThread* thread)
+    {
+        // The whole session is owned by this, so it all goes along, including pending events
+        moveToThread(thread);
+        emit moved();
+    }
+
     void shutdown()
     {
         if (_session) {
@@ -81,28 +91,43 @@ public slots:
 
 signals:
     void initialized();
+    void moved();
 
 private:
     UserId _userId;
     bool _restoreState;
     bool _strictIdentEnabled;  ///< Whether or not strict ident mode is enabled, locking users' idents to Quassel username
+    std::shared_ptr<std::atomic<quint64>> _activity;
     QPointer<CoreSession> _session;
 };
 
 }  // namespace
 
-SessionThread::SessionThread(UserId uid, bool restoreState, bool strictIdentEnabled, QObject* parent)
+SessionThread::SessionThread(UserId uid, bool restoreState, bool strictIdentEnabled, SessionScheduler* scheduler, QObject* parent)
     : QObject(parent)
+    , _thread{&_sessionThread}
+    , _scheduler{scheduler}
+    , _activity{std::make_shared<std::atomic<quint64>>(0)}
 {
-    auto worker = new Worker(uid, restoreState, strictIdentEnabled);
-    worker->moveToThread(&_sessionThread);
-    connect(&_sessionThread, &QThread::started, worker, &Worker::initialize);
-    connect(&_sessionThread, &QThread::finished, worker, &QObject::deleteLater);
+    auto worker = new Worker(uid, restoreState, strictIdentEnabled, _activity);
     connect(worker, &Worker::initialized, this, &SessionThread::onSessionInitialized);
+    connect(worker, &Worker::moved, this, &SessionThread::onSessionMoved);
     connect(worker, &QObject::destroyed, this, &SessionThread::onSessionDestroyed);
 
     connect(this, &SessionThread::addClientToWorker, worker, &Worker::addClient);
     connect(this, &SessionThread::shutdownSession, worker, &Worker::shutdown);
+    connect(this, &SessionThread::moveWorker, worker, &Worker::moveTo);
+
+    if (_scheduler) {
+        _thread = _scheduler->assign(this);
+        worker->moveToThread(_thread);
+        QMetaObject::invokeMethod(worker, "initialize", Qt::QueuedConnection);
+        return;
+    }
+
+    worker->moveToThread(&_sessionThread);
+    connect(&_sessionThread, &QThread::started, worker, &Worker::initialize);
+    connect(&_sessionThread, &QThread::finished, worker, &QObject::deleteLater);
 
     // Defer thread start through the event loop, so the SessionThread instance is fully constructed before
     QTimer::singleShot(0, &_sessionThread, SLOT(start()));
@@ -110,6 +135,9 @@ SessionThread::SessionThread(UserId uid, bool restoreState, bool strictIdentEnab
 
 SessionThread::~SessionThread()
 {
+    if (_scheduler)
+        _scheduler->release(this);
+
     // shut down thread gracefully
     _sessionThread.quit();
     _sessionThread.wait(30000);
@@ -120,32 +148,53 @@ void SessionThread::shutdown()
     emit shutdownSession();
 }
 
+bool SessionThread::moveToWorker(QThread* thread)
+{
+    if (!_sessionInitialized || _moving || thread == _thread)
+        return false;
+
+    _moving = true;
+    emit moveWorker(thread);
+    _thread = thread;
+    return true;
+}
+
 void SessionThread::onSessionInitialized()
 {
     _sessionInitialized = true;
-    for (auto&& peer : _clientQueue) {
-        peer->setParent(nullptr);
-        peer->moveToThread(&_sessionThread);
-        emit addClientToWorker(peer);
-    }
-    _clientQueue.clear();
+    flushClientQueue();
+}
+
+void SessionThread::onSessionMoved()
+{
+    _moving = false;
+    flushClientQueue();
 }
 
 void SessionThread::onSessionDestroyed()
 {
+    if (_scheduler)
+        _scheduler->release(this);
+    _sessionThread.quit();
     emit shutdownComplete(this);
 }
 
 void SessionThread::addClient(Peer* peer)
 {
-    if (_sessionInitialized) {
+    _clientQueue.push_back(peer);
+    if (_sessionInitialized && !_moving)
+        flushClientQueue();
+}
+
+void SessionThread::flushClientQueue()
+{
+    // Peers need to live in the session's thread, which is only known for sure while the session isn't moving
+    for (auto&& peer : _clientQueue) {
         peer->setParent(nullptr);
-        peer->moveToThread(&_sessionThread);
+        peer->moveToThread(_thread);
         emit addClientToWorker(peer);
     }
-    else {
-        _clientQueue.push_back(peer);
-    }
+    _clientQueue.clear();
 }
 
 #include "sessionthread.moc"
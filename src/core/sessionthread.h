@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 
 #include <QThread>
@@ -30,21 +31,49 @@ class CoreSession;
 class Peer;
 class InternalPeer;
 class RemotePeer;
+class SessionScheduler;
 
 class SessionThread : public QObject
 {
     Q_OBJECT
 
 public:
-    SessionThread(UserId user, bool restoreState, bool strictIdentEnabled, QObject* parent = nullptr);
+    /**
+     * Constructor
+     *
+     * @param user                The user to run the session for
+     * @param restoreState        Whether to restore the session's state from the last run
+     * @param strictIdentEnabled  Whether strict ident mode is enabled
+     * @param scheduler           Worker pool to run the session on, or nullptr to give it a thread of its own
+     * @param parent              Parent object
+     */
+    SessionThread(UserId user,
+                  bool restoreState,
+                  bool strictIdentEnabled,
+                  SessionScheduler* scheduler = nullptr,
+                  QObject* parent = nullptr);
     ~SessionThread() override;
 
+    /// The number of messages the session has handled so far, as a measure of how busy it is
+    quint64 activity() const { return *_activity; }
+
+    /**
+     * Moves the running session to another thread
+     *
+     * Clients connecting in the meantime are held back until the session has arrived.
+     *
+     * @param thread  The worker thread to move to
+     * @return Whether the move was started; sessions can only be moved once initialized, one move at a time
+     */
+    bool moveToWorker(QThread* thread);
+
 public slots:
     void addClient(Peer* peer);
     void shutdown();
 
 private slots:
     void onSessionInitialized();
+    void onSessionMoved();
     void onSessionDestroyed();
 
 signals:
@@ -53,10 +82,18 @@ signals:
     void shutdownComplete(SessionThread*);
 
     void addClientToWorker(Peer* peer);
+    void moveWorker(QThread* thread);
 
 private:
-    QThread _sessionThread;
+    /// Hands the queued clients over to the session
+    void flushClientQueue();
+
+    QThread _sessionThread;              ///< The session's own thread, if it doesn't run on a worker pool
+    QThread* _thread;                    ///< The thread the session currently runs on
+    SessionScheduler* _scheduler;
     bool _sessionInitialized{false};
+    bool _moving{false};
+    std::shared_ptr<std::atomic<quint64>> _activity;
 
     std::vector<Peer*> _clientQueue;
 };
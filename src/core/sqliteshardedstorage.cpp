@@ -0,0 +1,1145 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "sqliteshardedstorage.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSqlQuery>
+
+#include "quassel.h"
+
+const int SqliteShardedStorage::_shardSchemaVersion = 2;
+
+SqliteShardedStorage::SqliteShardedStorage(QObject* parent)
+    : SqliteStorage(parent)
+{}
+
+QString SqliteShardedStorage::backendId() const
+{
+    return QString("SQLiteSharded");
+}
+
+QString SqliteShardedStorage::description() const
+{
+    return tr("SQLite storage that keeps the chat history of each user in a separate database file. This allows the sessions of "
+              "different users to store and load their backlog in parallel. Use this instead of plain SQLite if your Quassel Core "
+              "serves many users, but you still want a file-based database that does not require any setup.");
+}
+
+Storage::State SqliteShardedStorage::init(const QVariantMap& settings, const QProcessEnvironment& environment, bool loadFromEnvironment)
+{
+    State state = SqliteStorage::init(settings, environment, loadFromEnvironment);
+    if (state == IsReady)
+        loadLastMsgId();
+    return state;
+}
+
+QString SqliteShardedStorage::mainFile()
+{
+    return Quassel::configDirPath() + "quassel-storage-sharded.sqlite";
+}
+
+QString SqliteShardedStorage::shardDirectory()
+{
+    return Quassel::configDirPath() + "quassel-storage-sharded/";
+}
+
+QString SqliteShardedStorage::shardName(UserId user)
+{
+    return QString("user_%1").arg(user.toInt());
+}
+
+QString SqliteShardedStorage::shardDatabaseName(const QString& shard)
+{
+    if (!QDir().mkpath(shardDirectory()))
+        qWarning() << "Unable to create directory for SQLite backlog shards:" << shardDirectory();
+    return shardDirectory() + shard + ".sqlite";
+}
+
+bool SqliteShardedStorage::initDbSession(QSqlDatabase& db)
+{
+    // Write-ahead logging lets readers proceed while a message batch is being committed.  The
+    // journal mode is persistent, so this only does actual work the first time a file is opened.
+    QSqlQuery query = db.exec("PRAGMA journal_mode = WAL");
+    if (!query.first() || query.value(0).toString().toLower() != QLatin1String{"wal"}) {
+        qWarning() << "Unable to enable write-ahead logging for" << db.databaseName();
+    }
+    return true;
+}
+
+QSqlDatabase SqliteShardedStorage::userDb(UserId user)
+{
+    QSqlDatabase db = shardDb(shardName(user));
+
+    QMutexLocker locker(&_shardSetupMutex);
+    if (!_readyShards.contains(user) && db.isOpen()) {
+        if (setupShard(db))
+            _readyShards.insert(user);
+        else
+            qCritical() << "Unable to set up backlog shard" << db.databaseName();
+    }
+    return db;
+}
+
+bool SqliteShardedStorage::setupShard(QSqlDatabase& db)
+{
+    int version = 0;
+    {
+        QSqlQuery query = db.exec("PRAGMA user_version");
+        if (query.first())
+            version = query.value(0).toInt();
+    }
+
+    if (version == _shardSchemaVersion)
+        return true;
+
+    if (version > _shardSchemaVersion) {
+        qCritical() << "Backlog shard" << db.databaseName() << "has schema version" << version << "which is newer than any known version.";
+        return false;
+    }
+
+    // New shards are created with the current schema, existing ones are upgraded version by version
+    // using the queries in 'sharded/version/##'
+    QStringList queryNames;
+    if (version == 0) {
+        QDir dir = QDir(QString(":/SQL/%1/sharded/").arg(queryFolder()));
+        foreach (QFileInfo fileInfo, dir.entryInfoList(QStringList() << "setup*", QDir::NoFilter, QDir::Name)) {
+            queryNames << "sharded/" + fileInfo.baseName();
+        }
+    }
+    else {
+        for (int upgradeVersion = version + 1; upgradeVersion <= _shardSchemaVersion; upgradeVersion++) {
+            QDir dir = QDir(QString(":/SQL/%1/sharded/version/%2/").arg(queryFolder()).arg(upgradeVersion));
+            foreach (QFileInfo fileInfo, dir.entryInfoList(QStringList() << "upgrade*", QDir::NoFilter, QDir::Name)) {
+                queryNames << QString("sharded/version/%1/%2").arg(upgradeVersion).arg(fileInfo.baseName());
+            }
+        }
+    }
+
+    db.transaction();
+    for (auto&& queryName : queryNames) {
+        QSqlQuery query = db.exec(queryString(queryName));
+        if (!watchQuery(query)) {
+            qCritical() << qPrintable(QString("Unable to set up backlog shard!  Setup query failed (step: %1).").arg(queryName));
+            db.rollback();
+            return false;
+        }
+    }
+    QSqlQuery versionQuery = db.exec(QString("PRAGMA user_version = %1").arg(_shardSchemaVersion));
+    if (!watchQuery(versionQuery)) {
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+
+void SqliteShardedStorage::loadLastMsgId()
+{
+    // Message IDs are assigned by us rather than by the shards, so they stay unique across users
+    qint64 lastMsgId = 0;
+    QDir dir = QDir(shardDirectory());
+    foreach (QFileInfo fileInfo, dir.entryInfoList(QStringList() << "user_*.sqlite", QDir::Files)) {
+        bool ok;
+        UserId user = fileInfo.baseName().mid(QString("user_").length()).toInt(&ok);
+        if (!ok || !user.isValid())
+            continue;
+
+        QSqlQuery query(userDb(user));
+        query.prepare(queryString("sharded/select_max_messageid"));
+        safeExec(query);
+        if (watchQuery(query) && query.first())
+            lastMsgId = std::max(lastMsgId, query.value(0).toLongLong());
+    }
+    _lastMsgId = lastMsgId;
+}
+
+UserId SqliteShardedStorage::bufferOwner(BufferId bufferId)
+{
+    {
+        QReadLocker locker(&_bufferOwnerLock);
+        auto it = _bufferOwners.constFind(bufferId);
+        if (it != _bufferOwners.constEnd())
+            return *it;
+    }
+
+    UserId owner;
+    {
+        QSqlQuery query(logDb());
+        query.prepare(queryString("sharded/select_buffer_owner"));
+        query.bindValue(":bufferid", bufferId.toInt());
+
+        lockForRead();
+        safeExec(query);
+        if (watchQuery(query) && query.first())
+            owner = query.value(0).toInt();
+        unlock();
+    }
+
+    if (owner.isValid()) {
+        QWriteLocker locker(&_bufferOwnerLock);
+        _bufferOwners[bufferId] = owner;
+    }
+    return owner;
+}
+
+void SqliteShardedStorage::delUser(UserId user)
+{
+    QSqlDatabase db = userDb(user);
+    db.transaction();
+    {
+        QSqlQuery query(db);
+        query.prepare(queryString("sharded/delete_backlog"));
+        safeExec(query);
+
+        query.prepare(queryString("sharded/delete_buffer_lastmsgs"));
+        safeExec(query);
+
+        query.prepare(queryString("sharded/delete_senders"));
+        safeExec(query);
+    }
+    db.commit();
+
+    SqliteStorage::delUser(user);
+}
+
+bool SqliteShardedStorage::removeNetwork(UserId user, const NetworkId& networkId)
+{
+    std::vector<BufferId> bufferIds = requestBufferIdsForNetwork(user, networkId);
+    if (!SqliteStorage::removeNetwork(user, networkId))
+        return false;
+
+    QSqlDatabase db = userDb(user);
+    db.transaction();
+
+    bool error = false;
+    {
+        QSqlQuery delBacklogQuery(db);
+        delBacklogQuery.prepare(queryString("delete_backlog_for_buffer"));
+        QSqlQuery delLastMsgQuery(db);
+        delLastMsgQuery.prepare(queryString("sharded/delete_buffer_lastmsg"));
+        for (auto&& bufferId : bufferIds) {
+            delBacklogQuery.bindValue(":bufferid", bufferId.toInt());
+            safeExec(delBacklogQuery);
+            delLastMsgQuery.bindValue(":bufferid", bufferId.toInt());
+            safeExec(delLastMsgQuery);
+            if (!watchQuery(delBacklogQuery) || !watchQuery(delLastMsgQuery)) {
+                error = true;
+                break;
+            }
+        }
+    }
+
+    if (error) {
+        db.rollback();
+    }
+    else {
+        db.commit();
+    }
+    return !error;
+}
+
+bool SqliteShardedStorage::removeBuffer(const UserId& user, const BufferId& bufferId)
+{
+    if (!SqliteStorage::removeBuffer(user, bufferId))
+        return false;
+
+    QSqlDatabase db = userDb(user);
+    db.transaction();
+
+    bool error = false;
+    {
+        QSqlQuery delBacklogQuery(db);
+        delBacklogQuery.prepare(queryString("delete_backlog_for_buffer"));
+        delBacklogQuery.bindValue(":bufferid", bufferId.toInt());
+        safeExec(delBacklogQuery);
+        error = !watchQuery(delBacklogQuery);
+    }
+    if (!error) {
+        QSqlQuery delLastMsgQuery(db);
+        delLastMsgQuery.prepare(queryString("sharded/delete_buffer_lastmsg"));
+        delLastMsgQuery.bindValue(":bufferid", bufferId.toInt());
+        safeExec(delLastMsgQuery);
+        error = !watchQuery(delLastMsgQuery);
+    }
+
+    if (error) {
+        db.rollback();
+    }
+    else {
+        db.commit();
+    }
+
+    QWriteLocker locker(&_bufferOwnerLock);
+    _bufferOwners.remove(bufferId);
+    return !error;
+}
+
+bool SqliteShardedStorage::mergeBuffersPermanently(const UserId& user, const BufferId& bufferId1, const BufferId& bufferId2)
+{
+    if (!SqliteStorage::mergeBuffersPermanently(user, bufferId1, bufferId2))
+        return false;
+
+    QSqlDatabase db = userDb(user);
+    db.transaction();
+
+    bool error = false;
+    {
+        // The update trigger moves the last message ID over to the merged buffer
+        QSqlQuery query(db);
+        query.prepare(queryString("update_backlog_bufferid"));
+        query.bindValue(":oldbufferid", bufferId2.toInt());
+        query.bindValue(":newbufferid", bufferId1.toInt());
+        safeExec(query);
+        error = !watchQuery(query);
+    }
+    if (!error) {
+        QSqlQuery delLastMsgQuery(db);
+        delLastMsgQuery.prepare(queryString("sharded/delete_buffer_lastmsg"));
+        delLastMsgQuery.bindValue(":bufferid", bufferId2.toInt());
+        safeExec(delLastMsgQuery);
+        error = !watchQuery(delLastMsgQuery);
+    }
+
+    if (error) {
+        db.rollback();
+    }
+    else {
+        db.commit();
+    }
+
+    QWriteLocker locker(&_bufferOwnerLock);
+    _bufferOwners.remove(bufferId2);
+    return !error;
+}
+
+QHash<BufferId, MsgId> SqliteShardedStorage::bufferLastMsgIds(UserId user)
+{
+    QHash<BufferId, MsgId> lastMsgHash;
+
+    QSqlQuery query(userDb(user));
+    query.prepare(queryString("sharded/select_buffer_last_messages"));
+    safeExec(query);
+    if (watchQuery(query)) {
+        while (query.next()) {
+            lastMsgHash[query.value(0).toInt()] = query.value(1).toLongLong();
+        }
+    }
+    return lastMsgHash;
+}
+
+MsgId SqliteShardedStorage::shardLastMsgId(QSqlDatabase& db, BufferId bufferId)
+{
+    QSqlQuery query(db);
+    query.prepare(queryString("sharded/select_buffer_last_message"));
+    query.bindValue(":bufferid", bufferId.toInt());
+    safeExec(query);
+    if (watchQuery(query) && query.first())
+        return query.value(0).toLongLong();
+    return 0;
+}
+
+void SqliteShardedStorage::setBufferLastSeenMsg(UserId user, const BufferId& bufferId, const MsgId& msgId)
+{
+    // The main file's lastmsgid is not maintained on every insert, so bring it up to date with the
+    // shard before clamping the last seen message to it
+    MsgId lastMsgId;
+    {
+        QSqlDatabase shard = userDb(user);
+        lastMsgId = shardLastMsgId(shard, bufferId);
+    }
+
+    QSqlDatabase db = logDb();
+    db.transaction();
+
+    {
+        QSqlQuery query(db);
+        query.prepare(queryString("sharded/update_buffer_lastseen"));
+        query.bindValue(":userid", user.toInt());
+        query.bindValue(":bufferid", bufferId.toInt());
+        query.bindValue(":lastseenmsgid", msgId.toQint64());
+        query.bindValue(":lastmsgid", lastMsgId.toQint64());
+
+        lockForWrite();
+        safeExec(query);
+        watchQuery(query);
+    }
+    db.commit();
+    unlock();
+}
+
+void SqliteShardedStorage::setBufferStates(UserId user, const std::vector<BufferState>& states)
+{
+    if (states.empty())
+        return;
+
+    // Same as in setBufferLastSeenMsg(), collected up front so the shard isn't read while writing
+    QHash<BufferId, MsgId> lastMsgIds;
+    {
+        QSqlDatabase shard = userDb(user);
+        for (auto&& state : states) {
+            if (state.fields & BufferState::LastSeenMsg)
+                lastMsgIds[state.bufferId] = shardLastMsgId(shard, state.bufferId);
+        }
+    }
+
+    QSqlDatabase db = logDb();
+    db.transaction();
+
+    bool error = false;
+    {
+        QSqlQuery query(db);
+        query.prepare(queryString("sharded/update_buffer_state"));
+
+        lockForWrite();
+        for (auto&& state : states) {
+            bindBufferState(query, user, state);
+            auto lastMsgId = lastMsgIds.constFind(state.bufferId);
+            query.bindValue(":lastmsgid", lastMsgId != lastMsgIds.cend() ? QVariant(lastMsgId->toQint64()) : QVariant(QVariant::LongLong));
+            safeExec(query);
+            if (!watchQuery(query)) {
+                error = true;
+                break;
+            }
+        }
+    }
+    if (error)
+        db.rollback();
+    else
+        db.commit();
+    unlock();
+}
+
+Message::Types SqliteShardedStorage::bufferActivity(BufferId bufferId, MsgId lastSeenMsgId)
+{
+    UserId user = bufferOwner(bufferId);
+    if (!user.isValid())
+        return {};
+
+    Message::Types result{};
+    QSqlQuery query(userDb(user));
+    query.prepare(queryString("select_buffer_bufferactivity"));
+    query.bindValue(":bufferid", bufferId.toInt());
+    query.bindValue(":lastseenmsgid", lastSeenMsgId.toQint64());
+    safeExec(query);
+    if (query.first())
+        result = Message::Types(query.value(0).toInt());
+    return result;
+}
+
+int SqliteShardedStorage::highlightCount(BufferId bufferId, MsgId lastSeenMsgId)
+{
+    UserId user = bufferOwner(bufferId);
+    if (!user.isValid())
+        return 0;
+
+    int result = 0;
+    QSqlQuery query(userDb(user));
+    query.prepare(queryString("select_buffer_highlightcount"));
+    query.bindValue(":bufferid", bufferId.toInt());
+    query.bindValue(":lastseenmsgid", lastSeenMsgId.toQint64());
+    safeExec(query);
+    if (query.first())
+        result = query.value(0).toInt();
+    return result;
+}
+
+bool SqliteShardedStorage::logMessage(Message& msg)
+{
+    QList<Message*> msgs{&msg};
+    return logUserMessages(bufferOwner(msg.bufferInfo().bufferId()), msgs);
+}
+
+bool SqliteShardedStorage::logMessages(MessageList& msgs)
+{
+    // A batch normally stems from a single session, but don't rely on that
+    QHash<UserId, QList<Message*>> userMsgs;
+    for (int i = 0; i < msgs.count(); i++) {
+        Message& msg = msgs[i];
+        userMsgs[bufferOwner(msg.bufferInfo().bufferId())] << &msg;
+    }
+
+    bool success = true;
+    for (auto it = userMsgs.begin(); it != userMsgs.end(); ++it) {
+        success &= logUserMessages(it.key(), it.value());
+    }
+    return success;
+}
+
+bool SqliteShardedStorage::logUserMessages(UserId user, QList<Message*>& msgs)
+{
+    if (!user.isValid()) {
+        qWarning() << "Unable to log" << msgs.count() << "message(s) for an unknown buffer";
+        for (Message* msg : msgs) {
+            msg->setMsgId(MsgId());
+        }
+        return false;
+    }
+
+    QSqlDatabase db = userDb(user);
+    db.transaction();
+
+    {
+        QSet<SenderData> senders;
+        QSqlQuery addSenderQuery(db);
+        addSenderQuery.prepare(queryString("insert_sender"));
+        for (Message* msg : msgs) {
+            SenderData sender = {msg->sender(), msg->realName(), msg->avatarUrl()};
+            if (senders.contains(sender))
+                continue;
+            senders << sender;
+
+            addSenderQuery.bindValue(":sender", sender.sender);
+            addSenderQuery.bindValue(":realname", sender.realname);
+            addSenderQuery.bindValue(":avatarurl", sender.avatarurl);
+            safeExec(addSenderQuery);
+        }
+    }
+
+    bool error = false;
+    {
+        QSqlQuery logMessageQuery(db);
+        logMessageQuery.prepare(queryString("sharded/insert_message"));
+        for (Message* msg : msgs) {
+            MsgId msgId = ++_lastMsgId;
+            logMessageQuery.bindValue(":messageid", msgId.toQint64());
+            // As of SQLite schema version 31, timestamps are stored in milliseconds instead of
+            // seconds.  This nets us more precision as well as simplifying 64-bit time.
+            logMessageQuery.bindValue(":time", msg->timestamp().toMSecsSinceEpoch());
+            logMessageQuery.bindValue(":bufferid", msg->bufferInfo().bufferId().toInt());
+            logMessageQuery.bindValue(":type", msg->type());
+            logMessageQuery.bindValue(":flags", (int)msg->flags());
+            logMessageQuery.bindValue(":sender", msg->sender());
+            logMessageQuery.bindValue(":realname", msg->realName());
+            logMessageQuery.bindValue(":avatarurl", msg->avatarUrl());
+            logMessageQuery.bindValue(":senderprefixes", msg->senderPrefixes());
+            logMessageQuery.bindValue(":message", msg->contents());
+
+            safeExec(logMessageQuery);
+            if (!watchQuery(logMessageQuery)) {
+                error = true;
+                break;
+            }
+            msg->setMsgId(msgId);
+        }
+    }
+
+    if (error) {
+        db.rollback();
+        // we had a rollback in the db so we need to reset all msgIds
+        for (Message* msg : msgs) {
+            msg->setMsgId(MsgId());
+        }
+    }
+    else {
+        db.commit();
+    }
+    return !error;
+}
+
+std::vector<Message> SqliteShardedStorage::requestUserMsgs(UserId user, BufferId bufferId, QSqlQuery& query)
+{
+    std::vector<Message> messagelist;
+
+    BufferInfo bufferInfo = getBufferInfo(user, bufferId);
+    if (!bufferInfo.isValid())
+        return messagelist;
+
+    safeExec(query);
+    watchQuery(query);
+
+    while (query.next()) {
+        Message msg(
+            // As of SQLite schema version 31, timestamps are stored in milliseconds instead of
+            // seconds.  This nets us more precision as well as simplifying 64-bit time.
+            QDateTime::fromMSecsSinceEpoch(query.value(1).toLongLong()),
+            bufferInfo,
+            (Message::Type)query.value(2).toInt(),
+            query.value(8).toString(),
+            query.value(4).toString(),
+            query.value(5).toString(),
+            query.value(6).toString(),
+            query.value(7).toString(),
+            Message::Flags{query.value(3).toInt()});
+        msg.setMsgId(query.value(0).toLongLong());
+        messagelist.push_back(std::move(msg));
+    }
+    return messagelist;
+}
+
+std::vector<Message> SqliteShardedStorage::requestAllUserMsgs(UserId user, QSqlQuery& query)
+{
+    std::vector<Message> messagelist;
+
+    QHash<BufferId, BufferInfo> bufferInfoHash;
+    for (auto&& bufferInfo : requestBuffers(user)) {
+        bufferInfoHash[bufferInfo.bufferId()] = bufferInfo;
+    }
+
+    safeExec(query);
+    watchQuery(query);
+
+    while (query.next()) {
+        Message msg(
+            // As of SQLite schema version 31, timestamps are stored in milliseconds instead of
+            // seconds.  This nets us more precision as well as simplifying 64-bit time.
+            QDateTime::fromMSecsSinceEpoch(query.value(2).toLongLong()),
+            bufferInfoHash[query.value(1).toInt()],
+            (Message::Type)query.value(3).toInt(),
+            query.value(9).toString(),
+            query.value(5).toString(),
+            query.value(6).toString(),
+            query.value(7).toString(),
+            query.value(8).toString(),
+            Message::Flags{query.value(4).toInt()});
+        msg.setMsgId(query.value(0).toLongLong());
+        messagelist.push_back(std::move(msg));
+    }
+    return messagelist;
+}
+
+std::vector<Message> SqliteShardedStorage::requestMsgs(UserId user, BufferId bufferId, MsgId first, MsgId last, int limit)
+{
+    QSqlQuery query(userDb(user));
+    if (last == -1 && first == -1) {
+        query.prepare(queryString("sharded/select_messagesNewestK"));
+    }
+    else if (last == -1) {
+        query.prepare(queryString("sharded/select_messagesNewerThan"));
+        query.bindValue(":firstmsg", first.toQint64());
+    }
+    else {
+        query.prepare(queryString("select_messagesRange"));
+        query.bindValue(":lastmsg", last.toQint64());
+        query.bindValue(":firstmsg", first.toQint64());
+    }
+    query.bindValue(":bufferid", bufferId.toInt());
+    query.bindValue(":limit", limit);
+
+    return requestUserMsgs(user, bufferId, query);
+}
+
+std::vector<Message> SqliteShardedStorage::requestMsgsFiltered(
+    UserId user, BufferId bufferId, MsgId first, MsgId last, int limit, Message::Types type, Message::Flags flags)
+{
+    QSqlQuery query(userDb(user));
+    if (last == -1 && first == -1) {
+        query.prepare(queryString("sharded/select_messagesNewestK_filtered"));
+    }
+    else if (last == -1) {
+        query.prepare(queryString("sharded/select_messagesNewerThan_filtered"));
+        query.bindValue(":firstmsg", first.toQint64());
+    }
+    else {
+        query.prepare(queryString("select_messagesRange_filtered"));
+        query.bindValue(":lastmsg", last.toQint64());
+        query.bindValue(":firstmsg", first.toQint64());
+    }
+    query.bindValue(":bufferid", bufferId.toInt());
+    query.bindValue(":limit", limit);
+    int typeRaw = type;
+    query.bindValue(":type", typeRaw);
+    int flagsRaw = flags;
+    query.bindValue(":flags", flagsRaw);
+
+    return requestUserMsgs(user, bufferId, query);
+}
+
+std::vector<Message> SqliteShardedStorage::requestMsgsForward(
+    UserId user, BufferId bufferId, MsgId first, MsgId last, int limit, Message::Types type, Message::Flags flags)
+{
+    QSqlQuery query(userDb(user));
+    query.prepare(queryString("select_messagesForward"));
+
+    if (first == -1) {
+        query.bindValue(":firstmsg", std::numeric_limits<qint64>::min());
+    }
+    else {
+        query.bindValue(":firstmsg", first.toQint64());
+    }
+
+    if (last == -1) {
+        query.bindValue(":lastmsg", std::numeric_limits<qint64>::max());
+    }
+    else {
+        query.bindValue(":lastmsg", last.toQint64());
+    }
+
+    query.bindValue(":bufferid", bufferId.toInt());
+
+    int typeRaw = type;
+    int flagsRaw = flags;
+    query.bindValue(":type", typeRaw);
+    query.bindValue(":flags", flagsRaw);
+
+    query.bindValue(":limit", limit);
+
+    return requestUserMsgs(user, bufferId, query);
+}
+
+std::vector<Message> SqliteShardedStorage::requestAllMsgs(UserId user, MsgId first, MsgId last, int limit)
+{
+    QSqlQuery query(userDb(user));
+    if (last == -1) {
+        query.prepare(queryString("sharded/select_messagesAllNew"));
+    }
+    else {
+        query.prepare(queryString("sharded/select_messagesAll"));
+        query.bindValue(":lastmsg", last.toQint64());
+    }
+    query.bindValue(":firstmsg", first.toQint64());
+    query.bindValue(":limit", limit);
+
+    return requestAllUserMsgs(user, query);
+}
+
+std::vector<Message> SqliteShardedStorage::requestAllMsgsFiltered(
+    UserId user, MsgId first, MsgId last, int limit, Message::Types type, Message::Flags flags)
+{
+    QSqlQuery query(userDb(user));
+    if (last == -1) {
+        query.prepare(queryString("sharded/select_messagesAllNew_filtered"));
+    }
+    else {
+        query.prepare(queryString("sharded/select_messagesAll_filtered"));
+        query.bindValue(":lastmsg", last.toQint64());
+    }
+    query.bindValue(":firstmsg", first.toQint64());
+    query.bindValue(":limit", limit);
+    int typeRaw = type;
+    query.bindValue(":type", typeRaw);
+    int flagsRaw = flags;
+    query.bindValue(":flags", flagsRaw);
+
+    return requestAllUserMsgs(user, query);
+}
+
+std::vector<Message> SqliteShardedStorage::searchMsgs(UserId user,
+                                                     const QString& query,
+                                                     NetworkId networkId,
+                                                     BufferId bufferId,
+                                                     const QString& sender,
+                                                     Message::Types type,
+                                                     const QDateTime& start,
+                                                     const QDateTime& end,
+                                                     MsgId last,
+                                                     int limit)
+{
+    QString matchExpression = ftsMatchExpression(query, sender);
+    if (matchExpression.isEmpty())
+        return {};
+
+    // Shards don't know about networks, so the buffers to search are passed as a list
+    QString bufferIds;
+    if (bufferId.isValid()) {
+        bufferIds = QString(",%1,").arg(bufferId.toInt());
+    }
+    else if (networkId.isValid()) {
+        for (auto&& networkBufferId : requestBufferIdsForNetwork(user, networkId)) {
+            bufferIds += QString(",%1").arg(networkBufferId.toInt());
+        }
+        if (bufferIds.isEmpty())
+            return {};
+        bufferIds += ',';
+    }
+
+    QSqlQuery searchQuery(userDb(user));
+    searchQuery.prepare(queryString("sharded/select_messagesSearch"));
+    searchQuery.bindValue(":query", matchExpression);
+    searchQuery.bindValue(":bufferids", bufferIds);
+    searchQuery.bindValue(":lastmsg", last == -1 ? std::numeric_limits<qint64>::max() : last.toQint64());
+    searchQuery.bindValue(":starttime", start.isValid() ? start.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min());
+    searchQuery.bindValue(":endtime", end.isValid() ? end.toMSecsSinceEpoch() : std::numeric_limits<qint64>::max());
+    int typeRaw = type;
+    searchQuery.bindValue(":type", typeRaw);
+    searchQuery.bindValue(":limit", limit);
+
+    return requestAllUserMsgs(user, searchQuery);
+}
+
+std::vector<Message> SqliteShardedStorage::requestExpiredMsgs(UserId user, const BufferInfo& bufferInfo, const QDateTime& before, int limit)
+{
+    std::vector<Message> messagelist;
+
+    QSqlQuery query(userDb(user));
+    query.prepare(queryString("select_messagesExpired"));
+    query.bindValue(":bufferid", bufferInfo.bufferId().toInt());
+    query.bindValue(":before", before.toMSecsSinceEpoch());
+    query.bindValue(":limit", limit);
+
+    safeExec(query);
+    watchQuery(query);
+
+    while (query.next()) {
+        Message msg(QDateTime::fromMSecsSinceEpoch(query.value(2).toLongLong()),
+                    bufferInfo,
+                    (Message::Type)query.value(3).toInt(),
+                    query.value(9).toString(),
+                    query.value(5).toString(),
+                    query.value(6).toString(),
+                    query.value(7).toString(),
+                    query.value(8).toString(),
+                    Message::Flags{query.value(4).toInt()});
+        msg.setMsgId(query.value(0).toLongLong());
+        messagelist.push_back(std::move(msg));
+    }
+    return messagelist;
+}
+
+int SqliteShardedStorage::deleteExpiredMsgs(UserId user, BufferId bufferId, const QDateTime& before, MsgId last, int limit)
+{
+    QSqlQuery query(userDb(user));
+    query.prepare(queryString("delete_backlog_expired"));
+    query.bindValue(":bufferid", bufferId.toInt());
+    query.bindValue(":before", before.toMSecsSinceEpoch());
+    query.bindValue(":lastmsg", last == -1 ? std::numeric_limits<qint64>::max() : last.toQint64());
+    query.bindValue(":limit", limit);
+
+    safeExec(query);
+    if (!watchQuery(query))
+        return -1;
+    return query.numRowsAffected();
+}
+
+// ========================================
+//  SqliteShardedMigrationWriter
+// ========================================
+SqliteShardedMigrationWriter::SqliteShardedMigrationWriter()
+    : SqliteShardedStorage()
+{}
+
+SqliteShardedMigrationWriter::~SqliteShardedMigrationWriter()
+{
+    qDeleteAll(_shardWriters);
+}
+
+bool SqliteShardedMigrationWriter::prepareQuery(MigrationObject mo)
+{
+    QString query;
+    switch (mo) {
+    case QuasselUser:
+        query = queryString("migrate_write_quasseluser");
+        break;
+    case Sender:
+        // Senders are staged in the main file, and copied into the shards along with the
+        // backlog referencing them
+        query = queryString("migrate_write_sender");
+        break;
+    case Identity:
+        query = queryString("migrate_write_identity");
+        break;
+    case IdentityNick:
+        query = queryString("migrate_write_identity_nick");
+        break;
+    case Network:
+        query = queryString("migrate_write_network");
+        break;
+    case Buffer:
+        _bufferOwners.clear();
+        query = queryString("migrate_write_buffer");
+        break;
+    case Backlog:
+        // Backlog is written to the shards, which have prepared queries of their own
+        _senderLookupQuery.reset(new QSqlQuery(logDb()));
+        _senderLookupQuery->prepare(queryString("sharded/select_sender_by_id"));
+        return true;
+    case IrcServer:
+        query = queryString("migrate_write_ircserver");
+        break;
+    case UserSetting:
+        query = queryString("migrate_write_usersetting");
+        break;
+    case CoreState:
+        query = queryString("migrate_write_corestate");
+        break;
+    }
+    newQuery(query, logDb());
+    return true;
+}
+
+bool SqliteShardedMigrationWriter::writeMo(const QuasselUserMO& user)
+{
+    bindValue(0, user.id.toInt());
+    bindValue(1, user.username);
+    bindValue(2, user.password);
+    bindValue(3, user.hashversion);
+    bindValue(4, user.authenticator);
+    return exec();
+}
+
+bool SqliteShardedMigrationWriter::writeMo(const SenderMO& sender)
+{
+    bindValue(0, sender.senderId);
+    bindValue(1, sender.sender);
+    bindValue(2, sender.realname);
+    bindValue(3, sender.avatarurl);
+    return exec();
+}
+
+bool SqliteShardedMigrationWriter::writeMo(const IdentityMO& identity)
+{
+    bindValue(0, identity.id.toInt());
+    bindValue(1, identity.userid.toInt());
+    bindValue(2, identity.identityname);
+    bindValue(3, identity.realname);
+    bindValue(4, identity.awayNick);
+    bindValue(5, identity.awayNickEnabled ? 1 : 0);
+    bindValue(6, identity.awayReason);
+    bindValue(7, identity.awayReasonEnabled ? 1 : 0);
+    bindValue(8, identity.autoAwayEnabled ? 1 : 0);
+    bindValue(9, identity.autoAwayTime);
+    bindValue(10, identity.autoAwayReason);
+    bindValue(11, identity.autoAwayReasonEnabled ? 1 : 0);
+    bindValue(12, identity.detachAwayEnabled ? 1 : 0);
+    bindValue(13, identity.detachAwayReason);
+    bindValue(14, identity.detachAwayReasonEnabled ? 1 : 0);
+    bindValue(15, identity.ident);
+    bindValue(16, identity.kickReason);
+    bindValue(17, identity.partReason);
+    bindValue(18, identity.quitReason);
+    bindValue(19, identity.sslCert);
+    bindValue(20, identity.sslKey);
+    return exec();
+}
+
+bool SqliteShardedMigrationWriter::writeMo(const IdentityNickMO& identityNick)
+{
+    bindValue(0, identityNick.nickid);
+    bindValue(1, identityNick.identityId.toInt());
+    bindValue(2, identityNick.nick);
+    return exec();
+}
+
+bool SqliteShardedMigrationWriter::writeMo(const NetworkMO& network)
+{
+    bindValue(0, network.networkid.toInt());
+    bindValue(1, network.userid.toInt());
+    bindValue(2, network.networkname);
+    bindValue(3, network.identityid.toInt());
+    bindValue(4, network.encodingcodec);
+    bindValue(5, network.decodingcodec);
+    bindValue(6, network.servercodec);
+    bindValue(7, network.userandomserver ? 1 : 0);
+    bindValue(8, network.perform);
+    bindValue(9, network.useautoidentify ? 1 : 0);
+    bindValue(10, network.autoidentifyservice);
+    bindValue(11, network.autoidentifypassword);
+    bindValue(12, network.useautoreconnect ? 1 : 0);
+    bindValue(13, network.autoreconnectinterval);
+    bindValue(14, network.autoreconnectretries);
+    bindValue(15, network.unlimitedconnectretries ? 1 : 0);
+    bindValue(16, network.rejoinchannels ? 1 : 0);
+    bindValue(17, network.connected ? 1 : 0);
+    bindValue(18, network.usermode);
+    bindValue(19, network.awaymessage);
+    bindValue(20, network.attachperform);
+    bindValue(21, network.detachperform);
+    bindValue(22, network.usesasl ? 1 : 0);
+    bindValue(23, network.saslaccount);
+    bindValue(24, network.saslpassword);
+    // Custom rate limiting
+    bindValue(25, network.usecustommessagerate ? 1 : 0);
+    bindValue(26, network.messagerateburstsize);
+    bindValue(27, network.messageratedelay);
+    bindValue(28, network.unlimitedmessagerate ? 1 : 0);
+    // Skipped IRCv3 caps
+    bindValue(29, network.skipcaps);
+    return exec();
+}
+
+bool SqliteShardedMigrationWriter::writeMo(const BufferMO& buffer)
+{
+    _bufferOwners[buffer.bufferid] = buffer.userid;
+
+    bindValue(0, buffer.bufferid.toInt());
+    bindValue(1, buffer.userid.toInt());
+    bindValue(2, buffer.groupid);
+    bindValue(3, buffer.networkid.toInt());
+    bindValue(4, buffer.buffername);
+    bindValue(5, buffer.buffercname);
+    bindValue(6, (int)buffer.buffertype);
+    bindValue(7, buffer.lastmsgid);
+    bindValue(8, buffer.lastseenmsgid);
+    bindValue(9, buffer.markerlinemsgid);
+    bindValue(10, buffer.bufferactivity);
+    bindValue(11, buffer.highlightcount);
+    bindValue(12, buffer.key);
+    bindValue(13, buffer.joined ? 1 : 0);
+    bindValue(14, buffer.cipher);
+    return exec();
+}
+
+bool SqliteShardedMigrationWriter::writeMo(const BacklogMO& backlog)
+{
+    UserId user = _bufferOwners.value(backlog.bufferid);
+    if (!user.isValid()) {
+        // Leftover backlog of a buffer that no longer exists; nothing would ever read it
+        return true;
+    }
+
+    ShardWriter* writer = shardWriter(user);
+    if (!writer)
+        return false;
+
+    if (!writer->senders.contains(backlog.senderid) && !copySender(writer, backlog.senderid))
+        return false;
+
+    QSqlQuery& query = *writer->backlogQuery;
+    query.bindValue(0, backlog.messageid.toQint64());
+    // As of SQLite schema version 31, timestamps are stored in milliseconds instead of
+    // seconds.  This nets us more precision as well as simplifying 64-bit time.
+    query.bindValue(1, backlog.time.toMSecsSinceEpoch());
+    query.bindValue(2, backlog.bufferid.toInt());
+    query.bindValue(3, backlog.type);
+    query.bindValue(4, backlog.flags);
+    query.bindValue(5, backlog.senderid);
+    query.bindValue(6, backlog.senderprefixes);
+    query.bindValue(7, backlog.message);
+    safeExec(query);
+    return watchQuery(query);
+}
+
+bool SqliteShardedMigrationWriter::writeMo(const IrcServerMO& ircserver)
+{
+    bindValue(0, ircserver.serverid);
+    bindValue(1, ircserver.userid.toInt());
+    bindValue(2, ircserver.networkid.toInt());
+    bindValue(3, ircserver.hostname);
+    bindValue(4, ircserver.port);
+    bindValue(5, ircserver.password);
+    bindValue(6, ircserver.ssl ? 1 : 0);
+    bindValue(7, ircserver.sslversion);
+    bindValue(8, ircserver.useproxy ? 1 : 0);
+    bindValue(9, ircserver.proxytype);
+    bindValue(10, ircserver.proxyhost);
+    bindValue(11, ircserver.proxyport);
+    bindValue(12, ircserver.proxyuser);
+    bindValue(13, ircserver.proxypass);
+    bindValue(14, ircserver.sslverify ? 1 : 0);
+    return exec();
+}
+
+bool SqliteShardedMigrationWriter::writeMo(const UserSettingMO& userSetting)
+{
+    bindValue(0, userSetting.userid.toInt());
+    bindValue(1, userSetting.settingname);
+    bindValue(2, userSetting.settingvalue);
+    return exec();
+}
+
+bool SqliteShardedMigrationWriter::writeMo(const CoreStateMO& coreState)
+{
+    bindValue(0, coreState.key);
+    bindValue(1, coreState.value);
+    return exec();
+}
+
+SqliteShardedMigrationWriter::ShardWriter* SqliteShardedMigrationWriter::shardWriter(UserId user)
+{
+    if (_shardWriters.contains(user))
+        return _shardWriters[user];
+
+    auto* writer = new ShardWriter;
+    writer->db = userDb(user);
+    if (!writer->db.isOpen() || !writer->db.transaction()) {
+        qWarning() << "SqliteShardedMigrationWriter::shardWriter(): unable to open backlog shard for user" << user;
+        delete writer;
+        return nullptr;
+    }
+
+    // The main file was set up from scratch, so anything already in the shard is stale
+    {
+        QSqlQuery query(writer->db);
+        query.prepare(queryString("sharded/delete_backlog"));
+        safeExec(query);
+        query.prepare(queryString("sharded/delete_buffer_lastmsgs"));
+        safeExec(query);
+        query.prepare(queryString("sharded/delete_senders"));
+        safeExec(query);
+    }
+
+    writer->senderQuery.reset(new QSqlQuery(writer->db));
+    writer->senderQuery->prepare(queryString("migrate_write_sender"));
+    writer->backlogQuery.reset(new QSqlQuery(writer->db));
+    writer->backlogQuery->prepare(queryString("migrate_write_backlog"));
+
+    _shardWriters[user] = writer;
+    return writer;
+}
+
+bool SqliteShardedMigrationWriter::copySender(ShardWriter* writer, qint64 senderId)
+{
+    QSqlQuery& lookupQuery = *_senderLookupQuery;
+    lookupQuery.bindValue(0, senderId);
+    safeExec(lookupQuery);
+    if (!watchQuery(lookupQuery) || !lookupQuery.first()) {
+        qWarning() << "SqliteShardedMigrationWriter::copySender(): unknown sender" << senderId;
+        return false;
+    }
+
+    QSqlQuery& insertQuery = *writer->senderQuery;
+    for (int i = 0; i < 4; i++) {
+        insertQuery.bindValue(i, lookupQuery.value(i));
+    }
+    safeExec(insertQuery);
+    if (!watchQuery(insertQuery))
+        return false;
+
+    writer->senders.insert(senderId);
+    return true;
+}
+
+void SqliteShardedMigrationWriter::rollback()
+{
+    for (ShardWriter* writer : _shardWriters) {
+        writer->senderQuery.reset();
+        writer->backlogQuery.reset();
+        writer->db.rollback();
+    }
+    logDb().rollback();
+}
+
+bool SqliteShardedMigrationWriter::commit()
+{
+    // Commit the shards first, so the main file can still be rolled back if one of them fails
+    for (ShardWriter* writer : _shardWriters) {
+        writer->senderQuery.reset();
+        writer->backlogQuery.reset();
+        if (!writer->db.commit()) {
+            qWarning() << "SqliteShardedMigrationWriter::commit(): unable to commit backlog shard" << writer->db.databaseName();
+            logDb().rollback();
+            return false;
+        }
+    }
+    return logDb().commit();
+}
+
+bool SqliteShardedMigrationWriter::postProcess()
+{
+    // The staged senders now live in the shards referencing them
+    _senderLookupQuery.reset();
+    resetQuery();
+    newQuery(queryString("sharded/delete_senders"), logDb());
+    return exec();
+}
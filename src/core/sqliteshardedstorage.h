@@ -0,0 +1,229 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <QHash>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QSet>
+
+#include "sqlitestorage.h"
+
+/**
+ * SQLite storage backend keeping the backlog of each user in a database file of its own
+ *
+ * Core users, identities, networks and buffers are stored in a main database file, handled by
+ * SqliteStorage.  The backlog and sender tables of every user live in a separate shard file, so
+ * session threads of different users can write and read backlog in parallel instead of queueing
+ * up behind SqliteStorage's database lock.  All files are opened in write-ahead logging mode,
+ * which lets readers proceed while a message batch is being committed.
+ *
+ * Message IDs are handed out by the storage for all shards, so they stay unique core-wide and
+ * keep fitting into the 32-bit IDs of legacy clients for as long as the monolithic file would.
+ *
+ * An existing monolithic SQLite database can be converted with --select-backend, which migrates
+ * it through the regular SqliteMigrationReader.
+ */
+class SqliteShardedStorage : public SqliteStorage
+{
+    Q_OBJECT
+
+public:
+    SqliteShardedStorage(QObject* parent = nullptr);
+
+    std::unique_ptr<AbstractSqlMigrationReader> createMigrationReader() override;
+    std::unique_ptr<AbstractSqlMigrationWriter> createMigrationWriter() override;
+
+    /* General */
+
+    QString backendId() const override;
+    QString description() const override;
+
+    State init(const QVariantMap& settings = QVariantMap(),
+               const QProcessEnvironment& environment = {},
+               bool loadFromEnvironment = false) override;
+
+    /* User handling */
+    void delUser(UserId user) override;
+
+    /* Network handling */
+    bool removeNetwork(UserId user, const NetworkId& networkId) override;
+
+    /* Buffer handling */
+    bool removeBuffer(const UserId& user, const BufferId& bufferId) override;
+    bool mergeBuffersPermanently(const UserId& user, const BufferId& bufferId1, const BufferId& bufferId2) override;
+    QHash<BufferId, MsgId> bufferLastMsgIds(UserId user) override;
+    void setBufferLastSeenMsg(UserId user, const BufferId& bufferId, const MsgId& msgId) override;
+    void setBufferStates(UserId user, const std::vector<BufferState>& states) override;
+    Message::Types bufferActivity(BufferId bufferId, MsgId lastSeenMsgId) override;
+    int highlightCount(BufferId bufferId, MsgId lastSeenMsgId) override;
+
+    /* Message handling */
+    bool logMessage(Message& msg) override;
+    bool logMessages(MessageList& msgs) override;
+    std::vector<Message> requestMsgs(UserId user, BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1) override;
+    std::vector<Message> requestMsgsFiltered(UserId user,
+                                             BufferId bufferId,
+                                             MsgId first = -1,
+                                             MsgId last = -1,
+                                             int limit = -1,
+                                             Message::Types type = Message::Types{-1},
+                                             Message::Flags flags = Message::Flags{-1}) override;
+    std::vector<Message> requestMsgsForward(UserId user,
+                                            BufferId bufferId,
+                                            MsgId first = -1,
+                                            MsgId last = -1,
+                                            int limit = -1,
+                                            Message::Types type = Message::Types{-1},
+                                            Message::Flags flags = Message::Flags{-1}) override;
+    std::vector<Message> requestAllMsgs(UserId user, MsgId first = -1, MsgId last = -1, int limit = -1) override;
+    std::vector<Message> requestAllMsgsFiltered(UserId user,
+                                                MsgId first = -1,
+                                                MsgId last = -1,
+                                                int limit = -1,
+                                                Message::Types type = Message::Types{-1},
+                                                Message::Flags flags = Message::Flags{-1}) override;
+    std::vector<Message> searchMsgs(UserId user,
+                                    const QString& query,
+                                    NetworkId networkId,
+                                    BufferId bufferId,
+                                    const QString& sender,
+                                    Message::Types type,
+                                    const QDateTime& start,
+                                    const QDateTime& end,
+                                    MsgId last,
+                                    int limit) override;
+    std::vector<Message> requestExpiredMsgs(UserId user, const BufferInfo& bufferInfo, const QDateTime& before, int limit) override;
+    int deleteExpiredMsgs(UserId user, BufferId bufferId, const QDateTime& before, MsgId last, int limit) override;
+
+protected:
+    QString databaseName() override { return mainFile(); }
+    QString shardDatabaseName(const QString& shard) override;
+    // Share the schema and queries of the monolithic backend
+    QString queryFolder() const override { return SqliteStorage::backendId(); }
+    bool initDbSession(QSqlDatabase& db) override;
+
+    /**
+     * Gets the current thread's connection to the backlog shard of the given user
+     *
+     * The shard file and its schema are created on first access.
+     *
+     * @param user  The user owning the shard
+     * @return Open connection to the user's shard
+     */
+    QSqlDatabase userDb(UserId user);
+
+    /**
+     * Finds the user owning the given buffer
+     *
+     * Buffers never change their owner, so lookups are cached.
+     *
+     * @param bufferId  Buffer to look up
+     * @return The owner's UserId, or an invalid one if the buffer does not exist
+     */
+    UserId bufferOwner(BufferId bufferId);
+
+private:
+    static QString mainFile();
+    static QString shardDirectory();
+    static QString shardName(UserId user);
+
+    bool setupShard(QSqlDatabase& db);
+    bool logUserMessages(UserId user, QList<Message*>& msgs);
+    std::vector<Message> requestUserMsgs(UserId user, BufferId bufferId, QSqlQuery& query);
+    std::vector<Message> requestAllUserMsgs(UserId user, QSqlQuery& query);
+    MsgId shardLastMsgId(QSqlDatabase& db, BufferId bufferId);
+    void loadLastMsgId();
+
+    static const int _shardSchemaVersion;
+
+    QMutex _shardSetupMutex;
+    QSet<UserId> _readyShards;
+
+    QReadWriteLock _bufferOwnerLock;
+    QHash<BufferId, UserId> _bufferOwners;
+
+    std::atomic<qint64> _lastMsgId{0};
+};
+
+// ========================================
+//  SqliteShardedMigration
+// ========================================
+class SqliteShardedMigrationWriter : public SqliteShardedStorage, public AbstractSqlMigrationWriter
+{
+    Q_OBJECT
+
+public:
+    SqliteShardedMigrationWriter();
+    ~SqliteShardedMigrationWriter() override;
+
+    bool writeMo(const QuasselUserMO& user) override;
+    bool writeMo(const SenderMO& sender) override;
+    bool writeMo(const IdentityMO& identity) override;
+    bool writeMo(const IdentityNickMO& identityNick) override;
+    bool writeMo(const NetworkMO& network) override;
+    bool writeMo(const BufferMO& buffer) override;
+    bool writeMo(const BacklogMO& backlog) override;
+    bool writeMo(const IrcServerMO& ircserver) override;
+    bool writeMo(const UserSettingMO& userSetting) override;
+    bool writeMo(const CoreStateMO& coreState) override;
+
+    bool prepareQuery(MigrationObject mo) override;
+
+    bool postProcess() override;
+
+protected:
+    bool transaction() override { return logDb().transaction(); }
+    void rollback() override;
+    bool commit() override;
+
+private:
+    // Open transaction and prepared queries for one user's shard
+    struct ShardWriter
+    {
+        QSqlDatabase db;
+        std::unique_ptr<QSqlQuery> senderQuery;
+        std::unique_ptr<QSqlQuery> backlogQuery;
+        QSet<qint64> senders;  ///< Senders already copied into this shard
+    };
+
+    ShardWriter* shardWriter(UserId user);
+    bool copySender(ShardWriter* writer, qint64 senderId);
+
+    std::unique_ptr<QSqlQuery> _senderLookupQuery;
+    QHash<BufferId, UserId> _bufferOwners;
+    QHash<UserId, ShardWriter*> _shardWriters;
+};
+
+inline std::unique_ptr<AbstractSqlMigrationReader> SqliteShardedStorage::createMigrationReader()
+{
+    // Reading shards back into a single database is not supported yet
+    return {};
+}
+
+inline std::unique_ptr<AbstractSqlMigrationWriter> SqliteShardedStorage::createMigrationWriter()
+{
+    return std::unique_ptr<AbstractSqlMigrationWriter>{new SqliteShardedMigrationWriter()};
+}
@@ -20,15 +20,20 @@
 
 #include "sqlitestorage.h"
 
+#include <algorithm>
+#include <limits>
+
 #include <QByteArray>
 #include <QDataStream>
 #include <QLatin1String>
+#include <QRegularExpression>
 #include <QVariant>
 
 #include "network.h"
 #include "quassel.h"
 
 int SqliteStorage::_maxRetryCount = 150;
+int SqliteStorage::_maxInsertRows = 100;
 
 SqliteStorage::SqliteStorage(QObject* parent)
     : AbstractSqlStorage(parent)
@@ -1212,22 +1217,21 @@ BufferInfo SqliteStorage::bufferInfo(UserId user, const NetworkId& networkId, Bu
 
     BufferInfo bufferInfo;
     {
-        QSqlQuery query(db);
-        query.prepare(queryString("select_bufferByName"));
-        query.bindValue(":networkid", networkId.toInt());
-        query.bindValue(":userid", user.toInt());
-        query.bindValue(":buffercname", buffer.toLower());
+        PreparedQuery query = cachedQuery("select_bufferByName", db);
+        query->bindValue(":networkid", networkId.toInt());
+        query->bindValue(":userid", user.toInt());
+        query->bindValue(":buffercname", buffer.toLower());
 
         lockForRead();
-        safeExec(query);
+        safeExec(*query);
 
-        if (query.first()) {
-            bufferInfo = BufferInfo(query.value(0).toInt(), networkId, (BufferInfo::Type)query.value(1).toInt(), 0, buffer);
-            if (query.next()) {
+        if (query->first()) {
+            bufferInfo = BufferInfo(query->value(0).toInt(), networkId, (BufferInfo::Type)query->value(1).toInt(), 0, buffer);
+            if (query->next()) {
                 qCritical() << "SqliteStorage::getBufferInfo(): received more then one Buffer!";
-                qCritical() << "         Query:" << query.lastQuery();
+                qCritical() << "         Query:" << query->lastQuery();
                 qCritical() << "  bound Values:";
-                QList<QVariant> list = query.boundValues().values();
+                QList<QVariant> list = query->boundValues().values();
                 for (int i = 0; i < list.size(); ++i)
                     qCritical() << i << ":" << list.at(i).toString().toLatin1().data();
                 Q_ASSERT(false);
@@ -1235,20 +1239,19 @@ BufferInfo SqliteStorage::bufferInfo(UserId user, const NetworkId& networkId, Bu
         }
         else if (create) {
             // let's create the buffer
-            QSqlQuery createQuery(db);
-            createQuery.prepare(queryString("insert_buffer"));
-            createQuery.bindValue(":userid", user.toInt());
-            createQuery.bindValue(":networkid", networkId.toInt());
-            createQuery.bindValue(":buffertype", (int)type);
-            createQuery.bindValue(":buffername", buffer);
-            createQuery.bindValue(":buffercname", buffer.toLower());
-            createQuery.bindValue(":joined", type & BufferInfo::ChannelBuffer ? 1 : 0);
+            PreparedQuery createQuery = cachedQuery("insert_buffer", db);
+            createQuery->bindValue(":userid", user.toInt());
+            createQuery->bindValue(":networkid", networkId.toInt());
+            createQuery->bindValue(":buffertype", (int)type);
+            createQuery->bindValue(":buffername", buffer);
+            createQuery->bindValue(":buffercname", buffer.toLower());
+            createQuery->bindValue(":joined", type & BufferInfo::ChannelBuffer ? 1 : 0);
 
             unlock();
             lockForWrite();
-            safeExec(createQuery);
-            watchQuery(createQuery);
-            bufferInfo = BufferInfo(createQuery.lastInsertId().toInt(), networkId, type, 0, buffer);
+            safeExec(*createQuery);
+            watchQuery(*createQuery);
+            bufferInfo = BufferInfo(createQuery->lastInsertId().toInt(), networkId, type, 0, buffer);
         }
     }
     db.commit();
@@ -1509,15 +1512,14 @@ void SqliteStorage::setBufferLastSeenMsg(UserId user, const BufferId& bufferId,
     db.transaction();
 
     {
-        QSqlQuery query(db);
-        query.prepare(queryString("update_buffer_lastseen"));
-        query.bindValue(":userid", user.toInt());
-        query.bindValue(":bufferid", bufferId.toInt());
-        query.bindValue(":lastseenmsgid", msgId.toQint64());
+        PreparedQuery query = cachedQuery("update_buffer_lastseen", db);
+        query->bindValue(":userid", user.toInt());
+        query->bindValue(":bufferid", bufferId.toInt());
+        query->bindValue(":lastseenmsgid", msgId.toQint64());
 
         lockForWrite();
-        safeExec(query);
-        watchQuery(query);
+        safeExec(*query);
+        watchQuery(*query);
     }
     db.commit();
     unlock();
@@ -1557,15 +1559,14 @@ void SqliteStorage::setBufferMarkerLineMsg(UserId user, const BufferId& bufferId
     db.transaction();
 
     {
-        QSqlQuery query(db);
-        query.prepare(queryString("update_buffer_markerlinemsgid"));
-        query.bindValue(":userid", user.toInt());
-        query.bindValue(":bufferid", bufferId.toInt());
-        query.bindValue(":markerlinemsgid", msgId.toQint64());
+        PreparedQuery query = cachedQuery("update_buffer_markerlinemsgid", db);
+        query->bindValue(":userid", user.toInt());
+        query->bindValue(":bufferid", bufferId.toInt());
+        query->bindValue(":markerlinemsgid", msgId.toQint64());
 
         lockForWrite();
-        safeExec(query);
-        watchQuery(query);
+        safeExec(*query);
+        watchQuery(*query);
     }
     db.commit();
     unlock();
@@ -1605,15 +1606,14 @@ void SqliteStorage::setBufferActivity(UserId user, BufferId bufferId, Message::T
     db.transaction();
 
     {
-        QSqlQuery query(db);
-        query.prepare(queryString("update_buffer_bufferactivity"));
-        query.bindValue(":userid", user.toInt());
-        query.bindValue(":bufferid", bufferId.toInt());
-        query.bindValue(":bufferactivity", (int)bufferActivity);
+        PreparedQuery query = cachedQuery("update_buffer_bufferactivity", db);
+        query->bindValue(":userid", user.toInt());
+        query->bindValue(":bufferid", bufferId.toInt());
+        query->bindValue(":bufferactivity", (int)bufferActivity);
 
         lockForWrite();
-        safeExec(query);
-        watchQuery(query);
+        safeExec(*query);
+        watchQuery(*query);
     }
     db.commit();
     unlock();
@@ -1654,15 +1654,14 @@ Message::Types SqliteStorage::bufferActivity(BufferId bufferId, MsgId lastSeenMs
 
     Message::Types result{};
     {
-        QSqlQuery query(db);
-        query.prepare(queryString("select_buffer_bufferactivity"));
-        query.bindValue(":bufferid", bufferId.toInt());
-        query.bindValue(":lastseenmsgid", lastSeenMsgId.toQint64());
+        PreparedQuery query = cachedQuery("select_buffer_bufferactivity", db);
+        query->bindValue(":bufferid", bufferId.toInt());
+        query->bindValue(":lastseenmsgid", lastSeenMsgId.toQint64());
 
         lockForRead();
-        safeExec(query);
-        if (query.first())
-            result = Message::Types(query.value(0).toInt());
+        safeExec(*query);
+        if (query->first())
+            result = Message::Types(query->value(0).toInt());
     }
 
     db.commit();
@@ -1720,20 +1719,48 @@ void SqliteStorage::setHighlightCount(UserId user, BufferId bufferId, int count)
     db.transaction();
 
     {
-        QSqlQuery query(db);
-        query.prepare(queryString("update_buffer_highlightcount"));
-        query.bindValue(":userid", user.toInt());
-        query.bindValue(":bufferid", bufferId.toInt());
-        query.bindValue(":highlightcount", count);
+        PreparedQuery query = cachedQuery("update_buffer_highlightcount", db);
+        query->bindValue(":userid", user.toInt());
+        query->bindValue(":bufferid", bufferId.toInt());
+        query->bindValue(":highlightcount", count);
 
         lockForWrite();
-        safeExec(query);
-        watchQuery(query);
+        safeExec(*query);
+        watchQuery(*query);
     }
     db.commit();
     unlock();
 }
 
+void SqliteStorage::setBufferStates(UserId user, const std::vector<BufferState>& states)
+{
+    if (states.empty())
+        return;
+
+    QSqlDatabase db = logDb();
+    db.transaction();
+
+    bool error = false;
+    {
+        PreparedQuery query = cachedQuery("update_buffer_state", db);
+
+        lockForWrite();
+        for (auto&& state : states) {
+            bindBufferState(*query, user, state);
+            safeExec(*query);
+            if (!watchQuery(*query)) {
+                error = true;
+                break;
+            }
+        }
+    }
+    if (error)
+        db.rollback();
+    else
+        db.commit();
+    unlock();
+}
+
 QHash<BufferId, int> SqliteStorage::highlightCounts(UserId user)
 {
     QHash<BufferId, int> highlightCountHash;
@@ -1769,15 +1796,14 @@ int SqliteStorage::highlightCount(BufferId bufferId, MsgId lastSeenMsgId)
 
     int result = 0;
     {
-        QSqlQuery query(db);
-        query.prepare(queryString("select_buffer_highlightcount"));
-        query.bindValue(":bufferid", bufferId.toInt());
-        query.bindValue(":lastseenmsgid", lastSeenMsgId.toQint64());
+        PreparedQuery query = cachedQuery("select_buffer_highlightcount", db);
+        query->bindValue(":bufferid", bufferId.toInt());
+        query->bindValue(":lastseenmsgid", lastSeenMsgId.toQint64());
 
         lockForRead();
-        safeExec(query);
-        if (query.first())
-            result = query.value(0).toInt();
+        safeExec(*query);
+        if (query->first())
+            result = query->value(0).toInt();
     }
 
     db.commit();
@@ -1792,41 +1818,39 @@ bool SqliteStorage::logMessage(Message& msg)
 
     bool error = false;
     {
-        QSqlQuery logMessageQuery(db);
-        logMessageQuery.prepare(queryString("insert_message"));
+        PreparedQuery logMessageQuery = cachedQuery("insert_message", db);
         // As of SQLite schema version 31, timestamps are stored in milliseconds instead of
         // seconds.  This nets us more precision as well as simplifying 64-bit time.
-        logMessageQuery.bindValue(":time", msg.timestamp().toMSecsSinceEpoch());
-        logMessageQuery.bindValue(":bufferid", msg.bufferInfo().bufferId().toInt());
-        logMessageQuery.bindValue(":type", msg.type());
-        logMessageQuery.bindValue(":flags", (int)msg.flags());
-        logMessageQuery.bindValue(":sender", msg.sender());
-        logMessageQuery.bindValue(":realname", msg.realName());
-        logMessageQuery.bindValue(":avatarurl", msg.avatarUrl());
-        logMessageQuery.bindValue(":senderprefixes", msg.senderPrefixes());
-        logMessageQuery.bindValue(":message", msg.contents());
+        logMessageQuery->bindValue(":time", msg.timestamp().toMSecsSinceEpoch());
+        logMessageQuery->bindValue(":bufferid", msg.bufferInfo().bufferId().toInt());
+        logMessageQuery->bindValue(":type", msg.type());
+        logMessageQuery->bindValue(":flags", (int)msg.flags());
+        logMessageQuery->bindValue(":sender", msg.sender());
+        logMessageQuery->bindValue(":realname", msg.realName());
+        logMessageQuery->bindValue(":avatarurl", msg.avatarUrl());
+        logMessageQuery->bindValue(":senderprefixes", msg.senderPrefixes());
+        logMessageQuery->bindValue(":message", msg.contents());
 
         lockForWrite();
-        safeExec(logMessageQuery);
+        safeExec(*logMessageQuery);
 
-        if (logMessageQuery.lastError().isValid()) {
+        if (logMessageQuery->lastError().isValid()) {
             // constraint violation - must be NOT NULL constraint - probably the sender is missing...
-            if (logMessageQuery.lastError().nativeErrorCode() == QLatin1String{"19"}) {
-                QSqlQuery addSenderQuery(db);
-                addSenderQuery.prepare(queryString("insert_sender"));
-                addSenderQuery.bindValue(":sender", msg.sender());
-                addSenderQuery.bindValue(":realname", msg.realName());
-                addSenderQuery.bindValue(":avatarurl", msg.avatarUrl());
-                safeExec(addSenderQuery);
-                safeExec(logMessageQuery);
-                error = !watchQuery(logMessageQuery);
+            if (logMessageQuery->lastError().nativeErrorCode() == QLatin1String{"19"}) {
+                PreparedQuery addSenderQuery = cachedQuery("insert_sender", db);
+                addSenderQuery->bindValue(":sender", msg.sender());
+                addSenderQuery->bindValue(":realname", msg.realName());
+                addSenderQuery->bindValue(":avatarurl", msg.avatarUrl());
+                safeExec(*addSenderQuery);
+                safeExec(*logMessageQuery);
+                error = !watchQuery(*logMessageQuery);
             }
             else {
-                watchQuery(logMessageQuery);
+                watchQuery(*logMessageQuery);
             }
         }
         if (!error) {
-            MsgId msgId = logMessageQuery.lastInsertId().toLongLong();
+            MsgId msgId = logMessageQuery->lastInsertId().toLongLong();
             if (msgId.isValid()) {
                 msg.setMsgId(msgId);
             }
@@ -1851,51 +1875,82 @@ bool SqliteStorage::logMessages(MessageList& msgs)
 {
     QSqlDatabase db = logDb();
     db.transaction();
+    lockForWrite();
 
+    bool error = false;
+    QList<qint64> senderIdList;
+    // Senders added in this transaction; they must only be cached once it has been committed
+    QHash<SenderData, qint64> newSenderIds;
     {
-        QSet<SenderData> senders;
-        QSqlQuery addSenderQuery(db);
-        addSenderQuery.prepare(queryString("insert_sender"));
-        lockForWrite();
+        PreparedQuery selectSenderQuery = cachedQuery("select_senderid", db);
+        PreparedQuery addSenderQuery = cachedQuery("insert_sender", db);
         for (int i = 0; i < msgs.count(); i++) {
             auto& msg = msgs.at(i);
             SenderData sender = {msg.sender(), msg.realName(), msg.avatarUrl()};
-            if (senders.contains(sender))
-                continue;
-            senders << sender;
-
-            addSenderQuery.bindValue(":sender", sender.sender);
-            addSenderQuery.bindValue(":realname", sender.realname);
-            addSenderQuery.bindValue(":avatarurl", sender.avatarurl);
-            safeExec(addSenderQuery);
+            qint64 senderId = _senderIds.find(sender);
+            if (senderId < 0)
+                senderId = newSenderIds.value(sender, -1);
+            if (senderId < 0) {
+                selectSenderQuery->bindValue(":sender", sender.sender);
+                selectSenderQuery->bindValue(":realname", sender.realname);
+                selectSenderQuery->bindValue(":avatarurl", sender.avatarurl);
+                safeExec(*selectSenderQuery);
+                if (!watchQuery(*selectSenderQuery)) {
+                    error = true;
+                    break;
+                }
+                if (selectSenderQuery->first()) {
+                    senderId = selectSenderQuery->value(0).toLongLong();
+                }
+                else {
+                    addSenderQuery->bindValue(":sender", sender.sender);
+                    addSenderQuery->bindValue(":realname", sender.realname);
+                    addSenderQuery->bindValue(":avatarurl", sender.avatarurl);
+                    safeExec(*addSenderQuery);
+                    if (!watchQuery(*addSenderQuery)) {
+                        error = true;
+                        break;
+                    }
+                    senderId = addSenderQuery->lastInsertId().toLongLong();
+                }
+                selectSenderQuery->finish();
+                newSenderIds[sender] = senderId;
+            }
+            senderIdList << senderId;
         }
     }
 
-    bool error = false;
-    {
-        QSqlQuery logMessageQuery(db);
-        logMessageQuery.prepare(queryString("insert_message"));
-        for (int i = 0; i < msgs.count(); i++) {
-            Message& msg = msgs[i];
-            // As of SQLite schema version 31, timestamps are stored in milliseconds instead of
-            // seconds.  This nets us more precision as well as simplifying 64-bit time.
-            logMessageQuery.bindValue(":time", msg.timestamp().toMSecsSinceEpoch());
-            logMessageQuery.bindValue(":bufferid", msg.bufferInfo().bufferId().toInt());
-            logMessageQuery.bindValue(":type", msg.type());
-            logMessageQuery.bindValue(":flags", (int)msg.flags());
-            logMessageQuery.bindValue(":sender", msg.sender());
-            logMessageQuery.bindValue(":realname", msg.realName());
-            logMessageQuery.bindValue(":avatarurl", msg.avatarUrl());
-            logMessageQuery.bindValue(":senderprefixes", msg.senderPrefixes());
-            logMessageQuery.bindValue(":message", msg.contents());
-
-            safeExec(logMessageQuery);
-            if (!watchQuery(logMessageQuery)) {
+    // Insert up to _maxInsertRows messages per statement, staying well below SQLite's limit of 999 parameters
+    if (!error) {
+        for (int offset = 0; offset < msgs.count(); offset += _maxInsertRows) {
+            int rows = std::min(_maxInsertRows, msgs.count() - offset);
+            QString values = QString("(?, ?, ?, ?, ?, ?, ?), ").repeated(rows);
+            values.chop(2);
+            PreparedQuery logMessagesQuery = cachedQuery("insert_messages", db, values);
+
+            int pos = 0;
+            for (int i = offset; i < offset + rows; i++) {
+                const Message& msg = msgs.at(i);
+                // As of SQLite schema version 31, timestamps are stored in milliseconds instead of
+                // seconds.  This nets us more precision as well as simplifying 64-bit time.
+                logMessagesQuery->bindValue(pos++, msg.timestamp().toMSecsSinceEpoch());
+                logMessagesQuery->bindValue(pos++, msg.bufferInfo().bufferId().toInt());
+                logMessagesQuery->bindValue(pos++, msg.type());
+                logMessagesQuery->bindValue(pos++, (int)msg.flags());
+                logMessagesQuery->bindValue(pos++, senderIdList.at(i));
+                logMessagesQuery->bindValue(pos++, msg.senderPrefixes());
+                logMessagesQuery->bindValue(pos++, msg.contents());
+            }
+
+            safeExec(*logMessagesQuery);
+            if (!watchQuery(*logMessagesQuery)) {
                 error = true;
                 break;
             }
-            else {
-                msg.setMsgId(logMessageQuery.lastInsertId().toLongLong());
+            // We hold the write lock, so the rows of a single statement are assigned consecutive IDs
+            qint64 lastMsgId = logMessagesQuery->lastInsertId().toLongLong();
+            for (int i = 0; i < rows; i++) {
+                msgs[offset + i].setMsgId(lastMsgId - rows + 1 + i);
             }
         }
     }
@@ -1911,6 +1966,9 @@ bool SqliteStorage::logMessages(MessageList& msgs)
     else {
         db.commit();
         unlock();
+        for (auto it = newSenderIds.cbegin(); it != newSenderIds.cend(); ++it) {
+            _senderIds.insert(it.key(), it.value());
+        }
     }
     return !error;
 }
@@ -1927,20 +1985,19 @@ std::vector<Message> SqliteStorage::requestMsgs(UserId user, BufferId bufferId,
     {
         // code duplication from getBufferInfo:
         // this is due to the impossibility of nesting transactions and recursive locking
-        QSqlQuery bufferInfoQuery(db);
-        bufferInfoQuery.prepare(queryString("select_buffer_by_id"));
-        bufferInfoQuery.bindValue(":userid", user.toInt());
-        bufferInfoQuery.bindValue(":bufferid", bufferId.toInt());
+        PreparedQuery bufferInfoQuery = cachedQuery("select_buffer_by_id", db);
+        bufferInfoQuery->bindValue(":userid", user.toInt());
+        bufferInfoQuery->bindValue(":bufferid", bufferId.toInt());
 
         lockForRead();
-        safeExec(bufferInfoQuery);
-        error = !watchQuery(bufferInfoQuery) || !bufferInfoQuery.first();
+        safeExec(*bufferInfoQuery);
+        error = !watchQuery(*bufferInfoQuery) || !bufferInfoQuery->first();
         if (!error) {
-            bufferInfo = BufferInfo(bufferInfoQuery.value(0).toInt(),
-                                    bufferInfoQuery.value(1).toInt(),
-                                    (BufferInfo::Type)bufferInfoQuery.value(2).toInt(),
+            bufferInfo = BufferInfo(bufferInfoQuery->value(0).toInt(),
+                                    bufferInfoQuery->value(1).toInt(),
+                                    (BufferInfo::Type)bufferInfoQuery->value(2).toInt(),
                                     0,
-                                    bufferInfoQuery.value(4).toString());
+                                    bufferInfoQuery->value(4).toString());
             error = !bufferInfo.isValid();
         }
     }
@@ -1951,39 +2008,38 @@ std::vector<Message> SqliteStorage::requestMsgs(UserId user, BufferId bufferId,
     }
 
     {
-        QSqlQuery query(db);
-        if (last == -1 && first == -1) {
-            query.prepare(queryString("select_messagesNewestK"));
-        }
-        else if (last == -1) {
-            query.prepare(queryString("select_messagesNewerThan"));
-            query.bindValue(":firstmsg", first.toQint64());
-        }
-        else {
-            query.prepare(queryString("select_messagesRange"));
-            query.bindValue(":lastmsg", last.toQint64());
-            query.bindValue(":firstmsg", first.toQint64());
-        }
-        query.bindValue(":bufferid", bufferId.toInt());
-        query.bindValue(":limit", limit);
+        QString queryName;
+        if (last == -1 && first == -1)
+            queryName = "select_messagesNewestK";
+        else if (last == -1)
+            queryName = "select_messagesNewerThan";
+        else
+            queryName = "select_messagesRange";
+        PreparedQuery query = cachedQuery(queryName, db);
+        if (last != -1 || first != -1)
+            query->bindValue(":firstmsg", first.toQint64());
+        if (last != -1)
+            query->bindValue(":lastmsg", last.toQint64());
+        query->bindValue(":bufferid", bufferId.toInt());
+        query->bindValue(":limit", limit);
 
-        safeExec(query);
-        watchQuery(query);
+        safeExec(*query);
+        watchQuery(*query);
 
-        while (query.next()) {
+        while (query->next()) {
             Message msg(
                 // As of SQLite schema version 31, timestamps are stored in milliseconds instead of
                 // seconds.  This nets us more precision as well as simplifying 64-bit time.
-                QDateTime::fromMSecsSinceEpoch(query.value(1).toLongLong()),
+                QDateTime::fromMSecsSinceEpoch(query->value(1).toLongLong()),
                 bufferInfo,
-                (Message::Type)query.value(2).toInt(),
-                query.value(8).toString(),
-                query.value(4).toString(),
-                query.value(5).toString(),
-                query.value(6).toString(),
-                query.value(7).toString(),
-                (Message::Flags)query.value(3).toInt());
-            msg.setMsgId(query.value(0).toLongLong());
+                (Message::Type)query->value(2).toInt(),
+                query->value(8).toString(),
+                query->value(4).toString(),
+                query->value(5).toString(),
+                query->value(6).toString(),
+                query->value(7).toString(),
+                (Message::Flags)query->value(3).toInt());
+            msg.setMsgId(query->value(0).toLongLong());
             messagelist.push_back(std::move(msg));
         }
     }
@@ -2006,20 +2062,19 @@ std::vector<Message> SqliteStorage::requestMsgsFiltered(
     {
         // code dupication from getBufferInfo:
         // this is due to the impossibility of nesting transactions and recursive locking
-        QSqlQuery bufferInfoQuery(db);
-        bufferInfoQuery.prepare(queryString("select_buffer_by_id"));
-        bufferInfoQuery.bindValue(":userid", user.toInt());
-        bufferInfoQuery.bindValue(":bufferid", bufferId.toInt());
+        PreparedQuery bufferInfoQuery = cachedQuery("select_buffer_by_id", db);
+        bufferInfoQuery->bindValue(":userid", user.toInt());
+        bufferInfoQuery->bindValue(":bufferid", bufferId.toInt());
 
         lockForRead();
-        safeExec(bufferInfoQuery);
-        error = !watchQuery(bufferInfoQuery) || !bufferInfoQuery.first();
+        safeExec(*bufferInfoQuery);
+        error = !watchQuery(*bufferInfoQuery) || !bufferInfoQuery->first();
         if (!error) {
-            bufferInfo = BufferInfo(bufferInfoQuery.value(0).toInt(),
-                                    bufferInfoQuery.value(1).toInt(),
-                                    (BufferInfo::Type)bufferInfoQuery.value(2).toInt(),
+            bufferInfo = BufferInfo(bufferInfoQuery->value(0).toInt(),
+                                    bufferInfoQuery->value(1).toInt(),
+                                    (BufferInfo::Type)bufferInfoQuery->value(2).toInt(),
                                     0,
-                                    bufferInfoQuery.value(4).toString());
+                                    bufferInfoQuery->value(4).toString());
             error = !bufferInfo.isValid();
         }
     }
@@ -2030,44 +2085,43 @@ std::vector<Message> SqliteStorage::requestMsgsFiltered(
     }
 
     {
-        QSqlQuery query(db);
-        if (last == -1 && first == -1) {
-            query.prepare(queryString("select_messagesNewestK_filtered"));
-        }
-        else if (last == -1) {
-            query.prepare(queryString("select_messagesNewerThan_filtered"));
-            query.bindValue(":firstmsg", first.toQint64());
-        }
-        else {
-            query.prepare(queryString("select_messagesRange_filtered"));
-            query.bindValue(":lastmsg", last.toQint64());
-            query.bindValue(":firstmsg", first.toQint64());
-        }
-        query.bindValue(":bufferid", bufferId.toInt());
-        query.bindValue(":limit", limit);
+        QString queryName;
+        if (last == -1 && first == -1)
+            queryName = "select_messagesNewestK_filtered";
+        else if (last == -1)
+            queryName = "select_messagesNewerThan_filtered";
+        else
+            queryName = "select_messagesRange_filtered";
+        PreparedQuery query = cachedQuery(queryName, db);
+        if (last != -1 || first != -1)
+            query->bindValue(":firstmsg", first.toQint64());
+        if (last != -1)
+            query->bindValue(":lastmsg", last.toQint64());
+        query->bindValue(":bufferid", bufferId.toInt());
+        query->bindValue(":limit", limit);
         int typeRaw = type;
-        query.bindValue(":type", typeRaw);
+        query->bindValue(":type", typeRaw);
         int flagsRaw = flags;
-        query.bindValue(":flags", flagsRaw);
+        query->bindValue(":flags", flagsRaw);
 
-        safeExec(query);
-        watchQuery(query);
+        safeExec(*query);
+        watchQuery(*query);
 
-        while (query.next()) {
+        while (query->next()) {
             Message msg(
                 // As of SQLite schema version 31, timestamps are stored in milliseconds
                 // instead of seconds.  This nets us more precision as well as simplifying
                 // 64-bit time.
-                QDateTime::fromMSecsSinceEpoch(query.value(1).toLongLong()),
+                QDateTime::fromMSecsSinceEpoch(query->value(1).toLongLong()),
                 bufferInfo,
-                (Message::Type)query.value(2).toInt(),
-                query.value(8).toString(),
-                query.value(4).toString(),
-                query.value(5).toString(),
-                query.value(6).toString(),
-                query.value(7).toString(),
-                Message::Flags{query.value(3).toInt()});
-            msg.setMsgId(query.value(0).toLongLong());
+                (Message::Type)query->value(2).toInt(),
+                query->value(8).toString(),
+                query->value(4).toString(),
+                query->value(5).toString(),
+                query->value(6).toString(),
+                query->value(7).toString(),
+                Message::Flags{query->value(3).toInt()});
+            msg.setMsgId(query->value(0).toLongLong());
             messagelist.push_back(std::move(msg));
         }
     }
@@ -2090,20 +2144,19 @@ std::vector<Message> SqliteStorage::requestMsgsForward(
     {
         // code dupication from getBufferInfo:
         // this is due to the impossibility of nesting transactions and recursive locking
-        QSqlQuery bufferInfoQuery(db);
-        bufferInfoQuery.prepare(queryString("select_buffer_by_id"));
-        bufferInfoQuery.bindValue(":userid", user.toInt());
-        bufferInfoQuery.bindValue(":bufferid", bufferId.toInt());
+        PreparedQuery bufferInfoQuery = cachedQuery("select_buffer_by_id", db);
+        bufferInfoQuery->bindValue(":userid", user.toInt());
+        bufferInfoQuery->bindValue(":bufferid", bufferId.toInt());
 
         lockForRead();
-        safeExec(bufferInfoQuery);
-        error = !watchQuery(bufferInfoQuery) || !bufferInfoQuery.first();
+        safeExec(*bufferInfoQuery);
+        error = !watchQuery(*bufferInfoQuery) || !bufferInfoQuery->first();
         if (!error) {
-            bufferInfo = BufferInfo(bufferInfoQuery.value(0).toInt(),
-                                    bufferInfoQuery.value(1).toInt(),
-                                    (BufferInfo::Type)bufferInfoQuery.value(2).toInt(),
+            bufferInfo = BufferInfo(bufferInfoQuery->value(0).toInt(),
+                                    bufferInfoQuery->value(1).toInt(),
+                                    (BufferInfo::Type)bufferInfoQuery->value(2).toInt(),
                                     0,
-                                    bufferInfoQuery.value(4).toString());
+                                    bufferInfoQuery->value(4).toString());
             error = !bufferInfo.isValid();
         }
     }
@@ -2114,48 +2167,47 @@ std::vector<Message> SqliteStorage::requestMsgsForward(
     }
 
     {
-        QSqlQuery query(db);
-        query.prepare(queryString("select_messagesForward"));
+        PreparedQuery query = cachedQuery("select_messagesForward", db);
 
         if (first == -1) {
-            query.bindValue(":firstmsg", std::numeric_limits<qint64>::min());
+            query->bindValue(":firstmsg", std::numeric_limits<qint64>::min());
         } else {
-            query.bindValue(":firstmsg", first.toQint64());
+            query->bindValue(":firstmsg", first.toQint64());
         }
 
         if (last == -1) {
-            query.bindValue(":lastmsg", std::numeric_limits<qint64>::max());
+            query->bindValue(":lastmsg", std::numeric_limits<qint64>::max());
         } else {
-            query.bindValue(":lastmsg", last.toQint64());
+            query->bindValue(":lastmsg", last.toQint64());
         }
 
-        query.bindValue(":bufferid", bufferId.toInt());
+        query->bindValue(":bufferid", bufferId.toInt());
 
         int typeRaw = type;
         int flagsRaw = flags;
-        query.bindValue(":type", typeRaw);
-        query.bindValue(":flags", flagsRaw);
+        query->bindValue(":type", typeRaw);
+        query->bindValue(":flags", flagsRaw);
 
-        query.bindValue(":limit", limit);
+        query->bindValue(":limit", limit);
 
-        safeExec(query);
-        watchQuery(query);
+        safeExec(*query);
+        watchQuery(*query);
 
-        while (query.next()) {
+        while (query->next()) {
             Message msg(
                 // As of SQLite schema version 31, timestamps are stored in milliseconds
                 // instead of seconds.  This nets us more precision as well as simplifying
                 // 64-bit time.
-                QDateTime::fromMSecsSinceEpoch(query.value(1).toLongLong()),
+                QDateTime::fromMSecsSinceEpoch(query->value(1).toLongLong()),
                 bufferInfo,
-                (Message::Type)query.value(2).toInt(),
-                query.value(8).toString(),
-                query.value(4).toString(),
-                query.value(5).toString(),
-                query.value(6).toString(),
-                query.value(7).toString(),
-                Message::Flags{query.value(3).toInt()});
-            msg.setMsgId(query.value(0).toLongLong());
+                (Message::Type)query->value(2).toInt(),
+                query->value(8).toString(),
+                query->value(4).toString(),
+                query->value(5).toString(),
+                query->value(6).toString(),
+                query->value(7).toString(),
+                Message::Flags{query->value(3).toInt()});
+            msg.setMsgId(query->value(0).toLongLong());
             messagelist.push_back(std::move(msg));
         }
     }
@@ -2174,51 +2226,45 @@ std::vector<Message> SqliteStorage::requestAllMsgs(UserId user, MsgId first, Msg
 
     QHash<BufferId, BufferInfo> bufferInfoHash;
     {
-        QSqlQuery bufferInfoQuery(db);
-        bufferInfoQuery.prepare(queryString("select_buffers"));
-        bufferInfoQuery.bindValue(":userid", user.toInt());
+        PreparedQuery bufferInfoQuery = cachedQuery("select_buffers", db);
+        bufferInfoQuery->bindValue(":userid", user.toInt());
 
         lockForRead();
-        safeExec(bufferInfoQuery);
-        watchQuery(bufferInfoQuery);
-        while (bufferInfoQuery.next()) {
-            BufferInfo bufferInfo = BufferInfo(bufferInfoQuery.value(0).toInt(),
-                                               bufferInfoQuery.value(1).toInt(),
-                                               (BufferInfo::Type)bufferInfoQuery.value(2).toInt(),
-                                               bufferInfoQuery.value(3).toInt(),
-                                               bufferInfoQuery.value(4).toString());
+        safeExec(*bufferInfoQuery);
+        watchQuery(*bufferInfoQuery);
+        while (bufferInfoQuery->next()) {
+            BufferInfo bufferInfo = BufferInfo(bufferInfoQuery->value(0).toInt(),
+                                               bufferInfoQuery->value(1).toInt(),
+                                               (BufferInfo::Type)bufferInfoQuery->value(2).toInt(),
+                                               bufferInfoQuery->value(3).toInt(),
+                                               bufferInfoQuery->value(4).toString());
             bufferInfoHash[bufferInfo.bufferId()] = bufferInfo;
         }
 
-        QSqlQuery query(db);
-        if (last == -1) {
-            query.prepare(queryString("select_messagesAllNew"));
-        }
-        else {
-            query.prepare(queryString("select_messagesAll"));
-            query.bindValue(":lastmsg", last.toQint64());
-        }
-        query.bindValue(":userid", user.toInt());
-        query.bindValue(":firstmsg", first.toQint64());
-        query.bindValue(":limit", limit);
-        safeExec(query);
+        PreparedQuery query = cachedQuery(last == -1 ? "select_messagesAllNew" : "select_messagesAll", db);
+        if (last != -1)
+            query->bindValue(":lastmsg", last.toQint64());
+        query->bindValue(":userid", user.toInt());
+        query->bindValue(":firstmsg", first.toQint64());
+        query->bindValue(":limit", limit);
+        safeExec(*query);
 
-        watchQuery(query);
+        watchQuery(*query);
 
-        while (query.next()) {
+        while (query->next()) {
             Message msg(
                 // As of SQLite schema version 31, timestamps are stored in milliseconds instead of
                 // seconds.  This nets us more precision as well as simplifying 64-bit time.
-                QDateTime::fromMSecsSinceEpoch(query.value(2).toLongLong()),
-                bufferInfoHash[query.value(1).toInt()],
-                (Message::Type)query.value(3).toInt(),
-                query.value(9).toString(),
-                query.value(5).toString(),
-                query.value(6).toString(),
-                query.value(7).toString(),
-                query.value(8).toString(),
-                (Message::Flags)query.value(4).toInt());
-            msg.setMsgId(query.value(0).toLongLong());
+                QDateTime::fromMSecsSinceEpoch(query->value(2).toLongLong()),
+                bufferInfoHash[query->value(1).toInt()],
+                (Message::Type)query->value(3).toInt(),
+                query->value(9).toString(),
+                query->value(5).toString(),
+                query->value(6).toString(),
+                query->value(7).toString(),
+                query->value(8).toString(),
+                (Message::Flags)query->value(4).toInt());
+            msg.setMsgId(query->value(0).toLongLong());
             messagelist.push_back(std::move(msg));
         }
     }
@@ -2236,56 +2282,170 @@ std::vector<Message> SqliteStorage::requestAllMsgsFiltered(UserId user, MsgId fi
 
     QHash<BufferId, BufferInfo> bufferInfoHash;
     {
-        QSqlQuery bufferInfoQuery(db);
-        bufferInfoQuery.prepare(queryString("select_buffers"));
-        bufferInfoQuery.bindValue(":userid", user.toInt());
+        PreparedQuery bufferInfoQuery = cachedQuery("select_buffers", db);
+        bufferInfoQuery->bindValue(":userid", user.toInt());
 
         lockForRead();
-        safeExec(bufferInfoQuery);
-        watchQuery(bufferInfoQuery);
-        while (bufferInfoQuery.next()) {
-            BufferInfo bufferInfo = BufferInfo(bufferInfoQuery.value(0).toInt(),
-                                               bufferInfoQuery.value(1).toInt(),
-                                               (BufferInfo::Type)bufferInfoQuery.value(2).toInt(),
-                                               bufferInfoQuery.value(3).toInt(),
-                                               bufferInfoQuery.value(4).toString());
+        safeExec(*bufferInfoQuery);
+        watchQuery(*bufferInfoQuery);
+        while (bufferInfoQuery->next()) {
+            BufferInfo bufferInfo = BufferInfo(bufferInfoQuery->value(0).toInt(),
+                                               bufferInfoQuery->value(1).toInt(),
+                                               (BufferInfo::Type)bufferInfoQuery->value(2).toInt(),
+                                               bufferInfoQuery->value(3).toInt(),
+                                               bufferInfoQuery->value(4).toString());
             bufferInfoHash[bufferInfo.bufferId()] = bufferInfo;
         }
 
-        QSqlQuery query(db);
-        if (last == -1) {
-            query.prepare(queryString("select_messagesAllNew_filtered"));
-        }
-        else {
-            query.prepare(queryString("select_messagesAll_filtered"));
-            query.bindValue(":lastmsg", last.toQint64());
-        }
-        query.bindValue(":userid", user.toInt());
-        query.bindValue(":firstmsg", first.toQint64());
-        query.bindValue(":limit", limit);
+        PreparedQuery query = cachedQuery(last == -1 ? "select_messagesAllNew_filtered" : "select_messagesAll_filtered", db);
+        if (last != -1)
+            query->bindValue(":lastmsg", last.toQint64());
+        query->bindValue(":userid", user.toInt());
+        query->bindValue(":firstmsg", first.toQint64());
+        query->bindValue(":limit", limit);
         int typeRaw = type;
-        query.bindValue(":type", typeRaw);
+        query->bindValue(":type", typeRaw);
         int flagsRaw = flags;
-        query.bindValue(":flags", flagsRaw);
-        safeExec(query);
+        query->bindValue(":flags", flagsRaw);
+        safeExec(*query);
 
-        watchQuery(query);
+        watchQuery(*query);
 
-        while (query.next()) {
+        while (query->next()) {
             Message msg(
                 // As of SQLite schema version 31, timestamps are stored in milliseconds
                 // instead of seconds.  This nets us more precision as well as simplifying
                 // 64-bit time.
-                QDateTime::fromMSecsSinceEpoch(query.value(2).toLongLong()),
-                bufferInfoHash[query.value(1).toInt()],
-                (Message::Type)query.value(3).toInt(),
-                query.value(9).toString(),
-                query.value(5).toString(),
-                query.value(6).toString(),
-                query.value(7).toString(),
-                query.value(8).toString(),
-                Message::Flags{query.value(4).toInt()});
-            msg.setMsgId(query.value(0).toLongLong());
+                QDateTime::fromMSecsSinceEpoch(query->value(2).toLongLong()),
+                bufferInfoHash[query->value(1).toInt()],
+                (Message::Type)query->value(3).toInt(),
+                query->value(9).toString(),
+                query->value(5).toString(),
+                query->value(6).toString(),
+                query->value(7).toString(),
+                query->value(8).toString(),
+                Message::Flags{query->value(4).toInt()});
+            msg.setMsgId(query->value(0).toLongLong());
+            messagelist.push_back(std::move(msg));
+        }
+    }
+    db.commit();
+    unlock();
+    return messagelist;
+}
+
+std::vector<Message> SqliteStorage::searchMsgs(UserId user,
+                                               const QString& query,
+                                               NetworkId networkId,
+                                               BufferId bufferId,
+                                               const QString& sender,
+                                               Message::Types type,
+                                               const QDateTime& start,
+                                               const QDateTime& end,
+                                               MsgId last,
+                                               int limit)
+{
+    std::vector<Message> messagelist;
+
+    QString matchExpression = ftsMatchExpression(query, sender);
+    if (matchExpression.isEmpty())
+        return messagelist;
+
+    QSqlDatabase db = logDb();
+    db.transaction();
+
+    QHash<BufferId, BufferInfo> bufferInfoHash;
+    {
+        PreparedQuery bufferInfoQuery = cachedQuery("select_buffers", db);
+        bufferInfoQuery->bindValue(":userid", user.toInt());
+
+        lockForRead();
+        safeExec(*bufferInfoQuery);
+        watchQuery(*bufferInfoQuery);
+        while (bufferInfoQuery->next()) {
+            BufferInfo bufferInfo = BufferInfo(bufferInfoQuery->value(0).toInt(),
+                                               bufferInfoQuery->value(1).toInt(),
+                                               (BufferInfo::Type)bufferInfoQuery->value(2).toInt(),
+                                               bufferInfoQuery->value(3).toInt(),
+                                               bufferInfoQuery->value(4).toString());
+            bufferInfoHash[bufferInfo.bufferId()] = bufferInfo;
+        }
+
+        PreparedQuery searchQuery = cachedQuery("select_messagesSearch", db);
+        searchQuery->bindValue(":query", matchExpression);
+        searchQuery->bindValue(":userid", user.toInt());
+        searchQuery->bindValue(":networkid", networkId.toInt());
+        searchQuery->bindValue(":bufferid", bufferId.toInt());
+        searchQuery->bindValue(":lastmsg", last == -1 ? std::numeric_limits<qint64>::max() : last.toQint64());
+        searchQuery->bindValue(":starttime", start.isValid() ? start.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min());
+        searchQuery->bindValue(":endtime", end.isValid() ? end.toMSecsSinceEpoch() : std::numeric_limits<qint64>::max());
+        int typeRaw = type;
+        searchQuery->bindValue(":type", typeRaw);
+        searchQuery->bindValue(":limit", limit);
+        safeExec(*searchQuery);
+
+        watchQuery(*searchQuery);
+
+        while (searchQuery->next()) {
+            Message msg(QDateTime::fromMSecsSinceEpoch(searchQuery->value(2).toLongLong()),
+                        bufferInfoHash[searchQuery->value(1).toInt()],
+                        (Message::Type)searchQuery->value(3).toInt(),
+                        searchQuery->value(9).toString(),
+                        searchQuery->value(5).toString(),
+                        searchQuery->value(6).toString(),
+                        searchQuery->value(7).toString(),
+                        searchQuery->value(8).toString(),
+                        Message::Flags{searchQuery->value(4).toInt()});
+            msg.setMsgId(searchQuery->value(0).toLongLong());
+            messagelist.push_back(std::move(msg));
+        }
+    }
+    db.commit();
+    unlock();
+    return messagelist;
+}
+
+QString SqliteStorage::ftsMatchExpression(const QString& query, const QString& sender)
+{
+    QStringList terms;
+    auto addTerms = [&terms](const QString& column, const QString& words) {
+        for (auto&& word : words.split(QRegularExpression("\\s+"), QString::SkipEmptyParts)) {
+            terms << QString("%1 : \"%2\"").arg(column, QString(word).replace('"', "\"\""));
+        }
+    };
+    addTerms("message", query);
+    addTerms("sender", sender);
+    return terms.join(" AND ");
+}
+
+std::vector<Message> SqliteStorage::requestExpiredMsgs(UserId user, const BufferInfo& bufferInfo, const QDateTime& before, int limit)
+{
+    Q_UNUSED(user)
+    std::vector<Message> messagelist;
+
+    QSqlDatabase db = logDb();
+    db.transaction();
+    {
+        PreparedQuery query = cachedQuery("select_messagesExpired", db);
+        query->bindValue(":bufferid", bufferInfo.bufferId().toInt());
+        query->bindValue(":before", before.toMSecsSinceEpoch());
+        query->bindValue(":limit", limit);
+
+        lockForRead();
+        safeExec(*query);
+        watchQuery(*query);
+
+        while (query->next()) {
+            Message msg(QDateTime::fromMSecsSinceEpoch(query->value(2).toLongLong()),
+                        bufferInfo,
+                        (Message::Type)query->value(3).toInt(),
+                        query->value(9).toString(),
+                        query->value(5).toString(),
+                        query->value(6).toString(),
+                        query->value(7).toString(),
+                        query->value(8).toString(),
+                        Message::Flags{query->value(4).toInt()});
+            msg.setMsgId(query->value(0).toLongLong());
             messagelist.push_back(std::move(msg));
         }
     }
@@ -2294,6 +2454,33 @@ std::vector<Message> SqliteStorage::requestAllMsgsFiltered(UserId user, MsgId fi
     return messagelist;
 }
 
+int SqliteStorage::deleteExpiredMsgs(UserId user, BufferId bufferId, const QDateTime& before, MsgId last, int limit)
+{
+    Q_UNUSED(user)
+    int deleted = -1;
+
+    QSqlDatabase db = logDb();
+    db.transaction();
+    {
+        PreparedQuery query = cachedQuery("delete_backlog_expired", db);
+        query->bindValue(":bufferid", bufferId.toInt());
+        query->bindValue(":before", before.toMSecsSinceEpoch());
+        query->bindValue(":lastmsg", last == -1 ? std::numeric_limits<qint64>::max() : last.toQint64());
+        query->bindValue(":limit", limit);
+
+        lockForWrite();
+        safeExec(*query);
+        if (watchQuery(*query))
+            deleted = query->numRowsAffected();
+    }
+    if (deleted < 0)
+        db.rollback();
+    else
+        db.commit();
+    unlock();
+    return deleted;
+}
+
 QMap<UserId, QString> SqliteStorage::getAllAuthUserNames()
 {
     QMap<UserId, QString> authusernames;
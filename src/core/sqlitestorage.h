@@ -104,6 +104,7 @@ public:
     QHash<BufferId, Message::Types> bufferActivities(UserId id) override;
     Message::Types bufferActivity(BufferId bufferId, MsgId lastSeenMsgId) override;
     void setHighlightCount(UserId id, BufferId bufferId, int count) override;
+    void setBufferStates(UserId user, const std::vector<BufferState>& states) override;
     QHash<BufferId, int> highlightCounts(UserId id) override;
     int highlightCount(BufferId bufferId, MsgId lastSeenMsgId) override;
     QHash<QString, QByteArray> bufferCiphers(UserId user, const NetworkId& networkId) override;
@@ -134,6 +135,18 @@ public:
                                                 int limit = -1,
                                                 Message::Types type = Message::Types{-1},
                                                 Message::Flags flags = Message::Flags{-1}) override;
+    std::vector<Message> searchMsgs(UserId user,
+                                    const QString& query,
+                                    NetworkId networkId,
+                                    BufferId bufferId,
+                                    const QString& sender,
+                                    Message::Types type,
+                                    const QDateTime& start,
+                                    const QDateTime& end,
+                                    MsgId last,
+                                    int limit) override;
+    std::vector<Message> requestExpiredMsgs(UserId user, const BufferInfo& bufferInfo, const QDateTime& before, int limit) override;
+    int deleteExpiredMsgs(UserId user, BufferId bufferId, const QDateTime& before, MsgId last, int limit) override;
 
     /* Sysident handling */
     QMap<UserId, QString> getAllAuthUserNames() override;
@@ -169,16 +182,31 @@ protected:
 
     bool safeExec(QSqlQuery& query, int retryCount = 0);
 
+    /**
+     * Builds an FTS5 query for the backlog_fts table
+     *
+     * Every word has to appear in the respective column; words are quoted, so FTS5 syntax in the
+     * search terms is matched literally.
+     *
+     * @param query   Words to find in the message text
+     * @param sender  Words to find in the sender
+     * @return The expression for MATCH, or an empty string if there are no words to search for
+     */
+    static QString ftsMatchExpression(const QString& query, const QString& sender);
+
+    inline void lockForRead() { _dbLock.lockForRead(); }
+    inline void lockForWrite() { _dbLock.lockForWrite(); }
+    inline void unlock() { _dbLock.unlock(); }
+
 private:
     static QString backlogFile();
     void bindNetworkInfo(QSqlQuery& query, const NetworkInfo& info);
     void bindServerInfo(QSqlQuery& query, const Network::Server& server);
 
-    inline void lockForRead() { _dbLock.lockForRead(); }
-    inline void lockForWrite() { _dbLock.lockForWrite(); }
-    inline void unlock() { _dbLock.unlock(); }
     QReadWriteLock _dbLock;
+    SenderIdCache _senderIds;
     static int _maxRetryCount;
+    static int _maxInsertRows;
 };
 
 // ========================================
@@ -28,6 +28,20 @@ Storage::Storage(QObject* parent)
     : QObject(parent)
 {}
 
+void Storage::setBufferStates(UserId user, const std::vector<BufferState>& states)
+{
+    for (auto&& state : states) {
+        if (state.fields & BufferState::LastSeenMsg)
+            setBufferLastSeenMsg(user, state.bufferId, state.lastSeenMsg);
+        if (state.fields & BufferState::MarkerLineMsg)
+            setBufferMarkerLineMsg(user, state.bufferId, state.markerLineMsg);
+        if (state.fields & BufferState::Activity)
+            setBufferActivity(user, state.bufferId, state.activity);
+        if (state.fields & BufferState::HighlightCount)
+            setHighlightCount(user, state.bufferId, state.highlightCount);
+    }
+}
+
 QString Storage::hashPassword(const QString& password)
 {
     return hashPasswordSha2_512(password);
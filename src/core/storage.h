@@ -22,6 +22,7 @@
 
 #include <vector>
 
+#include <QDateTime>
 #include <QMap>
 #include <QObject>
 #include <QProcessEnvironment>
@@ -34,6 +35,8 @@
 #include "network.h"
 #include "types.h"
 
+class MetricsServer;
+
 class Storage : public QObject
 {
     Q_OBJECT
@@ -56,6 +59,39 @@ public:
 
     };
 
+    //! Changes to the persistent state of a buffer, see setBufferStates()
+    struct BufferState
+    {
+        enum Field
+        {
+            LastSeenMsg = 0x01,
+            MarkerLineMsg = 0x02,
+            Activity = 0x04,
+            HighlightCount = 0x08
+        };
+
+        BufferId bufferId;
+        int fields{0};  ///< The fields that changed, as a combination of Field values
+        MsgId lastSeenMsg;
+        MsgId markerLineMsg;
+        Message::Types activity{};
+        int highlightCount{0};
+
+        //! Applies the changes in a newer state on top of this one
+        void merge(const BufferState& newer)
+        {
+            if (newer.fields & LastSeenMsg)
+                lastSeenMsg = newer.lastSeenMsg;
+            if (newer.fields & MarkerLineMsg)
+                markerLineMsg = newer.markerLineMsg;
+            if (newer.fields & Activity)
+                activity = newer.activity;
+            if (newer.fields & HighlightCount)
+                highlightCount = newer.highlightCount;
+            fields |= newer.fields;
+        }
+    };
+
     /* General */
 
     //! Check if the storage type is available.
@@ -112,6 +148,13 @@ public:
      */
     virtual void sync() = 0;
 
+    /**
+     * Sets the metrics server to report storage statistics to
+     *
+     * @param metricsServer  Metrics server, may be nullptr
+     */
+    virtual void setMetricsServer(MetricsServer* metricsServer) { Q_UNUSED(metricsServer) }
+
     // TODO: Add functions for configuring the backlog handling, i.e. defining auto-cleanup settings etc
 
     /* User handling */
@@ -471,6 +514,16 @@ public:
      */
     virtual void setHighlightCount(UserId id, BufferId bufferId, int count) = 0;
 
+    //! Store changes to the state of several buffers at once
+    /** Last seen message, marker line, activity and highlight count of a user's buffers are all
+     *  written in a single transaction.  The default implementation stores them one by one.
+     *  \note This method is threadsafe.
+     *
+     * \param user    The Owner of the buffers
+     * \param states  The changes, at most one per buffer
+     */
+    virtual void setBufferStates(UserId user, const std::vector<BufferState>& states);
+
     //! Get a Hash of all highlight count states
     /** This Method is called when the Quassel Core is started to restore the HighlightCounts
      *  \note This method is threadsafe.
@@ -566,6 +619,50 @@ public:
                                                         Message::Types type = Message::Types{-1},
                                                         Message::Flags flags = Message::Flags{-1}) = 0;
 
+    //! Search the backlog of a user using the backend's full-text index
+    /** \param query     Words that have to appear in the message text, may be empty if sender is given
+     *  \param networkId if valid, only search buffers of this network
+     *  \param bufferId  if valid, only search this buffer
+     *  \param sender    Words that have to appear in the sender (nick!user@host), may be empty
+     *  \param type      The Message::Types that should be returned
+     *  \param start     if valid, return only messages sent at or after this time
+     *  \param end       if valid, return only messages sent before this time
+     *  \param last      if != -1 return only messages with a MsgId < last
+     *  \param limit     Max amount of messages
+     *  \return The matching messages, newest first
+     */
+    virtual std::vector<Message> searchMsgs(UserId user,
+                                            const QString& query,
+                                            NetworkId networkId,
+                                            BufferId bufferId,
+                                            const QString& sender,
+                                            Message::Types type,
+                                            const QDateTime& start,
+                                            const QDateTime& end,
+                                            MsgId last,
+                                            int limit) = 0;
+
+    //! Request the oldest messages of a buffer that were sent before a given time
+    /** \param user       The owner of the buffer
+     *  \param bufferInfo The buffer we request messages from
+     *  \param before     Return only messages with a timestamp < before
+     *  \param limit      Max amount of messages
+     *  \return The expired messages, oldest first
+     */
+    virtual std::vector<Message> requestExpiredMsgs(UserId user, const BufferInfo& bufferInfo, const QDateTime& before, int limit) = 0;
+
+    //! Delete the oldest messages of a buffer that were sent before a given time
+    /** Only a limited number of messages is deleted at once, so other users of the database don't
+     *  have to wait for long.
+     *  \param user       The owner of the buffer
+     *  \param bufferId   The buffer to delete messages from
+     *  \param before     Delete only messages with a timestamp < before
+     *  \param last       if != -1 delete only messages with a MsgId <= last
+     *  \param limit      Max amount of messages to delete
+     *  \return The number of deleted messages, or -1 on error
+     */
+    virtual int deleteExpiredMsgs(UserId user, BufferId bufferId, const QDateTime& before, MsgId last, int limit) = 0;
+
     //! Fetch all authusernames
     /** \return      Map of all current UserIds to permitted idents
      */
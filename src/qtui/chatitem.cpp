@@ -32,6 +32,7 @@
 #include <QPainter>
 #include <QPalette>
 #include <QTextLayout>
+#include <QtMath>
 
 #include "action.h"
 #include "buffermodel.h"
@@ -593,12 +594,15 @@ void SenderChatItem::handleClick(const QPointF& pos, ChatScene::ClickMode clickM
 
 ContentsChatItem::ActionProxy ContentsChatItem::_actionProxy;
 
-ContentsChatItem::ContentsChatItem(const QPointF& pos, const qreal& width, ChatLine* parent)
+ContentsChatItem::ContentsChatItem(const QPointF& pos, const qreal& width, bool estimateHeight, ChatLine* parent)
     : ChatItem(QRectF(pos, QSizeF(width, 0)), parent)
     , _data(nullptr)
 {
     setPos(pos);
-    setGeometryByWidth(width);
+    if (estimateHeight)
+        estimateGeometryByWidth(width);
+    else
+        setGeometryByWidth(width);
 }
 
 QFontMetricsF* ContentsChatItem::fontMetrics() const
@@ -648,6 +652,23 @@ qreal ContentsChatItem::setGeometryByWidth(qreal w)
     return h;
 }
 
+qreal ContentsChatItem::estimateGeometryByWidth(qreal w)
+{
+    // the raw contents are close enough, and unlike the display text they don't need the message to be styled
+    int lines = 1;
+    if (w > 0) {
+        qreal textWidth = data(ChatLineModel::ContentsLengthRole).toInt() * fontMetrics()->averageCharWidth();
+        lines = qMax(1, qCeil(textWidth / w));
+    }
+    qreal spacing = qMax(fontMetrics()->lineSpacing(), fontMetrics()->height());  // cope with negative leading()
+    qreal h = lines * spacing;
+
+    if (w != width() || h != height())
+        setGeometry(w, h);
+
+    return h;
+}
+
 void ContentsChatItem::initLayout(QTextLayout* layout) const
 {
     initLayoutHelper(layout, QTextOption::WrapAtWordBoundaryOrAnywhere);
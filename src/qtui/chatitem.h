@@ -207,7 +207,7 @@ class ContentsChatItem : public ChatItem
     Q_DECLARE_TR_FUNCTIONS(ContentsChatItem)
 
 public:
-    ContentsChatItem(const QPointF& pos, const qreal& width, ChatLine* parent);
+    ContentsChatItem(const QPointF& pos, const qreal& width, bool estimateHeight, ChatLine* parent);
     ~ContentsChatItem() override;
 
     inline int type() const override { return ChatScene::ContentsChatItemType; }
@@ -247,6 +247,11 @@ private:
     void clearWebPreview();
 
     qreal setGeometryByWidth(qreal w);
+    //! Sets an approximate geometry derived from the text length instead of wrapping the text
+    /** Computing the wrap list needs a QTextLayout of the whole message, which is by far the most expensive part of
+     *  laying out a ChatLine. Lines away from the viewport use this estimate until ChatScene refines them.
+     */
+    qreal estimateGeometryByWidth(qreal w);
 
     QFontMetricsF* _fontMetrics;
 
@@ -55,16 +55,18 @@ ChatLine::ChatLine(int row,
                    const qreal& contentsWidth,
                    const QPointF& senderPos,
                    const QPointF& contentsPos,
+                   bool estimateHeight,
                    QGraphicsItem* parent)
     : QGraphicsItem(parent)
     , _row(row) // needs to be set before the items
     , _model(model)
-    , _contentsItem(contentsPos, contentsWidth, this)
+    , _contentsItem(contentsPos, contentsWidth, estimateHeight, this)
     , _senderItem(QRectF(senderPos, QSizeF(senderWidth, _contentsItem.height())), this)
     , _timestampItem(QRectF(0, 0, timestampWidth, _contentsItem.height()), this)
     , _width(width)
     , _height(_contentsItem.height())
     , _selection(0)
+    , _needsLayout(estimateHeight)
     , _mouseGrabberItem(nullptr)
     , _hoverItem(nullptr)
 {
@@ -139,10 +141,20 @@ void ChatLine::setFirstColumn(const qreal& timestampWidth, const qreal& senderWi
     _senderItem.setPos(senderPos);
 }
 
-void ChatLine::setSecondColumn(const qreal& senderWidth, const qreal& contentsWidth, const QPointF& contentsPos, qreal& linePos)
+bool ChatLine::hasFirstColumn(const qreal& timestampWidth, const qreal& senderWidth, const QPointF& senderPos) const
+{
+    return _timestampItem.width() == timestampWidth && _senderItem.width() == senderWidth && _senderItem.pos() == senderPos;
+}
+
+void ChatLine::setSecondColumn(const qreal& senderWidth,
+                               const qreal& contentsWidth,
+                               const QPointF& contentsPos,
+                               qreal& linePos,
+                               bool estimateHeight)
 {
     // linepos is the *bottom* position for the line
-    qreal height = _contentsItem.setGeometryByWidth(contentsWidth);
+    qreal height = estimateHeight ? _contentsItem.estimateGeometryByWidth(contentsWidth) : _contentsItem.setGeometryByWidth(contentsWidth);
+    _needsLayout = estimateHeight;
     linePos -= height;
     bool needGeometryChange = (height != _height);
 
@@ -158,10 +170,11 @@ void ChatLine::setSecondColumn(const qreal& senderWidth, const qreal& contentsWi
     setPos(0, linePos);
 }
 
-void ChatLine::setGeometryByWidth(const qreal& width, const qreal& contentsWidth, qreal& linePos)
+void ChatLine::setGeometryByWidth(const qreal& width, const qreal& contentsWidth, qreal& linePos, bool estimateHeight)
 {
     // linepos is the *bottom* position for the line
-    qreal height = _contentsItem.setGeometryByWidth(contentsWidth);
+    qreal height = estimateHeight ? _contentsItem.estimateGeometryByWidth(contentsWidth) : _contentsItem.setGeometryByWidth(contentsWidth);
+    _needsLayout = estimateHeight;
     linePos -= height;
     bool needGeometryChange = (height != _height || width != _width);
 
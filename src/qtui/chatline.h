@@ -46,6 +46,7 @@ public:
              const qreal& contentsWidth,
              const QPointF& senderPos,
              const QPointF& contentsPos,
+             bool estimateHeight = false,
              QGraphicsItem* parent = nullptr);
 
     ~ChatLine() override;
@@ -83,8 +84,18 @@ public:
     void setFirstColumn(const qreal& timestampWidth, const qreal& senderWidth, const QPointF& senderPos);
     // setSecondColumn and setGeometryByWidth both also relocate the chatline.
     // the _bottom_ position is passed via linePos. linePos is updated to the top of the chatLine.
-    void setSecondColumn(const qreal& senderWidth, const qreal& contentsWidth, const QPointF& contentsPos, qreal& linePos);
-    void setGeometryByWidth(const qreal& width, const qreal& contentsWidth, qreal& linePos);
+    // with estimateHeight, the height is only approximated and the line is marked as needing layout.
+    void setSecondColumn(const qreal& senderWidth,
+                         const qreal& contentsWidth,
+                         const QPointF& contentsPos,
+                         qreal& linePos,
+                         bool estimateHeight = false);
+    void setGeometryByWidth(const qreal& width, const qreal& contentsWidth, qreal& linePos, bool estimateHeight = false);
+
+    // true if the geometry is outdated or only estimated; ChatScene lays out such lines once they get near the viewport
+    inline bool needsLayout() const { return _needsLayout; }
+    // true if the first column has been set to the given geometry with setFirstColumn()
+    bool hasFirstColumn(const qreal& timestampWidth, const qreal& senderWidth, const QPointF& senderPos) const;
 
     void setSelected(bool selected, ChatLineModel::ColumnType minColumn = ChatLineModel::ContentsColumn);
     void setHighlighted(bool highlighted);
@@ -126,6 +137,7 @@ private:
     // _selection[6] ...... Selected
     // _selection[7] ...... Highlighted
     quint8 _selection;  // save space, so we put both the col and the flags into one byte
+    bool _needsLayout;
 
     ChatItem* _mouseGrabberItem;
     ChatItem* _hoverItem;
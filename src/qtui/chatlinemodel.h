@@ -35,7 +35,8 @@ public:
     {
         WrapListRole = MessageModel::UserRole,
         MsgLabelRole,
-        SelectedBackgroundRole
+        SelectedBackgroundRole,
+        ContentsLengthRole  ///< Length of the message text, available without styling the message
     };
 
     ChatLineModel(QObject* parent = nullptr);
@@ -57,6 +58,10 @@ protected:
     inline void insertMessage__(int pos, const Message& msg) override { _messageList.insert(pos, ChatLineModelItem(msg)); }
     void insertMessages__(int pos, const QList<Message>&) override;
     inline void removeMessageAt(int i) override { _messageList.removeAt(i); }
+    inline void removeMessagesAt(int start, int count) override
+    {
+        _messageList.erase(_messageList.begin() + start, _messageList.begin() + start + count);
+    }
     inline void removeAllMessages() override { _messageList.clear(); }
     Message takeMessageAt(int i) override;
 
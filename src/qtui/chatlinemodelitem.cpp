@@ -150,6 +150,8 @@ QVariant ChatLineModelItem::contentsData(int role) const
         if (_wrapList.isEmpty())
             computeWrapList();
         return QVariant::fromValue(_wrapList);
+    case ChatLineModel::ContentsLengthRole:
+        return _styledMsg.contents().length();
     }
     return QVariant();
 }
@@ -175,6 +177,19 @@ QVariant ChatLineModelItem::backgroundBrush(UiStyle::FormatType subelement, bool
     return QVariant();
 }
 
+qint64 ChatLineModelItem::memoryUsage() const
+{
+    qint64 wrapListSize = _wrapList.capacity() * static_cast<qint64>(sizeof(Word));
+    return MessageModelItem::memoryUsage() + _styledMsg.styleCacheSize() + wrapListSize;
+}
+
+void ChatLineModelItem::dropCaches()
+{
+    // Unlike clear(), this releases the memory
+    _wrapList = WrapList();
+    _styledMsg.clearStyleCache();
+}
+
 void ChatLineModelItem::computeWrapList() const
 {
     QString text = _styledMsg.plainContents();
@@ -41,6 +41,9 @@ public:
 
     virtual inline void invalidateWrapList() { _wrapList.clear(); }
 
+    qint64 memoryUsage() const override;
+    void dropCaches() override;
+
     /// Used to store information about words to be used for wrapping
     struct Word
     {
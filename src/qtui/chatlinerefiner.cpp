@@ -0,0 +1,98 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "chatlinerefiner.h"
+
+ChatLineRefiner::Result ChatLineRefiner::refine(qreal viewTop, qreal viewHeight, bool followsBottom)
+{
+    Result result;
+    int count = lineCount();
+    if (!count)
+        return result;
+
+    if (followsBottom)
+        viewTop = lineTop(count - 1) + lineHeight(count - 1) - viewHeight;
+
+    // The window is determined before anything moves, so lines shrinking or growing don't change what gets laid out
+    int first = firstRowEndingAfter(viewTop - viewHeight);
+    int last = lastRowStartingBefore(viewTop + 2 * viewHeight);
+    if (first > last)
+        return result;
+
+    // The line at the top of the viewport should stay where it is on screen
+    int anchor = qBound(first, firstRowEndingAfter(viewTop), last);
+    qreal anchorTop = lineTop(anchor);
+    qreal firstTop = lineTop(first);
+
+    qreal linePos = lineTop(last) + lineHeight(last);
+    for (int row = last; row >= first; row--) {
+        if (needsLayout(row)) {
+            linePos -= layoutLine(row, linePos);
+            result.changed = true;
+        }
+        else {
+            linePos -= lineHeight(row);
+            moveLine(row, linePos);
+        }
+    }
+
+    if (!result.changed)
+        return result;
+
+    // Lines above the window keep their geometry, but move along
+    qreal shift = linePos - firstTop;
+    if (shift != 0) {
+        for (int row = first - 1; row >= 0; row--)
+            moveLine(row, lineTop(row) + shift);
+    }
+
+    if (!followsBottom)
+        result.offset = anchorTop - lineTop(anchor);
+    return result;
+}
+
+int ChatLineRefiner::firstRowEndingAfter(qreal y) const
+{
+    // Lines are stacked in row order, so we can bisect
+    int low = 0;
+    int high = lineCount();
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (lineTop(mid) + lineHeight(mid) > y)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return low;
+}
+
+int ChatLineRefiner::lastRowStartingBefore(qreal y) const
+{
+    int low = 0;
+    int high = lineCount();
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (lineTop(mid) < y)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low - 1;
+}
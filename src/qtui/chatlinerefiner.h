@@ -0,0 +1,68 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include "qtui-export.h"
+
+#include <QtGlobal>
+
+//! Lays out the lines near the viewport whose geometry is only estimated
+/** ChatScene stacks one line per row, from top to bottom. Wrapping a line's text to get its exact height needs a text
+ *  layout of the whole message, so lines away from the viewport only get an estimated height. Once the view gets close,
+ *  the refiner lays out the lines within one viewport height around the visible area exactly and restacks the lines:
+ *  the bottom of that window stays in place, the lines above it move along.
+ *
+ *  Subclasses provide access to the lines, which keeps this testable without a scene.
+ */
+class QTUI_EXPORT ChatLineRefiner
+{
+public:
+    struct Result
+    {
+        bool changed{false};  ///< Whether any line has been laid out
+        qreal offset{0};      ///< How far the line at the top of the viewport moved up, 0 if the view follows the bottom
+    };
+
+    virtual ~ChatLineRefiner() = default;
+
+    //! Lays out the lines near the viewport
+    /** \param viewTop        The top of the visible area
+     *  \param viewHeight     The height of the visible area
+     *  \param followsBottom  Whether the view sticks to the end of the scene, in which case viewTop is ignored
+     *  \return Whether lines changed, and how far the view needs to scroll up to keep its contents in place
+     */
+    Result refine(qreal viewTop, qreal viewHeight, bool followsBottom);
+
+protected:
+    virtual int lineCount() const = 0;
+    virtual qreal lineTop(int row) const = 0;
+    virtual qreal lineHeight(int row) const = 0;
+    virtual bool needsLayout(int row) const = 0;
+    //! Lays out the line exactly with its bottom at the given position, returning its new height
+    virtual qreal layoutLine(int row, qreal bottom) = 0;
+    virtual void moveLine(int row, qreal top) = 0;
+
+private:
+    //! Returns the first row ending below y, or lineCount() if there is none
+    int firstRowEndingAfter(qreal y) const;
+    //! Returns the last row starting above y, or -1 if there is none
+    int lastRowStartingBefore(qreal y) const;
+};
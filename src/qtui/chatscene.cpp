@@ -31,6 +31,7 @@
 #include <QMenuBar>
 #include <QMimeData>
 #include <QPersistentModelIndex>
+#include <QScrollBar>
 #include <QUrl>
 
 #ifdef HAVE_WEBENGINE
@@ -42,6 +43,7 @@
 #include "chatitem.h"
 #include "chatline.h"
 #include "chatlinemodelitem.h"
+#include "chatlinerefiner.h"
 #include "chatview.h"
 #include "chatviewsettings.h"
 #include "client.h"
@@ -58,6 +60,57 @@
 
 const qreal minContentsWidth = 200;
 
+namespace {
+
+//! Lays out the lines of a scene with its current column geometry
+class SceneLineRefiner : public ChatLineRefiner
+{
+public:
+    SceneLineRefiner(const QList<ChatLine*>& lines, const ChatScene* scene, qreal width)
+        : _lines(lines)
+        , _timestampWidth(scene->firstColumnHandle()->sceneLeft())
+        , _senderWidth(scene->secondColumnHandle()->sceneLeft() - scene->firstColumnHandle()->sceneRight())
+        , _contentsWidth(width - scene->secondColumnHandle()->sceneRight())
+        , _senderPos(scene->firstColumnHandle()->sceneRight(), 0)
+        , _contentsPos(scene->secondColumnHandle()->sceneRight(), 0)
+    {}
+
+protected:
+    int lineCount() const override { return _lines.count(); }
+    qreal lineTop(int row) const override { return _lines.at(row)->pos().y(); }
+    qreal lineHeight(int row) const override { return _lines.at(row)->height(); }
+
+    bool needsLayout(int row) const override
+    {
+        // dragging the first column handle only updates the lines near the viewport, the others catch up here
+        ChatLine* line = _lines.at(row);
+        return line->needsLayout() || !line->hasFirstColumn(_timestampWidth, _senderWidth, _senderPos);
+    }
+
+    qreal layoutLine(int row, qreal bottom) override
+    {
+        ChatLine* line = _lines.at(row);
+        line->setFirstColumn(_timestampWidth, _senderWidth, _senderPos);
+        if (line->needsLayout())
+            line->setSecondColumn(_senderWidth, _contentsWidth, _contentsPos, bottom);
+        else
+            line->setPos(0, bottom - line->height());
+        return line->height();
+    }
+
+    void moveLine(int row, qreal top) override { _lines.at(row)->setPos(0, top); }
+
+private:
+    const QList<ChatLine*>& _lines;
+    qreal _timestampWidth;
+    qreal _senderWidth;
+    qreal _contentsWidth;
+    QPointF _senderPos;
+    QPointF _contentsPos;
+};
+
+}  // namespace
+
 ChatScene::ChatScene(QAbstractItemModel* model, QString idString, qreal width, ChatView* parent)
     : QGraphicsScene(0, 0, width, 0, (QObject*)parent)
     , _chatView(parent)
@@ -355,7 +408,7 @@ void ChatScene::rowsInserted(const QModelIndex& index, int start, int end)
 
     if (atTop) {
         for (int i = end; i >= start; i--) {
-            auto* line = new ChatLine(i, model(), width, timestampWidth, senderWidth, contentsWidth, senderPos, contentsPos);
+            auto* line = new ChatLine(i, model(), width, timestampWidth, senderWidth, contentsWidth, senderPos, contentsPos, true);
             h += line->height();
             line->setPos(0, y - h);
             _lines.insert(start, line);
@@ -364,7 +417,7 @@ void ChatScene::rowsInserted(const QModelIndex& index, int start, int end)
     }
     else {
         for (int i = start; i <= end; i++) {
-            auto* line = new ChatLine(i, model(), width, timestampWidth, senderWidth, contentsWidth, senderPos, contentsPos);
+            auto* line = new ChatLine(i, model(), width, timestampWidth, senderWidth, contentsWidth, senderPos, contentsPos, true);
             line->setPos(0, y + h);
             h += line->height();
             _lines.insert(i, line);
@@ -434,13 +487,19 @@ void ChatScene::rowsInserted(const QModelIndex& index, int start, int end)
         // force new search for first proper line
         _firstLineRow = -1;
     }
+
+    // new lines only got an estimated height so far, wrap those that might become visible
+    bool refined = layoutVisibleLines(width);
+    if (atBottom)
+        h = _lines.last()->pos().y() + _lines.last()->height() - _lines.at(start)->pos().y();
+
     updateSceneRect();
     if (atBottom) {
         emit lastLineChanged(_lines.last(), h);
     }
 
     // now move the marker line if necessary. we don't need to do anything if we appended lines though...
-    if (!_markerLineValid)
+    if (!_markerLineValid || refined)
         setMarkerLine();
 }
 
@@ -540,6 +599,8 @@ void ChatScene::rowsAboutToBeRemoved(const QModelIndex& parent, int start, int e
 
 void ChatScene::rowsRemoved()
 {
+    // lines that moved into the viewport might only have an estimated height
+    refineGeometry();
     // move the marker line if necessary
     setMarkerLine();
 }
@@ -575,7 +636,7 @@ void ChatScene::layout(int start, int end, qreal width)
         qreal linePos = _lines.at(row)->scenePos().y() + _lines.at(row)->height();
         qreal contentsWidth = width - secondColumnHandle()->sceneRight();
         while (row >= start) {
-            _lines.at(row--)->setGeometryByWidth(width, contentsWidth, linePos);
+            _lines.at(row--)->setGeometryByWidth(width, contentsWidth, linePos, true);
         }
 
         if (row >= 0) {
@@ -589,6 +650,9 @@ void ChatScene::layout(int start, int end, qreal width)
                 }
             }
         }
+
+        // the above only estimated the heights, wrapping is done for the lines near the viewport
+        layoutVisibleLines(width);
     }
 
     // setItemIndexMethod(QGraphicsScene::BspTreeIndex);
@@ -619,16 +683,8 @@ void ChatScene::firstHandlePositionChanged(qreal xpos)
     // 2 to 10 times faster!
     // setItemIndexMethod(QGraphicsScene::NoIndex);
 
-    QList<ChatLine*>::iterator lineIter = _lines.end();
-    QList<ChatLine*>::iterator lineIterBegin = _lines.begin();
-    qreal timestampWidth = firstColumnHandle()->sceneLeft();
-    qreal senderWidth = secondColumnHandle()->sceneLeft() - firstColumnHandle()->sceneRight();
-    QPointF senderPos(firstColumnHandle()->sceneRight(), 0);
-
-    while (lineIter != lineIterBegin) {
-        --lineIter;
-        (*lineIter)->setFirstColumn(timestampWidth, senderWidth, senderPos);
-    }
+    // only the lines near the viewport are updated right away, the others once they get close to it
+    refineGeometry();
     // setItemIndexMethod(QGraphicsScene::BspTreeIndex);
 
     setHandleXLimits();
@@ -662,8 +718,9 @@ void ChatScene::secondHandlePositionChanged(qreal xpos)
     QPointF contentsPos(secondColumnHandle()->sceneRight(), 0);
     while (lineIter != lineIterBegin) {
         --lineIter;
-        (*lineIter)->setSecondColumn(senderWidth, contentsWidth, contentsPos, linePos);
+        (*lineIter)->setSecondColumn(senderWidth, contentsWidth, contentsPos, linePos, true);
     }
+    layoutVisibleLines(_sceneRect.width());
     // setItemIndexMethod(QGraphicsScene::BspTreeIndex);
 
     updateSceneRect();
@@ -674,6 +731,32 @@ void ChatScene::secondHandlePositionChanged(qreal xpos)
     //   qDebug() << "resized" << _lines.count() << "in" << (float)(endT - startT) / CLOCKS_PER_SEC << "sec";
 }
 
+qreal ChatScene::refineGeometry()
+{
+    qreal offset = 0;
+    if (layoutVisibleLines(_sceneRect.width(), &offset)) {
+        updateSceneRect();
+        setMarkerLine();
+        emit layoutChanged();
+    }
+    return offset;
+}
+
+bool ChatScene::layoutVisibleLines(qreal width, qreal* viewOffset)
+{
+    // if the view sticks to the bottom, that's the end of the scene no matter where the scrollbar currently is
+    ChatView* view = chatView();
+    QScrollBar* vbar = view->verticalScrollBar();
+    QRectF visible = view->mapToScene(view->viewport()->rect()).boundingRect();
+    bool followsBottom = (view->scene() != this || vbar->value() == vbar->maximum());
+
+    SceneLineRefiner refiner(_lines, this, width);
+    ChatLineRefiner::Result result = refiner.refine(visible.top(), visible.height(), followsBottom);
+    if (viewOffset)
+        *viewOffset = result.offset;
+    return result.changed;
+}
+
 void ChatScene::setHandleXLimits()
 {
     _firstColHandle->setXLimits(0, _secondColHandle->sceneLeft());
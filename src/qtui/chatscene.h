@@ -144,6 +144,14 @@ public:
 
     bool isScrollingAllowed() const;
 
+    //! Lays out the lines near the viewport that only have an estimated geometry
+    /** Only lines within one viewport height around the visible area are wrapped exactly; all others get an
+     *  estimated height (see ChatLine::needsLayout()), so inserting backlog, resizing and dragging the column
+     *  handles do not need to wrap every line of the scene.
+     *  \return The distance the contents at the top of the viewport moved up, so the view can compensate
+     */
+    qreal refineGeometry();
+
 public slots:
     void updateForViewport(qreal width, qreal height);
     void setWidth(qreal width);
@@ -230,6 +238,7 @@ private slots:
 private:
     void setHandleXLimits();
     void updateSelection(const QPointF& pos);
+    bool layoutVisibleLines(qreal width, qreal* viewOffset = nullptr);
 
     ChatView* _chatView;
     QString _idString;
@@ -422,6 +422,7 @@ void ChatView::scrollContentsBy(int dx, int dy)
 {
     QGraphicsView::scrollContentsBy(dx, dy);
     checkChatLineCaches();
+    refineChatLines();
 }
 
 void ChatView::setHasCache(ChatLine* line, bool hasCache)
@@ -450,6 +451,14 @@ bool ChatView::requestBacklogForScroll()
     }
 }
 
+void ChatView::refineChatLines()
+{
+    // lines that scrolled into view might need their exact height, keep the contents at the top of the viewport in place
+    int offset = qRound(scene()->refineGeometry() * _currentScaleFactor);
+    if (offset != 0)
+        verticalScrollBar()->setValue(verticalScrollBar()->value() - offset);
+}
+
 void ChatView::checkChatLineCaches()
 {
     qreal top = mapToScene(viewport()->rect().topLeft()).y() - 10;  // some grace area to avoid premature cleaning
@@ -113,6 +113,7 @@ private slots:
     void lastLineChanged(QGraphicsItem* chatLine, qreal offset);
     void adjustSceneRect();
     void checkChatLineCaches();
+    void refineChatLines();
     void mouseMoveWhileSelecting(const QPointF& scenePos);
     void scrollTimerTimeout();
     void invalidateFilter();
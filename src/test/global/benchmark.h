@@ -0,0 +1,84 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+
+#include <QElapsedTimer>
+#include <QString>
+
+#include "testglobal.h"
+
+/**
+ * Defines a benchmark
+ *
+ * Benchmarks are disabled tests, so they don't slow down regular test runs. Run them with
+ * --gtest_also_run_disabled_tests; their results are recorded as test properties, which end up
+ * in the report written with --gtest_output=xml.
+ */
+#define QUASSEL_BENCHMARK(test_case_name, test_name) TEST(test_case_name, DISABLED_##test_name)
+
+namespace test {
+
+/**
+ * Times the phases of a benchmark, and records its results
+ */
+class Benchmark
+{
+public:
+    Benchmark() { _timer.start(); }
+
+    /**
+     * Ends the current phase
+     *
+     * @returns the milliseconds since the previous call, or since construction, but at least 1
+     */
+    qint64 lap() { return std::max<qint64>(_timer.restart(), 1); }
+
+    /**
+     * Records a result of the benchmark
+     *
+     * @param key    Name of the result
+     * @param value  The result
+     */
+    static void record(const QString& key, qint64 value) { record(key, QString::number(value)); }
+
+    static void record(const QString& key, double value, int precision) { record(key, QString::number(value, 'f', precision)); }
+
+    static void record(const QString& key, const QString& value)
+    {
+        ::testing::Test::RecordProperty(key.toStdString(), value.toStdString());
+    }
+
+    /**
+     * Records how many items were processed per second
+     *
+     * @param key    Name of the result
+     * @param items  Number of items processed
+     * @param ms     Milliseconds it took
+     */
+    static void recordRate(const QString& key, qint64 items, qint64 ms) { record(key, items * 1000 / std::max<qint64>(ms, 1)); }
+
+private:
+    QElapsedTimer _timer;
+};
+
+}  // namespace test
@@ -1021,6 +1021,12 @@ const UiStyle::FormatList& UiStyle::StyledMessage::contentsFormatList() const
     return _contents.formatList;
 }
 
+qint64 UiStyle::StyledMessage::styleCacheSize() const
+{
+    return _contents.plainText.capacity() * static_cast<qint64>(sizeof(QChar))
+           + _contents.formatList.capacity() * static_cast<qint64>(sizeof(FormatList::value_type));
+}
+
 QString UiStyle::StyledMessage::decoratedTimestamp() const
 {
     return timestamp().toLocalTime().toString(UiStyle::timestampFormatString());
@@ -412,6 +412,11 @@ public:
 
     quint8 senderHash() const;
 
+    //! Returns the memory taken up by the styled contents, in bytes
+    qint64 styleCacheSize() const;
+    //! Drops the styled contents; they are computed again when needed
+    void clearStyleCache() { _contents = StyledString(); }
+
 protected:
     void style() const;
 
@@ -0,0 +1,159 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "testglobal.h"
+#include "abstractmessageprocessor.h"
+#include "abstractui.h"
+#include "backlogrequester.h"
+#include "bufferinfo.h"
+#include "client.h"
+#include "clientbacklogmanager.h"
+#include "message.h"
+#include "quassel.h"
+
+class RecordingMessageProcessor : public AbstractMessageProcessor
+{
+    Q_OBJECT
+
+public:
+    using AbstractMessageProcessor::AbstractMessageProcessor;
+
+    void reset() override {}
+    void process(Message&) override {}
+    void process(QList<Message>& msgs) override { processed.push_back(msgs); }
+    void networkRemoved(NetworkId) override {}
+
+    std::vector<QList<Message>> processed;
+};
+
+class TestUi : public AbstractUi
+{
+    Q_OBJECT
+
+public:
+    void init() override {}
+    // Backlog handling doesn't touch the message model
+    MessageModel* createMessageModel(QObject*) override { return nullptr; }
+    AbstractMessageProcessor* createMessageProcessor(QObject* parent) override { return new RecordingMessageProcessor(parent); }
+};
+
+class TestBacklogRequester : public BacklogRequester
+{
+public:
+    TestBacklogRequester(ClientBacklogManager* backlogManager)
+        : BacklogRequester(true, BacklogRequester::PerBufferFixed, backlogManager)
+    {}
+
+    void requestBacklog(const BufferIdList& bufferIds) override { setWaitingBuffers(bufferIds); }
+};
+
+class TestBacklogManager : public ClientBacklogManager
+{
+public:
+    using ClientBacklogManager::_requester;
+};
+
+namespace {
+
+RecordingMessageProcessor* messageProcessor()
+{
+    // Settings need the application instance, which can only ever be created once
+    static Quassel* quassel = new Quassel;
+    static Client* client = new Client(std::make_unique<TestUi>());
+    Q_UNUSED(quassel);
+    Q_UNUSED(client);
+    return static_cast<RecordingMessageProcessor*>(Client::messageProcessor());
+}
+
+QVariantList chunk(BufferId bufferId, std::initializer_list<int> msgIds)
+{
+    QVariantList result;
+    for (int msgId : msgIds) {
+        Message msg(BufferInfo(bufferId, 1, BufferInfo::ChannelBuffer), Message::Plain, QString("message %1").arg(msgId));
+        msg.setMsgId(msgId);
+        result << QVariant::fromValue(msg);
+    }
+    return result;
+}
+
+/// @returns the MsgIds of each list of messages processed since the last call
+std::vector<std::vector<int>> takeProcessed()
+{
+    std::vector<std::vector<int>> result;
+    for (auto&& msgs : messageProcessor()->processed) {
+        std::vector<int> msgIds;
+        for (auto&& msg : msgs) {
+            EXPECT_TRUE(msg.flags() & Message::Backlog);
+            msgIds.push_back(static_cast<int>(msg.msgId().toQint64()));
+        }
+        result.push_back(msgIds);
+    }
+    messageProcessor()->processed.clear();
+    return result;
+}
+
+}  // namespace
+
+TEST(ClientBacklogManagerTest, bufferedChunks)
+{
+    messageProcessor();
+    TestBacklogManager manager;
+    manager._requester = new TestBacklogRequester(&manager);
+    manager._requester->requestBacklog({1, 2});
+
+    std::vector<std::pair<int, int>> progress;
+    QObject::connect(&manager, &ClientBacklogManager::updateProgress, [&](int done, int total) { progress.emplace_back(done, total); });
+
+    // Each chunk is processed as soon as it arrives, even though the buffer isn't complete yet
+    manager.receiveBacklogChunk(1, chunk(1, {10, 8}), false);
+    EXPECT_EQ((std::vector<std::vector<int>>{{8, 10}}), takeProcessed());
+    manager.receiveBacklogChunk(2, chunk(2, {9}), true);
+    EXPECT_EQ((std::vector<std::vector<int>>{{9}}), takeProcessed());
+    manager.receiveBacklogChunk(1, chunk(1, {6}), false);
+    EXPECT_EQ((std::vector<std::vector<int>>{{6}}), takeProcessed());
+    EXPECT_EQ(1, manager._requester->buffersWaiting());
+
+    // The final chunk of the last buffer may be empty
+    manager.receiveBacklogChunk(1, {}, true);
+    EXPECT_TRUE(takeProcessed().empty());
+    EXPECT_EQ(0, manager._requester->buffersWaiting());
+    EXPECT_EQ(0, manager._requester->totalBuffers());
+    EXPECT_TRUE(manager._requester->bufferedMessages().isEmpty());
+
+    EXPECT_EQ((std::vector<std::pair<int, int>>{{0, 2}, {1, 2}, {1, 2}, {2, 2}}), progress);
+}
+
+TEST(ClientBacklogManagerTest, unbufferedChunks)
+{
+    messageProcessor();
+    TestBacklogManager manager;
+
+    // Without a buffering requester, chunks are processed as they come in, the same as for all buffers
+    manager.receiveBacklogChunk(1, chunk(1, {10, 9}), false);
+    manager.receiveBacklogChunk(1, chunk(1, {8}), true);
+    manager.receiveBacklogChunk({}, chunk(2, {7}), true);
+    EXPECT_EQ((std::vector<std::vector<int>>{{10, 9}, {8}, {7}}), takeProcessed());
+}
+
+#include "clientbacklogmanagertest.moc"
@@ -0,0 +1,256 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <memory>
+#include <vector>
+
+#include <QList>
+#include <QSortFilterProxyModel>
+
+#include "testglobal.h"
+#include "abstractmessageprocessor.h"
+#include "abstractui.h"
+#include "benchmark.h"
+#include "buffermodel.h"
+#include "bufferinfo.h"
+#include "client.h"
+#include "message.h"
+#include "messagefilter.h"
+#include "messagemodel.h"
+#include "networkmodel.h"
+#include "quassel.h"
+#include "testmessagemodel.h"
+
+class TestMessageProcessor : public AbstractMessageProcessor
+{
+    Q_OBJECT
+
+public:
+    using AbstractMessageProcessor::AbstractMessageProcessor;
+
+    void reset() override {}
+    void process(Message&) override {}
+    void process(QList<Message>&) override {}
+    void networkRemoved(NetworkId) override {}
+};
+
+class TestUi : public AbstractUi
+{
+    Q_OBJECT
+
+public:
+    void init() override {}
+    MessageModel* createMessageModel(QObject* parent) override { return new TestMessageModel(parent); }
+    AbstractMessageProcessor* createMessageProcessor(QObject* parent) override { return new TestMessageProcessor(parent); }
+};
+
+// The real filter consults the client's network model, which isn't available here
+class BufferFilter : public MessageFilter
+{
+    Q_OBJECT
+
+public:
+    using MessageFilter::MessageFilter;
+
+    bool filterAcceptsRow(int sourceRow, const QModelIndex&) const override { return containsBuffer(sourceItem(sourceRow)->bufferId()); }
+};
+
+// Filtering the way MessageFilter used to, for reference
+class RoleFilter : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+    RoleFilter(QAbstractItemModel* source, BufferId bufferId)
+        : _bufferId(bufferId)
+    {
+        setDynamicSortFilter(true);
+        setSourceModel(source);
+    }
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex&) const override
+    {
+        QModelIndex sourceIdx = sourceModel()->index(sourceRow, 2);
+        Message::Type messageType = (Message::Type)sourceIdx.data(MessageModel::TypeRole).toInt();
+        Message::Flags flags = (Message::Flags)sourceIdx.data(MessageModel::FlagsRole).toInt();
+        if (messageType == Message::DayChange || flags & Message::Redirected)
+            return false;
+        return sourceIdx.data(MessageModel::BufferIdRole).value<BufferId>() == _bufferId
+               && sourceIdx.data(MessageModel::MessageRole).value<Message>().isValid();
+    }
+
+private:
+    BufferId _bufferId;
+};
+
+namespace {
+
+void ensureQuassel()
+{
+    // Settings need the application instance, which can only ever be created once
+    static Quassel* quassel = new Quassel;
+    Q_UNUSED(quassel);
+}
+
+void ensureClient()
+{
+    ensureQuassel();
+    static Client* client = new Client(std::make_unique<TestUi>());
+    Q_UNUSED(client);
+}
+
+const QDateTime timestamp = QDateTime::fromMSecsSinceEpoch(1600000000000);
+
+Message message(int msgId, int bufferId)
+{
+    Message msg(timestamp, BufferInfo(bufferId, 1, BufferInfo::ChannelBuffer), Message::Plain, QString("message %1").arg(msgId));
+    msg.setMsgId(msgId);
+    return msg;
+}
+
+QList<Message> messages(int first, int last, int buffers)
+{
+    QList<Message> result;
+    for (int msgId = first; msgId <= last; msgId++) {
+        result << message(msgId, msgId % buffers + 1);
+    }
+    return result;
+}
+
+std::vector<int> scanRows(const QAbstractItemModel& model, BufferId bufferId)
+{
+    std::vector<int> rows;
+    for (int row = 0; row < model.rowCount(); row++) {
+        if (model.index(row, 0).data(MessageModel::BufferIdRole).value<BufferId>() == bufferId)
+            rows.push_back(row);
+    }
+    return rows;
+}
+
+std::vector<int> filterRows(const MessageFilter& filter)
+{
+    std::vector<int> rows;
+    for (int row = 0; row < filter.rowCount(); row++) {
+        rows.push_back(filter.mapToSource(filter.index(row, 0)).row());
+    }
+    return rows;
+}
+
+}  // namespace
+
+TEST(MessageFilterTest, partitions)
+{
+    ensureQuassel();
+    TestMessageModel model;
+    model.insertMessages(messages(1000, 1199, 5));
+    BufferFilter filter(&model, {BufferId(2)});
+    EXPECT_EQ(40, filter.rowCount());
+
+    // Backlog goes in front, live messages at the end
+    model.insertMessages(messages(500, 599, 5));
+    model.insertMessage(message(2000, 2));
+    model.insertMessage(message(2001, 3));
+    for (int bufferId = 1; bufferId <= 5; bufferId++) {
+        EXPECT_EQ(scanRows(model, bufferId), model.bufferRows(bufferId)) << "buffer " << bufferId;
+    }
+    EXPECT_EQ(61, filter.rowCount());
+    EXPECT_EQ(scanRows(model, 2), filterRows(filter));
+
+    // Messages of a merged buffer move over
+    BufferFilter mergedFilter(&model, {BufferId(4)});
+    EXPECT_EQ(60, mergedFilter.rowCount());
+    model.buffersPermanentlyMerged(4, 5);
+    EXPECT_TRUE(model.bufferRows(5).empty());
+    EXPECT_EQ(scanRows(model, 4), model.bufferRows(4));
+    EXPECT_EQ(120, mergedFilter.rowCount());
+    EXPECT_EQ(scanRows(model, 4), filterRows(mergedFilter));
+
+    model.clear();
+    EXPECT_TRUE(model.bufferRows(2).empty());
+    EXPECT_EQ(0, filter.rowCount());
+}
+
+TEST(MessageFilterTest, redirectedLiveMessage)
+{
+    ensureClient();
+    BufferInfo statusBuffer(1, 1, BufferInfo::StatusBuffer);
+    BufferInfo channelBuffer(2, 1, BufferInfo::ChannelBuffer, 0, "#quassel");
+    Client::networkModel()->bufferUpdated(statusBuffer);
+    Client::networkModel()->bufferUpdated(channelBuffer);
+    Client::bufferModel()->switchToBuffer(channelBuffer.bufferId());
+    ASSERT_EQ(channelBuffer.bufferId(), Client::bufferModel()->currentBuffer());
+
+    TestMessageModel model;
+    model.insertMessages(messages(1, 10, 2));
+    MessageFilter firstFilter(&model, {channelBuffer.bufferId()});
+    MessageFilter secondFilter(&model, {channelBuffer.bufferId()});
+    ASSERT_EQ(5, firstFilter.rowCount());
+    ASSERT_EQ(5, secondFilter.rowCount());
+
+    // User notices go to the current buffer as well; the first filter to see the notice stores that buffer in the
+    // model while the second one hasn't been told about the new row yet
+    Message notice(timestamp, statusBuffer, Message::Notice, "notice", "nick!user@host", {}, {}, {}, Message::Redirected);
+    notice.setMsgId(11);
+    model.insertMessage(notice);
+    ASSERT_EQ(11, model.rowCount());
+    EXPECT_EQ(channelBuffer.bufferId(), model.index(10, 0).data(MessageModel::RedirectedToRole).value<BufferId>());
+
+    std::vector<int> expected = scanRows(model, channelBuffer.bufferId());
+    expected.push_back(10);
+    EXPECT_EQ(expected, filterRows(firstFilter));
+    EXPECT_EQ(expected, filterRows(secondFilter));
+}
+
+QUASSEL_BENCHMARK(MessageFilterTest, benchmark)
+{
+    ensureQuassel();
+    const int messageCount = 1000000;
+    const int bufferCount = 500;
+    const int switches = 50;
+
+    TestMessageModel model;
+    test::Benchmark benchmark;
+    model.insertMessages(messages(1, messageCount, bufferCount));
+    qint64 loadTime = benchmark.lap();
+    ASSERT_EQ(messageCount, model.rowCount());
+
+    // Switching to a buffer creates a new filter and lays out every message it shows
+    for (int i = 0; i < switches; i++) {
+        BufferFilter filter(&model, {BufferId(i * 7 % bufferCount + 1)});
+        ASSERT_EQ(messageCount / bufferCount, filter.rowCount());
+        EXPECT_TRUE(filter.index(filter.rowCount() - 1, 2).data(MessageModel::MessageRole).value<Message>().isValid());
+    }
+    qint64 switchTime = benchmark.lap();
+
+    // The role based filter is slow enough that a few rounds are plenty
+    const int referenceSwitches = 3;
+    for (int i = 0; i < referenceSwitches; i++) {
+        RoleFilter filter(&model, BufferId(i * 7 % bufferCount + 1));
+        ASSERT_EQ(messageCount / bufferCount, filter.rowCount());
+    }
+    qint64 referenceTime = benchmark.lap();
+
+    test::Benchmark::record("loadMs", loadTime);
+    test::Benchmark::record("bufferSwitchMs", double(switchTime) / switches, 3);
+    test::Benchmark::record("roleFilterSwitchMs", double(referenceTime) / referenceSwitches, 3);
+}
+
+#include "messagefiltertest.moc"
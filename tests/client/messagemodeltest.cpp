@@ -0,0 +1,174 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <utility>
+#include <vector>
+
+#include <QList>
+#include <QSet>
+
+#include "testglobal.h"
+#include "bufferinfo.h"
+#include "message.h"
+#include "messagefilter.h"
+#include "messagemodel.h"
+#include "quassel.h"
+#include "testmessagemodel.h"
+
+// The real filter consults the client's network model, which isn't available here
+class BufferFilter : public MessageFilter
+{
+    Q_OBJECT
+
+public:
+    using MessageFilter::MessageFilter;
+
+    bool filterAcceptsRow(int sourceRow, const QModelIndex&) const override { return containsBuffer(sourceItem(sourceRow)->bufferId()); }
+};
+
+// Shows a few messages of any buffer, like the chat monitor does
+class MonitorFilter : public MessageFilter
+{
+    Q_OBJECT
+
+public:
+    MonitorFilter(MessageModel* model, QSet<qint64> msgIds)
+        : MessageFilter(model, nullptr)
+        , _msgIds(std::move(msgIds))
+    {}
+
+    bool filterAcceptsRow(int sourceRow, const QModelIndex&) const override
+    {
+        return _msgIds.contains(sourceItem(sourceRow)->msgId().toQint64());
+    }
+
+private:
+    QSet<qint64> _msgIds;
+};
+
+namespace {
+
+void ensureQuassel()
+{
+    // Settings need the application instance, which can only ever be created once
+    static Quassel* quassel = new Quassel;
+    Q_UNUSED(quassel);
+}
+
+QList<Message> messages(int first, int last, int buffers)
+{
+    QList<Message> result;
+    for (int msgId = first; msgId <= last; msgId++) {
+        Message msg(QDateTime::fromMSecsSinceEpoch(1600000000000), BufferInfo(msgId % buffers + 1, 1, BufferInfo::ChannelBuffer));
+        msg.setMsgId(msgId);
+        result << msg;
+    }
+    return result;
+}
+
+std::vector<int> scanRows(const QAbstractItemModel& model, BufferId bufferId)
+{
+    std::vector<int> rows;
+    for (int row = 0; row < model.rowCount(); row++) {
+        if (model.index(row, 0).data(MessageModel::BufferIdRole).value<BufferId>() == bufferId)
+            rows.push_back(row);
+    }
+    return rows;
+}
+
+std::vector<qint64> filterMsgIds(const MessageFilter& filter)
+{
+    std::vector<qint64> msgIds;
+    for (int row = 0; row < filter.rowCount(); row++) {
+        msgIds.push_back(filter.index(row, 0).data(MessageModel::MsgIdRole).value<MsgId>().toQint64());
+    }
+    return msgIds;
+}
+
+qint64 firstMsgId(const TestMessageModel& model, BufferId bufferId)
+{
+    return model.messageItemAt(model.bufferRows(bufferId).front())->msgId().toQint64();
+}
+
+}  // namespace
+
+TEST(MessageModelTest, eviction)
+{
+    ensureQuassel();
+    TestMessageModel model;
+    model.insertMessages(messages(1, 3000, 3));
+    BufferFilter filter(&model, {BufferId(1)});
+    ASSERT_EQ(1000, filter.rowCount());
+
+    // Nothing to do within budget
+    qint64 usage = model.memoryUsage();
+    EXPECT_EQ(usage, model.shrinkTo(usage, {}));
+    EXPECT_EQ(3000, model.rowCount());
+
+    // Buffer 1 is shown, buffer 2 has its marker line on msgId 1501, i.e. its 501st line
+    EXPECT_GT(usage, model.shrinkTo(1, {{BufferId(2), MsgId(1501)}}));
+    EXPECT_EQ(1000u, model.bufferRows(1).size());
+    ASSERT_EQ(550u, model.bufferRows(2).size());
+    ASSERT_EQ(100u, model.bufferRows(3).size());
+    EXPECT_EQ(1351, firstMsgId(model, 2));
+    EXPECT_EQ(2702, firstMsgId(model, 3));
+    for (int bufferId = 1; bufferId <= 3; bufferId++) {
+        EXPECT_EQ(scanRows(model, bufferId), model.bufferRows(bufferId)) << "buffer " << bufferId;
+    }
+    EXPECT_EQ(1000, filter.rowCount());
+}
+
+TEST(MessageModelTest, evictionKeepsShownLines)
+{
+    ensureQuassel();
+    TestMessageModel model;
+    model.insertMessages(messages(1, 3000, 3));
+
+    // The monitor shows the 601st line of buffer 2 and the 667th line of buffer 3
+    MonitorFilter monitor(&model, {1801, 2000});
+    ASSERT_EQ((std::vector<qint64>{1801, 2000}), filterMsgIds(monitor));
+
+    model.shrinkTo(1, {});
+    ASSERT_EQ(100u, model.bufferRows(1).size());
+    ASSERT_EQ(400u, model.bufferRows(2).size());
+    ASSERT_EQ(334u, model.bufferRows(3).size());
+    EXPECT_EQ(1801, firstMsgId(model, 2));
+    EXPECT_EQ(2000, firstMsgId(model, 3));
+    EXPECT_EQ((std::vector<qint64>{1801, 2000}), filterMsgIds(monitor));
+}
+
+TEST(MessageModelTest, evictionAfterFilterDeleted)
+{
+    ensureQuassel();
+    TestMessageModel model;
+    model.insertMessages(messages(1, 3000, 3));
+    {
+        BufferFilter filter(&model, {BufferId(1)});
+        ASSERT_EQ(1000, filter.rowCount());
+    }
+
+    // Buffers are evictable again once no filter shows them anymore
+    model.shrinkTo(1, {});
+    EXPECT_EQ(100u, model.bufferRows(1).size());
+    EXPECT_EQ(100u, model.bufferRows(2).size());
+    EXPECT_EQ(100u, model.bufferRows(3).size());
+}
+
+#include "messagemodeltest.moc"
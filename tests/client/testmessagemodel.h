@@ -0,0 +1,78 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QList>
+
+#include "message.h"
+#include "messagemodel.h"
+
+/// Message model item holding just the message, as MessageModel itself doesn't look at anything else
+class TestMessageItem : public MessageModelItem
+{
+public:
+    TestMessageItem(const Message& msg)
+        : _msg(msg)
+    {}
+
+    const Message& message() const override { return _msg; }
+    const QDateTime& timestamp() const override { return _msg.timestamp(); }
+    const MsgId& msgId() const override { return _msg.msgId(); }
+    const BufferId& bufferId() const override { return _msg.bufferId(); }
+    void setBufferId(BufferId bufferId) override { _msg.setBufferId(bufferId); }
+    Message::Type msgType() const override { return _msg.type(); }
+    Message::Flags msgFlags() const override { return _msg.flags(); }
+
+private:
+    Message _msg;
+};
+
+class TestMessageModel : public MessageModel
+{
+public:
+    TestMessageModel(QObject* parent = nullptr)
+        : MessageModel(parent)
+    {}
+
+    const MessageModelItem* messageItemAt(int i) const override { return &_messageList[i]; }
+
+protected:
+    int messageCount() const override { return _messageList.count(); }
+    bool messagesIsEmpty() const override { return _messageList.isEmpty(); }
+    MessageModelItem* messageItemAt(int i) override { return &_messageList[i]; }
+    const MessageModelItem* firstMessageItem() const override { return &_messageList.first(); }
+    MessageModelItem* firstMessageItem() override { return &_messageList.first(); }
+    const MessageModelItem* lastMessageItem() const override { return &_messageList.last(); }
+    MessageModelItem* lastMessageItem() override { return &_messageList.last(); }
+    void insertMessage__(int pos, const Message& msg) override { _messageList.insert(pos, TestMessageItem(msg)); }
+    void insertMessages__(int pos, const QList<Message>& messages) override
+    {
+        for (auto&& msg : messages) {
+            _messageList.insert(pos++, TestMessageItem(msg));
+        }
+    }
+    void removeMessageAt(int i) override { _messageList.removeAt(i); }
+    void removeAllMessages() override { _messageList.clear(); }
+    Message takeMessageAt(int i) override { return _messageList.takeAt(i).message(); }
+
+private:
+    QList<TestMessageItem> _messageList;
+};
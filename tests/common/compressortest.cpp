@@ -0,0 +1,237 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <memory>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtEndian>
+
+#include "testglobal.h"
+#include "benchmark.h"
+#include "compressor.h"
+
+namespace {
+
+// A compressed loopback connection, with the same framing RemotePeer uses
+class CompressedLink
+{
+public:
+    CompressedLink(Compressor::CompressionLevel level, Compressor::Algorithm algorithm)
+    {
+        EXPECT_TRUE(_server.listen(QHostAddress::LocalHost));
+        _senderSocket.connectToHost(QHostAddress::LocalHost, _server.serverPort());
+        EXPECT_TRUE(_senderSocket.waitForConnected(5000));
+        EXPECT_TRUE(_server.waitForNewConnection(5000));
+        _receiverSocket = _server.nextPendingConnection();
+
+        _sender.reset(new Compressor(&_senderSocket, level, algorithm));
+        _receiver.reset(new Compressor(_receiverSocket, level, algorithm));
+        QObject::connect(&_senderSocket, &QIODevice::bytesWritten, [this](qint64 bytes) { wireBytes += bytes; });
+    }
+
+    void send(const QByteArray& msg)
+    {
+        quint32 size = qToBigEndian<quint32>(msg.size());
+        _sender->write((const char*)&size, 4, Compressor::NoFlush);
+        _sender->write(msg.constData(), msg.size());
+    }
+
+    /// Receives the given number of uncompressed bytes
+    QByteArray receive(qint64 count)
+    {
+        QByteArray result;
+        QElapsedTimer timer;
+        timer.start();
+        while (result.size() < count && timer.elapsed() < 30000) {
+            if (_senderSocket.bytesToWrite())
+                _senderSocket.waitForBytesWritten(10);
+            _receiverSocket->waitForReadyRead(10);
+
+            QByteArray chunk(static_cast<int>(_receiver->bytesAvailable()), Qt::Uninitialized);
+            _receiver->read(chunk.data(), chunk.size());
+            result += chunk;
+        }
+        return result;
+    }
+
+    qint64 wireBytes{0};
+
+private:
+    QTcpServer _server;
+    QTcpSocket _senderSocket;
+    QTcpSocket* _receiverSocket{nullptr};
+    std::unique_ptr<Compressor> _sender;
+    std::unique_ptr<Compressor> _receiver;
+};
+
+QByteArray serialize(const QVariantList& list)
+{
+    QByteArray result;
+    QDataStream stream(&result, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_2);
+    stream << list;
+    return result;
+}
+
+// Approximates the traffic of a client connecting to a busy core: initial sync, then backlog and chatter
+QList<QByteArray> syntheticSession()
+{
+    QList<QByteArray> session;
+    QDateTime time = QDateTime::fromMSecsSinceEpoch(1600000000000);
+    for (int i = 0; i < 2000; i++) {
+        QString nick = QString("user%1").arg(i * 7919 % 10007);
+        QVariantMap initData{{"nick", nick},
+                             {"user", QString("~%1").arg(nick)},
+                             {"host", QString("host-%1.example.org").arg(i % 97)},
+                             {"realName", QString("Real Name %1").arg(i)},
+                             {"account", i % 3 ? nick : QString("*")},
+                             {"away", i % 5 == 0},
+                             {"awayMessage", QString()},
+                             {"idleTime", time},
+                             {"loginTime", time},
+                             {"server", QString("irc%1.example.org").arg(i % 4)},
+                             {"channels", QStringList{"#quassel", QString("#chan%1").arg(i % 20)}},
+                             {"userModes", QString("i")}};
+        session << serialize({4, QByteArray("IrcUser"), QString("1/%1").arg(nick).toUtf8(), initData});
+    }
+    for (int i = 0; i < 20000; i++) {
+        QString nick = QString("user%1").arg(i * 31 % 2000 * 7919 % 10007);
+        if (i % 10 == 0) {
+            session << serialize({1, QByteArray("IrcUser"), QString("1/%1").arg(nick).toUtf8(), QByteArray("setAway"), i % 20 == 0});
+            continue;
+        }
+        QVariantMap msg{{"msgId", 100000 + i},
+                        {"timestamp", time.addSecs(i * 13)},
+                        {"type", 1},
+                        {"flags", i % 50 ? 0 : 2},
+                        {"bufferId", i % 20 + 1},
+                        {"sender", QString("%1!~%1@host-%2.example.org").arg(nick).arg(i % 97)},
+                        {"contents", QString("message %1 from %2, talking about topic number %3").arg(i).arg(nick).arg(i % 42)}};
+        session << serialize({2, QByteArray("2displayMsg(Message)"), msg});
+    }
+    return session;
+}
+
+// Reads a dump of the uncompressed protocol stream, i.e. size-prefixed messages as written by RemotePeer
+QList<QByteArray> recordedSession(const QString& fileName)
+{
+    QList<QByteArray> session;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return session;
+
+    QDataStream stream(&file);
+    while (!stream.atEnd()) {
+        quint32 size;
+        stream >> size;
+        QByteArray msg(static_cast<int>(size), Qt::Uninitialized);
+        if (stream.readRawData(msg.data(), msg.size()) != msg.size())
+            break;
+        session << msg;
+    }
+    return session;
+}
+
+QByteArray framed(const QList<QByteArray>& messages)
+{
+    QByteArray result;
+    for (auto&& msg : messages) {
+        quint32 size = qToBigEndian<quint32>(msg.size());
+        result.append((const char*)&size, 4);
+        result.append(msg);
+    }
+    return result;
+}
+
+}  // namespace
+
+TEST(CompressorTest, dictionary)
+{
+    // Both sides of a connection rely on getting the very same dictionary
+    QByteArray dict = Compressor::dictionary();
+    EXPECT_FALSE(dict.isEmpty());
+    EXPECT_EQ(dict, Compressor::dictionary());
+    EXPECT_TRUE(dict.contains("IrcUser"));
+    EXPECT_TRUE(dict.contains("2displayMsg(Message)"));
+}
+
+TEST(CompressorTest, roundTrip)
+{
+    QList<QByteArray> messages = syntheticSession().mid(1900, 500);
+    messages << QByteArray(200 * 1024, 'x');  // larger than the IO buffers
+    const QByteArray expected = framed(messages);
+
+    for (auto algorithm : {Compressor::Deflate, Compressor::Zstd, Compressor::ZstdWithDictionary}) {
+        if (!Compressor::isAvailable(algorithm))
+            continue;
+        for (auto level : {Compressor::NoCompression, Compressor::BestSpeed, Compressor::BestCompression}) {
+            CompressedLink link(level, algorithm);
+            for (auto&& msg : messages) {
+                link.send(msg);
+            }
+            EXPECT_EQ(expected, link.receive(expected.size())) << "algorithm " << algorithm << ", level " << level;
+        }
+    }
+}
+
+QUASSEL_BENCHMARK(CompressorTest, benchmark)
+{
+    // Set QUASSEL_TEST_SESSION to a protocol dump to benchmark a recorded session instead
+    QList<QByteArray> session = qEnvironmentVariableIsSet("QUASSEL_TEST_SESSION")
+                                    ? recordedSession(QString::fromLocal8Bit(qgetenv("QUASSEL_TEST_SESSION")))
+                                    : syntheticSession();
+    ASSERT_FALSE(session.isEmpty());
+    const QByteArray expected = framed(session);
+
+    const struct
+    {
+        const char* name;
+        Compressor::Algorithm algorithm;
+        Compressor::CompressionLevel level;
+    } configs[] = {{"zlib-best", Compressor::Deflate, Compressor::BestCompression},
+                   {"zlib-fast", Compressor::Deflate, Compressor::BestSpeed},
+                   {"zstd-best", Compressor::Zstd, Compressor::BestCompression},
+                   {"zstd-fast", Compressor::Zstd, Compressor::BestSpeed},
+                   {"zstd-dict", Compressor::ZstdWithDictionary, Compressor::BestCompression}};
+
+    for (auto&& config : configs) {
+        if (!Compressor::isAvailable(config.algorithm))
+            continue;
+
+        CompressedLink link(config.level, config.algorithm);
+        test::Benchmark benchmark;
+        for (auto&& msg : session) {
+            link.send(msg);
+        }
+        qint64 compressTime = benchmark.lap();
+        EXPECT_EQ(expected, link.receive(expected.size())) << config.name;
+        qint64 roundTripTime = compressTime + benchmark.lap();
+
+        double ratio = double(link.wireBytes) / expected.size();
+        test::Benchmark::record(QString("%1Ratio").arg(config.name), ratio, 4);
+        test::Benchmark::record(QString("%1CompressMs").arg(config.name), compressTime);
+        test::Benchmark::record(QString("%1RoundTripMs").arg(config.name), roundTripTime);
+    }
+}
@@ -0,0 +1,198 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QStringList>
+
+#include "testglobal.h"
+#include "benchmark.h"
+#include "eventmanager.h"
+#include "ircevent.h"
+
+class TestEventManager : public EventManager
+{
+    Q_OBJECT
+
+protected:
+    Network* networkById(NetworkId) const override { return nullptr; }
+};
+
+// Records the handlers called, in order
+class Recorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    QStringList calls;
+    bool acceptPrivmsg{true};
+};
+
+class SessionProcessor : public Recorder
+{
+    Q_OBJECT
+
+public slots:
+    void processIrcEventJoin(IrcEvent*) { calls << "join"; }
+    void processIrcEventPrivmsg(IrcEvent*) { calls << "privmsg"; }
+    void processIrcEvent001(IrcEvent*) { calls << "001"; }
+    void processIrcEvent(IrcEvent*) { calls << "generic"; }
+    bool filterIrcEventPrivmsg(IrcEvent*) { return acceptPrivmsg; }
+};
+
+class Stringifier : public Recorder
+{
+    Q_OBJECT
+
+public slots:
+    void processIrcEventJoin(IrcEvent*) { calls << "stringify-join"; }
+    void processIrcEventPrivmsg(IrcEvent*) { calls << "stringify-privmsg"; }
+    void processIrcEventQuit(IrcEvent*) { calls << "stringify-quit"; }
+};
+
+// Mimics the per-event work of CoreSessionEventProcessor and friends, without the side effects
+class BenchmarkProcessor : public QObject
+{
+    Q_OBJECT
+
+public:
+    quint64 handled{0};
+
+public slots:
+    void processIrcEventJoin(IrcEvent* e) { handled += e->params().count(); }
+    void processIrcEventPart(IrcEvent* e) { handled += e->params().count(); }
+    void processIrcEventQuit(IrcEvent* e) { handled += e->params().count(); }
+    void processIrcEventPrivmsg(IrcEvent* e) { handled += e->params().count(); }
+    void processIrcEventMode(IrcEvent* e) { handled += e->params().count(); }
+    void processIrcEvent353(IrcEvent* e) { handled += e->params().count(); }
+    void processIrcEvent366(IrcEvent* e) { handled += e->params().count(); }
+    bool filterIrcEventPrivmsg(IrcEvent* e) { return !e->params().isEmpty(); }
+};
+
+namespace {
+
+IrcEvent* ircEvent(EventManager::EventType type)
+{
+    return new IrcEvent(type, nullptr, {}, "nick!user@host", {"#quassel", "message"});
+}
+
+IrcEventNumeric* numericEvent(uint number)
+{
+    return new IrcEventNumeric(number, nullptr, {}, "irc.example.org", "nick", {"#quassel", "nick"});
+}
+
+}  // namespace
+
+TEST(EventManagerTest, dispatchOrder)
+{
+    TestEventManager manager;
+    SessionProcessor processor;
+    Stringifier stringifier;
+    manager.registerObject(&processor, EventManager::HighPriority);
+    manager.registerObject(&stringifier, EventManager::NormalPriority);
+
+    manager.postEvent(ircEvent(EventManager::IrcEventJoin));
+    EXPECT_EQ(QStringList({"join"}), processor.calls);
+    EXPECT_EQ(QStringList({"stringify-join"}), stringifier.calls);
+
+    // The group handler is only used if there is no specific one for the same object
+    processor.calls.clear();
+    stringifier.calls.clear();
+    manager.postEvent(ircEvent(EventManager::IrcEventQuit));
+    EXPECT_EQ(QStringList({"generic"}), processor.calls);
+    EXPECT_EQ(QStringList({"stringify-quit"}), stringifier.calls);
+
+    processor.calls.clear();
+    stringifier.calls.clear();
+    manager.postEvent(numericEvent(1));
+    manager.postEvent(numericEvent(2));
+    EXPECT_EQ(QStringList({"001", "generic"}), processor.calls);
+    EXPECT_TRUE(stringifier.calls.isEmpty());
+}
+
+TEST(EventManagerTest, filters)
+{
+    TestEventManager manager;
+    SessionProcessor processor;
+    Stringifier stringifier;
+    manager.registerObject(&processor, EventManager::HighPriority);
+    manager.registerObject(&stringifier, EventManager::NormalPriority);
+
+    manager.postEvent(ircEvent(EventManager::IrcEventPrivmsg));
+    EXPECT_EQ(QStringList({"privmsg"}), processor.calls);
+
+    // A filter only applies to its own object
+    processor.calls.clear();
+    stringifier.calls.clear();
+    processor.acceptPrivmsg = false;
+    manager.postEvent(ircEvent(EventManager::IrcEventPrivmsg));
+    EXPECT_TRUE(processor.calls.isEmpty());
+    EXPECT_EQ(QStringList({"stringify-privmsg"}), stringifier.calls);
+}
+
+TEST(EventManagerTest, registrationInvalidatesCache)
+{
+    TestEventManager manager;
+    SessionProcessor processor;
+    manager.registerObject(&processor);
+
+    manager.postEvent(ircEvent(EventManager::IrcEventJoin));
+    EXPECT_EQ(QStringList({"join"}), processor.calls);
+
+    Stringifier stringifier;
+    manager.registerObject(&stringifier);
+    manager.postEvent(ircEvent(EventManager::IrcEventJoin));
+    EXPECT_EQ(QStringList({"join", "join"}), processor.calls);
+    EXPECT_EQ(QStringList({"stringify-join"}), stringifier.calls);
+
+    Stringifier lateStringifier;
+    manager.registerEventHandler(EventManager::IrcEventJoin, &lateStringifier, "processIrcEventQuit(IrcEvent*)");
+    manager.postEvent(ircEvent(EventManager::IrcEventJoin));
+    EXPECT_EQ(QStringList({"stringify-quit"}), lateStringifier.calls);
+}
+
+QUASSEL_BENCHMARK(EventManagerTest, throughput)
+{
+    TestEventManager manager;
+    BenchmarkProcessor processors[4];
+    manager.registerObject(&processors[0], EventManager::HighPriority);
+    manager.registerObject(&processors[1], EventManager::NormalPriority);
+    manager.registerObject(&processors[2], EventManager::LowPriority);
+    manager.registerObject(&processors[3], EventManager::LowPriority, "process", "filter");
+
+    // Join burst: mostly JOIN and NAMES replies, some chatter
+    const int rounds = 20000;
+    test::Benchmark benchmark;
+    for (int i = 0; i < rounds; i++) {
+        manager.postEvent(ircEvent(EventManager::IrcEventJoin));
+        manager.postEvent(ircEvent(EventManager::IrcEventJoin));
+        manager.postEvent(numericEvent(353));
+        manager.postEvent(ircEvent(EventManager::IrcEventMode));
+        manager.postEvent(ircEvent(EventManager::IrcEventPrivmsg));
+    }
+    qint64 elapsed = benchmark.lap();
+
+    const int events = rounds * 5;
+    for (auto&& processor : processors) {
+        EXPECT_EQ(events * 2u, processor.handled);
+    }
+
+    test::Benchmark::recordRate("eventsPerSecond", events, elapsed);
+}
+
+#include "eventmanagertest.moc"
@@ -0,0 +1,181 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <vector>
+
+#include <QString>
+#include <QStringList>
+
+#include "testglobal.h"
+#include "benchmark.h"
+#include "bufferinfo.h"
+#include "highlightrulemanager.h"
+#include "message.h"
+#include "util.h"
+
+namespace {
+
+// The rule loop HighlightRuleManager used before combining rules, for reference
+bool matchOneByOne(const HighlightRuleManager& manager, const Message& msg)
+{
+    if (!((msg.type() & (Message::Plain | Message::Notice | Message::Action)) && !(msg.flags() & Message::Self))) {
+        return false;
+    }
+
+    bool matches = false;
+    for (const auto& rule : manager.highlightRuleList()) {
+        if (!rule.isEnabled())
+            continue;
+        if (!rule.chanNameMatcher().match(msg.bufferInfo().bufferName(), true))
+            continue;
+        bool contentsMatch = rule.contentsMatcher().match(stripFormatCodes(msg.contents()), true);
+        bool senderMatch = rule.senderMatcher().match(msg.sender(), true);
+        if (contentsMatch && senderMatch) {
+            if (rule.isInverse())
+                return false;
+            matches = true;
+        }
+    }
+    return matches;
+}
+
+Message message(const QString& contents, const QString& sender = "nick!user@host", const QString& bufferName = "#quassel")
+{
+    return Message(BufferInfo(1, 1, BufferInfo::ChannelBuffer, 0, bufferName), Message::Plain, contents, sender);
+}
+
+void addRule(HighlightRuleManager& manager,
+             const QString& contents,
+             bool isRegEx = false,
+             bool isCaseSensitive = false,
+             bool isInverse = false,
+             const QString& sender = {},
+             const QString& chanName = {})
+{
+    manager.addHighlightRule(manager.nextId(), contents, isRegEx, isCaseSensitive, true, isInverse, sender, chanName);
+}
+
+}  // namespace
+
+TEST(HighlightRuleManagerTest, combinedRules)
+{
+    HighlightRuleManager manager;
+    manager.setHighlightNick(HighlightRuleManager::NoNick);
+    addRule(manager, "quassel");
+    addRule(manager, "Release", false, true);
+    addRule(manager, "bug\\s+#\\d+", true);
+    addRule(manager, "(\\w+) and \\1", true);  // backreference, can't be combined
+    addRule(manager, "deploy", false, false, false, {}, "#ops");
+    addRule(manager, "build", false, false, false, "ci!*@*");
+    addRule(manager, "spam", false, false, true);
+    addRule(manager, "", false, false, false, "friend!*@*");
+
+    EXPECT_TRUE(manager.match(message("I like Quassel"), {}, {}));
+    EXPECT_FALSE(manager.match(message("quasselcore"), {}, {}));
+    EXPECT_TRUE(manager.match(message("New Release out"), {}, {}));
+    EXPECT_FALSE(manager.match(message("new release out"), {}, {}));
+    EXPECT_TRUE(manager.match(message("see BUG #1234"), {}, {}));
+    EXPECT_TRUE(manager.match(message("this and this"), {}, {}));
+    EXPECT_FALSE(manager.match(message("this and that"), {}, {}));
+    EXPECT_TRUE(manager.match(message("deploy now", "nick!user@host", "#ops"), {}, {}));
+    EXPECT_FALSE(manager.match(message("deploy now", "nick!user@host", "#quassel"), {}, {}));
+    EXPECT_TRUE(manager.match(message("build failed", "ci!bot@host"), {}, {}));
+    EXPECT_FALSE(manager.match(message("build failed"), {}, {}));
+    EXPECT_FALSE(manager.match(message("quassel spam"), {}, {}));
+    EXPECT_TRUE(manager.match(message("hello", "friend!user@host"), {}, {}));
+    EXPECT_FALSE(manager.match(message("hello"), {}, {}));
+
+    // Rule changes must be picked up
+    manager.toggleHighlightRule(manager[0].id());
+    EXPECT_FALSE(manager.match(message("I like Quassel"), {}, {}));
+    manager.removeHighlightRule(manager[6].id());
+    EXPECT_TRUE(manager.match(message("bug #1 spam"), {}, {}));
+}
+
+TEST(HighlightRuleManagerTest, matchesRuleLoop)
+{
+    HighlightRuleManager manager;
+    manager.setHighlightNick(HighlightRuleManager::NoNick);
+    for (int i = 0; i < 50; i++) {
+        addRule(manager, QString("word%1").arg(i), false, i % 2);
+        addRule(manager, QString("re%1[a-z]+").arg(i), true, i % 3);
+        addRule(manager, QString("scoped%1").arg(i), false, false, false, {}, QString("#chan%1").arg(i % 5));
+    }
+    addRule(manager, "word7 ignored", false, false, true);
+
+    const QStringList contents{"nothing here", "word3", "Word4", "WORD5 and more", "re12abc", "RE13ABC", "scoped2 here",
+                               "word7 ignored", "x word49 y", "word490", "\x02word8\x02"};
+    const QStringList buffers{"#quassel", "#chan2", "#chan3"};
+    for (const QString& text : contents) {
+        for (const QString& buffer : buffers) {
+            Message msg = message(text, "nick!user@host", buffer);
+            EXPECT_EQ(matchOneByOne(manager, msg), manager.match(msg, {}, {})) << qPrintable(text) << " in " << qPrintable(buffer);
+        }
+    }
+}
+
+QUASSEL_BENCHMARK(HighlightRuleManagerTest, benchmark)
+{
+    HighlightRuleManager manager;
+    manager.setHighlightNick(HighlightRuleManager::NoNick);
+    for (int i = 0; i < 150; i++) {
+        switch (i % 3) {
+        case 0:
+            addRule(manager, QString("keyword%1").arg(i));
+            break;
+        case 1:
+            addRule(manager, QString("pattern%1\\d+").arg(i), true);
+            break;
+        default:
+            addRule(manager, QString("CaseSensitive%1").arg(i), false, true);
+        }
+    }
+
+    std::vector<Message> messages;
+    for (int i = 0; i < 1000; i++) {
+        // Most messages don't highlight
+        messages.push_back(message(i % 100 ? QString("just some regular chatter, line %1").arg(i) : QString("ping keyword%1").arg(i % 150)));
+    }
+
+    const int rounds = 10;
+    int combinedMatches = 0;
+    int loopMatches = 0;
+
+    test::Benchmark benchmark;
+    for (int round = 0; round < rounds; round++) {
+        for (const Message& msg : messages) {
+            combinedMatches += manager.match(msg, {}, {});
+        }
+    }
+    qint64 combinedElapsed = benchmark.lap();
+
+    for (int round = 0; round < rounds; round++) {
+        for (const Message& msg : messages) {
+            loopMatches += matchOneByOne(manager, msg);
+        }
+    }
+    qint64 loopElapsed = benchmark.lap();
+
+    EXPECT_EQ(loopMatches, combinedMatches);
+
+    const qint64 total = rounds * messages.size();
+    test::Benchmark::recordRate("combinedMessagesPerSecond", total, combinedElapsed);
+    test::Benchmark::recordRate("loopMessagesPerSecond", total, loopElapsed);
+}
@@ -20,8 +20,12 @@
 
 #include <ostream>
 
+#include <QBuffer>
+
 #include "testglobal.h"
+#include "benchmark.h"
 #include "ircdecoder.h"
+#include "irclinereader.h"
 #include "irctag.h"
 
 struct IrcMessage
@@ -301,3 +305,129 @@ TEST(IrcDecoderTest, tag_values)
                          "",
                          "COMMAND"));
 }
+
+TEST(IrcDecoderTest, slices)
+{
+    QByteArray raw("@a=b;c :coolguy!ag@example.org  PRIVMSG #chan  :hello :) ");
+    IrcDecoder::MessageSlices slices;
+    IrcDecoder::parseSlices(raw, slices);
+    EXPECT_EQ(QByteArray("a=b;c"), IrcDecoder::slice(raw, slices.tags));
+    EXPECT_EQ(QByteArray("coolguy!ag@example.org"), IrcDecoder::slice(raw, slices.prefix));
+    EXPECT_EQ(QByteArray("PRIVMSG"), IrcDecoder::slice(raw, slices.command));
+    ASSERT_EQ(2, slices.parameters.size());
+    EXPECT_EQ(QByteArray("#chan"), IrcDecoder::slice(raw, slices.parameters[0]));
+    EXPECT_EQ(QByteArray("hello :) "), IrcDecoder::slice(raw, slices.parameters[1]));
+
+    // Slices are reset when reused
+    raw = "PING";
+    IrcDecoder::parseSlices(raw, slices);
+    EXPECT_TRUE(IrcDecoder::slice(raw, slices.tags).isNull());
+    EXPECT_TRUE(IrcDecoder::slice(raw, slices.prefix).isNull());
+    EXPECT_EQ(QByteArray("PING"), IrcDecoder::slice(raw, slices.command));
+    EXPECT_TRUE(slices.parameters.isEmpty());
+}
+
+TEST(IrcDecoderTest, lineReader)
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::ReadWrite);
+    IrcLineReader reader;
+    QByteArray line;
+
+    buffer.write("PING :one\r\nPING :two\nPING :th");
+    buffer.seek(0);
+    EXPECT_EQ(29, reader.readFrom(&buffer));
+    ASSERT_TRUE(reader.readLine(line));
+    EXPECT_EQ(QByteArray("PING :one"), line);
+    ASSERT_TRUE(reader.readLine(line));
+    EXPECT_EQ(QByteArray("PING :two"), line);
+    EXPECT_FALSE(reader.readLine(line));
+
+    // Incomplete lines are kept until the rest arrives
+    buffer.write("ree\r\n\r\n");
+    buffer.seek(29);
+    EXPECT_EQ(7, reader.readFrom(&buffer));
+    ASSERT_TRUE(reader.readLine(line));
+    EXPECT_EQ(QByteArray("PING :three"), line);
+    ASSERT_TRUE(reader.readLine(line));
+    EXPECT_TRUE(line.isEmpty());
+    EXPECT_FALSE(reader.readLine(line));
+    EXPECT_EQ(0, reader.readFrom(&buffer));
+}
+
+QUASSEL_BENCHMARK(IrcDecoderTest, throughput)
+{
+    // The fixtures above, plus the bulk of what a busy server sends
+    const QList<QByteArray> lines{
+        ":coolguy foo bar baz :asdf quux",
+        "@a=b\\\\and\\nk;c=72\\s45;d=gh\\:764 foo",
+        "@tag1=value1;tag2;vendor1/tag3=value2;vendor2/tag4 :irc.example.com COMMAND param1 param2 :param3 param3",
+        ":gravel.mozilla.org 432  #momo :Erroneous Nickname: Illegal characters",
+        ":services.esper.net MODE #foo-bar +o foobar  ",
+        ":coolguy!ag@net\x03" "5w\x03ork.admin PRIVMSG foo :bar baz",
+        "@time=2021-01-01T00:00:00.000Z;account=coolguy :coolguy!~ag@example.org PRIVMSG #quassel :hello there, how are you?",
+        ":someone!~user@host.example.org JOIN #quassel",
+        ":irc.example.org 353 nick = #quassel :@op +voice user1 user2 user3 user4 user5 user6 user7 user8 user9",
+        "PING :irc.example.org",
+    };
+
+    QByteArray stream;
+    const int rounds = 20000;
+    for (int i = 0; i < rounds; i++) {
+        for (const QByteArray& line : lines) {
+            stream += line + "\r\n";
+        }
+    }
+    const qint64 total = qint64(rounds) * lines.size();
+    auto decode = [](const QByteArray& data) { return QString::fromUtf8(data); };
+
+    QHash<IrcTagKey, QString> tags;
+    QString prefix;
+    QString cmd;
+    QList<QByteArray> params;
+
+    // Previous ingestion path: readLine() on the socket, then chop the line ending
+    QBuffer legacyBuffer(&stream);
+    legacyBuffer.open(QIODevice::ReadOnly);
+    qint64 legacyParams = 0;
+    test::Benchmark benchmark;
+    while (legacyBuffer.canReadLine()) {
+        QByteArray s = legacyBuffer.readLine();
+        if (s.endsWith("\r\n"))
+            s.chop(2);
+        IrcDecoder::parseMessage(decode, s, tags, prefix, cmd, params);
+        legacyParams += params.size();
+    }
+    qint64 legacyElapsed = benchmark.lap();
+
+    QBuffer buffer(&stream);
+    buffer.open(QIODevice::ReadOnly);
+    IrcLineReader reader;
+    reader.readFrom(&buffer);
+    QByteArray line;
+    qint64 readerParams = 0;
+    while (reader.readLine(line)) {
+        IrcDecoder::parseMessage(decode, QByteArray(line.constData(), line.size()), tags, prefix, cmd, params);
+        readerParams += params.size();
+    }
+    qint64 readerElapsed = benchmark.lap();
+
+    // Splitting only, as used by consumers that don't need every field decoded
+    reader.clear();
+    buffer.seek(0);
+    reader.readFrom(&buffer);
+    IrcDecoder::MessageSlices slices;
+    qint64 sliceParams = 0;
+    while (reader.readLine(line)) {
+        IrcDecoder::parseSlices(line, slices);
+        sliceParams += slices.parameters.size();
+    }
+    qint64 slicesElapsed = benchmark.lap();
+
+    EXPECT_EQ(legacyParams, readerParams);
+    EXPECT_EQ(legacyParams, sliceParams);
+
+    test::Benchmark::recordRate("readLineLinesPerSecond", total, legacyElapsed);
+    test::Benchmark::recordRate("lineReaderLinesPerSecond", total, readerElapsed);
+    test::Benchmark::recordRate("slicesLinesPerSecond", total, slicesElapsed);
+}
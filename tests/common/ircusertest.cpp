@@ -0,0 +1,126 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QFile>
+#include <QStringList>
+
+#include "testglobal.h"
+#include "benchmark.h"
+#include "ircchannel.h"
+#include "ircuser.h"
+#include "network.h"
+#include "signalproxy.h"
+
+namespace {
+
+// Resident set size of the test process in kB, or -1 if unknown
+qint64 residentSetSize()
+{
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly))
+        return -1;
+    for (auto&& line : status.readAll().split('\n')) {
+        if (line.startsWith("VmRSS:"))
+            return line.mid(6).trimmed().split(' ').value(0).toLongLong();
+    }
+    return -1;
+}
+
+}  // namespace
+
+TEST(IrcUserTest, sharesStrings)
+{
+    SignalProxy proxy(SignalProxy::Server, nullptr);
+    Network network(1);
+    network.setProxy(&proxy);
+
+    IrcUser* alice = network.newIrcUser(QString("alice!~quassel@") + "gateway.example.org");
+    IrcUser* bob = network.newIrcUser(QString("bob!~quassel@") + "gateway.example.org");
+    alice->setServer(QString("irc.") + "example.org");
+    bob->setServer(QString("irc.") + "example.org");
+
+    EXPECT_EQ(alice->host(), bob->host());
+    EXPECT_EQ(alice->host().constData(), bob->host().constData());
+    EXPECT_EQ(alice->user().constData(), bob->user().constData());
+    EXPECT_EQ(alice->server().constData(), bob->server().constData());
+
+    // Rarely used state still works as before
+    EXPECT_FALSE(alice->loginTime().isValid());
+    EXPECT_TRUE(alice->suserHost().isEmpty());
+    QDateTime now = QDateTime::currentDateTime();
+    alice->setIdleTime(now);
+    alice->setSuserHost("is using a secure connection");
+    alice->setLastSpokenTo(BufferId(1), now);
+    EXPECT_EQ(now, alice->idleTime());
+    EXPECT_EQ(QString("is using a secure connection"), alice->suserHost());
+    EXPECT_EQ(now, alice->lastSpokenTo(BufferId(1)));
+    EXPECT_FALSE(bob->lastSpokenTo(BufferId(1)).isValid());
+
+    // Channel membership
+    IrcChannel* quassel = network.newIrcChannel("#quassel");
+    IrcChannel* test = network.newIrcChannel("#test");
+    alice->joinChannel(quassel);
+    alice->joinChannel(test);
+    alice->joinChannel(quassel);
+    EXPECT_EQ(2, alice->channels().count());
+    alice->partChannel(quassel);
+    EXPECT_EQ(QStringList{"#test"}, alice->channels());
+    EXPECT_EQ(alice, network.ircUser("alice"));
+    alice->partChannel(test);
+    EXPECT_EQ(nullptr, network.ircUser("alice"));
+}
+
+QUASSEL_BENCHMARK(IrcUserTest, memoryBenchmark)
+{
+    SignalProxy proxy(SignalProxy::Server, nullptr);
+    Network network(1);
+    network.setProxy(&proxy);
+    IrcChannel* channel = network.newIrcChannel("#huge");
+
+    // Roughly what a NAMES reply with userhost-in-names and a WHOX sweep give us for a big channel
+    const int members = 50000;
+    QStringList hostmasks;
+    QStringList modes;
+    for (int i = 0; i < members; i++) {
+        QString host = i % 3 ? QString("user/member%1").arg(i) : QString("gateway/web/irccloud.com");
+        hostmasks << QString("member%1!~member%2@%3").arg(i).arg(i % 5 ? QString::number(i) : QString("quassel")).arg(host);
+        modes << (i % 100 ? QString() : QString("o"));
+    }
+
+    qint64 rssBefore = residentSetSize();
+    test::Benchmark benchmark;
+    channel->joinIrcUsers(hostmasks, modes);
+    for (IrcUser* ircUser : channel->ircUsers()) {
+        ircUser->setServer(QString("irc%1.example.org").arg(qHash(ircUser->nick()) % 8));
+        ircUser->setRealName(QString("Member %1").arg(ircUser->nick().mid(6)));
+        ircUser->setAccount(ircUser->host().startsWith("user/") ? ircUser->host().mid(5) : QString("*"));
+    }
+    qint64 elapsed = benchmark.lap();
+    qint64 rssAfter = residentSetSize();
+
+    ASSERT_EQ(members, channel->ircUsers().count());
+    EXPECT_EQ(members, network.ircUsers().count());
+    hostmasks.clear();
+
+    test::Benchmark::record("joinMs", elapsed);
+    if (rssBefore >= 0 && rssAfter >= 0) {
+        test::Benchmark::record("bytesPerUser", (rssAfter - rssBefore) * 1024 / members);
+    }
+}
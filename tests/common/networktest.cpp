@@ -0,0 +1,210 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <algorithm>
+
+#include <QDataStream>
+
+#include "testglobal.h"
+#include "benchmark.h"
+#include "ircchannel.h"
+#include "ircuser.h"
+#include "network.h"
+#include "signalproxy.h"
+
+namespace {
+
+void setupNetwork(Network& network)
+{
+    network.addSupport("CHANMODES", "beI,k,l,imnpst");
+    network.addSupport("PREFIX", "(ov)@+");
+}
+
+void populate(Network& network, int userCount, int channelCount)
+{
+    QDateTime time = QDateTime::fromMSecsSinceEpoch(1600000000000, Qt::UTC);
+    for (int c = 0; c < channelCount; c++) {
+        IrcChannel* channel = network.newIrcChannel(QString("#channel%1").arg(c));
+        channel->setTopic(QString("Topic of channel %1").arg(c));
+        channel->addChannelMode('b', QString("*!*@spammer%1.example.org").arg(c));
+        channel->addChannelMode('k', "secret");
+        channel->addChannelMode('l', "500");
+        channel->addChannelMode('n', {});
+        channel->addChannelMode('t', {});
+
+        QStringList hostmasks;
+        QStringList modes;
+        for (int i = c; i < userCount; i += c + 1) {
+            hostmasks << QString("user%1!~user%1@host%2.example.org").arg(i).arg(i % 50);
+            modes << (i % 50 ? i % 7 ? "" : "v" : "o");
+        }
+        channel->joinIrcUsers(hostmasks, modes);
+    }
+    for (IrcUser* ircUser : network.ircUsers()) {
+        int i = ircUser->nick().mid(4).toInt();
+        ircUser->setRealName(QString("User %1").arg(i));
+        ircUser->setServer(QString("irc%1.example.org").arg(i % 4));
+        ircUser->setAccount(i % 3 ? ircUser->nick() : QString("*"));
+        if (i % 10 == 0) {
+            ircUser->setAway(true);
+            ircUser->setAwayMessage("Gone fishing");
+            ircUser->setLastAwayMessageTime(time.addSecs(i));
+        }
+        if (i % 100 == 0) {
+            ircUser->setLoginTime(time.addSecs(-i));
+            ircUser->setIrcOperator("is an IRC operator");
+        }
+    }
+}
+
+// Init data in the format used without the CompactUsersAndChannels feature, cf. Network::initIrcUsersAndChannels()
+QVariantMap legacyInitData(const Network& network)
+{
+    QHash<QString, QVariantList> users;
+    for (IrcUser* ircUser : network.ircUsers()) {
+        const QVariantMap map = ircUser->toVariantMap();
+        for (auto it = map.cbegin(); it != map.cend(); ++it) {
+            users[it.key()] << it.value();
+        }
+    }
+    QVariantMap userMap;
+    for (auto it = users.cbegin(); it != users.cend(); ++it) {
+        userMap[it.key()] = it.value();
+    }
+
+    QHash<QString, QVariantList> channels;
+    for (IrcChannel* channel : network.ircChannels()) {
+        const QVariantMap map = channel->toVariantMap();
+        for (auto it = map.cbegin(); it != map.cend(); ++it) {
+            channels[it.key()] << it.value();
+        }
+    }
+    QVariantMap channelMap;
+    for (auto it = channels.cbegin(); it != channels.cend(); ++it) {
+        channelMap[it.key()] = it.value();
+    }
+    return {{"Users", userMap}, {"Channels", channelMap}};
+}
+
+qint64 serializedSize(const QVariant& data)
+{
+    QByteArray buffer;
+    QDataStream stream(&buffer, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_2);
+    stream << data;
+    return buffer.size();
+}
+
+}  // namespace
+
+TEST(NetworkTest, compactUsersAndChannels)
+{
+    SignalProxy serverProxy(SignalProxy::Server, nullptr);
+    Network serverNetwork(1);
+    serverNetwork.setProxy(&serverProxy);
+    setupNetwork(serverNetwork);
+    populate(serverNetwork, 500, 5);
+
+    QByteArray data = serverNetwork.encodeIrcUsersAndChannels();
+    ASSERT_FALSE(data.isEmpty());
+
+    SignalProxy clientProxy(SignalProxy::Client, nullptr);
+    Network clientNetwork(1);
+    clientNetwork.setProxy(&clientProxy);
+    setupNetwork(clientNetwork);
+    ASSERT_TRUE(clientNetwork.decodeIrcUsersAndChannels(data));
+
+    ASSERT_EQ(serverNetwork.ircUserCount(), clientNetwork.ircUserCount());
+    for (IrcUser* expected : serverNetwork.ircUsers()) {
+        IrcUser* ircUser = clientNetwork.ircUser(expected->nick());
+        ASSERT_NE(nullptr, ircUser) << qPrintable(expected->nick());
+        EXPECT_EQ(expected->hostmask(), ircUser->hostmask());
+        EXPECT_EQ(expected->realName(), ircUser->realName());
+        EXPECT_EQ(expected->account(), ircUser->account());
+        EXPECT_EQ(expected->server(), ircUser->server());
+        EXPECT_EQ(expected->isAway(), ircUser->isAway());
+        EXPECT_EQ(expected->awayMessage(), ircUser->awayMessage());
+        EXPECT_EQ(expected->lastAwayMessageTime(), ircUser->lastAwayMessageTime());
+        EXPECT_EQ(expected->loginTime(), ircUser->loginTime());
+        EXPECT_EQ(expected->ircOperator(), ircUser->ircOperator());
+        QStringList expectedChannels = expected->channels();
+        QStringList channels = ircUser->channels();
+        std::sort(expectedChannels.begin(), expectedChannels.end());
+        std::sort(channels.begin(), channels.end());
+        EXPECT_EQ(expectedChannels, channels);
+    }
+
+    ASSERT_EQ(serverNetwork.ircChannelCount(), clientNetwork.ircChannelCount());
+    for (IrcChannel* expected : serverNetwork.ircChannels()) {
+        IrcChannel* channel = clientNetwork.ircChannel(expected->name());
+        ASSERT_NE(nullptr, channel) << qPrintable(expected->name());
+        EXPECT_EQ(expected->topic(), channel->topic());
+        QVariantMap expectedModes = expected->initChanModes();
+        QVariantMap modes = channel->initChanModes();
+        for (auto&& type : {"A", "B", "C"}) {
+            EXPECT_EQ(expectedModes[type], modes[type]) << type;
+        }
+        QString expectedFlags = expectedModes["D"].toString();
+        QString flags = modes["D"].toString();
+        std::sort(expectedFlags.begin(), expectedFlags.end());
+        std::sort(flags.begin(), flags.end());
+        EXPECT_EQ(expectedFlags, flags);
+        EXPECT_EQ(expected->initUserModes(), channel->initUserModes());
+    }
+
+    // The encoding is cached until something changes
+    EXPECT_EQ(data.constData(), serverNetwork.encodeIrcUsersAndChannels().constData());
+    serverNetwork.ircUsers().first()->setAway(!serverNetwork.ircUsers().first()->isAway());
+    EXPECT_NE(data, serverNetwork.encodeIrcUsersAndChannels());
+
+    // Garbage must not create anything
+    Network otherNetwork(2);
+    otherNetwork.setProxy(&clientProxy);
+    EXPECT_FALSE(otherNetwork.decodeIrcUsersAndChannels(data.left(data.size() / 2)));
+    EXPECT_FALSE(otherNetwork.decodeIrcUsersAndChannels(QByteArray("\x01\xff\xff\xff\xff\x0f", 6)));
+    EXPECT_EQ(0u, otherNetwork.ircUserCount());
+}
+
+QUASSEL_BENCHMARK(NetworkTest, compactUsersAndChannelsBenchmark)
+{
+    SignalProxy proxy(SignalProxy::Server, nullptr);
+    Network network(1);
+    network.setProxy(&proxy);
+    setupNetwork(network);
+    populate(network, 50000, 20);
+
+    test::Benchmark benchmark;
+    QVariantMap legacy = legacyInitData(network);
+    qint64 legacyTime = benchmark.lap();
+    QByteArray compact = network.encodeIrcUsersAndChannels();
+    qint64 compactTime = benchmark.lap();
+    network.encodeIrcUsersAndChannels();
+    qint64 cachedTime = benchmark.lap();
+
+    qint64 legacySize = serializedSize(legacy);
+    qint64 compactSize = serializedSize(QVariantMap{{"Compact", compact}});
+    EXPECT_LT(compactSize, legacySize);
+
+    test::Benchmark::record("legacyMs", legacyTime);
+    test::Benchmark::record("compactMs", compactTime);
+    test::Benchmark::record("legacyBytes", legacySize);
+    test::Benchmark::record("compactBytes", compactSize);
+    test::Benchmark::record("compactCachedMs", cachedTime);
+}
@@ -409,4 +409,57 @@ TEST_F(SignalProxyTest, syncableObject)
     EXPECT_EQ("Hi Universe", clientObject.stringProperty());
 }
 
+// -----------------------------------------------------------------------------------------------------------------------------------------
+
+// Peer recording the serialized messages written to it
+class SerializingPeer : public MockedPeer
+{
+    Q_OBJECT
+
+public:
+    SerializingPeer(int* serializations, QObject* parent)
+        : MockedPeer{parent}
+        , _serializations{serializations}
+    {}
+
+    using MockedPeer::serialize;
+
+    QByteArray serialize(const Protocol::RpcCall& rpcCall) const override
+    {
+        ++*_serializations;
+        return rpcCall.signalName + (hasFeature(Quassel::Feature::LongTime) ? "+LongTime" : "");
+    }
+
+    void writeSerialized(const QByteArray& msg) override { written << msg; }
+
+    QList<QByteArray> written;
+
+private:
+    int* _serializations;
+};
+
+TEST_F(SignalProxyTest, broadcastSerializesOnce)
+{
+    SignalProxy proxy{SignalProxy::ProxyMode::Server, this};
+    int serializations = 0;
+    SerializingPeer* peers[] = {new SerializingPeer{&serializations, this},
+                                new SerializingPeer{&serializations, this},
+                                new SerializingPeer{&serializations, this}};
+    peers[2]->setFeatures(Quassel::Features{{}, Quassel::LegacyFeatures{}});
+    for (auto&& peer : peers) {
+        proxy.addPeer(peer);
+    }
+
+    ProxyObject::Spy spy;
+    ProxyObject object{&spy, nullptr};
+    proxy.attachSignal(&object, &ProxyObject::sendData);
+    emit object.sendData(42, "Hello");
+
+    // Peers with the same features share the serialized message
+    EXPECT_EQ(2, serializations);
+    EXPECT_EQ(QList<QByteArray>{"2sendData(int,QString)+LongTime"}, peers[0]->written);
+    EXPECT_EQ(QList<QByteArray>{"2sendData(int,QString)+LongTime"}, peers[1]->written);
+    EXPECT_EQ(QList<QByteArray>{"2sendData(int,QString)"}, peers[2]->written);
+}
+
 #include "signalproxytest.moc"
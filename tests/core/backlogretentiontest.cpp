@@ -0,0 +1,125 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "testglobal.h"
+#include "backlogarchive.h"
+#include "retentionpolicy.h"
+
+namespace {
+
+const BufferInfo channel(1, 1, BufferInfo::ChannelBuffer, 0, "#quassel");
+
+std::vector<Message> messages(qint64 first, qint64 last)
+{
+    std::vector<Message> result;
+    for (qint64 id = first; id <= last; id++) {
+        Message msg(QDateTime::fromMSecsSinceEpoch(1600000000000 + id * 1000),
+                    channel,
+                    Message::Plain,
+                    QString("message %1").arg(id),
+                    "nick!user@host");
+        msg.setMsgId(id);
+        result.push_back(std::move(msg));
+    }
+    return result;
+}
+
+std::vector<qint64> ids(const std::vector<Message>& messages)
+{
+    std::vector<qint64> result;
+    for (auto&& msg : messages) {
+        result.push_back(msg.msgId().toQint64());
+    }
+    return result;
+}
+
+}  // namespace
+
+TEST(BacklogRetentionTest, policy)
+{
+    RetentionPolicy policy;
+    EXPECT_TRUE(policy.addRules("days=365; buffertype=status,days=30 ;user=alice,days=0;network=2,buffertype=query,days=7,archive"));
+    EXPECT_FALSE(policy.isEmpty());
+
+    const BufferInfo status(1, 1, BufferInfo::StatusBuffer);
+    const BufferInfo query(2, 2, BufferInfo::QueryBuffer, 0, "nick");
+    ASSERT_NE(nullptr, policy.rule("bob", channel));
+    EXPECT_EQ(365, policy.rule("bob", channel)->maxAge);
+    EXPECT_FALSE(policy.rule("bob", channel)->archive);
+    EXPECT_EQ(30, policy.rule("bob", status)->maxAge);
+    EXPECT_EQ(nullptr, policy.rule("alice", channel));
+    ASSERT_NE(nullptr, policy.rule("alice", query));
+    EXPECT_EQ(7, policy.rule("alice", query)->maxAge);
+    EXPECT_TRUE(policy.rule("alice", query)->archive);
+
+    QString errorString;
+    EXPECT_FALSE(policy.addRule("user=bob", &errorString));
+    EXPECT_FALSE(errorString.isEmpty());
+    EXPECT_FALSE(policy.addRule("buffertype=foo,days=1"));
+    EXPECT_FALSE(policy.addRule("days=-1"));
+    EXPECT_FALSE(policy.addRule("days=1,keep"));
+}
+
+TEST(BacklogRetentionTest, archive)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    BacklogArchive archive(dir.path());
+
+    EXPECT_FALSE(archive.contains(1, 1));
+    EXPECT_TRUE(archive.requestMsgs(1, channel).empty());
+    ASSERT_TRUE(archive.append(1, 1, messages(1, 100)));
+    ASSERT_TRUE(archive.append(1, 1, messages(101, 200)));
+    EXPECT_TRUE(archive.contains(1, 1));
+
+    auto result = archive.requestMsgs(1, channel, -1, 150, 3);
+    EXPECT_EQ((std::vector<qint64>{149, 148, 147}), ids(result));
+    EXPECT_EQ(QString("message 149"), result.front().contents());
+    EXPECT_EQ(QString("nick!user@host"), result.front().sender());
+    EXPECT_EQ(channel.bufferName(), result.front().bufferInfo().bufferName());
+    EXPECT_EQ(messages(149, 149).front().timestamp(), result.front().timestamp());
+
+    EXPECT_EQ((std::vector<qint64>{102, 101, 100, 99}), ids(archive.requestMsgs(1, channel, 99, 103)));
+    EXPECT_EQ(200u, archive.requestMsgs(1, channel).size());
+
+    // A segment cut short by a crash is ignored, and overwritten by the next one
+    {
+        QFile file(dir.filePath("1/1.archive"));
+        ASSERT_TRUE(file.open(QIODevice::Append));
+        file.write("QBA1 and then the power went out");
+    }
+    BacklogArchive reopened(dir.path());
+    EXPECT_EQ(200u, reopened.requestMsgs(1, channel).size());
+    ASSERT_TRUE(reopened.append(1, 1, messages(201, 210)));
+    EXPECT_EQ((std::vector<qint64>{210, 209}), ids(reopened.requestMsgs(1, channel, -1, -1, 2)));
+
+    // Merged archives keep their segments apart, but are read back in order
+    ASSERT_TRUE(reopened.append(1, 2, messages(300, 301)));
+    ASSERT_TRUE(reopened.mergeBuffers(1, 1, 2));
+    EXPECT_FALSE(reopened.contains(1, 2));
+    EXPECT_EQ((std::vector<qint64>{301, 300, 210}), ids(reopened.requestMsgs(1, channel, -1, -1, 3)));
+    EXPECT_EQ((std::vector<qint64>{210, 209}), ids(reopened.requestMsgs(1, channel, -1, 300, 2)));
+
+    reopened.removeUser(1);
+    EXPECT_FALSE(reopened.contains(1, 1));
+}
@@ -0,0 +1,92 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <algorithm>
+
+#include <QHash>
+
+#include "testglobal.h"
+#include "bufferstatewriter.h"
+
+class RecordingBufferStateWriter : public BufferStateWriter
+{
+public:
+    // Stop before the recording members are gone, rather than in the base class destructor
+    ~RecordingBufferStateWriter() override { stop(); }
+
+    int writeCount{0};
+    QHash<UserId, std::vector<Storage::BufferState>> written;
+
+protected:
+    void write(UserId user, const std::vector<Storage::BufferState>& states) override
+    {
+        writeCount++;
+        written[user] = states;
+    }
+};
+
+namespace {
+
+Storage::BufferState state(BufferId bufferId, int fields, MsgId lastSeenMsg, MsgId markerLineMsg, int highlightCount)
+{
+    Storage::BufferState result;
+    result.bufferId = bufferId;
+    result.fields = fields;
+    result.lastSeenMsg = lastSeenMsg;
+    result.markerLineMsg = markerLineMsg;
+    result.highlightCount = highlightCount;
+    return result;
+}
+
+}  // namespace
+
+TEST(BufferStateWriterTest, coalescesChanges)
+{
+    using Field = Storage::BufferState::Field;
+
+    RecordingBufferStateWriter writer;
+    writer.store(1, {state(1, Field::LastSeenMsg, 10, {}, 0), state(2, Field::HighlightCount, {}, {}, 3)});
+    writer.store(1, {state(1, Field::MarkerLineMsg, {}, 8, 0)});
+    writer.store(1, {state(1, Field::LastSeenMsg | Field::HighlightCount, 12, {}, 0)});
+    writer.store(2, {state(1, Field::LastSeenMsg, 5, {}, 0)});
+    writer.store(2, {});
+
+    // Everything queued before the thread starts is written in a single round, one transaction per user
+    writer.start();
+    writer.stop();
+    EXPECT_EQ(2, writer.writeCount);
+    ASSERT_EQ(2, writer.written.size());
+
+    auto states = writer.written.value(1);
+    std::sort(states.begin(), states.end(), [](auto&& a, auto&& b) { return a.bufferId < b.bufferId; });
+    ASSERT_EQ(2u, states.size());
+    EXPECT_EQ(BufferId(1), states[0].bufferId);
+    EXPECT_EQ(Field::LastSeenMsg | Field::MarkerLineMsg | Field::HighlightCount, states[0].fields);
+    EXPECT_EQ(MsgId(12), states[0].lastSeenMsg);
+    EXPECT_EQ(MsgId(8), states[0].markerLineMsg);
+    EXPECT_EQ(0, states[0].highlightCount);
+    EXPECT_EQ(BufferId(2), states[1].bufferId);
+    EXPECT_EQ(int(Field::HighlightCount), states[1].fields);
+    EXPECT_EQ(3, states[1].highlightCount);
+
+    ASSERT_EQ(1u, writer.written.value(2).size());
+    EXPECT_EQ(int(Field::LastSeenMsg), writer.written.value(2).front().fields);
+    EXPECT_EQ(MsgId(5), writer.written.value(2).front().lastSeenMsg);
+}
@@ -0,0 +1,145 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QCoreApplication>
+
+#include "testglobal.h"
+#include "connectionscheduler.h"
+
+// Stands in for a CoreNetwork
+class TestNetwork : public QObject
+{
+    Q_OBJECT
+
+public:
+    bool admitted{false};
+
+public slots:
+    void startConnection() { admitted = true; }
+};
+
+namespace {
+
+// Admissions take a round trip through the event loop
+void processEvents()
+{
+    for (int i = 0; i < 3; i++) {
+        QCoreApplication::processEvents();
+    }
+}
+
+}  // namespace
+
+TEST(ConnectionSchedulerTest, limitsConcurrency)
+{
+    ConnectionScheduler scheduler(2);
+    TestNetwork networks[5];
+    for (int i = 0; i < 5; i++) {
+        scheduler.requestAdmission(&networks[i], QString("irc%1.example.org:6697").arg(i), i == 3);
+    }
+    processEvents();
+
+    // Networks with clients go first, then the others in order
+    EXPECT_TRUE(networks[3].admitted);
+    EXPECT_TRUE(networks[0].admitted);
+    EXPECT_FALSE(networks[1].admitted);
+    EXPECT_EQ(2, scheduler.connecting());
+    EXPECT_EQ(3, scheduler.waiting());
+
+    scheduler.finished(&networks[3], true);
+    processEvents();
+    EXPECT_TRUE(networks[1].admitted);
+    EXPECT_FALSE(networks[2].admitted);
+
+    // Giving up on a connection frees its slot as well
+    scheduler.cancel(&networks[0]);
+    processEvents();
+    EXPECT_TRUE(networks[2].admitted);
+    EXPECT_FALSE(networks[4].admitted);
+
+    // Withdrawn requests never get admitted
+    scheduler.cancel(&networks[4]);
+    scheduler.finished(&networks[1], true);
+    processEvents();
+    EXPECT_FALSE(networks[4].admitted);
+    EXPECT_EQ(0, scheduler.waiting());
+}
+
+TEST(ConnectionSchedulerTest, backsOffFailingServers)
+{
+    ConnectionScheduler scheduler(1);
+    TestNetwork first, second, other;
+    scheduler.requestAdmission(&first, "irc.example.org:6697", false);
+    processEvents();
+    ASSERT_TRUE(first.admitted);
+
+    scheduler.requestAdmission(&second, "irc.example.org:6697", false);
+    scheduler.requestAdmission(&other, "irc.example.net:6697", false);
+    scheduler.finished(&first, false);
+    processEvents();
+
+    // The failed server has to wait, others don't
+    EXPECT_FALSE(second.admitted);
+    EXPECT_TRUE(other.admitted);
+}
+
+TEST(ConnectionSchedulerTest, cancelWhileQueued)
+{
+    ConnectionScheduler scheduler(1);
+    TestNetwork busy, withdrawn, next;
+    scheduler.requestAdmission(&busy, "irc.example.org:6697", false);
+    processEvents();
+    ASSERT_TRUE(busy.admitted);
+
+    scheduler.requestAdmission(&withdrawn, "irc.example.net:6697", false);
+    scheduler.requestAdmission(&next, "irc.example.com:6697", false);
+    scheduler.cancel(&withdrawn);
+    EXPECT_EQ(1, scheduler.waiting());
+    EXPECT_EQ(1, scheduler.connecting());
+
+    // Reports for a withdrawn request neither free a slot nor count as a failure of its server
+    scheduler.finished(&withdrawn, false);
+    processEvents();
+    EXPECT_FALSE(next.admitted);
+    scheduler.finished(&busy, true);
+    processEvents();
+    EXPECT_TRUE(next.admitted);
+    EXPECT_FALSE(withdrawn.admitted);
+
+    scheduler.requestAdmission(&withdrawn, "irc.example.net:6697", false);
+    scheduler.finished(&next, true);
+    processEvents();
+    EXPECT_TRUE(withdrawn.admitted);
+}
+
+TEST(ConnectionSchedulerTest, backoff)
+{
+    EXPECT_EQ(0, ConnectionScheduler::backoff(0, 0.5));
+    EXPECT_EQ(2000, ConnectionScheduler::backoff(1, 0.5));
+    EXPECT_EQ(8000, ConnectionScheduler::backoff(3, 0.5));
+    EXPECT_EQ(300000, ConnectionScheduler::backoff(30, 0.5));
+
+    // Jitter spreads retries between half and one and a half times the backoff
+    EXPECT_EQ(1000, ConnectionScheduler::backoff(1, 0.0));
+    EXPECT_GT(3000, ConnectionScheduler::backoff(1, 0.999));
+    EXPECT_LT(2000, ConnectionScheduler::backoff(1, 0.75));
+}
+
+#include "connectionschedulertest.moc"
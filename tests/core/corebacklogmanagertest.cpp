@@ -0,0 +1,109 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <vector>
+
+#include "testglobal.h"
+#include "corebacklogmanager.h"
+#include "peer.h"
+
+class TestBacklogManager : public CoreBacklogManager
+{
+public:
+    using CoreBacklogManager::BacklogStream;
+};
+
+using BacklogStream = TestBacklogManager::BacklogStream;
+
+namespace {
+
+BacklogStream backlogStream(BufferId bufferId, MsgId first, MsgId last, int limit, int additional)
+{
+    return BacklogStream{nullptr, bufferId, first, last, limit, additional, false, first, false};
+}
+
+/// Fetches messages the way Storage::requestMsgs() does, from a buffer holding the messages 1 to @p count
+std::vector<Message> fetch(int count, MsgId first, MsgId last, int limit)
+{
+    std::vector<Message> result;
+    for (int msgId = count; msgId > 0 && static_cast<int>(result.size()) < limit; msgId--) {
+        if ((first != -1 && msgId < first) || (last != -1 && msgId >= last))
+            continue;
+        Message msg(BufferInfo(1, 1, BufferInfo::ChannelBuffer), Message::Plain, QString("message %1").arg(msgId));
+        msg.setMsgId(msgId);
+        result.push_back(msg);
+    }
+    return result;
+}
+
+/// Runs the stream to completion in chunks of at most three messages, returning the MsgIds of each chunk
+std::vector<std::vector<int>> chunks(BacklogStream stream, int count)
+{
+    std::vector<std::vector<int>> result;
+    for (int i = 0; i < 100; i++) {
+        int chunkSize = stream.nextChunkSize(3);
+        std::vector<Message> messages;
+        if (chunkSize > 0)
+            messages = fetch(count, stream.first, stream.last, chunkSize);
+
+        std::vector<int> chunk;
+        for (auto&& msg : messages) {
+            chunk.push_back(static_cast<int>(msg.msgId().toQint64()));
+        }
+        result.push_back(chunk);
+        if (stream.advance(messages, chunkSize))
+            return result;
+    }
+    ADD_FAILURE() << "The stream never completed";
+    return result;
+}
+
+}  // namespace
+
+TEST(CoreBacklogManagerTest, streamLimit)
+{
+    EXPECT_EQ((std::vector<std::vector<int>>{{10, 9, 8}, {7, 6, 5}, {4}}), chunks(backlogStream(1, -1, -1, 7, 0), 10));
+    EXPECT_EQ((std::vector<std::vector<int>>{{6, 5, 4}, {3}}), chunks(backlogStream(1, -1, 7, 4, 0), 10));
+    EXPECT_EQ((std::vector<std::vector<int>>{{}}), chunks(backlogStream(1, -1, -1, 0, 0), 10));
+}
+
+TEST(CoreBacklogManagerTest, streamUnlimited)
+{
+    EXPECT_EQ((std::vector<std::vector<int>>{{7, 6, 5}, {4, 3, 2}, {1}}), chunks(backlogStream(1, -1, -1, -1, 0), 7));
+
+    // If the last chunk happens to be full, the stream ends with an empty one
+    EXPECT_EQ((std::vector<std::vector<int>>{{6, 5, 4}, {3, 2, 1}, {}}), chunks(backlogStream(1, -1, -1, -1, 0), 6));
+    EXPECT_EQ((std::vector<std::vector<int>>{{}}), chunks(backlogStream(1, -1, -1, -1, 0), 0));
+}
+
+TEST(CoreBacklogManagerTest, streamAdditional)
+{
+    // Unread messages first, then additional older ones continuing before them
+    EXPECT_EQ((std::vector<std::vector<int>>{{10, 9, 8}, {7, 6}, {5, 4}}), chunks(backlogStream(1, 6, -1, 10, 2), 10));
+
+    // Without a first message, additional messages continue where the limit was hit
+    EXPECT_EQ((std::vector<std::vector<int>>{{10, 9, 8}, {7}, {6, 5, 4}, {3}}), chunks(backlogStream(1, -1, -1, 4, 4), 10));
+
+    // For a single buffer, additional messages are only fetched if they continue seamlessly
+    EXPECT_EQ((std::vector<std::vector<int>>{{10, 9, 8}}), chunks(backlogStream(1, 6, -1, 3, 2), 10));
+
+    // For all buffers, they are fetched before the first message requested in any case
+    EXPECT_EQ((std::vector<std::vector<int>>{{10, 9, 8}, {5, 4}}), chunks(backlogStream({}, 6, -1, 3, 2), 10));
+}
@@ -0,0 +1,157 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QDateTime>
+#include <QStringList>
+
+#include "testglobal.h"
+#include "bufferinfo.h"
+#include "coreignorelistmanager.h"
+#include "coresession.h"
+#include "message.h"
+
+class IndexedIgnoreListManager : public CoreIgnoreListManager
+{
+public:
+    using CoreIgnoreListManager::CoreIgnoreListManager;
+    using CoreIgnoreListManager::isSenderIndexed;
+    using CoreIgnoreListManager::scannedRuleCount;
+};
+
+namespace {
+
+void addRule(CoreIgnoreListManager& manager,
+             IgnoreListManager::IgnoreType type,
+             const QString& rule,
+             bool isRegEx,
+             IgnoreListManager::StrictnessType strictness,
+             IgnoreListManager::ScopeType scope = IgnoreListManager::GlobalScope,
+             const QString& scopeRule = {},
+             bool isActive = true)
+{
+    manager.addIgnoreListItem(type, rule, isRegEx, strictness, scope, scopeRule, isActive);
+}
+
+// Compares the indexed lookup with the rule loop of IgnoreListManager
+void expectSameMatch(CoreIgnoreListManager& manager,
+                     const QString& text,
+                     const QString& sender,
+                     const QString& network,
+                     const QString& target,
+                     Message::Type type = Message::Plain)
+{
+    RawMessage rawMsg{QDateTime::currentDateTimeUtc(), 1, type, BufferInfo::ChannelBuffer, target, text, sender, Message::None};
+    Message msg{BufferInfo(1, 1, BufferInfo::ChannelBuffer, 0, target), type, text, sender};
+    EXPECT_EQ(static_cast<IgnoreListManager&>(manager).match(msg, network), manager.match(rawMsg, network))
+        << qPrintable(text) << " from " << qPrintable(sender) << " in " << qPrintable(network) << "/" << qPrintable(target);
+}
+
+}  // namespace
+
+TEST(CoreIgnoreListManagerTest, literalRules)
+{
+    CoreIgnoreListManager manager{nullptr};
+    addRule(manager, IgnoreListManager::SenderIgnore, "troll!troll@example.org", false, IgnoreListManager::HardStrictness);
+    addRule(manager, IgnoreListManager::SenderIgnore, "bot!bot@example.org", false, IgnoreListManager::SoftStrictness,
+            IgnoreListManager::NetworkScope, "libera");
+    addRule(manager, IgnoreListManager::MessageIgnore, "*spam*", false, IgnoreListManager::SoftStrictness,
+            IgnoreListManager::ChannelScope, "#quassel; #Ops");
+
+    RawMessage msg{QDateTime::currentDateTimeUtc(), 1, Message::Plain, BufferInfo::ChannelBuffer, "#quassel", "hi", "Troll!troll@Example.org", Message::None};
+    EXPECT_EQ(IgnoreListManager::HardStrictness, manager.match(msg, "libera"));
+
+    msg.sender = "bot!bot@example.org";
+    EXPECT_EQ(IgnoreListManager::SoftStrictness, manager.match(msg, "LIBERA"));
+    EXPECT_EQ(IgnoreListManager::UnmatchedStrictness, manager.match(msg, "oftc"));
+
+    msg.sender = "nick!user@host";
+    msg.text = "buy spam now";
+    EXPECT_EQ(IgnoreListManager::SoftStrictness, manager.match(msg, "oftc"));
+    msg.target = "#ops";
+    EXPECT_EQ(IgnoreListManager::SoftStrictness, manager.match(msg, "oftc"));
+    msg.target = "#other";
+    EXPECT_EQ(IgnoreListManager::UnmatchedStrictness, manager.match(msg, "oftc"));
+
+    // Rule changes must be picked up
+    msg.target = "#quassel";
+    manager.toggleIgnoreRule("*spam*");
+    EXPECT_EQ(IgnoreListManager::UnmatchedStrictness, manager.match(msg, "oftc"));
+    manager.removeIgnoreListItem("troll!troll@example.org");
+    msg.sender = "troll!troll@example.org";
+    EXPECT_EQ(IgnoreListManager::UnmatchedStrictness, manager.match(msg, "oftc"));
+}
+
+TEST(CoreIgnoreListManagerTest, matchesRuleLoop)
+{
+    CoreIgnoreListManager manager{nullptr};
+    for (int i = 0; i < 20; i++) {
+        auto strictness = i % 2 ? IgnoreListManager::SoftStrictness : IgnoreListManager::HardStrictness;
+        addRule(manager, IgnoreListManager::SenderIgnore, QString("nick%1!user@host").arg(i), false, strictness,
+                static_cast<IgnoreListManager::ScopeType>(i % 3), QString("net%1;#chan%1").arg(i % 4));
+        addRule(manager, IgnoreListManager::SenderIgnore, QString("wild%1!*@*").arg(i), false, strictness,
+                IgnoreListManager::NetworkScope, QString("net%1*").arg(i % 2));
+        addRule(manager, IgnoreListManager::MessageIgnore, QString("word%1*").arg(i), false, strictness,
+                IgnoreListManager::ChannelScope, QString("#chan%1").arg(i % 4));
+        addRule(manager, IgnoreListManager::MessageIgnore, QString("re%1[a-z]+").arg(i), true, strictness,
+                IgnoreListManager::NetworkScope, QString("!net%1").arg(i % 4));
+    }
+    addRule(manager, IgnoreListManager::SenderIgnore, "nick3!user@host", false, IgnoreListManager::HardStrictness,
+            IgnoreListManager::GlobalScope, {}, false);
+    addRule(manager, IgnoreListManager::SenderIgnore, "!nick5!user@host", false, IgnoreListManager::SoftStrictness,
+            IgnoreListManager::ChannelScope, "#chan9");
+    addRule(manager, IgnoreListManager::MessageIgnore, "empty scope", false, IgnoreListManager::HardStrictness,
+            IgnoreListManager::NetworkScope, {});
+
+    const QStringList senders{"nick0!user@host", "NICK1!USER@HOST", "nick3!user@host", "nick5!user@host", "wild4!x@y", "other!u@h"};
+    const QStringList texts{"nothing", "word2 here", "\x02word5\x02", "re7abc", "empty scope"};
+    const QStringList networks{"net0", "net1", "Net2", "net10", "elsewhere"};
+    const QStringList targets{"#chan0", "#CHAN1", "#chan3", "#chan9", "#quassel"};
+    for (const QString& sender : senders) {
+        for (const QString& text : texts) {
+            for (const QString& network : networks) {
+                for (const QString& target : targets) {
+                    expectSameMatch(manager, text, sender, network, target);
+                }
+            }
+        }
+    }
+    expectSameMatch(manager, "word2", "nick0!user@host", "net0", "#chan0", Message::Join);
+}
+
+TEST(CoreIgnoreListManagerTest, index)
+{
+    IndexedIgnoreListManager manager{nullptr};
+    addRule(manager, IgnoreListManager::SenderIgnore, "troll!troll@example.org", false, IgnoreListManager::HardStrictness);
+    addRule(manager, IgnoreListManager::SenderIgnore, "bot!bot@example.org", false, IgnoreListManager::SoftStrictness,
+            IgnoreListManager::NetworkScope, "libera");
+    EXPECT_TRUE(manager.isSenderIndexed("Troll!troll@Example.org"));
+    EXPECT_TRUE(manager.isSenderIndexed("bot!bot@example.org"));
+    EXPECT_EQ(0, manager.scannedRuleCount());
+
+    // Wildcards and inverted masks or scopes can't be looked up
+    addRule(manager, IgnoreListManager::SenderIgnore, "wild!*@*", false, IgnoreListManager::HardStrictness);
+    addRule(manager, IgnoreListManager::SenderIgnore, "!nick!user@host", false, IgnoreListManager::SoftStrictness,
+            IgnoreListManager::ChannelScope, "#quassel");
+    addRule(manager, IgnoreListManager::MessageIgnore, "spam", false, IgnoreListManager::SoftStrictness,
+            IgnoreListManager::NetworkScope, "!libera");
+    EXPECT_FALSE(manager.isSenderIndexed("wild!*@*"));
+    EXPECT_FALSE(manager.isSenderIndexed("!nick!user@host"));
+    EXPECT_EQ(2, manager.scannedRuleCount());
+}
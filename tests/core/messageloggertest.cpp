@@ -0,0 +1,174 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QCoreApplication>
+#include <QSet>
+
+#include "testglobal.h"
+#include "messagelogger.h"
+
+class RecordingMessageLogger : public MessageLogger
+{
+public:
+    // The commit latency doesn't matter, everything is queued before the thread starts
+    RecordingMessageLogger()
+        : MessageLogger(60000, nullptr)
+    {}
+
+    // Stop before the recording members are gone, rather than in the base class destructor
+    ~RecordingMessageLogger() override { stop(); }
+
+    QList<int> commits;    ///< Number of messages per transaction
+    QSet<QString> broken;  ///< Transactions containing a message with one of these contents fail
+    qint64 nextMsgId{1};
+
+protected:
+    bool store(MessageList& messages) override
+    {
+        commits << messages.count();
+        for (auto&& message : messages) {
+            if (broken.contains(message.contents()))
+                return false;
+        }
+        for (auto&& message : messages) {
+            message.setMsgId(nextMsgId++);
+        }
+        return true;
+    }
+};
+
+/// Handles MessagesLoggedEvent the way CoreSession does, displaying only messages that have been stored
+class MessageReceiver : public QObject
+{
+public:
+    MessageList displayed;
+    int failed{0};
+
+protected:
+    void customEvent(QEvent* event) override
+    {
+        ASSERT_EQ(MessagesLoggedEvent::EventType, event->type());
+        auto* loggedEvent = static_cast<MessagesLoggedEvent*>(event);
+        if (loggedEvent->success)
+            displayed << loggedEvent->messages;
+        else
+            failed++;
+        event->accept();
+    }
+};
+
+namespace {
+
+MessageList messages(std::initializer_list<QString> contents)
+{
+    BufferInfo bufferInfo{1, 1, BufferInfo::ChannelBuffer, 0, "#quassel"};
+    MessageList result;
+    for (auto&& content : contents) {
+        result << Message(bufferInfo, Message::Plain, content, "nick!user@host");
+    }
+    return result;
+}
+
+QStringList contents(const MessageList& messages)
+{
+    QStringList result;
+    for (auto&& message : messages) {
+        result << message.contents();
+    }
+    return result;
+}
+
+}  // namespace
+
+TEST(MessageLoggerTest, roundTrip)
+{
+    RecordingMessageLogger logger;
+    MessageReceiver first;
+    MessageReceiver second;
+    logger.logMessages(messages({"a", "b"}), &first);
+    logger.logMessages(messages({"c"}), &second);
+    logger.logMessages(messages({"d", "e"}), &first);
+    logger.logMessages({}, &second);
+
+    // All sessions' messages are coalesced into a single transaction
+    logger.start();
+    logger.stop();
+    EXPECT_EQ(QList<int>({5}), logger.commits);
+
+    // Nothing is displayed before the receiver's thread has processed the events
+    EXPECT_TRUE(first.displayed.isEmpty());
+    QCoreApplication::sendPostedEvents();
+
+    ASSERT_EQ(QStringList({"a", "b", "d", "e"}), contents(first.displayed));
+    EXPECT_EQ(MsgId(1), first.displayed[0].msgId());
+    EXPECT_EQ(MsgId(2), first.displayed[1].msgId());
+    EXPECT_EQ(MsgId(4), first.displayed[2].msgId());
+    EXPECT_EQ(MsgId(5), first.displayed[3].msgId());
+    ASSERT_EQ(QStringList({"c"}), contents(second.displayed));
+    EXPECT_EQ(MsgId(3), second.displayed[0].msgId());
+    EXPECT_EQ(0, first.failed);
+    EXPECT_EQ(0, second.failed);
+}
+
+TEST(MessageLoggerTest, failedBatch)
+{
+    RecordingMessageLogger logger;
+    logger.broken << "bad";
+    MessageReceiver first;
+    MessageReceiver second;
+    MessageReceiver third;
+    logger.logMessages(messages({"a"}), &first);
+    logger.logMessages(messages({"bad", "b"}), &second);
+    logger.logMessages(messages({"c"}), &third);
+
+    // The failing group commit is retried one batch at a time, so only the bad batch is lost
+    logger.start();
+    logger.stop();
+    EXPECT_EQ(QList<int>({4, 1, 2, 1}), logger.commits);
+    QCoreApplication::sendPostedEvents();
+
+    ASSERT_EQ(QStringList({"a"}), contents(first.displayed));
+    EXPECT_EQ(MsgId(1), first.displayed[0].msgId());
+    EXPECT_TRUE(second.displayed.isEmpty());
+    EXPECT_EQ(1, second.failed);
+    ASSERT_EQ(QStringList({"c"}), contents(third.displayed));
+    EXPECT_EQ(MsgId(2), third.displayed[0].msgId());
+}
+
+TEST(MessageLoggerTest, removeReceiver)
+{
+    RecordingMessageLogger logger;
+    MessageReceiver first;
+    MessageReceiver second;
+    logger.logMessages(messages({"a"}), &first);
+    logger.logMessages(messages({"b"}), &second);
+    logger.removeReceiver(&first);
+
+    // Messages of a removed receiver are stored anyway, but not posted back
+    logger.start();
+    logger.stop();
+    EXPECT_EQ(QList<int>({2}), logger.commits);
+    QCoreApplication::sendPostedEvents();
+
+    EXPECT_TRUE(first.displayed.isEmpty());
+    EXPECT_EQ(0, first.failed);
+    ASSERT_EQ(QStringList({"b"}), contents(second.displayed));
+    EXPECT_EQ(MsgId(2), second.displayed[0].msgId());
+}
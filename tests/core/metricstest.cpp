@@ -0,0 +1,86 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <thread>
+#include <vector>
+
+#include <QByteArray>
+
+#include "testglobal.h"
+#include "metrics.h"
+
+TEST(MetricsTest, counterAcrossThreads)
+{
+    MetricsCounter counter;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; i++) {
+        threads.emplace_back([&counter]() {
+            for (int j = 0; j < 10000; j++) {
+                counter.add(2);
+            }
+            counter.add(-1);
+        });
+    }
+    for (auto&& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(8 * 20000 - 8, counter.value());
+}
+
+TEST(MetricsTest, histogram)
+{
+    MetricsHistogram histogram({10, 100, 1000}, 0.5);
+    histogram.observe(5);
+    histogram.observe(10);
+    histogram.observe(50);
+    histogram.observe(5000);
+
+    QByteArray out;
+    histogram.render(out, "test_histogram", "123");
+    EXPECT_EQ(QByteArray("test_histogram_bucket{le=\"5\"} 2 123\n"
+                         "test_histogram_bucket{le=\"50\"} 3 123\n"
+                         "test_histogram_bucket{le=\"500\"} 3 123\n"
+                         "test_histogram_bucket{le=\"+Inf\"} 4 123\n"
+                         "test_histogram_sum 2532.5 123\n"
+                         "test_histogram_count 4 123\n"),
+              out);
+}
+
+TEST(MetricsTest, histogramAcrossThreads)
+{
+    MetricsHistogram histogram({1, 2});
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&histogram]() {
+            for (int j = 0; j < 1000; j++) {
+                histogram.observe(j % 3);
+            }
+        });
+    }
+    for (auto&& thread : threads) {
+        thread.join();
+    }
+
+    QByteArray out;
+    histogram.render(out, "h", "0");
+    EXPECT_TRUE(out.contains("h_bucket{le=\"+Inf\"} 4000 0\n"));
+    EXPECT_TRUE(out.contains("h_count 4000 0\n"));
+    EXPECT_TRUE(out.contains("h_sum 3996 0\n"));
+}
@@ -0,0 +1,61 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "testglobal.h"
+#include "abstractsqlstorage.h"
+
+TEST(SenderIdCacheTest, lookup)
+{
+    SenderIdCache cache;
+    SenderData alice{"alice!a@example.org", "Alice", {}};
+    SenderData bob{"bob!b@example.org", {}, {}};
+
+    EXPECT_EQ(-1, cache.find(alice));
+    cache.insert(alice, 1);
+    cache.insert(bob, 2);
+    EXPECT_EQ(1, cache.find(alice));
+    EXPECT_EQ(2, cache.find(bob));
+    EXPECT_EQ(-1, cache.find(SenderData{"alice!a@example.org", "Not Alice", {}}));
+
+    cache.insert(alice, 3);
+    EXPECT_EQ(3, cache.find(alice));
+    EXPECT_EQ(2, cache.count());
+
+    cache.clear();
+    EXPECT_EQ(-1, cache.find(alice));
+    EXPECT_EQ(0, cache.count());
+}
+
+TEST(SenderIdCacheTest, evictsLeastRecentlyUsed)
+{
+    SenderIdCache cache(3);
+    for (int i = 0; i < 3; i++) {
+        cache.insert(SenderData{QString("nick%1").arg(i), {}, {}}, i);
+    }
+
+    // Touch the oldest entry, so the next insert evicts the second one instead
+    EXPECT_EQ(0, cache.find(SenderData{"nick0", {}, {}}));
+    cache.insert(SenderData{"nick3", {}, {}}, 3);
+    EXPECT_EQ(3, cache.count());
+    EXPECT_EQ(0, cache.find(SenderData{"nick0", {}, {}}));
+    EXPECT_EQ(-1, cache.find(SenderData{"nick1", {}, {}}));
+    EXPECT_EQ(2, cache.find(SenderData{"nick2", {}, {}}));
+    EXPECT_EQ(3, cache.find(SenderData{"nick3", {}, {}}));
+}
@@ -0,0 +1,50 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "testglobal.h"
+#include "sessionscheduler.h"
+
+TEST(SessionSchedulerTest, balancedLoad)
+{
+    // Nothing to gain, or not enough going on to bother
+    EXPECT_FALSE(SessionScheduler::planMigration({{500, 500}, {400, 600}}).isValid());
+    EXPECT_FALSE(SessionScheduler::planMigration({{50, 30}, {}}).isValid());
+    EXPECT_FALSE(SessionScheduler::planMigration({{1000, 1000}}).isValid());
+    EXPECT_FALSE(SessionScheduler::planMigration({}).isValid());
+
+    // A single busy session stays where it is, since moving it wouldn't help
+    EXPECT_FALSE(SessionScheduler::planMigration({{5000}, {10, 20}}).isValid());
+}
+
+TEST(SessionSchedulerTest, movesBusySession)
+{
+    auto migration = SessionScheduler::planMigration({{100, 200}, {2000, 1500, 10}, {300}});
+    ASSERT_TRUE(migration.isValid());
+    EXPECT_EQ(1, migration.worker);
+    EXPECT_EQ(1, migration.session);
+    EXPECT_EQ(0, migration.target);
+
+    // Prefer the session that evens out the load best, not simply the busiest one
+    migration = SessionScheduler::planMigration({{3000, 1000, 700}, {2500}});
+    ASSERT_TRUE(migration.isValid());
+    EXPECT_EQ(0, migration.worker);
+    EXPECT_EQ(1, migration.session);
+    EXPECT_EQ(1, migration.target);
+}
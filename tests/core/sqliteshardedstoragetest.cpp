@@ -0,0 +1,108 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QTemporaryDir>
+
+#include "testglobal.h"
+#include "network.h"
+#include "sqliteshardedstorage.h"
+
+class TestSqliteShardedStorage : public SqliteShardedStorage
+{
+public:
+    TestSqliteShardedStorage(const QString& directory)
+        : _directory(directory)
+    {
+        Q_INIT_RESOURCE(sql);
+    }
+
+protected:
+    QString databaseName() override { return _directory + "/quassel-storage-sharded.sqlite"; }
+    QString shardDatabaseName(const QString& shard) override { return _directory + "/" + shard + ".sqlite"; }
+
+private:
+    QString _directory;
+};
+
+namespace {
+
+std::vector<qint64> ids(const std::vector<Message>& messages)
+{
+    std::vector<qint64> result;
+    for (auto&& msg : messages) {
+        result.push_back(msg.msgId().toQint64());
+    }
+    return result;
+}
+
+}  // namespace
+
+TEST(SqliteShardedStorageTest, requestMsgs)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    TestSqliteShardedStorage storage(dir.path());
+    ASSERT_TRUE(storage.setup());
+
+    UserId user = storage.addUser("alice", "secret");
+    ASSERT_TRUE(user.isValid());
+    NetworkInfo info;
+    info.networkName = "Libera";
+    NetworkId networkId = storage.createNetwork(user, info);
+    BufferInfo channel = storage.bufferInfo(user, networkId, BufferInfo::ChannelBuffer, "#quassel");
+    BufferInfo query = storage.bufferInfo(user, networkId, BufferInfo::QueryBuffer, "bob");
+    ASSERT_TRUE(channel.bufferId().isValid());
+    ASSERT_TRUE(query.bufferId().isValid());
+
+    // Even messages go to the channel, every other one of them is an action
+    MessageList messages;
+    for (int i = 0; i < 20; i++) {
+        messages << Message(QDateTime::fromMSecsSinceEpoch(1600000000000 + i * 1000),
+                            i % 2 ? query : channel,
+                            i % 4 ? Message::Plain : Message::Action,
+                            QString("message %1").arg(i),
+                            "bob!b@example.org");
+    }
+    ASSERT_TRUE(storage.logMessages(messages));
+    auto id = [&messages](int i) { return messages[i].msgId().toQint64(); };
+    ASSERT_GT(id(0), 0);
+
+    const BufferId channelId = channel.bufferId();
+    const BufferId queryId = query.bufferId();
+    auto newest = storage.requestMsgs(user, channelId, -1, -1, 3);
+    EXPECT_EQ((std::vector<qint64>{id(18), id(16), id(14)}), ids(newest));
+    ASSERT_FALSE(newest.empty());
+    EXPECT_EQ(QString("message 18"), newest.front().contents());
+    EXPECT_EQ(channel.bufferName(), newest.front().bufferInfo().bufferName());
+
+    EXPECT_EQ((std::vector<qint64>{id(18), id(16), id(14), id(12)}), ids(storage.requestMsgs(user, channelId, id(12))));
+    EXPECT_EQ((std::vector<qint64>{id(8), id(6), id(4)}), ids(storage.requestMsgs(user, channelId, id(4), id(10))));
+    EXPECT_EQ((std::vector<qint64>{id(8), id(6)}), ids(storage.requestMsgs(user, channelId, id(4), id(10), 2)));
+    EXPECT_EQ((std::vector<qint64>{id(19), id(17)}), ids(storage.requestMsgs(user, queryId, -1, -1, 2)));
+
+    const Message::Types actions{Message::Action};
+    EXPECT_EQ((std::vector<qint64>{id(16), id(12)}), ids(storage.requestMsgsFiltered(user, channelId, -1, -1, 2, actions)));
+    EXPECT_EQ((std::vector<qint64>{id(16), id(12), id(8)}), ids(storage.requestMsgsFiltered(user, channelId, id(8), -1, -1, actions)));
+    EXPECT_EQ((std::vector<qint64>{id(8), id(4), id(0)}), ids(storage.requestMsgsFiltered(user, channelId, id(0), id(12), -1, actions)));
+    EXPECT_TRUE(storage.requestMsgsFiltered(user, queryId, -1, -1, -1, actions).empty());
+
+    EXPECT_EQ((std::vector<qint64>{id(0), id(2), id(4)}), ids(storage.requestMsgsForward(user, channelId, -1, -1, 3)));
+    EXPECT_EQ((std::vector<qint64>{id(12), id(16)}), ids(storage.requestMsgsForward(user, channelId, id(10), -1, -1, actions)));
+}
@@ -0,0 +1,207 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QTemporaryDir>
+
+#include "testglobal.h"
+#include "corebacklogmanager.h"
+#include "network.h"
+#include "sqlitestorage.h"
+
+class TestSqliteStorage : public SqliteStorage
+{
+public:
+    TestSqliteStorage(const QString& path)
+        : _path(path)
+    {
+        Q_INIT_RESOURCE(sql);
+    }
+
+    using SqliteStorage::ftsMatchExpression;
+
+protected:
+    QString databaseName() override { return _path; }
+
+private:
+    QString _path;
+};
+
+class TestBacklogManager : public CoreBacklogManager
+{
+public:
+    using CoreBacklogManager::searchResultLimit;
+};
+
+namespace {
+
+std::vector<QString> contents(const std::vector<Message>& messages)
+{
+    std::vector<QString> result;
+    for (auto&& msg : messages) {
+        result.push_back(msg.contents());
+    }
+    return result;
+}
+
+}  // namespace
+
+TEST(SqliteStorageTest, ftsMatchExpression)
+{
+    EXPECT_EQ(QString(), TestSqliteStorage::ftsMatchExpression("", " \t"));
+    EXPECT_EQ(QString(R"(message : "hello" AND message : "world")"), TestSqliteStorage::ftsMatchExpression("  hello \t world ", ""));
+    EXPECT_EQ(QString(R"(sender : "alice!*@*")"), TestSqliteStorage::ftsMatchExpression("", "alice!*@*"));
+
+    // FTS5 operators and special characters in the input are quoted, so they are matched literally
+    EXPECT_EQ(QString(R"(message : "say" AND message : """hi""" AND message : "a""b" AND sender : "bob")"),
+              TestSqliteStorage::ftsMatchExpression(R"(say "hi" a"b)", "bob"));
+    EXPECT_EQ(QString(R"(message : "foo*" AND message : "NEAR(a" AND message : "b)" AND message : "OR" AND message : "AND")"),
+              TestSqliteStorage::ftsMatchExpression("foo* NEAR(a b) OR AND", ""));
+    EXPECT_EQ(QString(R"(message : "-x" AND message : "^y" AND message : "col:z")"),
+              TestSqliteStorage::ftsMatchExpression("-x ^y col:z", ""));
+}
+
+TEST(SqliteStorageTest, searchResultLimit)
+{
+    EXPECT_EQ(1000, TestBacklogManager::searchResultLimit(-1));
+    EXPECT_EQ(1000, TestBacklogManager::searchResultLimit(0));
+    EXPECT_EQ(1, TestBacklogManager::searchResultLimit(1));
+    EXPECT_EQ(1000, TestBacklogManager::searchResultLimit(1000));
+    EXPECT_EQ(1000, TestBacklogManager::searchResultLimit(1001));
+}
+
+TEST(SqliteStorageTest, searchMsgs)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    TestSqliteStorage storage(dir.filePath("quassel-storage.sqlite"));
+    ASSERT_TRUE(storage.setup());
+
+    UserId user = storage.addUser("alice", "secret");
+    ASSERT_TRUE(user.isValid());
+    NetworkInfo info;
+    info.networkName = "Libera";
+    NetworkId networkId = storage.createNetwork(user, info);
+    ASSERT_TRUE(networkId.isValid());
+    BufferInfo channel = storage.bufferInfo(user, networkId, BufferInfo::ChannelBuffer, "#quassel");
+    BufferInfo query = storage.bufferInfo(user, networkId, BufferInfo::QueryBuffer, "bob");
+    ASSERT_TRUE(channel.bufferId().isValid());
+    ASSERT_TRUE(query.bufferId().isValid());
+
+    // Another user's messages never show up in the results
+    UserId otherUser = storage.addUser("mallory", "secret");
+    NetworkId otherNetworkId = storage.createNetwork(otherUser, info);
+    BufferInfo otherChannel = storage.bufferInfo(otherUser, otherNetworkId, BufferInfo::ChannelBuffer, "#quassel");
+
+    auto message = [](const BufferInfo& buffer, qint64 seconds, const QString& text, const QString& sender, Message::Type type) {
+        return Message(QDateTime::fromMSecsSinceEpoch(1600000000000 + seconds * 1000), buffer, type, text, sender);
+    };
+    MessageList messages{
+        message(channel, 1, "hello world", "bob!b@example.org", Message::Plain),
+        message(channel, 2, "hello there", "carol!c@example.org", Message::Plain),
+        message(channel, 3, "alpha beta", "bob!b@example.org", Message::Plain),
+        message(channel, 4, "this OR that, NEAR the end", "carol!c@example.org", Message::Plain),
+        message(query, 5, "hello from a query", "bob!b@example.org", Message::Plain),
+        message(channel, 6, "hello action", "bob!b@example.org", Message::Action),
+        message(otherChannel, 7, "hello mallory", "bob!b@example.org", Message::Plain),
+    };
+    ASSERT_TRUE(storage.logMessages(messages));
+
+    auto search = [&](const QString& text, const QString& sender = {}, BufferId bufferId = {}, MsgId last = -1, int limit = 1000) {
+        return contents(storage.searchMsgs(user, text, {}, bufferId, sender, Message::Types{}, {}, {}, last, limit));
+    };
+
+    // Newest results come first
+    EXPECT_EQ((std::vector<QString>{"hello action", "hello from a query", "hello there", "hello world"}), search("hello"));
+    EXPECT_EQ((std::vector<QString>{"hello world"}), search("world HELLO"));
+    EXPECT_EQ((std::vector<QString>{"hello action", "hello from a query", "hello world"}), search("hello", "bob"));
+    EXPECT_EQ((std::vector<QString>{"hello action", "alpha beta"}), search({}, "b@example.org", channel.bufferId(), -1, 2));
+    EXPECT_EQ((std::vector<QString>{"hello from a query"}), search("hello", {}, query.bufferId()));
+
+    // Pagination continues before the oldest result of the previous page
+    auto page = storage.searchMsgs(user, "hello", {}, {}, {}, Message::Types{}, {}, {}, -1, 2);
+    ASSERT_EQ(2u, page.size());
+    EXPECT_EQ((std::vector<QString>{"hello there", "hello world"}), search("hello", {}, {}, page.back().msgId()));
+
+    auto actions = storage.searchMsgs(user, "hello", {}, {}, {}, Message::Action, {}, {}, -1, 1000);
+    EXPECT_EQ((std::vector<QString>{"hello action"}), contents(actions));
+
+    // Operators are matched as words, and wildcards don't turn into prefix queries
+    EXPECT_EQ((std::vector<QString>{"this OR that, NEAR the end"}), search("or near"));
+    EXPECT_EQ((std::vector<QString>{"this OR that, NEAR the end"}), search("\"that\""));
+    EXPECT_TRUE(search("alp*").empty());
+    EXPECT_TRUE(search("hello", "NOT").empty());
+    EXPECT_TRUE(search("mallory").empty());
+    EXPECT_TRUE(search({}).empty());
+}
+
+TEST(SqliteStorageTest, setBufferStates)
+{
+    using Field = Storage::BufferState::Field;
+
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    TestSqliteStorage storage(dir.filePath("quassel-storage.sqlite"));
+    ASSERT_TRUE(storage.setup());
+
+    UserId user = storage.addUser("alice", "secret");
+    NetworkInfo info;
+    info.networkName = "Libera";
+    NetworkId networkId = storage.createNetwork(user, info);
+    BufferInfo channel = storage.bufferInfo(user, networkId, BufferInfo::ChannelBuffer, "#quassel");
+    ASSERT_TRUE(channel.bufferId().isValid());
+
+    MessageList messages;
+    for (int i = 0; i < 3; i++) {
+        messages << Message(QDateTime::fromMSecsSinceEpoch(1600000000000 + i * 1000), channel, Message::Plain, "hello", "bob!b@exa.org");
+    }
+    ASSERT_TRUE(storage.logMessages(messages));
+
+    Storage::BufferState state;
+    state.bufferId = channel.bufferId();
+    state.fields = Field::LastSeenMsg | Field::MarkerLineMsg | Field::Activity | Field::HighlightCount;
+    state.lastSeenMsg = messages[1].msgId();
+    state.markerLineMsg = messages[0].msgId();
+    state.activity = Message::Plain | Message::Action;
+    state.highlightCount = 2;
+    storage.setBufferStates(user, {state});
+
+    // Fields that didn't change are bound as NULL, and keep their value
+    Storage::BufferState highlights;
+    highlights.bufferId = channel.bufferId();
+    highlights.fields = Field::HighlightCount;
+    highlights.highlightCount = 5;
+    storage.setBufferStates(user, {highlights});
+
+    EXPECT_EQ(messages[1].msgId(), storage.bufferLastSeenMsgIds(user).value(channel.bufferId()));
+    EXPECT_EQ(messages[0].msgId(), storage.bufferMarkerLineMsgIds(user).value(channel.bufferId()));
+    EXPECT_EQ(Message::Types{Message::Plain | Message::Action}, storage.bufferActivities(user).value(channel.bufferId()));
+    EXPECT_EQ(5, storage.highlightCounts(user).value(channel.bufferId()));
+
+    // The last seen message can't be newer than the last message of the buffer
+    Storage::BufferState lastSeen;
+    lastSeen.bufferId = channel.bufferId();
+    lastSeen.fields = Field::LastSeenMsg;
+    lastSeen.lastSeenMsg = messages[2].msgId().toQint64() + 100;
+    storage.setBufferStates(user, {lastSeen});
+
+    EXPECT_EQ(messages[2].msgId(), storage.bufferLastSeenMsgIds(user).value(channel.bufferId()));
+    EXPECT_EQ(messages[0].msgId(), storage.bufferMarkerLineMsgIds(user).value(channel.bufferId()));
+    EXPECT_EQ(5, storage.highlightCounts(user).value(channel.bufferId()));
+}
@@ -0,0 +1,74 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "testglobal.h"
+#include "corebuffersyncer.h"
+
+TEST(UnreadTrackerTest, activityAndHighlights)
+{
+    UnreadTracker tracker(10);
+    tracker.addActivity(5, Message::Join);  // stored before tracking started
+    tracker.addActivity(11, Message::Plain);
+    tracker.addActivity(12, Message::Join);
+    tracker.addHighlight(12);
+    tracker.addActivity(13, Message::Plain);
+    tracker.addHighlight(13);
+
+    EXPECT_FALSE(tracker.covers(9));
+    EXPECT_TRUE(tracker.covers(10));
+    EXPECT_EQ(MsgId(13), tracker.newest());
+
+    EXPECT_EQ(int(Message::Plain | Message::Join), tracker.activity(10));
+    EXPECT_EQ(2, tracker.highlightCount(10));
+    EXPECT_EQ(int(Message::Plain | Message::Join), tracker.activity(11));
+    EXPECT_EQ(int(Message::Plain), tracker.activity(12));
+    EXPECT_EQ(1, tracker.highlightCount(12));
+    EXPECT_EQ(0, tracker.activity(13));
+    EXPECT_EQ(0, tracker.highlightCount(13));
+
+    tracker.setLastSeen(12);
+    EXPECT_FALSE(tracker.covers(11));
+    EXPECT_EQ(int(Message::Plain), tracker.activity(12));
+    EXPECT_EQ(1, tracker.highlightCount(12));
+
+    // Moving backwards doesn't bring anything back
+    tracker.setLastSeen(11);
+    EXPECT_EQ(MsgId(12), tracker.since());
+}
+
+TEST(UnreadTrackerTest, limitsHighlights)
+{
+    UnreadTracker tracker({}, 3);
+    for (int i = 1; i <= 5; i++) {
+        tracker.addActivity(i, Message::Plain);
+        tracker.addHighlight(i);
+    }
+
+    // The two oldest highlights had to go, so results before them are no longer available
+    EXPECT_EQ(MsgId(2), tracker.since());
+    EXPECT_FALSE(tracker.covers(1));
+    EXPECT_EQ(3, tracker.highlightCount(2));
+    EXPECT_EQ(1, tracker.highlightCount(4));
+
+    // Out of order and duplicate highlights are counted once
+    tracker.addHighlight(3);
+    tracker.addHighlight(6);
+    EXPECT_EQ(3, tracker.highlightCount(3));
+}
@@ -0,0 +1,128 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "benchclient.h"
+
+#include <QDataStream>
+#include <QHostAddress>
+#include <QSslSocket>
+#include <QtEndian>
+
+#include "compressor.h"
+#include "peerfactory.h"
+#include "remotepeer.h"
+#include "signalproxy.h"
+
+BenchClient::BenchClient(SignalProxy* proxy, bool useCompression, QObject* parent)
+    : AuthHandler(parent)
+    , _proxy(proxy)
+    , _useCompression(useCompression)
+{}
+
+void BenchClient::connectToCore(quint16 port, const QString& user, const QString& password)
+{
+    _user = user;
+    _password = password;
+
+    auto* socket = new QSslSocket(this);
+    setSocket(socket);
+    connect(socket, &QAbstractSocket::connected, this, &BenchClient::onConnected);
+    connect(socket, &QIODevice::readyRead, this, &BenchClient::onReadyRead);
+    connect(this, &AuthHandler::socketError, this, [this](QAbstractSocket::SocketError, const QString& errorString) {
+        emit failed(errorString);
+    });
+    socket->connectToHost(QHostAddress::LocalHost, port);
+}
+
+void BenchClient::onConnected()
+{
+    // Probe for the DataStream protocol; we don't bother with legacy cores
+    QDataStream stream(socket());
+    stream.setVersion(QDataStream::Qt_4_2);
+
+    quint32 magic = Protocol::magic;
+    if (_useCompression) {
+        magic |= Protocol::Compression;
+        if (Compressor::isAvailable(Compressor::Zstd))
+            magic |= Protocol::ZstdCompression | Protocol::ZstdDictionary;
+    }
+    stream << magic << static_cast<quint32>(Protocol::DataStreamProtocol | 0x80000000);
+    socket()->flush();
+}
+
+void BenchClient::onReadyRead()
+{
+    if (_peer || socket()->bytesAvailable() < 4)
+        return;
+
+    disconnect(socket(), &QIODevice::readyRead, this, &BenchClient::onReadyRead);
+
+    quint32 reply;
+    socket()->read((char*)&reply, 4);
+    reply = qFromBigEndian<quint32>(reply);
+
+    auto type = static_cast<Protocol::Type>(reply & 0xff);
+    auto protoFeatures = static_cast<quint16>(reply >> 8 & 0xffff);
+    auto connectionFeatures = static_cast<quint8>(reply >> 24);
+
+    Compressor::CompressionLevel level = connectionFeatures & Protocol::Compression ? Compressor::BestCompression : Compressor::NoCompression;
+    Compressor::Algorithm algorithm = Compressor::Deflate;
+    if (connectionFeatures & Protocol::ZstdDictionary)
+        algorithm = Compressor::ZstdWithDictionary;
+    else if (connectionFeatures & Protocol::ZstdCompression)
+        algorithm = Compressor::Zstd;
+
+    _peer = PeerFactory::createPeer(PeerFactory::ProtoDescriptor(type, protoFeatures), this, socket(), level, algorithm, this);
+    if (!_peer || _peer->protocol() != Protocol::DataStreamProtocol) {
+        emit failed(tr("The core doesn't speak the DataStream protocol"));
+        return;
+    }
+
+    _peer->dispatch(Protocol::RegisterClient(Quassel::Features{}, "Quassel load test", Quassel::buildInfo().commitDate));
+}
+
+void BenchClient::handle(const Protocol::ClientDenied& msg)
+{
+    emit failed(msg.errorString);
+}
+
+void BenchClient::handle(const Protocol::ClientRegistered& msg)
+{
+    if (!msg.coreConfigured) {
+        emit failed(tr("The core hasn't been configured"));
+        return;
+    }
+    _peer->setFeatures(msg.features);
+    _peer->dispatch(Protocol::Login(_user, _password));
+}
+
+void BenchClient::handle(const Protocol::LoginFailed& msg)
+{
+    emit failed(tr("Login failed: %1").arg(msg.errorString));
+}
+
+void BenchClient::handle(const Protocol::LoginSuccess&) {}
+
+void BenchClient::handle(const Protocol::SessionState& msg)
+{
+    // From here on, everything is handled by the SignalProxy
+    _proxy->addPeer(_peer);
+    emit sessionReady(msg);
+}
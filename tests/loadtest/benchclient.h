@@ -0,0 +1,70 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QString>
+
+#include "authhandler.h"
+#include "protocol.h"
+
+class RemotePeer;
+class SignalProxy;
+
+/**
+ * A minimal client for load testing the core
+ *
+ * Goes through the handshake and login like the real client does, and then hands its peer over to
+ * the given SignalProxy.  Unlike the real client, it doesn't synchronize any objects; it only
+ * receives the messages and RPC calls the core sends to every client anyway.
+ */
+class BenchClient : public AuthHandler
+{
+    Q_OBJECT
+
+public:
+    BenchClient(SignalProxy* proxy, bool useCompression, QObject* parent = nullptr);
+
+    void connectToCore(quint16 port, const QString& user, const QString& password);
+
+    RemotePeer* peer() const { return _peer; }
+
+    using AuthHandler::handle;
+    void handle(const Protocol::ClientDenied& msg) override;
+    void handle(const Protocol::ClientRegistered& msg) override;
+    void handle(const Protocol::LoginFailed& msg) override;
+    void handle(const Protocol::LoginSuccess& msg) override;
+    void handle(const Protocol::SessionState& msg) override;
+
+signals:
+    void sessionReady(const Protocol::SessionState& sessionState);
+    void failed(const QString& errorString);
+
+private slots:
+    void onConnected();
+    void onReadyRead();
+
+private:
+    SignalProxy* _proxy;
+    bool _useCompression;
+    RemotePeer* _peer{nullptr};
+    QString _user;
+    QString _password;
+};
@@ -0,0 +1,299 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "fakeircd.h"
+
+#include <algorithm>
+
+#include <QFile>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+namespace {
+
+const QByteArray serverPrefix = ":irc.bench";
+const QLatin1String probeMarker{"loadtest "};
+
+// Don't queue up more than this on our side, so the line rate reflects what the core actually reads
+const qint64 maxPendingBytes = 256 * 1024;
+const int maxLinesPerTick = 2000;
+const int tickInterval = 5;
+
+// How long split users stay away
+const qint64 netsplitDuration = 3000;
+
+}  // namespace
+
+FakeIrcd::FakeIrcd(const Config& config, const QElapsedTimer& clock, QObject* parent)
+    : QObject(parent)
+    , _config(config)
+    , _clock(clock)
+{}
+
+QString FakeIrcd::channelName(int index)
+{
+    return QString("#bench%1").arg(index);
+}
+
+qint64 FakeIrcd::probeTimestamp(const QString& contents)
+{
+    if (!contents.startsWith(probeMarker))
+        return -1;
+
+    bool ok;
+    qint64 timestamp = contents.section(' ', 1, 1).toLongLong(&ok);
+    return ok ? timestamp : -1;
+}
+
+void FakeIrcd::listen()
+{
+    // Created here rather than in the constructor, so they live in the server's thread
+    _server = new QTcpServer(this);
+    connect(_server, &QTcpServer::newConnection, this, &FakeIrcd::onNewConnection);
+    _trafficTimer = new QTimer(this);
+    _trafficTimer->setInterval(tickInterval);
+    connect(_trafficTimer, &QTimer::timeout, this, &FakeIrcd::sendTraffic);
+
+    if (!_config.scriptFile.isEmpty()) {
+        QFile file(_config.scriptFile);
+        if (!file.open(QIODevice::ReadOnly)) {
+            emit error(tr("Could not open %1: %2").arg(_config.scriptFile, file.errorString()));
+            return;
+        }
+        while (!file.atEnd()) {
+            QByteArray line = file.readLine().trimmed();
+            if (!line.isEmpty() && !line.startsWith('#'))
+                _script.push_back(line);
+        }
+        if (_script.empty()) {
+            emit error(tr("%1 doesn't contain any IRC lines").arg(_config.scriptFile));
+            return;
+        }
+    }
+
+    if (!_server->listen(QHostAddress::LocalHost)) {
+        emit error(tr("Could not start the IRC server: %1").arg(_server->errorString()));
+        return;
+    }
+    _port = _server->serverPort();
+    emit listening(_port);
+}
+
+void FakeIrcd::startTraffic()
+{
+    _trafficTime.start();
+    _nextNetsplit = _config.netsplitInterval * 1000;
+    _trafficTimer->start();
+}
+
+void FakeIrcd::stopTraffic()
+{
+    _trafficTimer->stop();
+}
+
+void FakeIrcd::onNewConnection()
+{
+    while (_server->hasPendingConnections()) {
+        QTcpSocket* socket = _server->nextPendingConnection();
+        if (_socket) {
+            // We only ever expect the core under test
+            socket->abort();
+            socket->deleteLater();
+            continue;
+        }
+        _socket = socket;
+        connect(_socket, &QIODevice::readyRead, this, &FakeIrcd::onReadyRead);
+        connect(_socket, &QAbstractSocket::disconnected, this, &FakeIrcd::onDisconnected);
+    }
+}
+
+void FakeIrcd::onReadyRead()
+{
+    while (_socket && _socket->canReadLine()) {
+        handleLine(_socket->readLine().trimmed());
+    }
+}
+
+void FakeIrcd::onDisconnected()
+{
+    _trafficTimer->stop();
+    _socket->deleteLater();
+    _socket = nullptr;
+    _joinedChannels.clear();
+    emit error(tr("The core closed its IRC connection"));
+}
+
+void FakeIrcd::handleLine(const QByteArray& line)
+{
+    QList<QByteArray> params = line.split(' ');
+    QByteArray command = params.takeFirst().toUpper();
+    for (auto&& param : params) {
+        if (param.startsWith(':'))
+            param.remove(0, 1);
+    }
+
+    if (command == "CAP") {
+        if (params.value(0) == "LS")
+            sendLine(serverPrefix + " CAP * LS :");
+    }
+    else if (command == "NICK") {
+        _nick = params.value(0);
+    }
+    else if (command == "USER") {
+        _prefix = _nick + "!" + params.value(0) + "@127.0.0.1";
+        sendLine(serverPrefix + " 001 " + _nick + " :Welcome to the load test network " + _prefix);
+        sendLine(serverPrefix + " 005 " + _nick
+                 + " CHANTYPES=# PREFIX=(ov)@+ CHANMODES=b,k,l,imnst NETWORK=Bench CASEMAPPING=rfc1459 :are supported by this server");
+        sendLine(serverPrefix + " 376 " + _nick + " :End of /MOTD command.");
+    }
+    else if (command == "PING") {
+        sendLine(serverPrefix + " PONG irc.bench :" + params.value(0));
+    }
+    else if (command == "JOIN") {
+        for (auto&& channel : params.value(0).split(',')) {
+            joinChannel(channel);
+        }
+    }
+    else if (command == "WHO") {
+        sendLine(serverPrefix + " 315 " + _nick + " " + params.value(0) + " :End of /WHO list.");
+    }
+    else if (command == "QUIT") {
+        _socket->disconnectFromHost();
+    }
+}
+
+void FakeIrcd::sendLine(const QByteArray& line)
+{
+    if (_socket)
+        _socket->write(line + "\r\n");
+}
+
+void FakeIrcd::joinChannel(const QByteArray& channel)
+{
+    if (channel.isEmpty() || _joinedChannels.contains(channel))
+        return;
+    _joinedChannels << channel;
+
+    sendLine(":" + _prefix + " JOIN " + channel);
+
+    // Channels not generated by us (e.g. from a script) stay empty
+    bool ok;
+    int index = channel.mid(6).toInt(&ok);
+    QByteArray names = "@" + _nick;
+    for (int user = index; ok && channel.startsWith("#bench") && user < _config.users; user += _config.channels) {
+        names += " user" + QByteArray::number(user);
+        if (names.size() > 400) {
+            sendLine(serverPrefix + " 353 " + _nick + " = " + channel + " :" + names);
+            names.clear();
+        }
+    }
+    if (!names.isEmpty())
+        sendLine(serverPrefix + " 353 " + _nick + " = " + channel + " :" + names);
+    sendLine(serverPrefix + " 366 " + _nick + " " + channel + " :End of /NAMES list.");
+
+    if (_joinedChannels.count() == _config.channels)
+        emit channelsJoined();
+}
+
+QByteArray FakeIrcd::userPrefix(int user) const
+{
+    QByteArray number = QByteArray::number(user);
+    return "user" + number + "!~u" + number + "@host" + QByteArray::number(user % 97) + ".bench";
+}
+
+QByteArray FakeIrcd::probe(int user, const QByteArray& channel)
+{
+    _probesSent++;
+    return ":" + userPrefix(user) + " PRIVMSG " + channel + " :" + QByteArray(probeMarker.data(), probeMarker.size())
+           + QByteArray::number(_clock.nsecsElapsed()) + " message " + QByteArray::number(_step) + "\r\n";
+}
+
+void FakeIrcd::nextSyntheticLines(QByteArray& out, int& lines)
+{
+    // Netsplit: a third of the users drops off at once, and comes back a few seconds later
+    if (_config.netsplitInterval > 0 && _trafficTime.elapsed() >= _nextNetsplit) {
+        _split = !_split;
+        for (int user = 0; user < _config.users; user += 3) {
+            if (_split)
+                out += ":" + userPrefix(user) + " QUIT :irc1.bench irc2.bench\r\n";
+            else
+                out += ":" + userPrefix(user) + " JOIN " + channelName(user % _config.channels).toLatin1() + "\r\n";
+            lines++;
+        }
+        _nextNetsplit += _split ? netsplitDuration : std::max<qint64>(_config.netsplitInterval * 1000 - netsplitDuration, 1000);
+        return;
+    }
+
+    quint64 step = _step++;
+    int user = static_cast<int>(step * 7919 % _config.users);
+    if (_split && user % 3 == 0)
+        user = (user + 1) % _config.users;
+    QByteArray channel = channelName(user % _config.channels).toLatin1();
+
+    if (step % 20 == 10) {
+        // Some churn in between the chatter
+        out += ":" + userPrefix(user) + " PART " + channel + " :Leaving\r\n";
+        out += ":" + userPrefix(user) + " JOIN " + channel + "\r\n";
+        lines += 2;
+    }
+    else {
+        out += probe(user, channel);
+        lines++;
+    }
+}
+
+void FakeIrcd::nextScriptLines(QByteArray& out, int& lines)
+{
+    out += QByteArray(_script[_scriptPos]).replace("$me", _nick) + "\r\n";
+    lines++;
+    _scriptPos = (_scriptPos + 1) % _script.size();
+
+    // Interleave probes, so latency can be measured with replayed traffic as well
+    if (++_step % 50 == 0) {
+        out += probe(static_cast<int>(_step % _config.users), channelName(0).toLatin1());
+        lines++;
+    }
+}
+
+void FakeIrcd::sendTraffic()
+{
+    if (!_socket)
+        return;
+
+    qint64 budget = maxLinesPerTick;
+    if (_config.rate > 0) {
+        qint64 due = _trafficTime.elapsed() * _config.rate / 1000 - static_cast<qint64>(_linesSent.load());
+        budget = std::min(budget, due);
+    }
+
+    QByteArray out;
+    int lines = 0;
+    while (lines < budget && _socket->bytesToWrite() + out.size() < maxPendingBytes) {
+        if (_script.empty())
+            nextSyntheticLines(out, lines);
+        else
+            nextScriptLines(out, lines);
+    }
+    if (!out.isEmpty()) {
+        _socket->write(out);
+        _linesSent += lines;
+    }
+}
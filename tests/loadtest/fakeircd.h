@@ -0,0 +1,136 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QStringList>
+
+class QTcpServer;
+class QTcpSocket;
+class QTimer;
+
+/**
+ * A scripted IRC server for load testing the core
+ *
+ * Accepts the core's connection, registers it, answers its JOINs with a populated channel and then
+ * plays the configured traffic: either a synthetic mix of PRIVMSG floods, JOIN/PART churn and
+ * periodic netsplits, or a captured session replayed from a file.  Every PRIVMSG generated by the
+ * server itself carries the time it was sent (see probeTimestamp()), so clients can measure the
+ * end-to-end latency through the core.
+ *
+ * The server is meant to run in its own thread; all methods except the statistics getters must be
+ * called from that thread.
+ */
+class FakeIrcd : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Config
+    {
+        int channels{10};          ///< Number of channels the core is expected to join, #bench0 to #benchN
+        int users{500};            ///< Number of fake users spread over the channels
+        int rate{0};               ///< Lines per second to send, or 0 for as fast as the core reads them
+        int netsplitInterval{20};  ///< Seconds between netsplits, or 0 to disable them
+        QString scriptFile;        ///< Captured traffic to replay instead of the synthetic mix
+    };
+
+    /**
+     * Constructor
+     *
+     * @param config Traffic to generate
+     * @param clock  Reference clock for the probe timestamps, must have been started
+     */
+    FakeIrcd(const Config& config, const QElapsedTimer& clock, QObject* parent = nullptr);
+
+    /**
+     * Gets the name of one of the channels the core is supposed to join
+     */
+    static QString channelName(int index);
+
+    /**
+     * Extracts the send time from a message generated by the server
+     *
+     * @param contents Message contents as received by a client
+     * @return Send time in nanoseconds on the server's reference clock, or -1 if this isn't a probe
+     */
+    static qint64 probeTimestamp(const QString& contents);
+
+    quint16 port() const { return _port.load(); }
+    quint64 linesSent() const { return _linesSent.load(); }
+    quint64 probesSent() const { return _probesSent.load(); }
+
+public slots:
+    /**
+     * Starts listening on a random local port, see port()
+     */
+    void listen();
+
+    void startTraffic();
+    void stopTraffic();
+
+signals:
+    void listening(quint16 port);
+    void channelsJoined();
+    void error(const QString& message);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+    void sendTraffic();
+
+private:
+    void handleLine(const QByteArray& line);
+    void sendLine(const QByteArray& line);
+    void joinChannel(const QByteArray& channel);
+
+    QByteArray userPrefix(int user) const;
+    QByteArray probe(int user, const QByteArray& channel);
+    void nextSyntheticLines(QByteArray& out, int& lines);
+    void nextScriptLines(QByteArray& out, int& lines);
+
+    Config _config;
+    const QElapsedTimer& _clock;
+    QTcpServer* _server{nullptr};
+    QTcpSocket* _socket{nullptr};
+    QTimer* _trafficTimer{nullptr};
+
+    QByteArray _nick;
+    QByteArray _prefix;  ///< The core's nick!user@host
+    QList<QByteArray> _joinedChannels;
+
+    QElapsedTimer _trafficTime;
+    quint64 _step{0};
+    std::vector<QByteArray> _script;
+    size_t _scriptPos{0};
+    bool _split{false};
+    qint64 _nextNetsplit{0};
+
+    std::atomic<quint16> _port{0};
+    std::atomic<quint64> _linesSent{0};
+    std::atomic<quint64> _probesSent{0};
+};
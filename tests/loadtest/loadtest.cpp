@@ -0,0 +1,490 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+// Load generation harness for the core
+//
+// Starts a quasselcore with a fresh database, connects it to a scripted IRC server (see FakeIrcd) and
+// a number of simulated clients (see BenchClient), plays IRC traffic for a while and reports:
+//  - the rate of IRC lines the core consumed,
+//  - the rate of messages delivered to the clients, and their end-to-end latency,
+//  - the rate of messages written to the database, as reported by the core's metrics, and
+//  - the core's memory usage.
+//
+// Run with --help for the available options.  For an in-memory database, point --configdir to a tmpfs.
+// PostgreSQL can be used with --backend PostgreSQL, configured through the DB_PGSQL_* environment
+// variables as described for quasselcore's --config-from-environment.
+
+#include <algorithm>
+#include <vector>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QProcess>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+
+#include "benchclient.h"
+#include "fakeircd.h"
+#include "identity.h"
+#include "message.h"
+#include "network.h"
+#include "quassel.h"
+#include "remotepeer.h"
+#include "signalproxy.h"
+#include "util.h"
+
+#ifndef QUASSELCORE_PATH
+#    define QUASSELCORE_PATH "quasselcore"
+#endif
+
+namespace {
+
+const QString coreUser{"bench"};
+const QString corePassword{"bench"};
+const int coreStartupTimeout = 30000;
+
+bool verbose = false;
+
+void messageHandler(QtMsgType type, const QMessageLogContext&, const QString& msg)
+{
+    // The clients don't synchronize any objects, so the SignalProxy complains about every sync call
+    if (type == QtDebugMsg || (type == QtWarningMsg && !verbose))
+        return;
+    QTextStream(stderr) << msg << endl;
+}
+
+quint16 freePort()
+{
+    QTcpServer server;
+    server.listen(QHostAddress::LocalHost);
+    return server.serverPort();
+}
+
+}  // namespace
+
+class LoadTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options
+    {
+        QString corePath;
+        QString backend;
+        QString configDir;
+        int clients;
+        int duration;
+        int maxCommitLatency;
+        bool compression;
+        FakeIrcd::Config ircd;
+    };
+
+    LoadTest(const Options& options, QObject* parent = nullptr)
+        : QObject(parent)
+        , _options(options)
+        , _proxy(SignalProxy::Server)
+    {
+        _clock.start();
+
+        _proxy.attachSlot(SIGNAL(displayMsg(Message)), this, &LoadTest::onDisplayMsg);
+        _proxy.attachSlot(SIGNAL(identityCreated(Identity)), this, &LoadTest::onIdentityCreated);
+        _proxy.attachSlot(SIGNAL(networkCreated(NetworkId)), this, &LoadTest::onNetworkCreated);
+
+        connect(&_core, selectOverload<int, QProcess::ExitStatus>(&QProcess::finished), this, &LoadTest::onCoreFinished);
+        connect(&_rssTimer, &QTimer::timeout, this, &LoadTest::sampleRss);
+        _rssTimer.setInterval(1000);
+    }
+
+    ~LoadTest() override
+    {
+        stopCore();
+        _ircdThread.quit();
+        _ircdThread.wait();
+    }
+
+    int exitCode() const { return _exitCode; }
+
+public slots:
+    void start()
+    {
+        if (_options.configDir.isEmpty()) {
+            if (!_tempDir.isValid()) {
+                fail(tr("Could not create a temporary directory"));
+                return;
+            }
+            _options.configDir = _tempDir.path();
+        }
+
+        if (!createUser())
+            return;
+
+        _ircd = new FakeIrcd(_options.ircd, _clock);
+        _ircd->moveToThread(&_ircdThread);
+        connect(&_ircdThread, &QThread::finished, _ircd, &QObject::deleteLater);
+        connect(_ircd, &FakeIrcd::listening, this, &LoadTest::startCore);
+        connect(_ircd, &FakeIrcd::channelsJoined, this, &LoadTest::startTraffic);
+        connect(_ircd, &FakeIrcd::error, this, &LoadTest::fail);
+        _ircdThread.start();
+        QMetaObject::invokeMethod(_ircd, "listen", Qt::QueuedConnection);
+    }
+
+private slots:
+    void startCore(quint16 ircPort)
+    {
+        _ircPort = ircPort;
+        _corePort = freePort();
+        _metricsPort = freePort();
+
+        QStringList arguments = coreArguments();
+        arguments << "--listen" << "127.0.0.1" << "--port" << QString::number(_corePort) << "--metrics-daemon" << "--metrics-listen"
+                  << "127.0.0.1" << "--metrics-port" << QString::number(_metricsPort);
+        if (_options.maxCommitLatency >= 0)
+            arguments << "--max-commit-latency" << QString::number(_options.maxCommitLatency);
+
+        _core.start(_options.corePath, arguments);
+        _startupTime.start();
+        connectClients();
+    }
+
+    void connectClients()
+    {
+        // Wait until the core accepts connections
+        QTcpSocket probe;
+        probe.connectToHost(QHostAddress::LocalHost, _corePort);
+        if (!probe.waitForConnected(200)) {
+            if (_startupTime.elapsed() > coreStartupTimeout)
+                fail(tr("The core didn't start listening within %1 seconds").arg(coreStartupTimeout / 1000));
+            else
+                QTimer::singleShot(200, this, &LoadTest::connectClients);
+            return;
+        }
+        probe.disconnectFromHost();
+
+        for (int i = 0; i < _options.clients; i++) {
+            auto* client = new BenchClient(&_proxy, _options.compression, this);
+            connect(client, &BenchClient::sessionReady, this, &LoadTest::onSessionReady);
+            connect(client, &BenchClient::failed, this, &LoadTest::fail);
+            client->connectToCore(_corePort, coreUser, corePassword);
+            _clients << client;
+        }
+    }
+
+    void onSessionReady(const Protocol::SessionState& sessionState)
+    {
+        if (++_readyClients < _clients.count())
+            return;
+
+        if (!sessionState.networkIds.isEmpty()) {
+            fail(tr("The core already has networks configured, please use an empty configuration directory"));
+            return;
+        }
+
+        Identity identity;
+        identity.setToDefaults();
+        identity.setIdentityName("Load test");
+        identity.setNicks({"bench"});
+        _clients.first()->peer()->dispatch(
+            Protocol::RpcCall("2createIdentity(Identity,QVariantMap)", {QVariant::fromValue(identity), QVariantMap()}));
+    }
+
+    void onIdentityCreated(const Identity& identity)
+    {
+        // Every client is told about it
+        if (_identityId.isValid())
+            return;
+        _identityId = identity.id();
+
+        NetworkInfo info;
+        info.networkName = "Bench";
+        info.identity = _identityId;
+        info.serverList << Network::Server("127.0.0.1", _ircPort, QString(), false, false);
+        info.useCustomMessageRate = true;
+        info.unlimitedMessageRate = true;
+        info.useAutoReconnect = false;
+
+        QStringList channels;
+        for (int i = 0; i < _options.ircd.channels; i++) {
+            channels << FakeIrcd::channelName(i);
+        }
+        _clients.first()->peer()->dispatch(
+            Protocol::RpcCall("2createNetwork(NetworkInfo,QStringList)", {QVariant::fromValue(info), channels}));
+    }
+
+    void onNetworkCreated(NetworkId networkId)
+    {
+        if (_networkId.isValid())
+            return;
+        _networkId = networkId;
+
+        _clients.first()->peer()->dispatch(Protocol::SyncMessage("Network", QString::number(networkId.toInt()), "requestConnect", {}));
+    }
+
+    void startTraffic()
+    {
+        _committedAtStart = committedMessages();
+        _measuring = true;
+        _trafficTime.start();
+        QMetaObject::invokeMethod(_ircd, "startTraffic", Qt::QueuedConnection);
+        _rssTimer.start();
+        QTimer::singleShot(_options.duration * 1000, this, &LoadTest::finish);
+    }
+
+    void onDisplayMsg(const Message& msg)
+    {
+        if (!_measuring)
+            return;
+
+        _delivered++;
+        qint64 sent = FakeIrcd::probeTimestamp(msg.contents());
+        if (sent >= 0)
+            _latencies.push_back((_clock.nsecsElapsed() - sent) / 1000);
+    }
+
+    void sampleRss()
+    {
+        QFile status(QString("/proc/%1/status").arg(_core.processId()));
+        if (!status.open(QIODevice::ReadOnly))
+            return;
+        for (auto&& line : status.readAll().split('\n')) {
+            if (line.startsWith("VmRSS:"))
+                _rss = line.mid(6).trimmed().split(' ').value(0).toLongLong();
+            else if (line.startsWith("VmHWM:"))
+                _peakRss = line.mid(6).trimmed().split(' ').value(0).toLongLong();
+        }
+    }
+
+    void finish()
+    {
+        if (!_measuring)
+            return;
+        _measuring = false;
+        double seconds = _trafficTime.nsecsElapsed() / 1e9;
+        QMetaObject::invokeMethod(_ircd, "stopTraffic", Qt::QueuedConnection);
+        sampleRss();
+        qint64 committed = committedMessages();
+
+        QTextStream out(stdout);
+        out << "Duration:            " << QString::number(seconds, 'f', 1) << " s, " << _clients.count() << " clients" << endl;
+        out << "IRC lines:           " << _ircd->linesSent() << " (" << qRound64(_ircd->linesSent() / seconds) << " lines/s)" << endl;
+        out << "Messages delivered:  " << _delivered << " (" << qRound64(_delivered / seconds) << " msgs/s, "
+            << qRound64(_delivered / seconds / _clients.count()) << " msgs/s per client)" << endl;
+        if (_latencies.empty()) {
+            out << "Latency:             no probes received" << endl;
+        }
+        else {
+            std::sort(_latencies.begin(), _latencies.end());
+            auto percentile = [this](int p) {
+                return QString::number(_latencies[std::min(_latencies.size() - 1, _latencies.size() * p / 100)] / 1000.0, 'f', 2);
+            };
+            out << "Latency (ms):        p50 " << percentile(50) << ", p90 " << percentile(90) << ", p99 " << percentile(99) << ", max "
+                << QString::number(_latencies.back() / 1000.0, 'f', 2) << " (" << _latencies.size() << " of "
+                << _ircd->probesSent() * _clients.count() << " probes)" << endl;
+        }
+        if (committed >= 0 && _committedAtStart >= 0)
+            out << "DB writes:           " << committed - _committedAtStart << " (" << qRound64((committed - _committedAtStart) / seconds)
+                << " msgs/s)" << endl;
+        else
+            out << "DB writes:           unknown, core metrics not available" << endl;
+        if (_rss >= 0)
+            out << "Core RSS:            " << _rss / 1024 << " MiB (peak " << _peakRss / 1024 << " MiB)" << endl;
+        else
+            out << "Core RSS:            unknown" << endl;
+
+        _exitCode = _latencies.empty() ? EXIT_FAILURE : EXIT_SUCCESS;
+        stopCore();
+        QCoreApplication::exit(_exitCode);
+    }
+
+    void onCoreFinished(int exitCode, QProcess::ExitStatus)
+    {
+        if (!_stopping)
+            fail(tr("The core exited unexpectedly with exit code %1").arg(exitCode));
+    }
+
+    void fail(const QString& errorString)
+    {
+        if (_exitCode != EXIT_SUCCESS)
+            return;  // Already failed
+        qCritical() << qPrintable(errorString);
+        _exitCode = EXIT_FAILURE;
+        _measuring = false;
+        stopCore();
+        QCoreApplication::exit(_exitCode);
+    }
+
+private:
+    QStringList coreArguments() const
+    {
+        QStringList arguments{"--configdir", _options.configDir, "--config-from-environment"};
+        if (!verbose)
+            arguments << "--loglevel" << "Warning";
+        return arguments;
+    }
+
+    QProcessEnvironment coreEnvironment() const
+    {
+        QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+        environment.insert("DB_BACKEND", _options.backend);
+        environment.insert("AUTH_AUTHENTICATOR", "Database");
+        return environment;
+    }
+
+    bool createUser()
+    {
+        QProcess process;
+        process.setProcessEnvironment(coreEnvironment());
+        process.setProcessChannelMode(verbose ? QProcess::ForwardedChannels : QProcess::MergedChannels);
+        process.start(_options.corePath, coreArguments() << "--add-user");
+        process.write(QString("%1\n%2\n%2\n").arg(coreUser, corePassword).toUtf8());
+        process.closeWriteChannel();
+        if (!process.waitForFinished(coreStartupTimeout) || process.exitStatus() != QProcess::NormalExit) {
+            fail(tr("Could not run %1: %2").arg(_options.corePath, process.errorString()));
+            return false;
+        }
+        // The user may exist already if the configuration directory is reused
+        if (process.exitCode() != EXIT_SUCCESS)
+            qWarning() << "Could not add the core user, trying to log in anyway";
+
+        _core.setProcessEnvironment(coreEnvironment());
+        if (verbose)
+            _core.setProcessChannelMode(QProcess::ForwardedChannels);
+        else
+            _core.setStandardOutputFile(QProcess::nullDevice());
+        return true;
+    }
+
+    void stopCore()
+    {
+        _stopping = true;
+        _rssTimer.stop();
+        if (_core.state() == QProcess::NotRunning)
+            return;
+        _core.terminate();
+        if (!_core.waitForFinished(10000))
+            _core.kill();
+    }
+
+    // Reads the number of messages written to the database so far from the core's metrics
+    qint64 committedMessages()
+    {
+        QTcpSocket socket;
+        socket.connectToHost(QHostAddress::LocalHost, _metricsPort);
+        if (!socket.waitForConnected(2000))
+            return -1;
+        socket.write("GET /metrics HTTP/1.0\r\n\r\n");
+        QByteArray response;
+        while (socket.waitForReadyRead(2000)) {
+            response += socket.readAll();
+        }
+        for (auto&& line : response.split('\n')) {
+            if (line.startsWith("quassel_storage_committed_messages "))
+                return line.split(' ').value(1).toLongLong();
+        }
+        return -1;
+    }
+
+    Options _options;
+    QTemporaryDir _tempDir;
+    QElapsedTimer _clock;
+    QElapsedTimer _startupTime;
+    QElapsedTimer _trafficTime;
+
+    QProcess _core;
+    quint16 _corePort{0};
+    quint16 _metricsPort{0};
+    bool _stopping{false};
+
+    QThread _ircdThread;
+    FakeIrcd* _ircd{nullptr};
+    quint16 _ircPort{0};
+
+    SignalProxy _proxy;
+    QList<BenchClient*> _clients;
+    int _readyClients{0};
+    IdentityId _identityId;
+    NetworkId _networkId;
+
+    bool _measuring{false};
+    quint64 _delivered{0};
+    std::vector<qint64> _latencies;  ///< In microseconds
+    qint64 _committedAtStart{-1};
+    QTimer _rssTimer;
+    qint64 _rss{-1};      ///< In KiB
+    qint64 _peakRss{-1};  ///< In KiB
+
+    int _exitCode{EXIT_SUCCESS};
+};
+
+int main(int argc, char** argv)
+{
+    Quassel::setupBuildInfo();
+    QCoreApplication app(argc, argv);
+    Quassel::registerMetaTypes();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Generates IRC and client load for a quasselcore and reports its throughput.");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"core", "Path of the quasselcore binary to test.", "path", QUASSELCORE_PATH},
+        {"backend", "Storage backend to use, SQLite or PostgreSQL.", "backend", "SQLite"},
+        {"configdir", "Configuration directory for the core; must not contain any networks. Defaults to a temporary directory.", "path"},
+        {"clients", "Number of simulated clients.", "count", "4"},
+        {"duration", "Seconds to generate traffic for.", "seconds", "30"},
+        {"channels", "Number of channels the core joins.", "count", "10"},
+        {"users", "Number of other users in the channels.", "count", "500"},
+        {"rate", "IRC lines per second to send, or 0 to send as fast as the core reads them.", "lines", "0"},
+        {"netsplit-interval", "Seconds between netsplits, or 0 to disable them.", "seconds", "20"},
+        {"script", "Replay the IRC lines from this file instead of the synthetic traffic. $me is replaced with the core's nick.", "file"},
+        {"max-commit-latency", "Passed on to the core.", "milliseconds", "-1"},
+        {"compression", "Enable compression for the client connections."},
+        {"verbose", "Show the output of the core and all warnings."},
+    });
+    parser.process(app);
+
+    verbose = parser.isSet("verbose");
+    qInstallMessageHandler(messageHandler);
+
+    LoadTest::Options options;
+    options.corePath = parser.value("core");
+    options.backend = parser.value("backend");
+    options.configDir = parser.value("configdir");
+    options.clients = std::max(parser.value("clients").toInt(), 1);
+    options.duration = std::max(parser.value("duration").toInt(), 1);
+    options.maxCommitLatency = parser.value("max-commit-latency").toInt();
+    options.compression = parser.isSet("compression");
+    options.ircd.channels = std::max(parser.value("channels").toInt(), 1);
+    options.ircd.users = std::max(parser.value("users").toInt(), 1);
+    options.ircd.rate = std::max(parser.value("rate").toInt(), 0);
+    options.ircd.netsplitInterval = std::max(parser.value("netsplit-interval").toInt(), 0);
+    options.ircd.scriptFile = parser.value("script");
+
+    LoadTest loadTest(options);
+    QTimer::singleShot(0, &loadTest, &LoadTest::start);
+    app.exec();
+    return loadTest.exitCode();
+}
+
+#include "loadtest.moc"
@@ -0,0 +1,178 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2022 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <vector>
+
+#include "testglobal.h"
+#include "chatlinerefiner.h"
+
+//! Lines with an estimated height of 10, which turns out to be exactHeight once laid out
+class TestLines : public ChatLineRefiner
+{
+public:
+    struct Line
+    {
+        qreal top;
+        qreal height;
+        bool estimated;
+    };
+
+    TestLines(int count, qreal exactHeight)
+        : _exactHeight(exactHeight)
+    {
+        for (int row = 0; row < count; row++)
+            lines.push_back({row * 10.0, 10, true});
+    }
+
+    //! Returns the rows that have been laid out exactly
+    std::vector<int> exactRows() const
+    {
+        std::vector<int> rows;
+        for (int row = 0; row < static_cast<int>(lines.size()); row++) {
+            if (!lines[row].estimated)
+                rows.push_back(row);
+        }
+        return rows;
+    }
+
+    //! Checks that the lines are stacked without gaps or overlaps
+    void expectStacked() const
+    {
+        for (size_t row = 1; row < lines.size(); row++) {
+            EXPECT_EQ(lines[row - 1].top + lines[row - 1].height, lines[row].top) << "row " << row;
+        }
+    }
+
+    std::vector<Line> lines;
+
+protected:
+    int lineCount() const override { return static_cast<int>(lines.size()); }
+    qreal lineTop(int row) const override { return lines[row].top; }
+    qreal lineHeight(int row) const override { return lines[row].height; }
+    bool needsLayout(int row) const override { return lines[row].estimated; }
+
+    qreal layoutLine(int row, qreal bottom) override
+    {
+        lines[row] = {bottom - _exactHeight, _exactHeight, false};
+        return _exactHeight;
+    }
+
+    void moveLine(int row, qreal top) override { lines[row].top = top; }
+
+private:
+    qreal _exactHeight;
+};
+
+namespace {
+
+std::vector<int> range(int first, int last)
+{
+    std::vector<int> rows;
+    for (int row = first; row <= last; row++)
+        rows.push_back(row);
+    return rows;
+}
+
+}  // namespace
+
+TEST(ChatLineRefinerTest, empty)
+{
+    TestLines lines(0, 20);
+    auto result = lines.refine(0, 100, false);
+    EXPECT_FALSE(result.changed);
+    EXPECT_EQ(0, result.offset);
+}
+
+TEST(ChatLineRefinerTest, refineAroundViewport)
+{
+    TestLines lines(100, 20);
+
+    // The viewport shows rows 50 to 59, one viewport height is added above and below
+    auto result = lines.refine(500, 100, false);
+    EXPECT_TRUE(result.changed);
+    EXPECT_EQ(range(40, 69), lines.exactRows());
+    lines.expectStacked();
+
+    // The bottom of the window stays in place, so do the lines below it
+    EXPECT_EQ(700, lines.lines[70].top);
+    EXPECT_EQ(990, lines.lines[99].top);
+
+    // Rows 50 to 69 doubled in height, which moved row 50 up by 200
+    EXPECT_EQ(300, lines.lines[50].top);
+    EXPECT_EQ(200, result.offset);
+    EXPECT_EQ(-300, lines.lines[0].top);
+
+    // Once the view has scrolled by the offset, there's nothing left to do
+    result = lines.refine(300, 100, false);
+    EXPECT_FALSE(result.changed);
+    EXPECT_EQ(0, result.offset);
+}
+
+TEST(ChatLineRefinerTest, scrollUp)
+{
+    TestLines lines(100, 20);
+    lines.refine(500, 100, false);
+    ASSERT_EQ(100, lines.lines[40].top);
+
+    // Row 30 is at the top of the viewport now, rows 20 to 44 are in the window, of which rows 40 to 44 are exact already
+    ASSERT_EQ(0, lines.lines[30].top);
+    auto result = lines.refine(0, 100, false);
+    EXPECT_TRUE(result.changed);
+    EXPECT_EQ(range(20, 69), lines.exactRows());
+    lines.expectStacked();
+    EXPECT_EQ(100, lines.lines[40].top);
+    EXPECT_EQ(-100, lines.lines[30].top);
+    EXPECT_EQ(100, result.offset);
+}
+
+TEST(ChatLineRefinerTest, shrinkingLines)
+{
+    TestLines lines(100, 5);
+
+    // Lines getting shorter move the contents down, so the view has to scroll down
+    auto result = lines.refine(500, 100, false);
+    EXPECT_EQ(range(40, 69), lines.exactRows());
+    lines.expectStacked();
+    EXPECT_EQ(600, lines.lines[50].top);
+    EXPECT_EQ(-100, result.offset);
+}
+
+TEST(ChatLineRefinerTest, followBottom)
+{
+    TestLines lines(100, 20);
+
+    // The view position is ignored, the window covers the last two viewport heights
+    auto result = lines.refine(0, 100, true);
+    EXPECT_TRUE(result.changed);
+    EXPECT_EQ(range(80, 99), lines.exactRows());
+    lines.expectStacked();
+    EXPECT_EQ(1000, lines.lines[99].top + lines.lines[99].height);
+    EXPECT_EQ(0, result.offset);
+}
+
+TEST(ChatLineRefinerTest, viewportBelowLines)
+{
+    TestLines lines(10, 20);
+
+    // Nothing is near the viewport
+    auto result = lines.refine(500, 100, false);
+    EXPECT_FALSE(result.changed);
+    EXPECT_TRUE(lines.exactRows().empty());
+}